@@ -1,25 +1,33 @@
 #version 450 core
+#extension GL_EXT_nonuniform_qualifier : require
 
-layout (set = 2, binding = 0) uniform Parameters {
-    float alphaCutoff;
-    bool doubleSided;
-    vec3 emissiveFactor;
+struct Material {
     vec4 baseColorFactor;
+    vec3 emissiveFactor;
+    float alphaCutoff;
     float roughnessFactor;
     float metallicFactor;
-} parameters;
+    uint doubleSided;
+    uint emissiveTexture;
+    uint normalTexture;
+    uint occlusionTexture;
+    uint baseColorTexture;
+    uint metallicRoughnessTexture;
+};
+
+layout (std430, set = 2, binding = 0) readonly buffer Materials {
+    Material materials[];
+};
 
-layout (set = 2, binding = 1) uniform sampler2D emissiveTexture;
-layout (set = 2, binding = 2) uniform sampler2D normalTexture;
-layout (set = 2, binding = 3) uniform sampler2D occlusionTexture;
-layout (set = 2, binding = 4) uniform sampler2D baseColorTexture;
-layout (set = 2, binding = 5) uniform sampler2D metallicRoughnessTexture;
+layout (set = 2, binding = 1) uniform sampler2D textures[];
 
 layout (location = 0) in vec2 texCoord;
+layout (location = 1) flat in uint materialIndex;
 
 layout (location = 0) out vec4 color;
 
 void main() {
-	color = texture(baseColorTexture, texCoord);
-    if (color.a < parameters.alphaCutoff) discard;
+    Material material = materials[materialIndex];
+	color = texture(textures[material.baseColorTexture], texCoord);
+    if (color.a < material.alphaCutoff) discard;
 }
\ No newline at end of file
@@ -1,8 +1,10 @@
 #version 450 core
 
+// Encoded as described by VertexFormat, attributes a mesh lacks come from its defaults. Positions may be unorm16 in
+// the mesh's bounds, normal and tangent are octahedral, the tangent's bitangent sign folded into y.
 layout (location = 0) in vec3 position;
-layout (location = 1) in vec3 normal;
-layout (location = 2) in vec4 tangent;
+layout (location = 1) in vec2 normal;
+layout (location = 2) in vec2 tangent;
 
 layout (location = 3) in vec2 tex_coord_0;
 layout (location = 4) in vec2 tex_coord_1;
@@ -16,13 +18,30 @@ layout (set = 0, binding = 0) uniform Camera {
     mat4 inverseProj;
 } camera;
 
-layout (set = 1, binding = 0) uniform Object{
-    mat4 model;
-} object;
+layout (std430, set = 1, binding = 0) readonly buffer Objects {
+    mat4 models[];
+};
+
+struct DrawData {
+    vec3 positionOffset;
+    uint transformIndex;
+    vec3 positionScale;
+    uint materialIndex;
+};
+
+// Indexed by gl_InstanceIndex, every draw passes its index in the draw list as firstInstance
+layout (std430, set = 3, binding = 0) readonly buffer Draws {
+    DrawData draws[];
+};
+
 layout (location = 0) out vec2 tex_coord;
+layout (location = 1) flat out uint materialIndex;
 
 void main()
 {
+    DrawData draw = draws[gl_InstanceIndex];
     tex_coord = tex_coord_0;
-	gl_Position = camera.proj * camera.view * object.model * vec4(position, 1.0);
+    materialIndex = draw.materialIndex;
+    vec3 objectPosition = position * draw.positionScale + draw.positionOffset;
+	gl_Position = camera.proj * camera.view * models[draw.transformIndex] * vec4(objectPosition, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,6 @@
+#!/bin/sh
+cd "$(dirname "$0")"
+mkdir -p compiled
+find . -path ./compiled -prune -o -type f \( -name '*.vert' -o -name '*.frag' -o -name '*.comp' -o -name '*.tese' -o -name '*.tesc' \) -print | while read -r shader; do
+    glslangValidator -V "$shader" -o "compiled/$(basename "$shader").spv" || exit 1
+done
@@ -1,13 +1,7 @@
 #version 450 core
 
+// Reads the position stream only. The square it draws keeps float positions, so there is nothing to dequantize.
 layout (location = 0) in vec3 position;
-layout (location = 1) in vec3 normal;
-layout (location = 2) in vec4 tangent;
-
-layout (location = 3) in vec2 tex_coord_0;
-layout (location = 4) in vec2 tex_coord_1;
-
-layout (location = 5) in vec3 color_0;
 
 layout (set = 1, binding = 0) uniform Config {
     int size;
@@ -0,0 +1,150 @@
+#include "accessorBenchmark.hpp"
+
+#include "../engine/graphics/mesh.hpp"
+#include "../loader/accessorReader.hpp"
+#include "../log.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace ve {
+    namespace {
+        using ComponentType = GLTFDocument::ComponentType;
+        using AccessorType = GLTFDocument::AccessorType;
+        using Vertex = Mesh::Vertex;
+
+        struct Case {
+            std::string name;
+            uint32_t accessor;
+            // Offset of the attribute in Vertex and its width in floats
+            size_t vertexOffset;
+            uint32_t componentCount;
+        };
+
+        // Appends a buffer view of count elements of elementSize bytes, stride apart, filled with random bytes.
+        // Floats come out as random but finite values.
+        uint32_t addBufferView(GLTFDocument &document, std::vector<uint8_t> &bytes, std::mt19937 &random,
+                               const size_t count, const size_t elementSize, const size_t stride, const bool floats) {
+            // glTF aligns buffer views to 4 bytes
+            bytes.resize((bytes.size() + 3) & ~size_t(3));
+            GLTFDocument::BufferView bufferView{};
+            bufferView.buffer = 0;
+            bufferView.byteOffset = bytes.size();
+            bufferView.byteLength = (count - 1) * stride + elementSize;
+            bufferView.byteStride = stride == elementSize ? 0 : stride;
+            bytes.resize(bytes.size() + bufferView.byteLength);
+
+            std::uniform_real_distribution<float> value(-100.0f, 100.0f);
+            for (size_t i = bufferView.byteOffset; i + 4 <= bytes.size(); i += 4) {
+                if (floats) {
+                    const float number = value(random);
+                    std::memcpy(&bytes[i], &number, 4);
+                } else {
+                    const uint32_t bits = random();
+                    std::memcpy(&bytes[i], &bits, 4);
+                }
+            }
+            document.bufferViews.push_back(bufferView);
+            return static_cast<uint32_t>(document.bufferViews.size() - 1);
+        }
+    }
+
+    void AccessorBenchmark::run(const uint32_t vertexCount, const uint32_t iterations) {
+        std::mt19937 random(42);
+        GLTFDocument document;
+        std::vector<uint8_t> bytes;
+        std::vector<Case> cases;
+
+        const auto addAccessor = [&](const std::string &name, const ComponentType componentType, const AccessorType type,
+                                     const bool normalized, const size_t stride, const size_t vertexOffset) {
+            const uint32_t componentCount = GLTFDocument::getComponentCount(type);
+            const size_t elementSize = GLTFDocument::getComponentSize(componentType) * componentCount;
+            GLTFDocument::Accessor accessor{};
+            accessor.bufferView = addBufferView(document, bytes, random, vertexCount, elementSize,
+                                                stride == 0 ? elementSize : stride, componentType == ComponentType::Float);
+            accessor.componentType = componentType;
+            accessor.type = type;
+            accessor.normalized = normalized;
+            accessor.count = vertexCount;
+            document.accessors.push_back(accessor);
+            cases.push_back({name, static_cast<uint32_t>(document.accessors.size() - 1), vertexOffset, componentCount});
+            return &document.accessors.back();
+        };
+
+        addAccessor("float VEC3", ComponentType::Float, AccessorType::Vec3, false, 0, offsetof(Vertex, position));
+        addAccessor("float VEC3, stride 32", ComponentType::Float, AccessorType::Vec3, false, 32, offsetof(Vertex, normal));
+        addAccessor("normalized SHORT VEC3", ComponentType::Short, AccessorType::Vec3, true, 8, offsetof(Vertex, normal));
+        addAccessor("UNSIGNED_SHORT VEC3 (quantized)", ComponentType::UnsignedShort, AccessorType::Vec3, false, 8,
+                    offsetof(Vertex, position));
+        addAccessor("normalized BYTE VEC4", ComponentType::Byte, AccessorType::Vec4, true, 0, offsetof(Vertex, tangent));
+        addAccessor("normalized UNSIGNED_SHORT VEC2", ComponentType::UnsignedShort, AccessorType::Vec2, true, 0,
+                    offsetof(Vertex, tex_coord_0));
+
+        // Every 100th vertex replaced
+        auto *sparse = addAccessor("float VEC3, 1% sparse", ComponentType::Float, AccessorType::Vec3, false, 0,
+                                   offsetof(Vertex, position));
+        GLTFDocument::Sparse sparseData{};
+        sparseData.count = vertexCount / 100;
+        sparseData.indicesComponentType = ComponentType::UnsignedInt;
+        sparseData.indicesBufferView = addBufferView(document, bytes, random, sparseData.count, 4, 4, false);
+        sparseData.valuesBufferView = addBufferView(document, bytes, random, sparseData.count, 12, 12, true);
+        for (size_t i = 0; i < sparseData.count; i++) {
+            const auto index = static_cast<uint32_t>(i * 100);
+            std::memcpy(&bytes[document.bufferViews[sparseData.indicesBufferView].byteOffset + i * 4], &index, 4);
+        }
+        sparse->sparse = sparseData;
+
+        document.buffers.push_back({"", bytes.size()});
+        const std::vector<BufferData> buffers{{bytes.data(), bytes.size()}};
+
+        std::vector<Vertex> expected(vertexCount);
+        std::vector<Vertex> vertices(vertexCount);
+        for (const auto &benchmarkCase : cases) {
+            const auto read = [&](const AccessorReader &reader, std::vector<Vertex> &destination) {
+                const auto accessor = reader.get(benchmarkCase.accessor);
+                auto *output = reinterpret_cast<uint8_t *>(destination.data()) + benchmarkCase.vertexOffset;
+                if (benchmarkCase.componentCount == 2) {
+                    reader.read(accessor, 0, vertexCount, reinterpret_cast<glm::vec2 *>(output), sizeof(Vertex));
+                } else if (benchmarkCase.componentCount == 3) {
+                    reader.read(accessor, 0, vertexCount, reinterpret_cast<glm::vec3 *>(output), sizeof(Vertex),
+                                glm::vec3(-1.0f, 1.0f, 1.0f));
+                } else {
+                    reader.read(accessor, 0, vertexCount, reinterpret_cast<glm::vec4 *>(output), sizeof(Vertex));
+                }
+            };
+
+            read(AccessorReader(document, buffers, AccessorReader::Path::Scalar), expected);
+
+            for (const auto path : {AccessorReader::Path::Scalar, AccessorReader::Path::Sse}) {
+                const std::string name = benchmarkCase.name + " " + AccessorReader::getPathName(path);
+                if (!AccessorReader::isSupported(path)) {
+                    Log::info("Accessors " + name + ": not supported");
+                    continue;
+                }
+
+                const AccessorReader reader(document, buffers, path);
+                read(reader, vertices);
+                if (std::memcmp(vertices.data(), expected.data(), vertices.size() * sizeof(Vertex)) != 0) {
+                    Log::error("Accessors " + name + " disagrees with the scalar path");
+                    throw std::runtime_error("");
+                }
+
+                const auto start = std::chrono::high_resolution_clock::now();
+                for (uint32_t i = 0; i < iterations; i++) {
+                    read(reader, vertices);
+                }
+                const std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+                std::ostringstream message;
+                message << "Accessors " << name << ": "
+                        << static_cast<double>(vertexCount) * iterations / elapsed.count() / 1e6 << " M vertices/s";
+                Log::info(message.str());
+            }
+        }
+    }
+} // ve
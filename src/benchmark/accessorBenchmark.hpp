@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+
+namespace ve {
+    // Micro-benchmark of AccessorReader run by --bench-accessors: decodes synthetic accessors of the layouts found in
+    // glTF files, plain, interleaved, quantized and sparse, into Mesh::Vertex arrays with every path the CPU
+    // supports, checks them against the scalar path and logs the throughput in vertices per second.
+    class AccessorBenchmark {
+    public:
+        static void run(uint32_t vertexCount = 1 << 18, uint32_t iterations = 50);
+    };
+} // ve
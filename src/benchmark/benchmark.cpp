@@ -0,0 +1,198 @@
+#include "benchmark.hpp"
+
+#include "../engine/profiling/json.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+
+namespace ve {
+    Benchmark::Benchmark(const LaunchOptions &options, const float deltaTime)
+        : outputPath(options.outputPath), warmupFrames(options.warmupFrames), deltaTime(deltaTime) {
+        samples.reserve(options.frameCount);
+    }
+
+    void Benchmark::addFrame(const FrameTimings &timings, const float frameTime) {
+        if (timings.frameNumber < warmupFrames) {
+            return;
+        }
+
+        samples.push_back({
+            timings.frameNumber - warmupFrames,
+            frameTime,
+            timings.recordTime,
+            timings.submitTime,
+            timings.presentWaitTime
+        });
+    }
+
+    void Benchmark::addGpuTimes(const std::vector<GpuFrameTime> &gpuTimes) {
+        for (const auto &[frameNumber, gpuTime] : gpuTimes) {
+            if (frameNumber < warmupFrames) {
+                continue;
+            }
+
+            const uint64_t sample = frameNumber - warmupFrames;
+            if (sample < samples.size()) {
+                samples[sample].gpuTime = gpuTime;
+            }
+        }
+    }
+
+    void Benchmark::addGpuScopes(const std::vector<GpuProfiler::FrameResults> &frames) {
+        for (const auto &frame : frames) {
+            if (frame.frameNumber < warmupFrames) {
+                continue;
+            }
+
+            for (const auto &result : frame.scopes) {
+                auto scope = std::find_if(scopes.begin(), scopes.end(), [&](const ScopeSamples &samples) {
+                    return samples.path == result.path;
+                });
+                if (scope == scopes.end()) {
+                    scopes.push_back({ result.path });
+                    scope = scopes.end() - 1;
+                }
+
+                if (result.time >= 0.0f) {
+                    scope->times.push_back(result.time);
+                }
+                if (result.hasStatistics) {
+                    scope->frames++;
+                    scope->vertexInvocations += result.vertexInvocations;
+                    scope->clippingInvocations += result.clippingInvocations;
+                    scope->clippingPrimitives += result.clippingPrimitives;
+                    scope->fragmentInvocations += result.fragmentInvocations;
+                }
+            }
+        }
+    }
+
+    Benchmark::Summary Benchmark::summarize(std::vector<float> values) {
+        Summary summary{};
+        summary.count = values.size();
+        if (values.empty()) {
+            return summary;
+        }
+
+        std::sort(values.begin(), values.end());
+
+        // Nearest rank, so every reported percentile is a frame that actually happened
+        auto percentile = [&](const float p) {
+            const auto rank = static_cast<size_t>(std::ceil(p * static_cast<float>(values.size())));
+            return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
+        };
+
+        summary.mean = static_cast<float>(std::accumulate(values.begin(), values.end(), 0.0) / static_cast<double>(values.size()));
+        summary.p50 = percentile(0.50f);
+        summary.p95 = percentile(0.95f);
+        summary.p99 = percentile(0.99f);
+        summary.max = values.back();
+        return summary;
+    }
+
+    static void writeSummary(std::ofstream &file, const std::string &name, const Benchmark::Summary &summary, const bool last) {
+        file << "    \"" << escapeJson(name) << "\": { "
+             << "\"mean\": " << summary.mean << ", "
+             << "\"p50\": " << summary.p50 << ", "
+             << "\"p95\": " << summary.p95 << ", "
+             << "\"p99\": " << summary.p99 << ", "
+             << "\"max\": " << summary.max << ", "
+             << "\"count\": " << summary.count << " }" << (last ? "\n" : ",\n");
+
+        Log::info(name + ": mean " + std::to_string(summary.mean) + " ms, p50 " + std::to_string(summary.p50) +
+                  " ms, p95 " + std::to_string(summary.p95) + " ms, p99 " + std::to_string(summary.p99) +
+                  " ms, max " + std::to_string(summary.max) + " ms");
+    }
+
+    void Benchmark::write(const std::string &sceneName, const std::string &deviceName, const VkExtent2D extent,
+                          const VkSampleCountFlagBits sampleCount, const bool vsync) const {
+        std::vector<float> frameTimes, recordTimes, submitTimes, presentWaitTimes, gpuTimes;
+        for (const auto &sample : samples) {
+            frameTimes.push_back(sample.frameTime);
+            recordTimes.push_back(sample.recordTime);
+            submitTimes.push_back(sample.submitTime);
+            presentWaitTimes.push_back(sample.presentWaitTime);
+            if (sample.gpuTime >= 0.0f) {
+                gpuTimes.push_back(sample.gpuTime);
+            }
+        }
+
+        // The format follows the extension of --output, the other one is written next to it
+        std::filesystem::path path(outputPath);
+        const bool csvRequested = path.extension() == ".csv";
+        const std::string jsonPath = csvRequested ? std::filesystem::path(path).replace_extension(".json").string() : outputPath;
+        const std::string csvPath = csvRequested ? outputPath : std::filesystem::path(path).replace_extension(".csv").string();
+
+        std::ofstream json(jsonPath);
+        if (!json.is_open()) {
+            Log::error("Failed to open benchmark output " + jsonPath);
+            throw std::runtime_error("");
+        }
+
+        json << "{\n"
+             << "  \"scene\": \"" << escapeJson(sceneName) << "\",\n"
+             << "  \"device\": \"" << escapeJson(deviceName) << "\",\n"
+             << "  \"resolution\": [" << extent.width << ", " << extent.height << "],\n"
+             << "  \"msaaSamples\": " << static_cast<uint32_t>(sampleCount) << ",\n"
+             << "  \"vsync\": " << (vsync ? "true" : "false") << ",\n"
+             << "  \"deltaTime\": " << deltaTime << ",\n"
+             << "  \"warmupFrames\": " << warmupFrames << ",\n"
+             << "  \"frames\": " << samples.size() << ",\n"
+             << "  \"summary\": {\n";
+        writeSummary(json, "frameTime", summarize(frameTimes), false);
+        writeSummary(json, "recordTime", summarize(recordTimes), false);
+        writeSummary(json, "submitTime", summarize(submitTimes), false);
+        writeSummary(json, "presentWaitTime", summarize(presentWaitTimes), false);
+        writeSummary(json, "gpuTime", summarize(gpuTimes), true);
+        json << "  },\n";
+
+        // Statistics are per-frame averages
+        json << "  \"gpuScopes\": {\n";
+        for (size_t i = 0; i < scopes.size(); i++) {
+            const ScopeSamples &scope = scopes[i];
+            const Summary time = summarize(scope.times);
+            const double frames = static_cast<double>(std::max<uint64_t>(scope.frames, 1));
+
+            json << "    \"" << escapeJson(scope.path) << "\": { "
+                 << "\"mean\": " << time.mean << ", "
+                 << "\"p50\": " << time.p50 << ", "
+                 << "\"p95\": " << time.p95 << ", "
+                 << "\"p99\": " << time.p99 << ", "
+                 << "\"max\": " << time.max << ", "
+                 << "\"count\": " << time.count;
+            if (scope.frames > 0) {
+                json << ", \"vertexInvocations\": " << static_cast<double>(scope.vertexInvocations) / frames
+                     << ", \"fragmentInvocations\": " << static_cast<double>(scope.fragmentInvocations) / frames
+                     << ", \"clippingInvocations\": " << static_cast<double>(scope.clippingInvocations) / frames
+                     << ", \"clippingPrimitives\": " << static_cast<double>(scope.clippingPrimitives) / frames;
+            }
+            json << " }" << (i + 1 < scopes.size() ? ",\n" : "\n");
+        }
+        json << "  }\n"
+             << "}\n";
+
+        std::ofstream csv(csvPath);
+        if (!csv.is_open()) {
+            Log::error("Failed to open benchmark output " + csvPath);
+            throw std::runtime_error("");
+        }
+
+        csv << "frame,frameTime,recordTime,submitTime,presentWaitTime,gpuTime\n";
+        for (const auto &sample : samples) {
+            csv << sample.frameNumber << ','
+                << sample.frameTime << ','
+                << sample.recordTime << ','
+                << sample.submitTime << ','
+                << sample.presentWaitTime << ',';
+            if (sample.gpuTime >= 0.0f) {
+                csv << sample.gpuTime;
+            }
+            csv << '\n';
+        }
+
+        Log::info("Benchmark results written to " + jsonPath + " and " + csvPath);
+    }
+} // ve
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "../engine/renderer.hpp"
+#include "../engine/launchOptions.hpp"
+
+#include <string>
+#include <vector>
+
+namespace ve {
+    // Collects per-frame timings of a benchmark run. Summary statistics go to a JSON file, the raw
+    // samples to a CSV file next to it.
+    class Benchmark {
+    public:
+        struct FrameSample {
+            uint64_t frameNumber;
+            float frameTime;
+            float recordTime;
+            float submitTime;
+            float presentWaitTime;
+            // Negative until the GPU timestamps of the frame have been resolved
+            float gpuTime = -1.0f;
+        };
+
+        struct Summary {
+            float mean = 0.0f;
+            float p50 = 0.0f;
+            float p95 = 0.0f;
+            float p99 = 0.0f;
+            float max = 0.0f;
+            size_t count = 0;
+        };
+
+        Benchmark(const LaunchOptions &options, float deltaTime);
+
+        void addFrame(const FrameTimings &timings, float frameTime);
+        void addGpuTimes(const std::vector<GpuFrameTime> &gpuTimes);
+        void addGpuScopes(const std::vector<GpuProfiler::FrameResults> &frames);
+
+        void write(const std::string &sceneName, const std::string &deviceName, VkExtent2D extent,
+                   VkSampleCountFlagBits sampleCount, bool vsync) const;
+
+        static Summary summarize(std::vector<float> values);
+
+    private:
+        std::string outputPath;
+        uint32_t warmupFrames;
+        float deltaTime;
+
+        std::vector<FrameSample> samples{};
+
+        struct ScopeSamples {
+            std::string path;
+            std::vector<float> times{};
+            uint64_t frames = 0;
+            uint64_t vertexInvocations = 0;
+            uint64_t clippingInvocations = 0;
+            uint64_t clippingPrimitives = 0;
+            uint64_t fragmentInvocations = 0;
+        };
+        // In the order the scopes were first seen
+        std::vector<ScopeSamples> scopes{};
+    };
+} // ve
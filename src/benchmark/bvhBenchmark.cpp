@@ -0,0 +1,142 @@
+#include "bvhBenchmark.hpp"
+
+#include "../log.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <stdexcept>
+
+namespace ve {
+    static constexpr uint32_t BUILD_RUNS = 10;
+    static constexpr uint32_t QUERY_RUNS = 100;
+    static constexpr uint32_t OVERLAP_QUERIES = 1000;
+
+    template<typename Function>
+    static double timeMicroseconds(const Function &function) {
+        const auto start = std::chrono::high_resolution_clock::now();
+        function();
+        const std::chrono::duration<double, std::micro> elapsed = std::chrono::high_resolution_clock::now() - start;
+        return elapsed.count();
+    }
+
+    void BvhBenchmark::run(const std::vector<Bvh::Box> &boxes, const std::vector<glm::mat4> &viewProjections,
+                           const std::vector<Bvh::Ray> &rays) {
+        if (boxes.empty()) {
+            Log::warning("BVH benchmark: the scene has no draws");
+            return;
+        }
+
+        Bvh bvh;
+        std::ostringstream message;
+
+        const double serialBuild = timeMicroseconds([&] {
+            for (uint32_t i = 0; i < BUILD_RUNS; i++) {
+                bvh.build(boxes, false);
+            }
+        }) / BUILD_RUNS;
+        const double parallelBuild = timeMicroseconds([&] {
+            for (uint32_t i = 0; i < BUILD_RUNS; i++) {
+                bvh.build(boxes, true);
+            }
+        }) / BUILD_RUNS;
+        const double refit = timeMicroseconds([&] {
+            for (uint32_t i = 0; i < BUILD_RUNS; i++) {
+                bvh.refit(boxes);
+            }
+        }) / BUILD_RUNS;
+
+        message << "BVH over " << boxes.size() << " draws: " << bvh.getNodes().size() << " nodes, depth "
+                << bvh.getDepth() << ", build " << serialBuild / 1000.0 << " ms serial, " << parallelBuild / 1000.0
+                << " ms parallel, refit " << refit / 1000.0 << " ms";
+        Log::info(message.str());
+
+        if (!viewProjections.empty()) {
+            FrustumCuller culler;
+            for (const auto &box : boxes) {
+                culler.add(box.min, box.max);
+            }
+
+            std::vector<FrustumCuller::Planes> planes;
+            std::vector<uint32_t> expected;
+            std::vector<uint32_t> visible;
+            size_t visibleTotal = 0;
+            for (const auto &viewProjection : viewProjections) {
+                planes.push_back(FrustumCuller::getFrustumPlanes(viewProjection));
+
+                expected.clear();
+                culler.cull(viewProjection, expected);
+                visible.clear();
+                bvh.queryFrustum(planes.back(), visible);
+                std::sort(visible.begin(), visible.end());
+                if (visible != expected) {
+                    Log::error("BVH frustum query disagrees with FrustumCuller");
+                    throw std::runtime_error("");
+                }
+                visibleTotal += visible.size();
+            }
+
+            const double hierarchyTime = timeMicroseconds([&] {
+                for (uint32_t run = 0; run < QUERY_RUNS; run++) {
+                    for (const auto &frustum : planes) {
+                        visible.clear();
+                        bvh.queryFrustum(frustum, visible);
+                    }
+                }
+            });
+            const double flatTime = timeMicroseconds([&] {
+                for (uint32_t run = 0; run < QUERY_RUNS; run++) {
+                    for (const auto &viewProjection : viewProjections) {
+                        visible.clear();
+                        culler.cull(viewProjection, visible);
+                    }
+                }
+            });
+
+            const double queries = static_cast<double>(QUERY_RUNS) * viewProjections.size();
+            message.str("");
+            message << "Frustum queries: " << visibleTotal / viewProjections.size() << " draws visible on average, "
+                    << hierarchyTime / queries << " us per BVH query, " << flatTime / queries << " us per "
+                    << FrustumCuller::getPathName(FrustumCuller::getBestPath()) << " pass over every draw";
+            Log::info(message.str());
+        }
+
+        if (!rays.empty()) {
+            uint32_t hits = 0;
+            const double rayTime = timeMicroseconds([&] {
+                for (uint32_t run = 0; run < QUERY_RUNS; run++) {
+                    hits = 0;
+                    for (const auto &ray : rays) {
+                        hits += bvh.raycast(ray).has_value() ? 1 : 0;
+                    }
+                }
+            });
+
+            message.str("");
+            message << "Ray casts: " << hits << " of " << rays.size() << " hit, "
+                    << static_cast<double>(QUERY_RUNS) * rays.size() / rayTime << " rays/us";
+            Log::info(message.str());
+        }
+
+        // The draw boxes themselves, each overlaps at least itself
+        const auto overlapQueries = static_cast<uint32_t>(std::min<size_t>(boxes.size(), OVERLAP_QUERIES));
+        const uint32_t stride = static_cast<uint32_t>(boxes.size()) / overlapQueries;
+        std::vector<uint32_t> overlapping;
+        size_t overlapTotal = 0;
+        const double overlapTime = timeMicroseconds([&] {
+            for (uint32_t run = 0; run < QUERY_RUNS; run++) {
+                overlapTotal = 0;
+                for (uint32_t i = 0; i < overlapQueries; i++) {
+                    overlapping.clear();
+                    bvh.queryOverlap(boxes[i * stride], overlapping);
+                    overlapTotal += overlapping.size();
+                }
+            }
+        });
+
+        message.str("");
+        message << "Overlap queries: " << overlapTotal / overlapQueries << " draws on average, "
+                << overlapTime / (static_cast<double>(QUERY_RUNS) * overlapQueries) << " us per query";
+        Log::info(message.str());
+    }
+} // ve
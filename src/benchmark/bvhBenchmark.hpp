@@ -0,0 +1,15 @@
+#pragma once
+
+#include "../engine/graphics/bvh.hpp"
+
+#include <vector>
+
+namespace ve {
+    // Run by --bench-bvh on the draw boxes of the loaded scene: times serial and parallel builds, refits and the
+    // three query types, frustum queries also against the flat FrustumCuller pass. Results go to the log.
+    class BvhBenchmark {
+    public:
+        static void run(const std::vector<Bvh::Box> &boxes, const std::vector<glm::mat4> &viewProjections,
+                        const std::vector<Bvh::Ray> &rays);
+    };
+} // ve
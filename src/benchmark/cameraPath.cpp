@@ -0,0 +1,48 @@
+#include "cameraPath.hpp"
+
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+#include "../log.hpp"
+
+namespace ve {
+    static glm::vec3 catmullRom(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2, const glm::vec3 &p3, const float t) {
+        const float t2 = t * t;
+        const float t3 = t2 * t;
+        return 0.5f * (2.0f * p1 +
+                       (p2 - p0) * t +
+                       (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+                       (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+    }
+
+    CameraPath::CameraPath(std::vector<Keyframe> keyframes, const float duration)
+        : keyframes(std::move(keyframes)), duration(duration) {
+        if (this->keyframes.size() < 2) {
+            Log::error("A camera path needs at least 2 keyframes");
+            throw std::runtime_error("");
+        }
+        if (duration <= 0.0f) {
+            Log::error("Camera path duration must be positive");
+            throw std::runtime_error("");
+        }
+    }
+
+    CameraPath::Keyframe CameraPath::sample(const float time) const {
+        const auto count = static_cast<int>(keyframes.size());
+
+        const float wrapped = std::fmod(time, duration) / duration * static_cast<float>(count);
+        const int segment = static_cast<int>(wrapped) % count;
+        const float t = wrapped - std::floor(wrapped);
+
+        const Keyframe &k0 = keyframes[(segment + count - 1) % count];
+        const Keyframe &k1 = keyframes[segment];
+        const Keyframe &k2 = keyframes[(segment + 1) % count];
+        const Keyframe &k3 = keyframes[(segment + 2) % count];
+
+        return {
+            catmullRom(k0.position, k1.position, k2.position, k3.position, t),
+            catmullRom(k0.target, k1.target, k2.target, k3.target, t)
+        };
+    }
+} // ve
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace ve {
+    // Closed Catmull-Rom spline through camera keyframes. Sampling only depends on the time passed in,
+    // so runs stepped with a fixed delta time see the exact same views.
+    class CameraPath {
+    public:
+        struct Keyframe {
+            glm::vec3 position;
+            glm::vec3 target;
+        };
+
+        CameraPath(std::vector<Keyframe> keyframes, float duration);
+
+        // Wraps around after getDuration() seconds.
+        Keyframe sample(float time) const;
+        float getDuration() const { return duration; }
+
+    private:
+        std::vector<Keyframe> keyframes;
+        float duration;
+    };
+} // ve
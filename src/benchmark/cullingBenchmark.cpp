@@ -0,0 +1,64 @@
+#include "cullingBenchmark.hpp"
+
+#include "../engine/graphics/frustumCuller.hpp"
+#include "../log.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace ve {
+    void CullingBenchmark::run(const uint32_t objectCount, const uint32_t iterations) {
+        // Fixed seed, every run culls the same scene
+        std::mt19937 random(42);
+        std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+        std::uniform_real_distribution<float> size(0.1f, 4.0f);
+
+        FrustumCuller culler;
+        for (uint32_t i = 0; i < objectCount; i++) {
+            const glm::vec3 min(position(random), position(random), position(random));
+            culler.add(min, min + glm::vec3(size(random), size(random), size(random)));
+        }
+
+        const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 150.0f);
+        const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, -60.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        const glm::mat4 viewProjection = projection * view;
+
+        std::vector<uint32_t> expected;
+        culler.cull(FrustumCuller::Path::Scalar, viewProjection, expected);
+
+        std::vector<uint32_t> visible;
+        visible.reserve(objectCount);
+        for (const auto path : {FrustumCuller::Path::Scalar, FrustumCuller::Path::Sse, FrustumCuller::Path::Avx}) {
+            const std::string name = FrustumCuller::getPathName(path);
+            if (!FrustumCuller::isSupported(path)) {
+                Log::info("Culling " + name + ": not supported");
+                continue;
+            }
+
+            visible.clear();
+            culler.cull(path, viewProjection, visible);
+            if (visible != expected) {
+                Log::error("Culling " + name + " disagrees with the scalar path");
+                throw std::runtime_error("");
+            }
+
+            const auto start = std::chrono::high_resolution_clock::now();
+            for (uint32_t i = 0; i < iterations; i++) {
+                visible.clear();
+                culler.cull(path, viewProjection, visible);
+            }
+            const std::chrono::duration<double, std::micro> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+            std::ostringstream message;
+            message << "Culling " << name << ": " << visible.size() << " of " << objectCount << " visible, "
+                    << elapsed.count() / iterations << " us per pass, "
+                    << static_cast<double>(objectCount) * iterations / elapsed.count() << " objects/us";
+            Log::info(message.str());
+        }
+    }
+} // ve
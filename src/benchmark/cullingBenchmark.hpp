@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+
+namespace ve {
+    // Micro-benchmark of FrustumCuller run by --bench-culling: culls random boxes with every path the CPU supports,
+    // checks them against the scalar path and logs the throughput in objects per microsecond.
+    class CullingBenchmark {
+    public:
+        static void run(uint32_t objectCount = 100000, uint32_t iterations = 200);
+    };
+} // ve
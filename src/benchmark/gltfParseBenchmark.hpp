@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace ve {
+    // Benchmark of glTF document parsing run by --bench-gltf-parse: times the glTF SDK's Deserialize, which the loader
+    // used before, against GLTFDocument's simdjson parser on the same mapped .gltf file. Logs the best and median time
+    // of each and the throughput in MB/s.
+    class GltfParseBenchmark {
+    public:
+        static void run(const std::string &path, uint32_t iterations = 10);
+    };
+} // ve
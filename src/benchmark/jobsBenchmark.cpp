@@ -0,0 +1,105 @@
+#include "jobsBenchmark.hpp"
+
+#include "../engine/jobs/jobSystem.hpp"
+#include "../log.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include <vector>
+
+namespace ve {
+    static constexpr uint32_t RUNS = 5;
+    static constexpr uint32_t ELEMENT_COUNT = 1 << 22;
+    static constexpr uint32_t TINY_JOB_COUNT = 100000;
+    static constexpr uint32_t TREE_DEPTH = 14;
+
+    // Fork-join tree, every level spawns one half as a job and recurses into the other. Leaves land on whichever
+    // thread stole their parent.
+    static float treeSum(JobSystem &jobs, const uint32_t depth, const uint32_t seed) {
+        if (depth == 0) {
+            float sum = 0.0f;
+            for (uint32_t i = 0; i < 256; i++) {
+                sum += std::sqrt(static_cast<float>(seed + i));
+            }
+            return sum;
+        }
+
+        float left = 0.0f;
+        JobSystem::Counter counter;
+        jobs.run([&] { left = treeSum(jobs, depth - 1, seed * 2); }, &counter);
+        const float right = treeSum(jobs, depth - 1, seed * 2 + 1);
+        jobs.wait(counter);
+        return left + right;
+    }
+
+    template<typename Function>
+    static double bestMilliseconds(const Function &function) {
+        double best = 0.0;
+        for (uint32_t run = 0; run < RUNS; run++) {
+            const auto start = std::chrono::high_resolution_clock::now();
+            function();
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+            if (run == 0 || elapsed.count() < best) {
+                best = elapsed.count();
+            }
+        }
+        return best;
+    }
+
+    void JobsBenchmark::run() {
+        const uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<uint32_t> threadCounts;
+        for (uint32_t threads = 1; threads < maxThreads; threads *= 2) {
+            threadCounts.push_back(threads);
+        }
+        threadCounts.push_back(maxThreads);
+
+        std::vector<float> input(ELEMENT_COUNT);
+        for (uint32_t i = 0; i < ELEMENT_COUNT; i++) {
+            input[i] = static_cast<float>(i % 1024) * 0.01f;
+        }
+        std::vector<float> output(ELEMENT_COUNT);
+
+        double baseline[3] = {};
+        for (const uint32_t threads : threadCounts) {
+            JobSystem jobs(threads - 1);
+
+            // Plenty of independent math per element
+            const double parallelFor = bestMilliseconds([&] {
+                jobs.parallelFor(ELEMENT_COUNT, 0, [&](const uint32_t begin, const uint32_t end) {
+                    for (uint32_t i = begin; i < end; i++) {
+                        output[i] = std::sin(input[i]) * std::cos(input[i]) + std::sqrt(input[i]);
+                    }
+                });
+            });
+
+            // Nothing but scheduling overhead
+            std::atomic<uint32_t> ran{0};
+            const double tinyJobs = bestMilliseconds([&] {
+                JobSystem::Counter counter;
+                for (uint32_t i = 0; i < TINY_JOB_COUNT; i++) {
+                    jobs.run([&ran] { ran.fetch_add(1, std::memory_order_relaxed); }, &counter);
+                }
+                jobs.wait(counter);
+            });
+
+            float treeResult = 0.0f;
+            const double tree = bestMilliseconds([&] { treeResult = treeSum(jobs, TREE_DEPTH, 1); });
+
+            const double results[3] = {parallelFor, tinyJobs, tree};
+            if (threads == 1) {
+                std::copy(std::begin(results), std::end(results), baseline);
+            }
+
+            std::ostringstream message;
+            message << "Jobs with " << threads << " threads: parallel for " << parallelFor << " ms ("
+                    << baseline[0] / parallelFor << "x), " << TINY_JOB_COUNT << " empty jobs " << tinyJobs << " ms ("
+                    << baseline[1] / tinyJobs << "x), fork-join tree " << tree << " ms (" << baseline[2] / tree
+                    << "x)";
+            Log::info(message.str());
+        }
+    }
+} // ve
@@ -0,0 +1,10 @@
+#pragma once
+
+namespace ve {
+    // Scaling benchmark of the JobSystem run by --bench-jobs: the same workloads on systems of 1, 2, 4, ... threads up
+    // to the hardware thread count. Results go to the log as times and speedups over the single thread run.
+    class JobsBenchmark {
+    public:
+        static void run();
+    };
+} // ve
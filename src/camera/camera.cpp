@@ -38,6 +38,24 @@ void Camera::resize(uint32_t width, uint32_t height)
     recalculateProjection();
 }
 
+void Camera::setPose(const glm::vec3& position, const glm::vec3& direction)
+{
+    this->position = position;
+    forwardDirection = glm::normalize(direction);
+    moved = true;
+}
+
+void Camera::getRay(const glm::vec2& pixel, glm::vec3& origin, glm::vec3& direction) const
+{
+    const glm::vec2 ndc = pixel / glm::vec2(viewportSize) * 2.0f - 1.0f;
+    const glm::mat4 inverseViewProjection = inverseView * inverseProjection;
+
+    const glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndc, 0.0f, 1.0f);
+    const glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndc, 1.0f, 1.0f);
+    origin = glm::vec3(nearPoint) / nearPoint.w;
+    direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+}
+
 float Camera::getRotationSpeed()
 {
     return 5.0f;
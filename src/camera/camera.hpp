@@ -28,6 +28,7 @@ public:
 
     bool update(float deltaTime);
     void resize(uint32_t width, uint32_t height);
+    void setPose(const glm::vec3& position, const glm::vec3& direction);
 
     const glm::mat4& getProjection() const { return projection; }
     const glm::mat4& getInverseProjection() const { return inverseProjection; }
@@ -36,6 +37,8 @@ public:
 
     const glm::vec3& getPosition() const { return position; }
     const glm::vec3& getDirection() const { return forwardDirection; }
+    // World space ray through a pixel of the viewport, starting on the near plane
+    void getRay(const glm::vec2& pixel, glm::vec3& origin, glm::vec3& direction) const;
 
     float getRotationSpeed();
 private:
@@ -0,0 +1,275 @@
+#include "depthPyramid.hpp"
+
+#include <algorithm>
+
+static uint32_t previousPowerOfTwo(uint32_t value) {
+    uint32_t result = 1;
+    while (result * 2 <= value) {
+        result *= 2;
+    }
+    return result;
+}
+
+DepthPyramid::DepthPyramid(ve::Device &device) : device(device) {
+    createPipelineLayout();
+    createPipeline();
+    createSampler();
+}
+
+DepthPyramid::~DepthPyramid() {
+    destroyPyramid();
+    vkDestroySampler(device.getDevice(), sampler, nullptr);
+    vkDestroyPipelineLayout(device.getDevice(), pipelineLayout, nullptr);
+}
+
+VkDescriptorImageInfo DepthPyramid::getImageInfo() const {
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.sampler = sampler;
+    imageInfo.imageView = imageView;
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    return imageInfo;
+}
+
+void DepthPyramid::build(const ve::FrameInfo &frameInfo, VkImageView depthImageView, VkExtent2D extent,
+                         const glm::mat4 &viewProjection) {
+    VE_PROFILE_SCOPE("DepthPyramid::build");
+    const VkCommandBuffer commandBuffer = frameInfo.graphicsCommandBuffer;
+    ve::GpuProfiler::Scope scope(frameInfo.gpuProfiler, commandBuffer, "Depth pyramid");
+
+    if (extent.width != depthExtent.width || extent.height != depthExtent.height) {
+        createPyramid(extent);
+    }
+
+    // The culling of this frame has read the previous pyramid by now, a new pyramid also leaves UNDEFINED here
+    VkImageMemoryBarrier imageBarrier{};
+    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    imageBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    imageBarrier.oldLayout = valid ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED;
+    imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.image = image;
+    imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageBarrier.subresourceRange.baseMipLevel = 0;
+    imageBarrier.subresourceRange.levelCount = getLevelCount();
+    imageBarrier.subresourceRange.baseArrayLayer = 0;
+    imageBarrier.subresourceRange.layerCount = 1;
+
+    vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0,
+            0, nullptr,
+            0, nullptr,
+            1, &imageBarrier);
+
+    pipeline->bind(commandBuffer);
+
+    const bool multisampled = device.getSampleCount() != VK_SAMPLE_COUNT_1_BIT;
+    VkExtent2D sourceSize = extent;
+    for (uint32_t level = 0; level < getLevelCount(); level++) {
+        const VkExtent2D levelSize = {
+            std::max(1u, size.width >> level),
+            std::max(1u, size.height >> level)
+        };
+
+        PushConstants constants{};
+        constants.sourceSize = glm::ivec2(sourceSize.width, sourceSize.height);
+        constants.destinationSize = glm::ivec2(levelSize.width, levelSize.height);
+
+        ve::DescriptorWriter writer(*programLayout, frameInfo.frameDescriptorPool);
+
+        VkDescriptorImageInfo sourceInfo{};
+        sourceInfo.sampler = sampler;
+        if (level == 0) {
+            sourceInfo.imageView = depthImageView;
+            sourceInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+            writer.writeImage(multisampled ? 1 : 0, &sourceInfo);
+            constants.sampleCount = multisampled ? static_cast<uint32_t>(device.getSampleCount()) : 0;
+        } else {
+            sourceInfo.imageView = levelViews[level - 1];
+            sourceInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+            writer.writeImage(0, &sourceInfo);
+        }
+
+        VkDescriptorImageInfo destinationInfo{};
+        destinationInfo.imageView = levelViews[level];
+        destinationInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        writer.writeImage(2, &destinationInfo);
+
+        VkDescriptorSet levelDescriptorSet;
+        if (!writer.build(levelDescriptorSet)) {
+            Log::error("Failed to allocate depth pyramid descriptor set");
+            throw std::runtime_error("");
+        }
+
+        vkCmdBindDescriptorSets(
+                commandBuffer,
+                VK_PIPELINE_BIND_POINT_COMPUTE,
+                pipelineLayout,
+                0,
+                1,
+                &levelDescriptorSet,
+                0,
+                nullptr);
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &constants);
+        vkCmdDispatch(commandBuffer, (levelSize.width + 7) / 8, (levelSize.height + 7) / 8, 1);
+
+        // Each level is read by the next one, the last barrier also covers the culling of the next frame
+        VkMemoryBarrier memoryBarrier{};
+        memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        vkCmdPipelineBarrier(
+                commandBuffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0,
+                1, &memoryBarrier,
+                0, nullptr,
+                0, nullptr);
+
+        sourceSize = levelSize;
+    }
+
+    this->viewProjection = viewProjection;
+    valid = true;
+}
+
+void DepthPyramid::createPyramid(VkExtent2D extent) {
+    // Frames in flight may still sample the old pyramid
+    vkDeviceWaitIdle(device.getDevice());
+    destroyPyramid();
+
+    depthExtent = extent;
+    size = {previousPowerOfTwo(extent.width), previousPowerOfTwo(extent.height)};
+
+    uint32_t levelCount = 1;
+    while ((std::max(size.width, size.height) >> levelCount) > 0) {
+        levelCount++;
+    }
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = size.width;
+    imageInfo.extent.height = size.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = levelCount;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = VK_FORMAT_R32_SFLOAT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageAllocation);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = VK_FORMAT_R32_SFLOAT;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = levelCount;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(device.getDevice(), &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+        Log::error("Failed to create depth pyramid image view!");
+        throw std::runtime_error("");
+    }
+
+    levelViews.resize(levelCount);
+    for (uint32_t level = 0; level < levelCount; level++) {
+        viewInfo.subresourceRange.baseMipLevel = level;
+        viewInfo.subresourceRange.levelCount = 1;
+
+        if (vkCreateImageView(device.getDevice(), &viewInfo, nullptr, &levelViews[level]) != VK_SUCCESS) {
+            Log::error("Failed to create depth pyramid level view!");
+            throw std::runtime_error("");
+        }
+    }
+
+    valid = false;
+}
+
+void DepthPyramid::destroyPyramid() {
+    for (auto levelView : levelViews) {
+        vkDestroyImageView(device.getDevice(), levelView, nullptr);
+    }
+    levelViews.clear();
+
+    if (image != VK_NULL_HANDLE) {
+        vkDestroyImageView(device.getDevice(), imageView, nullptr);
+        vkDestroyImage(device.getDevice(), image, nullptr);
+        device.getAllocator().free(imageAllocation);
+        imageView = VK_NULL_HANDLE;
+        image = VK_NULL_HANDLE;
+    }
+}
+
+void DepthPyramid::createSampler() {
+    // Texels are fetched or sampled at exact levels, never filtered
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = samplerInfo.addressModeU;
+    samplerInfo.addressModeW = samplerInfo.addressModeU;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+    if (vkCreateSampler(device.getDevice(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+        Log::error("Failed to create depth pyramid sampler!");
+        throw std::runtime_error("");
+    }
+}
+
+void DepthPyramid::createPipelineLayout() {
+    // Only one of the two sources is written for a level, the shader picks it from the push constants
+    programLayout = ve::DescriptorSetLayout::Builder(device)
+        .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1,
+                    VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT)
+        .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1,
+                    VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT)
+        .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+        .build();
+
+    const VkDescriptorSetLayout layout = programLayout->getDescriptorSetLayout();
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &layout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(device.getDevice(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        Log::error("Failed to create pipeline layout!");
+        throw std::runtime_error("");
+    }
+}
+
+void DepthPyramid::createPipeline() {
+    if (programLayout == nullptr) {
+        Log::error("Cannot create pipeline before creating program layout!");
+        throw std::runtime_error("");
+    }
+
+    std::string shader = "shaders/compiled/depthPyramid.comp.spv";
+
+    pipeline = std::make_unique<ve::ComputePipeline>(device, shader, pipelineLayout);
+}
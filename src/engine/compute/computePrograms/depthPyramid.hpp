@@ -0,0 +1,65 @@
+#pragma once
+
+#include "../../../engine/device.hpp"
+#include "../../../engine/compute/computePipeline.hpp"
+#include "../../../engine/memory/descriptors.hpp"
+#include "../../../engine/renderer.hpp"
+
+#include <vector>
+
+// Hierarchical depth of the last rendered frame, every texel of a level holds the farthest depth of the texels it
+// covers in the level below. Level 0 is the largest power of two that fits the depth attachment, so a box that
+// spans at most one texel of some level is tested with four samples of it.
+class DepthPyramid {
+
+public:
+    explicit DepthPyramid(ve::Device& device);
+    ~DepthPyramid();
+
+    DepthPyramid(const DepthPyramid&) = delete;
+    DepthPyramid& operator=(const DepthPyramid&) = delete;
+
+    // Records the reduction of the frame's depth attachment after the render pass, the pyramid is recreated when
+    // the extent changes. Readers recorded after it on the same queue see the new pyramid. viewProjection is the
+    // matrix the frame was rendered with.
+    void build(const ve::FrameInfo& frameInfo, VkImageView depthImageView, VkExtent2D extent,
+               const glm::mat4& viewProjection);
+
+    // False until the first build, and again after the pyramid was recreated
+    bool isValid() const { return valid; }
+    VkDescriptorImageInfo getImageInfo() const;
+    VkExtent2D getSize() const { return size; }
+    uint32_t getLevelCount() const { return static_cast<uint32_t>(levelViews.size()); }
+    const glm::mat4& getViewProjection() const { return viewProjection; }
+
+private:
+    struct PushConstants {
+        glm::ivec2 sourceSize;
+        glm::ivec2 destinationSize;
+        // 0 reads the single sampled source, otherwise the number of samples of the multisampled depth
+        uint32_t sampleCount;
+    };
+
+    void createPipelineLayout();
+    void createPipeline();
+    void createSampler();
+    void createPyramid(VkExtent2D depthExtent);
+    void destroyPyramid();
+
+    ve::Device& device;
+    std::unique_ptr<ve::ComputePipeline> pipeline;
+    VkPipelineLayout pipelineLayout;
+
+    std::unique_ptr<ve::DescriptorSetLayout> programLayout;
+
+    VkSampler sampler = VK_NULL_HANDLE;
+    VkImage image = VK_NULL_HANDLE;
+    ve::Allocation imageAllocation{};
+    VkImageView imageView = VK_NULL_HANDLE;
+    std::vector<VkImageView> levelViews;
+
+    VkExtent2D depthExtent{0, 0};
+    VkExtent2D size{0, 0};
+    glm::mat4 viewProjection{1.0f};
+    bool valid = false;
+};
@@ -0,0 +1,263 @@
+#include "drawCulling.hpp"
+
+#include <algorithm>
+
+static constexpr uint32_t INITIAL_CAPACITY = 1024;
+
+DrawCulling::DrawCulling(ve::Device &device) : device(device) {
+    createPipelineLayout();
+    createPipeline();
+
+    for (auto &frame : frames) {
+        frame.params = std::make_unique<ve::Buffer>(
+                device,
+                sizeof(CullParams),
+                1,
+                VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        frame.params->map();
+
+        frame.counts = std::make_unique<ve::Buffer>(
+                device,
+                sizeof(Counts),
+                1,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        frame.readback = std::make_unique<ve::Buffer>(
+                device,
+                sizeof(Counts),
+                1,
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        frame.readback->map();
+
+        createVisibleCommands(frame, INITIAL_CAPACITY);
+    }
+}
+
+DrawCulling::~DrawCulling() {
+    vkDestroyPipelineLayout(device.getDevice(), pipelineLayout, nullptr);
+}
+
+// Only called for a frame whose previous submission has completed
+void DrawCulling::createVisibleCommands(Frame &frame, const uint32_t capacity) {
+    frame.visibleCommands = std::make_unique<ve::Buffer>(
+            device,
+            sizeof(VkDrawIndexedIndirectCommand),
+            capacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    frame.capacity = capacity;
+}
+
+void DrawCulling::cull(
+        const ve::FrameInfo &frameInfo,
+        const ve::DrawList &drawList,
+        const ve::TransformTable &transformTable,
+        const DepthPyramid &depthPyramid,
+        const glm::mat4 &viewProjection,
+        const glm::vec3 &cameraPosition,
+        const bool occlusion,
+        const bool clusters,
+        const bool backfaceCones,
+        const std::optional<ve::DrawList::LodView> &lodView) {
+    VE_PROFILE_SCOPE("DrawCulling::cull");
+    const VkCommandBuffer commandBuffer = frameInfo.graphicsCommandBuffer;
+    auto &frame = frames[frameInfo.frameIndex];
+
+    // This frame slot has retired, so the counts it copied back are complete
+    if (frame.pending) {
+        const auto *counts = static_cast<const Counts *>(frame.readback->getMappedMemory());
+        stats.drawCount = frame.drawCount;
+        stats.visible = 0;
+        for (uint32_t group = 0; group < frame.groupCount; group++) {
+            stats.visible += counts->visible[group];
+        }
+        stats.frustumCulled = counts->frustumCulled;
+        stats.occlusionCulled = counts->occlusionCulled;
+        stats.sizeCulled = counts->sizeCulled;
+        stats.clustersCulled = counts->clustersCulled;
+        stats.clustersBackfacing = counts->clustersBackfacing;
+        stats.triangles = counts->triangles;
+        frame.pending = false;
+    }
+
+    // Every item emits at most one command
+    const uint32_t itemCount = drawList.getCullItemCount();
+    if (itemCount > frame.capacity) {
+        createVisibleCommands(frame, std::max(frame.capacity * 2, itemCount));
+    }
+    frame.drawCount = drawList.getIndexedDrawCount();
+    frame.groupCount = drawList.getIndexedGroupCount();
+    if (frame.groupCount > MAX_DRAW_GROUPS) {
+        Log::error("Cannot cull more than " + std::to_string(MAX_DRAW_GROUPS) + " draw groups");
+        throw std::runtime_error("");
+    }
+
+    const bool testOcclusion = occlusion && depthPyramid.isValid();
+
+    CullParams params{};
+    params.viewProjection = viewProjection;
+    params.pyramidViewProjection = depthPyramid.getViewProjection();
+    const auto planes = ve::FrustumCuller::getFrustumPlanes(viewProjection);
+    std::copy(planes.begin(), planes.end(), params.frustumPlanes);
+    params.pyramidSize = glm::vec2(depthPyramid.getSize().width, depthPyramid.getSize().height);
+    params.itemCount = itemCount;
+    params.occlusionEnabled = testOcclusion ? 1 : 0;
+    params.groupCount = frame.groupCount;
+    params.clustersEnabled = clusters ? 1 : 0;
+    params.conesEnabled = backfaceCones ? 1 : 0;
+    for (uint32_t group = 0; group < frame.groupCount; group++) {
+        params.groupStarts[group / 4][group % 4] = drawList.getIndexedGroupItemStart(group);
+    }
+    params.cameraPosition = cameraPosition;
+    if (lodView.has_value()) {
+        params.pixelsPerUnit = lodView->pixelsPerUnit;
+        params.pixelError = lodView->pixelError;
+        params.minPixelSize = lodView->minPixelSize;
+    }
+    frame.params->writeToBuffer(&params);
+    frame.params->flush();
+
+    ve::GpuProfiler::Scope scope(frameInfo.gpuProfiler, commandBuffer, "Culling");
+
+    vkCmdFillBuffer(commandBuffer, frame.counts->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+
+    VkMemoryBarrier clearBarrier{};
+    clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0,
+            1, &clearBarrier,
+            0, nullptr,
+            0, nullptr);
+
+    pipeline->bind(commandBuffer);
+
+    auto paramsInfo = frame.params->descriptorInfo();
+    auto commandsInfo = drawList.getIndexedCommands(frameInfo.frameIndex).descriptorInfo();
+    auto drawDataInfo = drawList.getDrawData(frameInfo.frameIndex).descriptorInfo();
+    auto boundsInfo = drawList.getBounds(frameInfo.frameIndex).descriptorInfo();
+    auto transformsInfo = transformTable.getBuffer(frameInfo.frameIndex).descriptorInfo();
+    auto visibleCommandsInfo = frame.visibleCommands->descriptorInfo();
+    auto countsInfo = frame.counts->descriptorInfo();
+    auto pyramidInfo = depthPyramid.getImageInfo();
+    auto lodsInfo = drawList.getLods(frameInfo.frameIndex).descriptorInfo();
+    auto clustersInfo = drawList.getClusters(frameInfo.frameIndex).descriptorInfo();
+    auto itemsInfo = drawList.getCullItems(frameInfo.frameIndex).descriptorInfo();
+
+    ve::DescriptorWriter writer(*programLayout, frameInfo.frameDescriptorPool);
+    writer.writeBuffer(0, &paramsInfo)
+            .writeBuffer(1, &commandsInfo)
+            .writeBuffer(2, &drawDataInfo)
+            .writeBuffer(3, &boundsInfo)
+            .writeBuffer(4, &transformsInfo)
+            .writeBuffer(5, &visibleCommandsInfo)
+            .writeBuffer(6, &countsInfo)
+            .writeBuffer(8, &lodsInfo)
+            .writeBuffer(9, &clustersInfo)
+            .writeBuffer(10, &itemsInfo);
+    if (testOcclusion) {
+        writer.writeImage(7, &pyramidInfo);
+    }
+
+    VkDescriptorSet cullDescriptorSet;
+    if (!writer.build(cullDescriptorSet)) {
+        Log::error("Failed to allocate culling descriptor set");
+        throw std::runtime_error("");
+    }
+
+    vkCmdBindDescriptorSets(
+            commandBuffer,
+            VK_PIPELINE_BIND_POINT_COMPUTE,
+            pipelineLayout,
+            0,
+            1,
+            &cullDescriptorSet,
+            0,
+            nullptr);
+
+    vkCmdDispatch(commandBuffer, (itemCount + 63) / 64, 1, 1);
+
+    VkMemoryBarrier cullBarrier{};
+    cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+
+    vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0,
+            1, &cullBarrier,
+            0, nullptr,
+            0, nullptr);
+
+    VkBufferCopy copyRegion{};
+    copyRegion.size = sizeof(Counts);
+    vkCmdCopyBuffer(commandBuffer, frame.counts->getBuffer(), frame.readback->getBuffer(), 1, &copyRegion);
+
+    VkMemoryBarrier readbackBarrier{};
+    readbackBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    readbackBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    readbackBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+    vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_HOST_BIT,
+            0,
+            1, &readbackBarrier,
+            0, nullptr,
+            0, nullptr);
+
+    frame.pending = true;
+}
+
+void DrawCulling::createPipelineLayout() {
+    programLayout = ve::DescriptorSetLayout::Builder(device)
+        .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+        .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+        .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+        .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+        .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+        .addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+        .addBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+        // Left empty until there is a pyramid to test against
+        .addBinding(7, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1,
+                    VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT)
+        .addBinding(8, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+        .addBinding(9, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+        .addBinding(10, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+        .build();
+
+    const VkDescriptorSetLayout layout = programLayout->getDescriptorSetLayout();
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &layout;
+
+    if (vkCreatePipelineLayout(device.getDevice(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        Log::error("Failed to create pipeline layout!");
+        throw std::runtime_error("");
+    }
+}
+
+void DrawCulling::createPipeline() {
+    if (programLayout == nullptr) {
+        Log::error("Cannot create pipeline before creating program layout!");
+        throw std::runtime_error("");
+    }
+
+    std::string shader = "shaders/compiled/drawCulling.comp.spv";
+
+    pipeline = std::make_unique<ve::ComputePipeline>(device, shader, pipelineLayout);
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "depthPyramid.hpp"
+#include "../../../engine/device.hpp"
+#include "../../../engine/compute/computePipeline.hpp"
+#include "../../../engine/memory/descriptors.hpp"
+#include "../../../engine/memory/buffer.hpp"
+#include "../../../engine/renderer.hpp"
+#include "../../../engine/graphics/drawList.hpp"
+#include "../../../engine/graphics/frustumCuller.hpp"
+#include "../../../engine/graphics/transformTable.hpp"
+
+#include <array>
+#include <cstddef>
+#include <optional>
+
+// Tests the indexed draws of a draw list against the camera frustum and the depth pyramid of the previous frame,
+// picks the level of detail of the survivors and compacts them into a command buffer drawn with
+// vkCmdDrawIndexedIndirectCount, once per draw group. Draws at their full mesh with clusters are then tested cluster
+// by cluster, against the frustum, their normal cone and the pyramid, and each visible cluster becomes a command.
+class DrawCulling {
+
+public:
+    // Groups of the draw list the culling compacts separately, lists with more are not culled on the GPU
+    static constexpr uint32_t MAX_DRAW_GROUPS = 32;
+
+    struct Stats {
+        uint32_t drawCount = 0;
+        // Commands, one per visible draw or visible cluster
+        uint32_t visible = 0;
+        uint32_t frustumCulled = 0;
+        uint32_t occlusionCulled = 0;
+        // Smaller than LodView::minPixelSize
+        uint32_t sizeCulled = 0;
+        // Clusters of visible draws outside the frustum or occluded, and facing away from the camera
+        uint32_t clustersCulled = 0;
+        uint32_t clustersBackfacing = 0;
+        // Of the visible draws, at their levels of detail
+        uint32_t triangles = 0;
+    };
+
+    explicit DrawCulling(ve::Device& device);
+    ~DrawCulling();
+
+    DrawCulling(const DrawCulling&) = delete;
+    DrawCulling& operator=(const DrawCulling&) = delete;
+
+    // Records the culling into the graphics command buffer ahead of the render pass drawing the results. The draw
+    // list and transform table must already be updated for this frame. Occlusion is only tested when the pyramid
+    // holds an earlier frame. Without a LOD view every draw is at its full mesh and none are culled for their size.
+    // Without clusters the draws are culled whole. Without backfaceCones the clusters keep the triangles facing away,
+    // which a pipeline rasterizing back faces would draw.
+    void cull(
+            const ve::FrameInfo& frameInfo,
+            const ve::DrawList& drawList,
+            const ve::TransformTable& transformTable,
+            const DepthPyramid& depthPyramid,
+            const glm::mat4& viewProjection,
+            const glm::vec3& cameraPosition,
+            bool occlusion,
+            bool clusters,
+            bool backfaceCones,
+            const std::optional<ve::DrawList::LodView>& lodView);
+
+    ve::Buffer& getVisibleCommands(int frameIndex) const { return *frames[frameIndex].visibleCommands; }
+    // The draw count of group g is at getCountOffset() + g * getCountStride()
+    ve::Buffer& getCounts(int frameIndex) const { return *frames[frameIndex].counts; }
+    static VkDeviceSize getCountOffset() { return offsetof(Counts, visible); }
+    static VkDeviceSize getCountStride() { return sizeof(uint32_t); }
+    // The counts of the latest culling whose frame has retired
+    const Stats& getStats() const { return stats; }
+
+private:
+    // Laid out like the std140 CullParams block in drawCulling.comp
+    struct CullParams {
+        glm::mat4 viewProjection;
+        glm::mat4 pyramidViewProjection;
+        glm::vec4 frustumPlanes[6];
+        glm::vec2 pyramidSize;
+        uint32_t itemCount;
+        uint32_t occlusionEnabled;
+        uint32_t groupCount;
+        uint32_t clustersEnabled;
+        uint32_t conesEnabled;
+        uint32_t pad;
+        // Four to an element, std140 pads scalar arrays to 16 bytes
+        glm::uvec4 groupStarts[MAX_DRAW_GROUPS / 4];
+        glm::vec3 cameraPosition;
+        // 0 turns the level of detail selection off
+        float pixelsPerUnit;
+        float pixelError;
+        float minPixelSize;
+    };
+
+    struct Counts {
+        uint32_t frustumCulled;
+        uint32_t occlusionCulled;
+        uint32_t sizeCulled;
+        uint32_t triangles;
+        uint32_t clustersCulled;
+        uint32_t clustersBackfacing;
+        uint32_t visible[MAX_DRAW_GROUPS];
+    };
+
+    struct Frame {
+        std::unique_ptr<ve::Buffer> params;
+        std::unique_ptr<ve::Buffer> visibleCommands;
+        std::unique_ptr<ve::Buffer> counts;
+        std::unique_ptr<ve::Buffer> readback;
+        uint32_t capacity = 0;
+        uint32_t drawCount = 0;
+        uint32_t groupCount = 0;
+        // The readback buffer will hold the counts once the frame retires
+        bool pending = false;
+    };
+
+    void createPipelineLayout();
+    void createPipeline();
+    void createVisibleCommands(Frame& frame, uint32_t capacity);
+
+    ve::Device& device;
+    std::unique_ptr<ve::ComputePipeline> pipeline;
+    VkPipelineLayout pipelineLayout;
+
+    std::unique_ptr<ve::DescriptorSetLayout> programLayout;
+
+    std::array<Frame, ve::SwapChain::MAX_FRAMES_IN_FLIGHT> frames{};
+    Stats stats{};
+};
@@ -41,6 +41,9 @@ MatrixSum::~MatrixSum() {
 }
 
 void MatrixSum::computeMatrixSum(const ve::FrameInfo &frameInfo) {
+    VE_PROFILE_SCOPE("MatrixSum::computeMatrixSum");
+    ve::GpuProfiler::Scope scope(frameInfo.gpuProfiler, frameInfo.computeCommandBuffer, "MatrixSum");
+
     pipeline->bind(frameInfo.computeCommandBuffer);
 
     vkCmdBindDescriptorSets(
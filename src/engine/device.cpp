@@ -10,6 +10,7 @@
 
 #include "device.hpp"
 #include "../log.hpp"
+#include "profiling/cpuProfiler.hpp"
 
 namespace ve {
     static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
@@ -48,21 +49,29 @@ namespace ve {
     }
 
 
-    Device::Device(ve::Window &window) : window(window) {
+    Device::Device(ve::Window *window) : window(window) {
         createInstance();
         if (enableValidationLayers) {
             setupDebugMessenger();
         }
-        createSurface();
+        if (!isHeadless()) {
+            createSurface();
+        }
         pickPhysicalDevice();
         createLogicalDevice();
         createCommandPools();
+        allocator = std::make_unique<MemoryAllocator>(device, physicalDevice);
+        uploadContext = std::make_unique<UploadContext>(*this);
     }
 
     Device::~Device() {
+        uploadContext.reset();
+        allocator.reset();
         vkDestroyCommandPool(device, graphicsCommandPool, nullptr);
         vkDestroyDevice(device, nullptr);
-        vkDestroySurfaceKHR(instance, surface, nullptr);
+        if (surface != VK_NULL_HANDLE) {
+            vkDestroySurfaceKHR(instance, surface, nullptr);
+        }
         if (enableValidationLayers) {
             DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
         }
@@ -137,11 +146,15 @@ namespace ve {
     }
 
     std::vector<const char *> Device::getRequiredExtensions() const {
-        uint32_t glfwExtensionCount = 0;
-        const char **glfwExtensions;
-        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        std::vector<const char *> extensions;
 
-        std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        if (!isHeadless()) {
+            uint32_t glfwExtensionCount = 0;
+            const char **glfwExtensions;
+            glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+            extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        }
 
         if (enableValidationLayers) {
             extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -150,6 +163,16 @@ namespace ve {
         return extensions;
     }
 
+    std::vector<const char *> Device::getRequiredDeviceExtensions() const {
+        std::vector<const char *> extensions;
+
+        if (!isHeadless()) {
+            extensions.insert(extensions.end(), presentExtensions.begin(), presentExtensions.end());
+        }
+
+        return extensions;
+    }
+
     void Device::populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo) {
         createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
@@ -213,14 +236,48 @@ namespace ve {
 
         vkGetPhysicalDeviceProperties(physicalDevice, &properties);
         Log::info("Physical device: " + std::string(properties.deviceName));
+
+        // Software rasterizers such as lavapipe top out below 8x, use the highest count up to 8x both
+        // the color and depth attachments support
+        const VkSampleCountFlags supportedCounts =
+                properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+        for (VkSampleCountFlagBits count : {VK_SAMPLE_COUNT_8_BIT, VK_SAMPLE_COUNT_4_BIT, VK_SAMPLE_COUNT_2_BIT}) {
+            if (supportedCounts & count) {
+                sampleCount = count;
+                break;
+            }
+        }
+
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+        const QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+        graphicsTimestampValidBits = queueFamilies[indices.graphicsFamily].timestampValidBits;
+        computeTimestampValidBits = queueFamilies[indices.computeFamily].timestampValidBits;
+
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+        pipelineStatisticsSupported = supportedFeatures.pipelineStatisticsQuery == VK_TRUE;
+        // Indirect draws pass their draw index as firstInstance and go out in batches
+        indirectDrawSupported = supportedFeatures.multiDrawIndirect == VK_TRUE &&
+                                supportedFeatures.drawIndirectFirstInstance == VK_TRUE;
+
+        VkPhysicalDeviceVulkan12Features vulkan12Features {};
+        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceFeatures2 features {};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &vulkan12Features;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+        indirectDrawCountSupported = indirectDrawSupported && vulkan12Features.drawIndirectCount == VK_TRUE;
     }
 
     bool Device::isDeviceSuitable(VkPhysicalDevice device) {
         QueueFamilyIndices indices = findQueueFamilies(device);
         bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-        bool swapChainAdequate = false;
-        if (extensionsSupported) {
+        bool swapChainAdequate = isHeadless();
+        if (extensionsSupported && !isHeadless()) {
             SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
             swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
         }
@@ -228,13 +285,36 @@ namespace ve {
         VkPhysicalDeviceFeatures supportedFeatures;
         vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
+        return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy &&
+               supportsVulkan12Features(device);
+    }
+
+    // The material table indexes one sampler array with per-draw indices and leaves unused slots empty, uploads
+    // signal a timeline semaphore
+    bool Device::supportsVulkan12Features(VkPhysicalDevice device) {
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(device, &deviceProperties);
+        if (deviceProperties.apiVersion < VK_API_VERSION_1_2) {
+            return false;
+        }
+
+        VkPhysicalDeviceVulkan12Features vulkan12Features {};
+        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
 
+        VkPhysicalDeviceFeatures2 features {};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &vulkan12Features;
+        vkGetPhysicalDeviceFeatures2(device, &features);
 
-        return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy;
+        return features.features.shaderSampledImageArrayDynamicIndexing &&
+               vulkan12Features.runtimeDescriptorArray &&
+               vulkan12Features.descriptorBindingPartiallyBound &&
+               vulkan12Features.timelineSemaphore;
     }
 
     QueueFamilyIndices Device::findQueueFamilies(VkPhysicalDevice device) {
         QueueFamilyIndices indices;
+        indices.presentRequired = !isHeadless();
 
         uint32_t queueFamilyCount = 0;
         vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
@@ -255,7 +335,9 @@ namespace ve {
             }
 
             VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+            if (surface != VK_NULL_HANDLE) {
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+            }
             if (queueFamily.queueCount > 0 && presentSupport) {
                 indices.presentFamily = i;
                 indices.presentFamilyHasValue = true;
@@ -266,6 +348,17 @@ namespace ve {
             }
             i++;
         }
+
+        // Usually DMA engines, they copy without taking time from the graphics and compute queues
+        for (uint32_t family = 0; family < queueFamilyCount; family++) {
+            const VkQueueFlags flags = queueFamilies[family].queueFlags;
+            if (queueFamilies[family].queueCount > 0 && (flags & VK_QUEUE_TRANSFER_BIT) &&
+                !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+                indices.transferFamily = family;
+                indices.transferFamilyHasValue = true;
+                break;
+            }
+        }
         return indices;
     }
 
@@ -280,6 +373,7 @@ namespace ve {
                 &extensionCount,
                 availableExtensions.data());
 
+        const auto deviceExtensions = getRequiredDeviceExtensions();
         std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
 
         for (const auto &extension: availableExtensions) {
@@ -299,7 +393,7 @@ namespace ve {
     }
 
     void Device::createSurface() {
-        glfwCreateWindowSurface(instance, window.getWindowHandle(), nullptr, &surface);
+        glfwCreateWindowSurface(instance, window->getWindowHandle(), nullptr, &surface);
     }
 
     void Device::createLogicalDevice() {
@@ -308,9 +402,14 @@ namespace ve {
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
         std::set<uint32_t> uniqueQueueFamilies {
             indices.graphicsFamily,
-            indices.presentFamily,
             indices.computeFamily,
         };
+        if (indices.presentFamilyHasValue) {
+            uniqueQueueFamilies.insert(indices.presentFamily);
+        }
+        if (indices.transferFamilyHasValue) {
+            uniqueQueueFamilies.insert(indices.transferFamily);
+        }
 
         float queuePriority = 1.0f;
         for (uint32_t queueFamily: uniqueQueueFamilies) {
@@ -328,12 +427,31 @@ namespace ve {
         deviceFeatures.geometryShader = VK_TRUE;
         deviceFeatures.fillModeNonSolid = VK_TRUE;
         deviceFeatures.multiViewport = VK_TRUE;
+        deviceFeatures.pipelineStatisticsQuery = pipelineStatisticsSupported ? VK_TRUE : VK_FALSE;
+        deviceFeatures.multiDrawIndirect = indirectDrawSupported ? VK_TRUE : VK_FALSE;
+        deviceFeatures.drawIndirectFirstInstance = indirectDrawSupported ? VK_TRUE : VK_FALSE;
+        deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+
+        VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        vulkan12Features.runtimeDescriptorArray = VK_TRUE;
+        vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+        vulkan12Features.timelineSemaphore = VK_TRUE;
+        vulkan12Features.drawIndirectCount = indirectDrawCountSupported ? VK_TRUE : VK_FALSE;
+
+        VkPhysicalDeviceFeatures2 enabledFeatures = {};
+        enabledFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        enabledFeatures.pNext = &vulkan12Features;
+        enabledFeatures.features = deviceFeatures;
+
+        const auto deviceExtensions = getRequiredDeviceExtensions();
 
         VkDeviceCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
-        createInfo.pEnabledFeatures = &deviceFeatures;
+        createInfo.pNext = &enabledFeatures;
+        createInfo.pEnabledFeatures = nullptr;
         createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
         createInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
@@ -351,7 +469,12 @@ namespace ve {
 
         vkGetDeviceQueue(device, indices.computeFamily, 0, &computeQueue);
         vkGetDeviceQueue(device, indices.graphicsFamily, 0, &graphicsQueue);
-        vkGetDeviceQueue(device, indices.presentFamily, 0, &presentQueue);
+        if (indices.presentFamilyHasValue) {
+            vkGetDeviceQueue(device, indices.presentFamily, 0, &presentQueue);
+        }
+        if (indices.transferFamilyHasValue) {
+            vkGetDeviceQueue(device, indices.transferFamily, 0, &transferQueue);
+        }
     }
 
     void Device::createCommandPools() {
@@ -425,29 +548,13 @@ namespace ve {
         throw std::runtime_error("");
     }
 
-    void Device::createImageWithInfo(const VkImageCreateInfo &imageInfo, VkMemoryPropertyFlags properties, VkImage &image, VkDeviceMemory &imageMemory) {
+    void Device::createImageWithInfo(const VkImageCreateInfo &imageInfo, VkMemoryPropertyFlags properties, VkImage &image, Allocation &imageAllocation) {
         if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
             Log::error("Failed to create image!");
             throw std::runtime_error("");
         }
 
-        VkMemoryRequirements memRequirements;
-        vkGetImageMemoryRequirements(device, image, &memRequirements);
-
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-        if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-            Log::error("Failed to allocate image memory!");
-            throw std::runtime_error("");
-        }
-
-        if (vkBindImageMemory(device, image, imageMemory, 0) != VK_SUCCESS) {
-            Log::error("Failed to bind image memory!");
-            throw std::runtime_error("");
-        }
+        imageAllocation = allocator->allocateForImage(image, imageInfo.tiling, properties);
     }
 
     std::pair<uint64_t, uint64_t> Device::getMemorySize() const {
@@ -492,7 +599,7 @@ namespace ve {
         throw std::runtime_error("");
     }
 
-    void Device::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &bufferMemory) {
+    void Device::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, Allocation &bufferAllocation) {
         VkBufferCreateInfo bufferInfo{};
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         bufferInfo.size = size;
@@ -504,59 +611,7 @@ namespace ve {
             throw std::runtime_error("");
         }
 
-        VkMemoryRequirements memRequirements;
-        vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
-
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-        if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-            Log::error("Failed to allocate buffer memory!");
-            throw std::runtime_error("");
-        }
-
-        vkBindBufferMemory(device, buffer, bufferMemory, 0);
-    }
-
-    void Device::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-        VkBufferCopy copyRegion{};
-        copyRegion.srcOffset = 0;  // Optional
-        copyRegion.dstOffset = 0;  // Optional
-        copyRegion.size = size;
-        vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-        endSingleTimeCommands(commandBuffer);
-    }
-
-    void Device::copyBufferToImage(
-            VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount) {
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-        VkBufferImageCopy region{};
-        region.bufferOffset = 0;
-        region.bufferRowLength = 0;
-        region.bufferImageHeight = 0;
-
-        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.imageSubresource.mipLevel = 0;
-        region.imageSubresource.baseArrayLayer = 0;
-        region.imageSubresource.layerCount = layerCount;
-
-        region.imageOffset = {0, 0, 0};
-        region.imageExtent = {width, height, 1};
-
-        vkCmdCopyBufferToImage(
-                commandBuffer,
-                buffer,
-                image,
-                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                1,
-                &region);
-        endSingleTimeCommands(commandBuffer);
+        bufferAllocation = allocator->allocateForBuffer(buffer, properties);
     }
 
     VkCommandBuffer Device::beginSingleTimeCommands() {
@@ -579,6 +634,7 @@ namespace ve {
     }
 
     void Device::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
+        VE_PROFILE_SCOPE("Device::endSingleTimeCommands");
         vkEndCommandBuffer(commandBuffer);
 
         VkSubmitInfo submitInfo {};
@@ -591,90 +647,4 @@ namespace ve {
 
         vkFreeCommandBuffers(device, graphicsCommandPool, 1, &commandBuffer);
     }
-
-    void Device::transitionImageLayout(
-            VkImage image,
-            VkFormat format,
-            VkImageLayout oldLayout,
-            VkImageLayout newLayout,
-            uint32_t mipLevels,
-            uint32_t layerCount) {
-        // uses an image memory barrier transition image layouts and transfer queue
-        // family ownership when VK_SHARING_MODE_EXCLUSIVE is used. There is an
-        // equivalent buffer memory barrier to do this for buffers
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-        VkImageMemoryBarrier barrier{};
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.oldLayout = oldLayout;
-        barrier.newLayout = newLayout;
-
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-        barrier.image = image;
-        barrier.subresourceRange.baseMipLevel = 0;
-        barrier.subresourceRange.levelCount = mipLevels;
-        barrier.subresourceRange.baseArrayLayer = 0;
-        barrier.subresourceRange.layerCount = layerCount;
-
-        if (newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
-            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-            if (format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT) {
-                barrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
-            }
-        } else {
-            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        }
-
-        VkPipelineStageFlags sourceStage;
-        VkPipelineStageFlags destinationStage;
-
-        if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED &&
-            newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-            barrier.srcAccessMask = 0;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-            sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-            destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        } else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED &&
-                   newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
-            barrier.srcAccessMask = 0;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-            sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-            destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL &&
-                   newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-            sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-        } else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED &&
-                   newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
-            barrier.srcAccessMask = 0;
-            barrier.dstAccessMask =
-                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-            sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-            destinationStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-        } else {
-            Log::error("unsupported layout transition!");
-            throw std::invalid_argument("");
-        }
-        vkCmdPipelineBarrier(
-                commandBuffer,
-                sourceStage,
-                destinationStage,
-                0,
-                0,
-                nullptr,
-                0,
-                nullptr,
-                1,
-                &barrier);
-
-        endSingleTimeCommands(commandBuffer);
-    }
 } // ve
\ No newline at end of file
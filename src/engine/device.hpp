@@ -5,8 +5,11 @@
 #pragma once
 
 #include "../window/window.hpp"
+#include "memory/memoryAllocator.hpp"
+#include "memory/uploadContext.hpp"
 
 // std
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -22,13 +25,19 @@ namespace ve {
         uint32_t graphicsFamily;
         uint32_t presentFamily;
         uint32_t computeFamily;
+        // A family that only does transfers, not needed for isComplete
+        uint32_t transferFamily;
 
         bool graphicsFamilyHasValue = false;
         bool presentFamilyHasValue = false;
         bool computeFamilyHasValue = false;
+        bool transferFamilyHasValue = false;
+
+        // Headless devices have no surface to present to.
+        bool presentRequired = true;
 
         bool isComplete() const {
-            return graphicsFamilyHasValue && presentFamilyHasValue && computeFamilyHasValue;
+            return graphicsFamilyHasValue && (presentFamilyHasValue || !presentRequired) && computeFamilyHasValue;
         }
     };
 
@@ -41,7 +50,8 @@ namespace ve {
         const bool enableValidationLayers = true;
 #endif
 
-        explicit Device(Window &window);
+        // Pass nullptr to create a headless device without a surface or a present queue.
+        explicit Device(Window *window);
         ~Device();
 
         Device(const Device &) = delete;
@@ -57,8 +67,24 @@ namespace ve {
         VkQueue getGraphicsQueue() { return graphicsQueue; }
         VkQueue getPresentQueue() { return presentQueue; }
         VkQueue getComputeQueue() { return computeQueue; }
+        // Null without a dedicated transfer family, uploads go through the graphics queue then
+        VkQueue getTransferQueue() { return transferQueue; }
+        bool hasTransferQueue() const { return transferQueue != VK_NULL_HANDLE; }
         QueueFamilyIndices getQueueFamilyIndices() { return findPhysicalQueueFamilies(); }
+        MemoryAllocator &getAllocator() { return *allocator; }
+        // Fills device local buffers and images, flushed by the renderer before every frame is submitted
+        UploadContext &getUploadContext() { return *uploadContext; }
+        const MemoryAllocator &getAllocator() const { return *allocator; }
         std::pair<uint64_t, uint64_t> getMemorySize() const;
+        VkSampleCountFlagBits getSampleCount() const { return sampleCount; }
+        // 0 when the queue does not support timestamp queries.
+        uint32_t getGraphicsTimestampValidBits() const { return graphicsTimestampValidBits; }
+        uint32_t getComputeTimestampValidBits() const { return computeTimestampValidBits; }
+        bool supportsPipelineStatistics() const { return pipelineStatisticsSupported; }
+        bool supportsIndirectDraw() const { return indirectDrawSupported; }
+        // Indirect draws whose count is read from a buffer, used to draw what the GPU culling kept
+        bool supportsIndirectDrawCount() const { return indirectDrawCountSupported; }
+        bool isHeadless() const { return window == nullptr; }
 
         SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
         uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -71,24 +97,20 @@ namespace ve {
                 VkBufferUsageFlags usage,
                 VkMemoryPropertyFlags properties,
                 VkBuffer &buffer,
-                VkDeviceMemory &bufferMemory);
+                Allocation &bufferAllocation);
 
+        // Submits and waits for the queue, resource uploads go through getUploadContext instead
         VkCommandBuffer beginSingleTimeCommands();
         void endSingleTimeCommands(VkCommandBuffer commandBuffer);
 
-        void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-        void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
-
         void createImageWithInfo(
                 const VkImageCreateInfo &imageInfo,
                 VkMemoryPropertyFlags properties,
                 VkImage &image,
-                VkDeviceMemory &imageMemory);
+                Allocation &imageAllocation);
 
         VkPhysicalDeviceProperties properties;
 
-        void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels, uint32_t layerCount);
-
 
     private:
         void createInstance();
@@ -101,7 +123,9 @@ namespace ve {
         // helper functions
         void pickPhysicalDevice();
         bool isDeviceSuitable(VkPhysicalDevice device);
+        bool supportsVulkan12Features(VkPhysicalDevice device);
         std::vector<const char *> getRequiredExtensions() const;
+        std::vector<const char *> getRequiredDeviceExtensions() const;
         bool checkValidationLayerSupport();
         QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
         static void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
@@ -110,7 +134,7 @@ namespace ve {
 
         SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice physicalDevice);
 
-        Window &window;
+        Window *window;
 
         VkInstance instance;
         VkDebugUtilsMessengerEXT debugMessenger;
@@ -119,19 +143,29 @@ namespace ve {
         VkCommandPool computeCommandPool;
 
         VkDevice device;
-        VkSurfaceKHR surface;
+        VkSurfaceKHR surface = VK_NULL_HANDLE;
 
         VkQueue computeQueue;
         VkQueue graphicsQueue;
-        VkQueue presentQueue;
+        VkQueue presentQueue = VK_NULL_HANDLE;
+        VkQueue transferQueue = VK_NULL_HANDLE;
+
+        std::unique_ptr<MemoryAllocator> allocator;
+        std::unique_ptr<UploadContext> uploadContext;
 
         const std::vector<const char *> validationLayers = {
                 "VK_LAYER_KHRONOS_validation"
         };
-        const std::vector<const char *> deviceExtensions = {
+        const std::vector<const char *> presentExtensions = {
                 VK_KHR_SWAPCHAIN_EXTENSION_NAME,
         };
 
         uint64_t memorySize = 0;
+        VkSampleCountFlagBits sampleCount = VK_SAMPLE_COUNT_1_BIT;
+        uint32_t graphicsTimestampValidBits = 0;
+        uint32_t computeTimestampValidBits = 0;
+        bool pipelineStatisticsSupported = false;
+        bool indirectDrawSupported = false;
+        bool indirectDrawCountSupported = false;
     };
 } // ve
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "device.hpp"
+
+namespace ve {
+    // Where a frame ends up: the window's swap chain or a set of offscreen images.
+    class FrameTarget {
+    public:
+        static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+
+        FrameTarget() = default;
+        virtual ~FrameTarget() = default;
+
+        FrameTarget(const FrameTarget &) = delete;
+        FrameTarget &operator=(const FrameTarget &) = delete;
+
+        virtual VkFramebuffer getFrameBuffer(int index) = 0;
+        virtual VkRenderPass getRenderPass() = 0;
+        virtual size_t getImageCount() = 0;
+        // Depth attachment of an image, left in DEPTH_STENCIL_READ_ONLY_OPTIMAL and readable by compute shaders
+        // once the render pass has ended
+        virtual VkImageView getDepthImageView(int index) = 0;
+        virtual VkExtent2D getSwapChainExtent() = 0;
+        virtual float getExtentAspectRatio() const = 0;
+
+        virtual VkResult acquireNextImage(uint32_t *imageIndex) = 0;
+        virtual VkResult submitCommandBuffers(
+                const VkCommandBuffer *graphicsBuffers,
+                const VkCommandBuffer *computeBuffers,
+                uint32_t *imageIndex) = 0;
+    };
+} // ve
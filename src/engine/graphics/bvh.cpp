@@ -0,0 +1,375 @@
+#include "bvh.hpp"
+
+#include "../profiling/cpuProfiler.hpp"
+#include "../jobs/jobSystem.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+
+namespace ve {
+    static constexpr uint32_t BIN_COUNT = 16;
+    static constexpr uint32_t MAX_LEAF_SIZE = 4;
+    // Bounds the traversal stacks below
+    static constexpr uint32_t MAX_DEPTH = 48;
+    static constexpr uint32_t STACK_SIZE = 64;
+    // Smaller subtrees are not worth a thread
+    static constexpr uint32_t PARALLEL_MIN_ITEMS = 4096;
+    // Cost of visiting a node relative to testing an item
+    static constexpr float TRAVERSAL_COST = 1.0f;
+
+    struct Bvh::BuildContext {
+        const std::vector<Box> &boxes;
+        std::vector<glm::vec3> centroids;
+        std::atomic<uint32_t> nextNode{1};
+        std::atomic<uint32_t> depth{0};
+        // Levels above this one still hand one child to the job system
+        uint32_t parallelLevels = 0;
+    };
+
+    void Bvh::build(const std::vector<Box> &boxes, const bool parallel) {
+        VE_PROFILE_SCOPE("Bvh::build");
+        const auto count = static_cast<uint32_t>(boxes.size());
+        nodes.clear();
+        items.resize(count);
+        itemBoxes.clear();
+        depth = 0;
+        if (count == 0) {
+            return;
+        }
+
+        BuildContext context{boxes, {}};
+        context.centroids.resize(count);
+        for (uint32_t i = 0; i < count; i++) {
+            items[i] = i;
+            context.centroids[i] = (boxes[i].min + boxes[i].max) * 0.5f;
+        }
+        if (parallel) {
+            const uint32_t threads = JobSystem::getInstance().getThreadCount();
+            context.parallelLevels = static_cast<uint32_t>(std::ceil(std::log2(static_cast<float>(threads)))) + 1;
+        }
+
+        // A binary tree with leaves of at least one item never needs more nodes than this
+        nodes.resize(2 * count - 1);
+        buildNode(context, 0, 0, count, 0);
+        nodes.resize(context.nextNode.load());
+        depth = context.depth.load() + 1;
+
+        itemBoxes.resize(count);
+        for (uint32_t i = 0; i < count; i++) {
+            itemBoxes[i] = boxes[items[i]];
+        }
+    }
+
+    void Bvh::buildNode(BuildContext &context, const uint32_t nodeIndex, const uint32_t first, const uint32_t count,
+                        const uint32_t level) {
+        Box bounds;
+        Box centroidBounds;
+        for (uint32_t i = first; i < first + count; i++) {
+            bounds.grow(context.boxes[items[i]]);
+            centroidBounds.grow(context.centroids[items[i]]);
+        }
+
+        auto &node = nodes[nodeIndex];
+        node.min = bounds.min;
+        node.max = bounds.max;
+
+        uint32_t previousDepth = context.depth.load();
+        while (previousDepth < level && !context.depth.compare_exchange_weak(previousDepth, level)) {}
+
+        auto makeLeaf = [&] {
+            node.first = first;
+            node.count = count;
+        };
+
+        if (count <= 1 || level + 1 >= MAX_DEPTH) {
+            makeLeaf();
+            return;
+        }
+
+        // Bin the centroids along all three axes in one pass, then pick the cheapest bin boundary
+        const glm::vec3 centroidExtent = centroidBounds.max - centroidBounds.min;
+        glm::vec3 scale(0.0f);
+        for (int axis = 0; axis < 3; axis++) {
+            scale[axis] = centroidExtent[axis] > 0.0f ? BIN_COUNT / centroidExtent[axis] : 0.0f;
+        }
+        auto binOf = [&](const glm::vec3 &centroid, const int axis) {
+            const float offset = (centroid[axis] - centroidBounds.min[axis]) * scale[axis];
+            return std::min(BIN_COUNT - 1, static_cast<uint32_t>(offset));
+        };
+
+        std::array<std::array<Box, BIN_COUNT>, 3> bins{};
+        std::array<std::array<uint32_t, BIN_COUNT>, 3> binCounts{};
+        for (uint32_t i = first; i < first + count; i++) {
+            const auto &box = context.boxes[items[i]];
+            const auto &centroid = context.centroids[items[i]];
+            for (int axis = 0; axis < 3; axis++) {
+                const uint32_t bin = binOf(centroid, axis);
+                bins[axis][bin].grow(box);
+                binCounts[axis][bin]++;
+            }
+        }
+
+        int bestAxis = -1;
+        uint32_t bestSplit = 0;
+        float bestCost = FLT_MAX;
+        for (int axis = 0; axis < 3; axis++) {
+            if (scale[axis] == 0.0f) {
+                continue;
+            }
+
+            // Right to left sweep first, then evaluate every boundary while sweeping left to right
+            std::array<float, BIN_COUNT> rightCosts{};
+            Box right;
+            uint32_t rightCount = 0;
+            for (uint32_t bin = BIN_COUNT - 1; bin > 0; bin--) {
+                right.grow(bins[axis][bin]);
+                rightCount += binCounts[axis][bin];
+                rightCosts[bin] = rightCount > 0 ? right.area() * static_cast<float>(rightCount) : 0.0f;
+            }
+
+            Box left;
+            uint32_t leftCount = 0;
+            for (uint32_t split = 1; split < BIN_COUNT; split++) {
+                left.grow(bins[axis][split - 1]);
+                leftCount += binCounts[axis][split - 1];
+                if (leftCount == 0 || leftCount == count) {
+                    continue;
+                }
+                const float cost = left.area() * static_cast<float>(leftCount) + rightCosts[split];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = split;
+                }
+            }
+        }
+
+        const float leafCost = bounds.area() * static_cast<float>(count);
+        const float splitCost = TRAVERSAL_COST * bounds.area() + bestCost;
+        if (count <= MAX_LEAF_SIZE && (bestAxis < 0 || splitCost >= leafCost)) {
+            makeLeaf();
+            return;
+        }
+
+        uint32_t leftCount = count / 2;
+        if (bestAxis >= 0) {
+            const auto middle = std::partition(
+                items.begin() + first, items.begin() + first + count,
+                [&](const uint32_t item) { return binOf(context.centroids[item], bestAxis) < bestSplit; });
+            leftCount = static_cast<uint32_t>(middle - (items.begin() + first));
+        }
+        // Every centroid in the same spot leaves nothing to bin, any split is as good as another then
+        if (leftCount == 0 || leftCount == count) {
+            leftCount = count / 2;
+        }
+
+        const uint32_t leftIndex = context.nextNode.fetch_add(2);
+        node.first = leftIndex;
+        node.count = 0;
+
+        if (level < context.parallelLevels && count >= PARALLEL_MIN_ITEMS) {
+            // The halves touch disjoint item ranges and nodes, the other thread needs no locking
+            auto &jobs = JobSystem::getInstance();
+            JobSystem::Counter leftBuilt;
+            jobs.run([&, leftIndex, first, leftCount, level] {
+                buildNode(context, leftIndex, first, leftCount, level + 1);
+            }, &leftBuilt);
+            buildNode(context, leftIndex + 1, first + leftCount, count - leftCount, level + 1);
+            jobs.wait(leftBuilt);
+        } else {
+            buildNode(context, leftIndex, first, leftCount, level + 1);
+            buildNode(context, leftIndex + 1, first + leftCount, count - leftCount, level + 1);
+        }
+    }
+
+    void Bvh::refit(const std::vector<Box> &boxes) {
+        VE_PROFILE_SCOPE("Bvh::refit");
+        if (boxes.size() != items.size()) {
+            build(boxes);
+            return;
+        }
+
+        for (uint32_t i = 0; i < items.size(); i++) {
+            itemBoxes[i] = boxes[items[i]];
+        }
+
+        // Children come after their parent, so walking backwards finishes them first
+        for (auto node = nodes.rbegin(); node != nodes.rend(); ++node) {
+            Box bounds;
+            if (node->isLeaf()) {
+                for (uint32_t i = node->first; i < node->first + node->count; i++) {
+                    bounds.grow(itemBoxes[i]);
+                }
+            } else {
+                const auto &left = nodes[node->first];
+                const auto &right = nodes[node->first + 1];
+                bounds.grow(Box{left.min, left.max});
+                bounds.grow(Box{right.min, right.max});
+            }
+            node->min = bounds.min;
+            node->max = bounds.max;
+        }
+    }
+
+    void Bvh::queryFrustum(const FrustumCuller::Planes &planes, std::vector<uint32_t> &result) const {
+        if (nodes.empty()) {
+            return;
+        }
+
+        // Planes a node is entirely inside of are not tested again below it
+        constexpr uint32_t ALL_PLANES = (1u << 6) - 1;
+        struct Entry {
+            uint32_t node;
+            uint32_t planeMask;
+        };
+        Entry stack[STACK_SIZE];
+        uint32_t stackSize = 0;
+        stack[stackSize++] = {0, ALL_PLANES};
+
+        auto classify = [&](const glm::vec3 &min, const glm::vec3 &max, uint32_t &planeMask) {
+            const glm::vec3 center = (min + max) * 0.5f;
+            const glm::vec3 extent = (max - min) * 0.5f;
+            for (uint32_t p = 0; p < 6; p++) {
+                if ((planeMask & (1u << p)) == 0) {
+                    continue;
+                }
+                const glm::vec3 normal = glm::vec3(planes[p]);
+                const float distance = glm::dot(normal, center) + planes[p].w;
+                const float radius = glm::dot(glm::abs(normal), extent);
+                if (distance + radius < 0.0f) {
+                    return false;
+                }
+                if (distance - radius >= 0.0f) {
+                    planeMask &= ~(1u << p);
+                }
+            }
+            return true;
+        };
+
+        while (stackSize > 0) {
+            auto [nodeIndex, planeMask] = stack[--stackSize];
+            const auto &node = nodes[nodeIndex];
+            if (planeMask != 0 && !classify(node.min, node.max, planeMask)) {
+                continue;
+            }
+
+            if (!node.isLeaf()) {
+                stack[stackSize++] = {node.first + 1, planeMask};
+                stack[stackSize++] = {node.first, planeMask};
+                continue;
+            }
+
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                uint32_t itemMask = planeMask;
+                if (itemMask == 0 || classify(itemBoxes[i].min, itemBoxes[i].max, itemMask)) {
+                    result.push_back(items[i]);
+                }
+            }
+        }
+    }
+
+    void Bvh::queryOverlap(const Box &box, std::vector<uint32_t> &result) const {
+        if (nodes.empty()) {
+            return;
+        }
+
+        uint32_t stack[STACK_SIZE];
+        uint32_t stackSize = 0;
+        stack[stackSize++] = 0;
+
+        while (stackSize > 0) {
+            const auto &node = nodes[stack[--stackSize]];
+            if (!box.overlaps(Box{node.min, node.max})) {
+                continue;
+            }
+
+            if (!node.isLeaf()) {
+                stack[stackSize++] = node.first + 1;
+                stack[stackSize++] = node.first;
+                continue;
+            }
+
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                if (box.overlaps(itemBoxes[i])) {
+                    result.push_back(items[i]);
+                }
+            }
+        }
+    }
+
+    // Slab test, returns the distance at which the ray enters the box or FLT_MAX when it misses it within
+    // maxDistance. A ray starting inside the box enters it at 0.
+    static float intersectBox(const glm::vec3 &origin, const glm::vec3 &inverseDirection,
+                              const glm::vec3 &min, const glm::vec3 &max, const float maxDistance) {
+        const glm::vec3 t0 = (min - origin) * inverseDirection;
+        const glm::vec3 t1 = (max - origin) * inverseDirection;
+        const glm::vec3 entries = glm::min(t0, t1);
+        const glm::vec3 exits = glm::max(t0, t1);
+        const float enter = std::max(std::max(entries.x, entries.y), std::max(entries.z, 0.0f));
+        const float exit = std::min(std::min(exits.x, exits.y), std::min(exits.z, maxDistance));
+        return enter <= exit ? enter : FLT_MAX;
+    }
+
+    std::optional<Bvh::Hit> Bvh::raycast(const Ray &ray, const float maxDistance,
+                                         const Intersector &intersector) const {
+        if (nodes.empty()) {
+            return std::nullopt;
+        }
+
+        // Zero components become infinities, which the slab test handles
+        const glm::vec3 inverseDirection = 1.0f / ray.direction;
+
+        std::optional<Hit> closest;
+        float closestDistance = maxDistance;
+
+        uint32_t stack[STACK_SIZE];
+        uint32_t stackSize = 0;
+        if (intersectBox(ray.origin, inverseDirection, nodes[0].min, nodes[0].max, closestDistance) == FLT_MAX) {
+            return std::nullopt;
+        }
+        stack[stackSize++] = 0;
+
+        while (stackSize > 0) {
+            const auto &node = nodes[stack[--stackSize]];
+
+            if (node.isLeaf()) {
+                for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                    float distance = intersectBox(ray.origin, inverseDirection, itemBoxes[i].min, itemBoxes[i].max,
+                                                  closestDistance);
+                    if (distance == FLT_MAX) {
+                        continue;
+                    }
+                    if (intersector != nullptr && (!intersector(items[i], ray, distance) || distance > closestDistance)) {
+                        continue;
+                    }
+                    closestDistance = distance;
+                    closest = Hit{items[i], distance};
+                }
+                continue;
+            }
+
+            // Push the farther child first so the nearer one is visited first and shortens the ray sooner
+            uint32_t nearChild = node.first;
+            uint32_t farChild = node.first + 1;
+            float nearDistance = intersectBox(ray.origin, inverseDirection, nodes[nearChild].min, nodes[nearChild].max,
+                                              closestDistance);
+            float farDistance = intersectBox(ray.origin, inverseDirection, nodes[farChild].min, nodes[farChild].max,
+                                             closestDistance);
+            if (farDistance < nearDistance) {
+                std::swap(nearChild, farChild);
+                std::swap(nearDistance, farDistance);
+            }
+            if (farDistance != FLT_MAX) {
+                stack[stackSize++] = farChild;
+            }
+            if (nearDistance != FLT_MAX) {
+                stack[stackSize++] = nearChild;
+            }
+        }
+
+        return closest;
+    }
+} // ve
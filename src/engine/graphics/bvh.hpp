@@ -0,0 +1,98 @@
+#pragma once
+
+#include "frustumCuller.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <cfloat>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+namespace ve {
+    // Bounding volume hierarchy over a list of boxes, items are reported by their index in that list. Built top
+    // down with binned SAH, large subtrees are built as jobs. Nodes live in one array, the children of
+    // an interior node are adjacent and always come after it.
+    class Bvh {
+    public:
+        struct Box {
+            glm::vec3 min{FLT_MAX};
+            glm::vec3 max{-FLT_MAX};
+
+            void grow(const glm::vec3 &point) {
+                min = glm::min(min, point);
+                max = glm::max(max, point);
+            }
+            void grow(const Box &box) {
+                min = glm::min(min, box.min);
+                max = glm::max(max, box.max);
+            }
+            // Half the surface area, only ever compared
+            float area() const {
+                const glm::vec3 size = glm::max(max - min, glm::vec3(0.0f));
+                return size.x * size.y + size.y * size.z + size.z * size.x;
+            }
+            bool overlaps(const Box &box) const {
+                return min.x <= box.max.x && max.x >= box.min.x &&
+                       min.y <= box.max.y && max.y >= box.min.y &&
+                       min.z <= box.max.z && max.z >= box.min.z;
+            }
+        };
+
+        // Leaves hold count items starting at first in the item order, interior nodes have count 0 and their
+        // children at first and first + 1
+        struct Node {
+            glm::vec3 min;
+            uint32_t first;
+            glm::vec3 max;
+            uint32_t count;
+
+            bool isLeaf() const { return count != 0; }
+        };
+
+        struct Ray {
+            glm::vec3 origin;
+            glm::vec3 direction;
+        };
+
+        struct Hit {
+            uint32_t item;
+            float distance;
+        };
+
+        // Exact test of a ray against an item whose box it hits, stores the distance along the ray on a hit
+        using Intersector = std::function<bool(uint32_t item, const Ray &ray, float &distance)>;
+
+        void build(const std::vector<Box> &boxes, bool parallel = true);
+        // Updates the node bounds after the boxes moved, the item count must not change. Cheaper than a build, the
+        // tree gets worse the further the boxes move from where they were built.
+        void refit(const std::vector<Box> &boxes);
+
+        // Items whose box is at least partially inside the frustum
+        void queryFrustum(const FrustumCuller::Planes &planes, std::vector<uint32_t> &items) const;
+        void queryOverlap(const Box &box, std::vector<uint32_t> &items) const;
+        // Closest item along the ray. Without an intersector the item boxes are the hit distances.
+        std::optional<Hit> raycast(const Ray &ray, float maxDistance = FLT_MAX,
+                                   const Intersector &intersector = nullptr) const;
+
+        bool empty() const { return nodes.empty(); }
+        uint32_t getItemCount() const { return static_cast<uint32_t>(items.size()); }
+        const std::vector<Node> &getNodes() const { return nodes; }
+        uint32_t getDepth() const { return depth; }
+
+    private:
+        struct BuildContext;
+
+        void buildNode(BuildContext &context, uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t level);
+
+        std::vector<Node> nodes;
+        std::vector<uint32_t> items;
+        // The item boxes in item order, so leaves read them sequentially
+        std::vector<Box> itemBoxes;
+        uint32_t depth = 0;
+    };
+} // ve
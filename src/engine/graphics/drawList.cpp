@@ -0,0 +1,493 @@
+#include "drawList.hpp"
+
+#include "../profiling/cpuProfiler.hpp"
+#include "../../log.hpp"
+
+// std
+#include <algorithm>
+
+namespace ve {
+    static constexpr uint32_t INITIAL_CAPACITY = 1024;
+
+    DrawList::DrawList(Device &device) : device(device) {
+        setLayout = DescriptorSetLayout::Builder(device)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+            .build();
+
+        pool = DescriptorPool::Builder(device)
+            .setMaxSets(SwapChain::MAX_FRAMES_IN_FLIGHT)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, SwapChain::MAX_FRAMES_IN_FLIGHT)
+            .build();
+
+        for (auto &frame : frames) {
+            if (!pool->allocateDescriptor(setLayout->getDescriptorSetLayout(), frame.descriptorSet)) {
+                Log::error("Failed to allocate draw list descriptor set");
+                throw std::runtime_error("");
+            }
+            createFrameBuffers(frame, INITIAL_CAPACITY);
+            createVisibleCommands(frame, INITIAL_CAPACITY);
+            createLods(frame, INITIAL_CAPACITY);
+            createClusters(frame, INITIAL_CAPACITY);
+            createCullItems(frame, INITIAL_CAPACITY);
+        }
+    }
+
+    // Only called for a frame whose previous submission has completed, so its set can be rewritten in place
+    void DrawList::createFrameBuffers(Frame &frame, const uint32_t capacity) {
+        frame.indexedCommands = std::make_unique<Buffer>(
+            device,
+            sizeof(VkDrawIndexedIndirectCommand),
+            capacity,
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        frame.indexedCommands->map();
+
+        frame.nonIndexedCommands = std::make_unique<Buffer>(
+            device,
+            sizeof(VkDrawIndirectCommand),
+            capacity,
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        frame.nonIndexedCommands->map();
+
+        frame.drawData = std::make_unique<Buffer>(
+            device,
+            sizeof(DrawData),
+            capacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        frame.drawData->map();
+
+        frame.bounds = std::make_unique<Buffer>(
+            device,
+            sizeof(DrawBounds),
+            capacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        frame.bounds->map();
+
+        frame.capacity = capacity;
+
+        auto bufferInfo = frame.drawData->descriptorInfo();
+        DescriptorWriter(*setLayout, *pool)
+            .writeBuffer(0, &bufferInfo)
+            .overwrite(frame.descriptorSet);
+    }
+
+    // Only called for a frame whose previous submission has completed
+    void DrawList::createVisibleCommands(Frame &frame, const uint32_t capacity) {
+        frame.visibleCommands = std::make_unique<Buffer>(
+            device,
+            sizeof(VkDrawIndexedIndirectCommand),
+            capacity,
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        frame.visibleCommands->map();
+        frame.visibleCapacity = capacity;
+    }
+
+    // Only called for a frame whose previous submission has completed
+    void DrawList::createLods(Frame &frame, const uint32_t capacity) {
+        frame.lods = std::make_unique<Buffer>(
+            device,
+            sizeof(DrawLod),
+            capacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        frame.lods->map();
+        frame.lodCapacity = capacity;
+    }
+
+    // Only called for a frame whose previous submission has completed
+    void DrawList::createClusters(Frame &frame, const uint32_t capacity) {
+        frame.clusters = std::make_unique<Buffer>(
+            device,
+            sizeof(DrawCluster),
+            capacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        frame.clusters->map();
+        frame.clusterCapacity = capacity;
+    }
+
+    // Only called for a frame whose previous submission has completed
+    void DrawList::createCullItems(Frame &frame, const uint32_t capacity) {
+        frame.cullItems = std::make_unique<Buffer>(
+            device,
+            sizeof(CullItem),
+            capacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        frame.cullItems->map();
+        frame.cullItemCapacity = capacity;
+    }
+
+    void DrawList::clear() {
+        indexedDraws.clear();
+        indexedDrawGroups.clear();
+        indexedGroups.clear();
+        indexedData.clear();
+        indexedBounds.clear();
+        indexedLods.clear();
+        indexedClusters.clear();
+        indexedClusterSpans.clear();
+        cullItemCount = 0;
+        nonIndexedDraws.clear();
+        nonIndexedGroups.clear();
+        nonIndexedData.clear();
+        formats.clear();
+        dirtyFrames = ALL_FRAMES_DIRTY;
+    }
+
+    uint32_t DrawList::findGroup(std::vector<Group> &groups, const VertexFormat &format, const VkIndexType indexType,
+                                 const uint32_t first, const uint32_t firstItem) {
+        for (uint32_t group = 0; group < groups.size(); group++) {
+            if (groups[group].format == format && groups[group].indexType == indexType) {
+                return group;
+            }
+        }
+        groups.push_back({format, indexType, {}, first, firstItem});
+        return static_cast<uint32_t>(groups.size() - 1);
+    }
+
+    uint32_t DrawList::getMaxIndexedGroupItemCount() const {
+        uint32_t itemCount = 0;
+        for (const auto &group : indexedGroups) {
+            itemCount = std::max(itemCount, group.itemCount);
+        }
+        return itemCount;
+    }
+
+    void DrawList::add(const Mesh &mesh, const uint32_t transformIndex, const uint32_t materialIndex) {
+        const auto &range = mesh.getRange();
+        const auto &format = mesh.getFormat();
+        if (std::find(formats.begin(), formats.end(), format) == formats.end()) {
+            formats.push_back(format);
+        }
+        const DrawData data{mesh.getPositionOffset(), transformIndex, mesh.getPositionScale(), materialIndex};
+
+        if (range.isIndexed()) {
+            const auto drawIndex = static_cast<uint32_t>(indexedDraws.size());
+            const auto &lods = mesh.getLods();
+            indexedDraws.push_back({lods[0].indexCount, 1, lods[0].firstIndex, range.vertexOffset, drawIndex});
+            const auto &clusters = mesh.getClusters();
+            const auto itemCount = static_cast<uint32_t>(std::max<size_t>(clusters.size(), 1));
+            const uint32_t group = findGroup(indexedGroups, format, range.indexType, drawIndex, cullItemCount);
+            indexedGroups[group].draws.push_back(drawIndex);
+            indexedGroups[group].itemCount += itemCount;
+            for (uint32_t later = group + 1; later < indexedGroups.size(); later++) {
+                indexedGroups[later].first++;
+                indexedGroups[later].firstItem += itemCount;
+            }
+            cullItemCount += itemCount;
+            indexedDrawGroups.push_back(group);
+            indexedData.push_back(data);
+            const auto &bounds = mesh.getBounds();
+            indexedBounds.push_back({
+                (bounds.min + bounds.max) * 0.5f, static_cast<uint32_t>(indexedLods.size()),
+                (bounds.max - bounds.min) * 0.5f, static_cast<uint32_t>(lods.size())});
+            for (const auto &lod : lods) {
+                indexedLods.push_back({lod.firstIndex, lod.indexCount, lod.error});
+            }
+            indexedClusterSpans.emplace_back(static_cast<uint32_t>(indexedClusters.size()),
+                                             static_cast<uint32_t>(clusters.size()));
+            for (const auto &cluster : clusters) {
+                indexedClusters.push_back({
+                    cluster.center, cluster.radius, cluster.coneAxis, cluster.coneCutoff,
+                    cluster.firstIndex, cluster.indexCount, {}});
+            }
+        } else {
+            const auto drawIndex = static_cast<uint32_t>(nonIndexedDraws.size());
+            nonIndexedDraws.push_back({range.vertexCount, 1, static_cast<uint32_t>(range.vertexOffset), 0});
+            const uint32_t group = findGroup(nonIndexedGroups, format, VK_INDEX_TYPE_UINT16, drawIndex);
+            nonIndexedGroups[group].draws.push_back(drawIndex);
+            for (uint32_t later = group + 1; later < nonIndexedGroups.size(); later++) {
+                nonIndexedGroups[later].first++;
+            }
+            nonIndexedData.push_back(data);
+        }
+        dirtyFrames = ALL_FRAMES_DIRTY;
+    }
+
+    void DrawList::update(const int frameIndex) {
+        const uint32_t frameBit = 1u << frameIndex;
+        if ((dirtyFrames & frameBit) == 0) {
+            return;
+        }
+        VE_PROFILE_SCOPE("DrawList::update");
+
+        auto &frame = frames[frameIndex];
+        const uint32_t drawCount = getDrawCount();
+        if (drawCount > frame.capacity) {
+            createFrameBuffers(frame, std::max(frame.capacity * 2, drawCount));
+        }
+        const auto lodCount = static_cast<uint32_t>(indexedLods.size());
+        if (lodCount > frame.lodCapacity) {
+            createLods(frame, std::max(frame.lodCapacity * 2, lodCount));
+        }
+        const auto clusterCount = static_cast<uint32_t>(indexedClusters.size());
+        if (clusterCount > frame.clusterCapacity) {
+            createClusters(frame, std::max(frame.clusterCapacity * 2, clusterCount));
+        }
+        if (cullItemCount > frame.cullItemCapacity) {
+            createCullItems(frame, std::max(frame.cullItemCapacity * 2, cullItemCount));
+        }
+
+        const auto indexedCount = static_cast<uint32_t>(indexedDraws.size());
+        auto *indexedCommands = static_cast<VkDrawIndexedIndirectCommand *>(frame.indexedCommands->getMappedMemory());
+        auto *cullItems = static_cast<CullItem *>(frame.cullItems->getMappedMemory());
+        for (const auto &group : indexedGroups) {
+            uint32_t item = group.firstItem;
+            for (uint32_t i = 0; i < group.draws.size(); i++) {
+                const uint32_t command = group.first + i;
+                indexedCommands[command] = indexedDraws[group.draws[i]];
+                const auto [firstCluster, drawClusters] = indexedClusterSpans[group.draws[i]];
+                if (drawClusters == 0) {
+                    cullItems[item++] = {command, NO_CLUSTER | LEAD_ITEM};
+                }
+                for (uint32_t cluster = 0; cluster < drawClusters; cluster++) {
+                    cullItems[item++] = {command, (firstCluster + cluster) | (cluster == 0 ? LEAD_ITEM : 0)};
+                }
+            }
+        }
+
+        auto *nonIndexedCommands = static_cast<VkDrawIndirectCommand *>(frame.nonIndexedCommands->getMappedMemory());
+        for (const auto &group : nonIndexedGroups) {
+            for (uint32_t i = 0; i < group.draws.size(); i++) {
+                nonIndexedCommands[group.first + i] = nonIndexedDraws[group.draws[i]];
+                nonIndexedCommands[group.first + i].firstInstance = indexedCount + group.draws[i];
+            }
+        }
+
+        auto *drawData = static_cast<DrawData *>(frame.drawData->getMappedMemory());
+        std::copy(indexedData.begin(), indexedData.end(), drawData);
+        std::copy(nonIndexedData.begin(), nonIndexedData.end(), drawData + indexedCount);
+
+        std::copy(indexedBounds.begin(), indexedBounds.end(), static_cast<DrawBounds *>(frame.bounds->getMappedMemory()));
+        std::copy(indexedLods.begin(), indexedLods.end(), static_cast<DrawLod *>(frame.lods->getMappedMemory()));
+        std::copy(indexedClusters.begin(), indexedClusters.end(),
+                  static_cast<DrawCluster *>(frame.clusters->getMappedMemory()));
+
+        frame.indexedCommands->flush();
+        frame.nonIndexedCommands->flush();
+        frame.drawData->flush();
+        frame.bounds->flush();
+        frame.lods->flush();
+        frame.clusters->flush();
+        frame.cullItems->flush();
+
+        dirtyFrames &= ~frameBit;
+    }
+
+    void DrawList::setVisible(const int frameIndex, const std::vector<uint32_t> &visible,
+                              const std::vector<uint32_t> &lods) {
+        VE_PROFILE_SCOPE("DrawList::setVisible");
+        auto &frame = frames[frameIndex];
+        const auto visibleCount = static_cast<uint32_t>(visible.size());
+        if (visibleCount > frame.visibleCapacity) {
+            createVisibleCommands(frame, std::max(frame.visibleCapacity * 2, visibleCount));
+        }
+
+        // Counted first, so each group's visible draws can be placed where the group starts
+        frame.visibleGroupCounts.assign(indexedGroups.size(), 0);
+        for (const uint32_t draw : visible) {
+            frame.visibleGroupCounts[indexedDrawGroups[draw]]++;
+        }
+        std::vector<uint32_t> groupEnds(indexedGroups.size());
+        uint32_t first = 0;
+        for (uint32_t group = 0; group < indexedGroups.size(); group++) {
+            groupEnds[group] = first;
+            first += frame.visibleGroupCounts[group];
+        }
+
+        frame.visibleDraws.resize(visibleCount);
+        for (uint32_t i = 0; i < visibleCount; i++) {
+            const uint32_t draw = visible[i];
+            auto &command = frame.visibleDraws[groupEnds[indexedDrawGroups[draw]]++];
+            command = indexedDraws[draw];
+            if (!lods.empty()) {
+                const auto &lod = indexedLods[indexedBounds[draw].firstLod + lods[i]];
+                command.firstIndex = lod.firstIndex;
+                command.indexCount = lod.indexCount;
+            }
+        }
+
+        std::copy(frame.visibleDraws.begin(), frame.visibleDraws.end(),
+                  static_cast<VkDrawIndexedIndirectCommand *>(frame.visibleCommands->getMappedMemory()));
+        frame.visibleCommands->flush();
+        frame.visibleOnly = true;
+    }
+
+    void DrawList::setAllVisible(const int frameIndex) {
+        frames[frameIndex].visibleOnly = false;
+    }
+
+    uint32_t DrawList::selectLod(const uint32_t draw, const glm::vec3 &center, const float radius, const float scale,
+                                 const LodView &view) const {
+        // From inside the sphere its projection is unbounded
+        const float distance = glm::length(center - view.cameraPosition);
+        if (distance <= radius) {
+            return 0;
+        }
+        if (2.0f * radius * view.pixelsPerUnit < view.minPixelSize * distance) {
+            return CULLED_LOD;
+        }
+
+        // Errors are projected from the nearest point of the sphere. They grow with the level, the first one over
+        // the budget ends the search.
+        const float pixelsPerError = scale * view.pixelsPerUnit / (distance - radius);
+        const auto &bounds = indexedBounds[draw];
+        uint32_t lod = 0;
+        for (uint32_t level = 1; level < bounds.lodCount; level++) {
+            if (indexedLods[bounds.firstLod + level].error * pixelsPerError > view.pixelError) {
+                break;
+            }
+            lod = level;
+        }
+        return lod;
+    }
+
+    uint32_t DrawList::getDrawnCount(const Frame &frame, const uint32_t group) const {
+        return frame.visibleOnly
+            ? frame.visibleGroupCounts[group]
+            : static_cast<uint32_t>(indexedGroups[group].draws.size());
+    }
+
+    void DrawList::bindGroup(VkCommandBuffer commandBuffer, const Group &group, const VertexFormat *&boundFormat,
+                             const BindFormat &bindFormat) {
+        if (boundFormat != nullptr && *boundFormat == group.format) {
+            Mesh::getGeometryArena(group.format).bindIndices(commandBuffer, group.indexType);
+            return;
+        }
+        bindFormat(commandBuffer, group.format);
+        Mesh::bindGeometry(commandBuffer, group.format, group.indexType);
+        boundFormat = &group.format;
+    }
+
+    void DrawList::drawIndirect(VkCommandBuffer commandBuffer, const int frameIndex,
+                                const BindFormat &bindFormat) const {
+        const auto &frame = frames[frameIndex];
+        const Buffer &commands = frame.visibleOnly ? *frame.visibleCommands : *frame.indexedCommands;
+
+        const VertexFormat *boundFormat = nullptr;
+        uint32_t first = 0;
+        for (uint32_t group = 0; group < indexedGroups.size(); group++) {
+            const uint32_t drawCount = getDrawnCount(frame, group);
+            if (drawCount > 0) {
+                bindGroup(commandBuffer, indexedGroups[group], boundFormat, bindFormat);
+                drawIndexedIndirect(commandBuffer, commands, first * sizeof(VkDrawIndexedIndirectCommand), drawCount);
+            }
+            first += drawCount;
+        }
+
+        drawNonIndexedIndirect(commandBuffer, frame, boundFormat, bindFormat);
+    }
+
+    void DrawList::drawIndexedIndirect(VkCommandBuffer commandBuffer, const Buffer &commands,
+                                       const VkDeviceSize offset, const uint32_t drawCount) const {
+        const uint32_t maxBatch = device.properties.limits.maxDrawIndirectCount;
+        for (uint32_t first = 0; first < drawCount; first += maxBatch) {
+            vkCmdDrawIndexedIndirect(
+                commandBuffer,
+                commands.getBuffer(),
+                offset + first * sizeof(VkDrawIndexedIndirectCommand),
+                std::min(maxBatch, drawCount - first),
+                sizeof(VkDrawIndexedIndirectCommand));
+        }
+    }
+
+    void DrawList::drawIndirectCount(VkCommandBuffer commandBuffer, const int frameIndex,
+                                     const BindFormat &bindFormat, const Buffer &commands, const Buffer &count,
+                                     const VkDeviceSize countOffset, const VkDeviceSize countStride) const {
+        const VertexFormat *boundFormat = nullptr;
+        for (uint32_t group = 0; group < indexedGroups.size(); group++) {
+            const auto &indexedGroup = indexedGroups[group];
+            bindGroup(commandBuffer, indexedGroup, boundFormat, bindFormat);
+            vkCmdDrawIndexedIndirectCount(
+                commandBuffer,
+                commands.getBuffer(),
+                indexedGroup.firstItem * sizeof(VkDrawIndexedIndirectCommand),
+                count.getBuffer(),
+                countOffset + group * countStride,
+                indexedGroup.itemCount,
+                sizeof(VkDrawIndexedIndirectCommand));
+        }
+
+        drawNonIndexedIndirect(commandBuffer, frames[frameIndex], boundFormat, bindFormat);
+    }
+
+    void DrawList::drawNonIndexedIndirect(VkCommandBuffer commandBuffer, const Frame &frame,
+                                          const VertexFormat *&boundFormat, const BindFormat &bindFormat) const {
+        const uint32_t maxBatch = device.properties.limits.maxDrawIndirectCount;
+        for (const auto &group : nonIndexedGroups) {
+            bindGroup(commandBuffer, group, boundFormat, bindFormat);
+            const auto drawCount = static_cast<uint32_t>(group.draws.size());
+            for (uint32_t first = 0; first < drawCount; first += maxBatch) {
+                vkCmdDrawIndirect(
+                    commandBuffer,
+                    frame.nonIndexedCommands->getBuffer(),
+                    (group.first + first) * sizeof(VkDrawIndirectCommand),
+                    std::min(maxBatch, drawCount - first),
+                    sizeof(VkDrawIndirectCommand));
+            }
+        }
+    }
+
+    uint32_t DrawList::getDirectDrawCount(const int frameIndex) const {
+        const auto &frame = frames[frameIndex];
+        const auto indexedCount = frame.visibleOnly ? frame.visibleDraws.size() : indexedDraws.size();
+        return static_cast<uint32_t>(indexedCount + nonIndexedDraws.size());
+    }
+
+    uint64_t DrawList::getIndexedTriangleCount(const int frameIndex) const {
+        const auto &frame = frames[frameIndex];
+        uint64_t indexCount = 0;
+        for (const auto &draw : frame.visibleOnly ? frame.visibleDraws : indexedDraws) {
+            indexCount += draw.indexCount;
+        }
+        return indexCount / 3;
+    }
+
+    void DrawList::drawDirect(VkCommandBuffer commandBuffer, const int frameIndex, const BindFormat &bindFormat,
+                              const uint32_t first, const uint32_t count) const {
+        const auto &frame = frames[frameIndex];
+        const auto indexedCount = static_cast<uint32_t>(indexedDraws.size());
+        const uint32_t drawCount = getDirectDrawCount(frameIndex);
+        const uint32_t end = first + std::min(count, drawCount - std::min(first, drawCount));
+
+        // Positions in the visible indexed draws, then in the non-indexed ones, walked group by group
+        const VertexFormat *boundFormat = nullptr;
+        uint32_t groupFirst = 0;
+        for (uint32_t group = 0; group < indexedGroups.size() && groupFirst < end; group++) {
+            const uint32_t groupEnd = groupFirst + getDrawnCount(frame, group);
+            const auto &indexedGroup = indexedGroups[group];
+            for (uint32_t i = std::max(first, groupFirst); i < std::min(end, groupEnd); i++) {
+                if (i == std::max(first, groupFirst)) {
+                    bindGroup(commandBuffer, indexedGroup, boundFormat, bindFormat);
+                }
+                const auto &draw = frame.visibleOnly
+                    ? frame.visibleDraws[i]
+                    : indexedDraws[indexedGroup.draws[i - groupFirst]];
+                vkCmdDrawIndexed(commandBuffer, draw.indexCount, 1, draw.firstIndex, draw.vertexOffset,
+                                 draw.firstInstance);
+            }
+            groupFirst = groupEnd;
+        }
+
+        for (const auto &group : nonIndexedGroups) {
+            if (groupFirst >= end) {
+                break;
+            }
+            const uint32_t groupEnd = groupFirst + static_cast<uint32_t>(group.draws.size());
+            for (uint32_t i = std::max(first, groupFirst); i < std::min(end, groupEnd); i++) {
+                if (i == std::max(first, groupFirst)) {
+                    bindGroup(commandBuffer, group, boundFormat, bindFormat);
+                }
+                const uint32_t drawIndex = group.draws[i - groupFirst];
+                const auto &draw = nonIndexedDraws[drawIndex];
+                vkCmdDraw(commandBuffer, draw.vertexCount, 1, draw.firstVertex, indexedCount + drawIndex);
+            }
+            groupFirst = groupEnd;
+        }
+    }
+} // ve
@@ -0,0 +1,243 @@
+#pragma once
+
+#include "mesh.hpp"
+#include "../memory/buffer.hpp"
+#include "../memory/descriptors.hpp"
+#include "../swapChain.hpp"
+
+// std
+#include <array>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace ve {
+    // The draws of a render program, built on the CPU when the scene changes and uploaded once per frame slot.
+    // Draw i is issued with firstInstance = i, so the shaders find its record at drawData[gl_InstanceIndex]
+    // whether it goes out through a multi-draw indirect call or a plain draw call.
+    // Commands are issued in groups of one vertex format and, for indexed ones, one index type, in the order the
+    // groups first appeared, with one geometry bind per group and one pipeline bind per change of format. The draw
+    // data stays in the order the draws were added.
+    class DrawList {
+    public:
+        // One record of the draw data buffer, laid out like the std430 DrawData struct in PBR.vert. Positions are
+        // dequantized as position * positionScale + positionOffset.
+        struct DrawData {
+            glm::vec3 positionOffset;
+            uint32_t transformIndex;
+            glm::vec3 positionScale;
+            uint32_t materialIndex;
+        };
+
+        // Binds the pipeline of a vertex format, called before the geometry of its groups is bound
+        using BindFormat = std::function<void(VkCommandBuffer, const VertexFormat &)>;
+
+        // Object space box of an indexed draw and where its levels of detail are, laid out like the std430
+        // DrawBounds struct in drawCulling.comp. Indexed like the draw data.
+        struct DrawBounds {
+            glm::vec3 center;
+            uint32_t firstLod;
+            glm::vec3 extent;
+            uint32_t lodCount;
+        };
+
+        // A level of detail of an indexed draw, laid out like the std430 DrawLod struct in drawCulling.comp
+        struct DrawLod {
+            uint32_t firstIndex;
+            uint32_t indexCount;
+            // Object space, see Mesh::Lod
+            float error;
+        };
+
+        // What the levels of detail are picked for, see selectLod
+        struct LodView {
+            glm::vec3 cameraPosition;
+            // Pixels an object one unit across covers at unit distance, |projection[1][1]| * viewport height / 2
+            float pixelsPerUnit;
+            // Projected error a level may have, levels with none are picked even at 0
+            float pixelError;
+            // Draws whose bounding sphere is projected smaller across are culled, 0 culls none
+            float minPixelSize;
+        };
+
+        static constexpr uint32_t CULLED_LOD = UINT32_MAX;
+
+        // A cluster of an indexed draw's full mesh, laid out like the std430 DrawCluster struct in drawCulling.comp.
+        // See Mesh::Cluster.
+        struct DrawCluster {
+            glm::vec3 center;
+            float radius;
+            glm::vec3 coneAxis;
+            float coneCutoff;
+            uint32_t firstIndex;
+            uint32_t indexCount;
+            uint32_t pad[2];
+        };
+
+        // What the GPU culling tests, one of a draw's clusters, or the whole draw when it has none. Grouped like the
+        // indexed commands, each draw's items in a row, so every group has as many as it can emit visible commands.
+        struct CullItem {
+            // Where the draw is in the grouped indexed commands
+            uint32_t command;
+            // Into the clusters, NO_CLUSTER for a whole draw. The first item of each draw carries LEAD_ITEM.
+            uint32_t cluster;
+        };
+
+        static constexpr uint32_t LEAD_ITEM = 0x80000000u;
+        static constexpr uint32_t NO_CLUSTER = 0x7FFFFFFFu;
+
+        explicit DrawList(Device &device);
+
+        DrawList(const DrawList &) = delete;
+        DrawList &operator=(const DrawList &) = delete;
+
+        void clear();
+        void add(const Mesh &mesh, uint32_t transformIndex, uint32_t materialIndex);
+
+        // Uploads the commands and draw data into this frame's buffers if the list changed since they were written.
+        void update(int frameIndex);
+        // Restricts this frame's indexed draws to the ones listed, by index in the order they were added, until the
+        // next call, each at the level of detail of the same position in lods, or at its full mesh when lods is
+        // empty. The draws keep firstInstance = their index, so they still find their draw data.
+        void setVisible(int frameIndex, const std::vector<uint32_t> &visible, const std::vector<uint32_t> &lods = {});
+        void setAllVisible(int frameIndex);
+        // The draw calls bind the pipeline through bindFormat and the geometry of each group themselves.
+
+        // Needs Device::supportsIndirectDraw, the commands go out in batches of at most maxDrawIndirectCount.
+        void drawIndirect(VkCommandBuffer commandBuffer, int frameIndex, const BindFormat &bindFormat) const;
+        // Issues count of this frame's getDirectDrawCount draws starting at first, so chunks of the list can be
+        // recorded into separate command buffers
+        void drawDirect(VkCommandBuffer commandBuffer, int frameIndex, const BindFormat &bindFormat,
+                        uint32_t first = 0, uint32_t count = UINT32_MAX) const;
+        // Needs Device::supportsIndirectDrawCount. The indexed draws come from commands compacted per group the
+        // way the GPU culling does it, group g from getIndexedGroupItemStart(g) on, as many as count holds at
+        // countOffset + g * countStride. Each group is one call, the counts must stay within maxDrawIndirectCount,
+        // see getMaxIndexedGroupItemCount. The non-indexed ones are not culled and go out as in drawIndirect.
+        void drawIndirectCount(VkCommandBuffer commandBuffer, int frameIndex, const BindFormat &bindFormat,
+                               const Buffer &commands, const Buffer &count, VkDeviceSize countOffset,
+                               VkDeviceSize countStride) const;
+
+        DescriptorSetLayout &getSetLayout() const { return *setLayout; }
+        VkDescriptorSet getDescriptorSet(int frameIndex) const { return frames[frameIndex].descriptorSet; }
+        uint32_t getDrawCount() const {
+            return static_cast<uint32_t>(indexedDraws.size() + nonIndexedDraws.size());
+        }
+        uint32_t getIndexedDrawCount() const { return static_cast<uint32_t>(indexedDraws.size()); }
+        uint32_t getIndexedGroupCount() const { return static_cast<uint32_t>(indexedGroups.size()); }
+        uint32_t getLodCount() const { return static_cast<uint32_t>(indexedLods.size()); }
+        uint32_t getClusterCount() const { return static_cast<uint32_t>(indexedClusters.size()); }
+        uint32_t getCullItemCount() const { return cullItemCount; }
+        // Where the group's commands start in the indexed commands
+        uint32_t getIndexedGroupStart(const uint32_t group) const { return indexedGroups[group].first; }
+        // Where the group's cull items start, and its commands in a buffer compacted per group by the GPU culling
+        uint32_t getIndexedGroupItemStart(const uint32_t group) const { return indexedGroups[group].firstItem; }
+        // The most cull items of an indexed group, the most commands drawIndirectCount can draw in one call
+        uint32_t getMaxIndexedGroupItemCount() const;
+        // Every format a draw uses, in the order they first appeared
+        const std::vector<VertexFormat> &getFormats() const { return formats; }
+        // The visible indexed draws followed by the non-indexed ones
+        uint32_t getDirectDrawCount(int frameIndex) const;
+        // Indices of this frame's visible indexed draws, or of all of them, divided by 3
+        uint64_t getIndexedTriangleCount(int frameIndex) const;
+
+        // Level of detail of an indexed draw whose world space bounding sphere is center and radius, scale being the
+        // largest scale of its transform: the coarsest level whose error projects to at most view.pixelError
+        // pixels, or CULLED_LOD when the sphere covers less than view.minPixelSize. Mirrors drawCulling.comp.
+        uint32_t selectLod(uint32_t draw, const glm::vec3 &center, float radius, float scale,
+                           const LodView &view) const;
+
+        // This frame's buffers, valid after update. The indexed commands are grouped, their firstInstance is where
+        // their draw data and bounds are.
+        Buffer &getIndexedCommands(int frameIndex) const { return *frames[frameIndex].indexedCommands; }
+        Buffer &getDrawData(int frameIndex) const { return *frames[frameIndex].drawData; }
+        Buffer &getBounds(int frameIndex) const { return *frames[frameIndex].bounds; }
+        // Every indexed draw's levels of detail, where its bounds say
+        Buffer &getLods(int frameIndex) const { return *frames[frameIndex].lods; }
+        Buffer &getClusters(int frameIndex) const { return *frames[frameIndex].clusters; }
+        Buffer &getCullItems(int frameIndex) const { return *frames[frameIndex].cullItems; }
+
+    private:
+        struct Frame {
+            std::unique_ptr<Buffer> indexedCommands;
+            std::unique_ptr<Buffer> nonIndexedCommands;
+            std::unique_ptr<Buffer> drawData;
+            std::unique_ptr<Buffer> bounds;
+            std::unique_ptr<Buffer> lods;
+            std::unique_ptr<Buffer> clusters;
+            std::unique_ptr<Buffer> cullItems;
+            VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+            uint32_t capacity = 0;
+            uint32_t lodCapacity = 0;
+            uint32_t clusterCapacity = 0;
+            uint32_t cullItemCapacity = 0;
+
+            // Written by setVisible, only drawn while visibleOnly is set. Grouped like the indexed commands, with
+            // visibleGroupCounts of each group.
+            std::unique_ptr<Buffer> visibleCommands;
+            std::vector<VkDrawIndexedIndirectCommand> visibleDraws;
+            std::vector<uint32_t> visibleGroupCounts;
+            uint32_t visibleCapacity = 0;
+            bool visibleOnly = false;
+        };
+
+        // Draws of one format and, when indexed, one index type
+        struct Group {
+            VertexFormat format;
+            // Bound for non-indexed groups too, where it is unused
+            VkIndexType indexType;
+            // In the order they were added
+            std::vector<uint32_t> draws;
+            // Where the group starts in the grouped commands
+            uint32_t first = 0;
+            // Of indexed groups, where the group starts in the cull items and how many it has
+            uint32_t firstItem = 0;
+            uint32_t itemCount = 0;
+        };
+
+        // A new group is appended after every draw and cull item added so far, the given counts of them
+        static uint32_t findGroup(std::vector<Group> &groups, const VertexFormat &format, VkIndexType indexType,
+                                  uint32_t first, uint32_t firstItem = 0);
+        // Binds the group's geometry, and its pipeline when the format differs from the bound one
+        static void bindGroup(VkCommandBuffer commandBuffer, const Group &group, const VertexFormat *&boundFormat,
+                              const BindFormat &bindFormat);
+        // Draws of the group this frame draws
+        uint32_t getDrawnCount(const Frame &frame, uint32_t group) const;
+
+        void createFrameBuffers(Frame &frame, uint32_t capacity);
+        void createVisibleCommands(Frame &frame, uint32_t capacity);
+        void createLods(Frame &frame, uint32_t capacity);
+        void createClusters(Frame &frame, uint32_t capacity);
+        void createCullItems(Frame &frame, uint32_t capacity);
+        void drawIndexedIndirect(VkCommandBuffer commandBuffer, const Buffer &commands, VkDeviceSize offset,
+                                 uint32_t drawCount) const;
+        void drawNonIndexedIndirect(VkCommandBuffer commandBuffer, const Frame &frame,
+                                    const VertexFormat *&boundFormat, const BindFormat &bindFormat) const;
+
+        Device &device;
+
+        std::unique_ptr<DescriptorSetLayout> setLayout;
+        std::unique_ptr<DescriptorPool> pool;
+        std::array<Frame, SwapChain::MAX_FRAMES_IN_FLIGHT> frames{};
+
+        // Indexed draws come first in the draw data, their firstInstance is their index
+        std::vector<VkDrawIndexedIndirectCommand> indexedDraws;
+        // Group of each indexed draw
+        std::vector<uint32_t> indexedDrawGroups;
+        std::vector<Group> indexedGroups;
+        std::vector<DrawData> indexedData;
+        std::vector<DrawBounds> indexedBounds;
+        std::vector<DrawLod> indexedLods;
+        std::vector<DrawCluster> indexedClusters;
+        // First cluster and cluster count of each indexed draw
+        std::vector<std::pair<uint32_t, uint32_t>> indexedClusterSpans;
+        uint32_t cullItemCount = 0;
+        std::vector<VkDrawIndirectCommand> nonIndexedDraws;
+        std::vector<Group> nonIndexedGroups;
+        std::vector<DrawData> nonIndexedData;
+        std::vector<VertexFormat> formats;
+
+        static constexpr uint32_t ALL_FRAMES_DIRTY = (1u << SwapChain::MAX_FRAMES_IN_FLIGHT) - 1;
+        uint32_t dirtyFrames = ALL_FRAMES_DIRTY;
+    };
+} // ve
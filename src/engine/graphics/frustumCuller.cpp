@@ -0,0 +1,261 @@
+#include "frustumCuller.hpp"
+
+// std
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64)
+#define VE_CULLING_SSE
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// Compiled in without -mavx, only called once the CPU has reported AVX support
+#if defined(VE_CULLING_SSE) && (defined(__GNUC__) || defined(__clang__))
+#define VE_TARGET_AVX __attribute__((target("avx")))
+#else
+#define VE_TARGET_AVX
+#endif
+
+namespace ve {
+    void FrustumCuller::clear() {
+        centerX.clear();
+        centerY.clear();
+        centerZ.clear();
+        extentX.clear();
+        extentY.clear();
+        extentZ.clear();
+    }
+
+    uint32_t FrustumCuller::add(const glm::vec3 &min, const glm::vec3 &max) {
+        const uint32_t index = size();
+        centerX.push_back(0.0f);
+        centerY.push_back(0.0f);
+        centerZ.push_back(0.0f);
+        extentX.push_back(0.0f);
+        extentY.push_back(0.0f);
+        extentZ.push_back(0.0f);
+        set(index, min, max);
+        return index;
+    }
+
+    void FrustumCuller::set(const uint32_t index, const glm::vec3 &min, const glm::vec3 &max) {
+        const glm::vec3 center = (min + max) * 0.5f;
+        const glm::vec3 extent = (max - min) * 0.5f;
+        centerX[index] = center.x;
+        centerY[index] = center.y;
+        centerZ[index] = center.z;
+        extentX[index] = extent.x;
+        extentY[index] = extent.y;
+        extentZ[index] = extent.z;
+    }
+
+    FrustumCuller::Planes FrustumCuller::getFrustumPlanes(const glm::mat4 &viewProjection) {
+        // Gribb-Hartmann, on the rows of the matrix
+        const glm::mat4 rows = glm::transpose(viewProjection);
+        Planes planes = {
+            rows[3] + rows[0],
+            rows[3] - rows[0],
+            rows[3] + rows[1],
+            rows[3] - rows[1],
+            rows[2],
+            rows[3] - rows[2],
+        };
+
+        for (auto &plane : planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+        return planes;
+    }
+
+    void FrustumCuller::transformBox(const glm::mat4 &matrix, glm::vec3 &min, glm::vec3 &max) {
+        const glm::vec3 center = glm::vec3(matrix * glm::vec4((min + max) * 0.5f, 1.0f));
+        const glm::vec3 extent = (max - min) * 0.5f;
+        const glm::vec3 transformedExtent =
+            glm::abs(glm::vec3(matrix[0])) * extent.x +
+            glm::abs(glm::vec3(matrix[1])) * extent.y +
+            glm::abs(glm::vec3(matrix[2])) * extent.z;
+        min = center - transformedExtent;
+        max = center + transformedExtent;
+    }
+
+    void FrustumCuller::cull(const Path path, const glm::mat4 &viewProjection, std::vector<uint32_t> &visible) const {
+        const Planes planes = getFrustumPlanes(viewProjection);
+
+        uint32_t next = 0;
+        if (path == Path::Avx) {
+            next = cullAvx(planes, next, visible);
+        }
+        if (path == Path::Avx || path == Path::Sse) {
+            next = cullSse(planes, next, visible);
+        }
+        cullScalar(planes, next, visible);
+    }
+
+    // Outside when the center is farther behind a plane than the box reaches towards it. Written as !(d >= 0), so
+    // NaN boxes are culled the same way the SIMD comparisons cull them.
+    uint32_t FrustumCuller::cullScalar(const Planes &planes, const uint32_t first, std::vector<uint32_t> &visible) const {
+        const uint32_t count = size();
+        for (uint32_t i = first; i < count; i++) {
+            bool inside = true;
+            for (const auto &plane : planes) {
+                const float distance = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w;
+                const float radius = std::abs(plane.x) * extentX[i] + std::abs(plane.y) * extentY[i] +
+                                     std::abs(plane.z) * extentZ[i];
+                if (!(distance + radius >= 0.0f)) {
+                    inside = false;
+                    break;
+                }
+            }
+            if (inside) {
+                visible.push_back(i);
+            }
+        }
+        return count;
+    }
+
+#ifdef VE_CULLING_SSE
+    uint32_t FrustumCuller::cullSse(const Planes &planes, const uint32_t first, std::vector<uint32_t> &visible) const {
+        __m128 planeX[6], planeY[6], planeZ[6], planeW[6], absX[6], absY[6], absZ[6];
+        for (int p = 0; p < 6; p++) {
+            planeX[p] = _mm_set1_ps(planes[p].x);
+            planeY[p] = _mm_set1_ps(planes[p].y);
+            planeZ[p] = _mm_set1_ps(planes[p].z);
+            planeW[p] = _mm_set1_ps(planes[p].w);
+            absX[p] = _mm_set1_ps(std::abs(planes[p].x));
+            absY[p] = _mm_set1_ps(std::abs(planes[p].y));
+            absZ[p] = _mm_set1_ps(std::abs(planes[p].z));
+        }
+        const __m128 zero = _mm_setzero_ps();
+
+        const uint32_t count = size();
+        uint32_t i = first;
+        for (; i + 4 <= count; i += 4) {
+            const __m128 cx = _mm_loadu_ps(centerX.data() + i);
+            const __m128 cy = _mm_loadu_ps(centerY.data() + i);
+            const __m128 cz = _mm_loadu_ps(centerZ.data() + i);
+            const __m128 ex = _mm_loadu_ps(extentX.data() + i);
+            const __m128 ey = _mm_loadu_ps(extentY.data() + i);
+            const __m128 ez = _mm_loadu_ps(extentZ.data() + i);
+
+            int mask = 0xF;
+            for (int p = 0; p < 6 && mask != 0; p++) {
+                const __m128 distance = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)),
+                    _mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+                const __m128 radius = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(absX[p], ex), _mm_mul_ps(absY[p], ey)),
+                    _mm_mul_ps(absZ[p], ez));
+                mask &= _mm_movemask_ps(_mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+            }
+
+            for (uint32_t lane = 0; mask != 0; lane++, mask >>= 1) {
+                if (mask & 1) {
+                    visible.push_back(i + lane);
+                }
+            }
+        }
+        return i;
+    }
+
+    VE_TARGET_AVX
+    uint32_t FrustumCuller::cullAvx(const Planes &planes, const uint32_t first, std::vector<uint32_t> &visible) const {
+        __m256 planeX[6], planeY[6], planeZ[6], planeW[6], absX[6], absY[6], absZ[6];
+        for (int p = 0; p < 6; p++) {
+            planeX[p] = _mm256_set1_ps(planes[p].x);
+            planeY[p] = _mm256_set1_ps(planes[p].y);
+            planeZ[p] = _mm256_set1_ps(planes[p].z);
+            planeW[p] = _mm256_set1_ps(planes[p].w);
+            absX[p] = _mm256_set1_ps(std::abs(planes[p].x));
+            absY[p] = _mm256_set1_ps(std::abs(planes[p].y));
+            absZ[p] = _mm256_set1_ps(std::abs(planes[p].z));
+        }
+        const __m256 zero = _mm256_setzero_ps();
+
+        const uint32_t count = size();
+        uint32_t i = first;
+        for (; i + 8 <= count; i += 8) {
+            const __m256 cx = _mm256_loadu_ps(centerX.data() + i);
+            const __m256 cy = _mm256_loadu_ps(centerY.data() + i);
+            const __m256 cz = _mm256_loadu_ps(centerZ.data() + i);
+            const __m256 ex = _mm256_loadu_ps(extentX.data() + i);
+            const __m256 ey = _mm256_loadu_ps(extentY.data() + i);
+            const __m256 ez = _mm256_loadu_ps(extentZ.data() + i);
+
+            int mask = 0xFF;
+            for (int p = 0; p < 6 && mask != 0; p++) {
+                const __m256 distance = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(planeX[p], cx), _mm256_mul_ps(planeY[p], cy)),
+                    _mm256_add_ps(_mm256_mul_ps(planeZ[p], cz), planeW[p]));
+                const __m256 radius = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(absX[p], ex), _mm256_mul_ps(absY[p], ey)),
+                    _mm256_mul_ps(absZ[p], ez));
+                mask &= _mm256_movemask_ps(_mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_GE_OQ));
+            }
+
+            for (uint32_t lane = 0; mask != 0; lane++, mask >>= 1) {
+                if (mask & 1) {
+                    visible.push_back(i + lane);
+                }
+            }
+        }
+        return i;
+    }
+
+    static bool cpuSupportsAvx() {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        // The OS has to save the upper halves of the ymm registers too
+        return osxsave && avx && (_xgetbv(0) & 0x6) == 0x6;
+#else
+        return __builtin_cpu_supports("avx");
+#endif
+    }
+#else
+    uint32_t FrustumCuller::cullSse(const Planes &, const uint32_t first, std::vector<uint32_t> &) const {
+        return first;
+    }
+
+    uint32_t FrustumCuller::cullAvx(const Planes &, const uint32_t first, std::vector<uint32_t> &) const {
+        return first;
+    }
+#endif
+
+    bool FrustumCuller::isSupported(const Path path) {
+        switch (path) {
+            case Path::Scalar:
+                return true;
+#ifdef VE_CULLING_SSE
+            case Path::Sse:
+                return true;
+            case Path::Avx: {
+                static const bool avx = cpuSupportsAvx();
+                return avx;
+            }
+#endif
+            default:
+                return false;
+        }
+    }
+
+    FrustumCuller::Path FrustumCuller::getBestPath() {
+        static const Path best = isSupported(Path::Avx) ? Path::Avx : isSupported(Path::Sse) ? Path::Sse : Path::Scalar;
+        return best;
+    }
+
+    const char *FrustumCuller::getPathName(const Path path) {
+        switch (path) {
+            case Path::Scalar:
+                return "scalar";
+            case Path::Sse:
+                return "SSE";
+            case Path::Avx:
+                return "AVX";
+        }
+        return "unknown";
+    }
+} // ve
@@ -0,0 +1,56 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace ve {
+    // World space boxes stored as structure of arrays, center and half extent per axis, so the frustum test loads
+    // 4 (SSE) or 8 (AVX) boxes per instruction. The widest path the CPU supports is picked at run time.
+    class FrustumCuller {
+    public:
+        enum class Path { Scalar, Sse, Avx };
+
+        using Planes = std::array<glm::vec4, 6>;
+
+        void clear();
+        // Returns the index the box is reported with
+        uint32_t add(const glm::vec3 &min, const glm::vec3 &max);
+        void set(uint32_t index, const glm::vec3 &min, const glm::vec3 &max);
+        uint32_t size() const { return static_cast<uint32_t>(centerX.size()); }
+
+        // Appends the indices of the boxes intersecting the frustum, in increasing order. Boxes straddling a plane
+        // count as visible.
+        void cull(const glm::mat4 &viewProjection, std::vector<uint32_t> &visible) const {
+            cull(getBestPath(), viewProjection, visible);
+        }
+        void cull(Path path, const glm::mat4 &viewProjection, std::vector<uint32_t> &visible) const;
+
+        // Planes of a [0, 1] depth projection with normalized, inward facing normals
+        static Planes getFrustumPlanes(const glm::mat4 &viewProjection);
+        // The box around a transformed box
+        static void transformBox(const glm::mat4 &matrix, glm::vec3 &min, glm::vec3 &max);
+
+        static bool isSupported(Path path);
+        static Path getBestPath();
+        static const char *getPathName(Path path);
+
+    private:
+        // All of them cull from box first onwards and return where they stopped, the rest is left to a narrower path
+        uint32_t cullScalar(const Planes &planes, uint32_t first, std::vector<uint32_t> &visible) const;
+        uint32_t cullSse(const Planes &planes, uint32_t first, std::vector<uint32_t> &visible) const;
+        uint32_t cullAvx(const Planes &planes, uint32_t first, std::vector<uint32_t> &visible) const;
+
+        std::vector<float> centerX;
+        std::vector<float> centerY;
+        std::vector<float> centerZ;
+        std::vector<float> extentX;
+        std::vector<float> extentY;
+        std::vector<float> extentZ;
+    };
+} // ve
@@ -5,7 +5,6 @@
 #include "graphicsPipeline.hpp"
 #include "../../utils.hpp"
 #include "../../log.hpp"
-#include "Mesh.hpp"
 
 namespace ve {
     GraphicsPipeline::GraphicsPipeline(Device &device, ShaderFiles& shaderFiles, GraphicsPipelineConfigInfo &configInfo) :device(device) {
@@ -115,8 +114,8 @@ namespace ve {
             shaderStages[stageCount - 2].pSpecializationInfo = nullptr;
         }
 
-        const auto bindingDescriptions = Mesh::Vertex::getBindingDescriptions();
-        const auto attributeDescriptions = Mesh::Vertex::getAttributeDescriptions();
+        const auto& bindingDescriptions = configInfo.bindingDescriptions;
+        const auto& attributeDescriptions = configInfo.attributeDescriptions;
 
         VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
         vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -156,7 +155,7 @@ namespace ve {
         }
     }
 
-    void GraphicsPipeline::defaultPipelineConfigInfo(GraphicsPipelineConfigInfo& configInfo) {
+    void GraphicsPipeline::defaultPipelineConfigInfo(GraphicsPipelineConfigInfo& configInfo, VkSampleCountFlagBits sampleCount) {
         configInfo.inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
         configInfo.inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
         configInfo.inputAssemblyInfo.primitiveRestartEnable = VK_FALSE;
@@ -181,7 +180,7 @@ namespace ve {
 
         configInfo.multisampleInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
         configInfo.multisampleInfo.sampleShadingEnable = VK_FALSE;
-        configInfo.multisampleInfo.rasterizationSamples = VK_SAMPLE_COUNT_8_BIT;
+        configInfo.multisampleInfo.rasterizationSamples = sampleCount;
         configInfo.multisampleInfo.minSampleShading = 1.0f;          // Optional
         configInfo.multisampleInfo.pSampleMask = nullptr;            // Optional
         configInfo.multisampleInfo.alphaToCoverageEnable = VK_FALSE; // Optional
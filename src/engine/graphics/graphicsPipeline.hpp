@@ -21,6 +21,9 @@ namespace ve {
         VkPipelineLayout pipelineLayout = nullptr;
         VkRenderPass renderPass = nullptr;
         VkPipelineTessellationStateCreateInfo tessellationInfo;
+        // From the VertexFormat of the meshes the pipeline draws
+        std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
         uint32_t subpass = 0;
     };
 
@@ -41,7 +44,7 @@ namespace ve {
         GraphicsPipeline& operator=(const GraphicsPipeline&) = delete;
 
         void bind(VkCommandBuffer commandBuffer);
-        static void defaultPipelineConfigInfo(GraphicsPipelineConfigInfo& configInfo);
+        static void defaultPipelineConfigInfo(GraphicsPipelineConfigInfo& configInfo, VkSampleCountFlagBits sampleCount = VK_SAMPLE_COUNT_8_BIT);
 
     private:
         void createGraphicsPipeline(const ShaderFiles& shaderFiles, const GraphicsPipelineConfigInfo& configInfo);
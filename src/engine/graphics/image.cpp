@@ -5,7 +5,6 @@
 #include <stb_image.h>
 
 // std
-#include <execution>
 #include <stdexcept>
 
 namespace ve {
@@ -68,7 +67,7 @@ namespace ve {
                 imageInfo,
                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                 mTextureImage,
-                mTextureImageMemory);
+                mTextureImageAllocation);
 
         VkImageViewCreateInfo viewInfo{};
         viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -117,7 +116,7 @@ namespace ve {
     Image::~Image() {
         vkDestroySampler(mDevice.getDevice(), mTextureSampler, nullptr);
         vkDestroyImage(mDevice.getDevice(), mTextureImage, nullptr);
-        vkFreeMemory(mDevice.getDevice(), mTextureImageMemory, nullptr);
+        mDevice.getAllocator().free(mTextureImageAllocation);
     }
 
     std::shared_ptr<Image> Image::createTextureFromFile(Device &device, const std::string &filepath) {
@@ -144,21 +143,6 @@ namespace ve {
         // mMipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
         mMipLevels = 1;
 
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-
-        mDevice.createBuffer(
-                imageSize,
-                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                stagingBuffer,
-                stagingBufferMemory);
-
-        void *data;
-        vkMapMemory(mDevice.getDevice(), stagingBufferMemory, 0, imageSize, 0, &data);
-        memcpy(data, pixels, static_cast<size_t>(imageSize));
-        vkUnmapMemory(mDevice.getDevice(), stagingBufferMemory);
-
         mFormat = VK_FORMAT_R8G8B8A8_SRGB;
         mExtent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1};
 
@@ -180,36 +164,13 @@ namespace ve {
                 imageInfo,
                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                 mTextureImage,
-                mTextureImageMemory);
-        mDevice.transitionImageLayout(
-                mTextureImage,
-                VK_FORMAT_R8G8B8A8_SRGB,
-                VK_IMAGE_LAYOUT_UNDEFINED,
-                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                mMipLevels,
-                mLayerCount);
-        mDevice.copyBufferToImage(
-                stagingBuffer,
-                mTextureImage,
-                static_cast<uint32_t>(width),
-                static_cast<uint32_t>(height),
-                mLayerCount);
-
-        // comment this out if using mips
-        mDevice.transitionImageLayout(
-                mTextureImage,
-                VK_FORMAT_R8G8B8A8_SRGB,
-                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                mMipLevels,
-                mLayerCount);
+                mTextureImageAllocation);
+        // Recorded into the upload batch, the frames submitted after it see the pixels
+        mDevice.getUploadContext().uploadImage(mTextureImage, mExtent, mMipLevels, mLayerCount, pixels, imageSize);
 
         // If we generate mip maps then the final image will alerady be READ_ONLY_OPTIMAL
         // mDevice.generateMipmaps(mTextureImage, mFormat, texWidth, texHeight, mMipLevels);
         mTextureLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-        vkDestroyBuffer(mDevice.getDevice(), stagingBuffer, nullptr);
-        vkFreeMemory(mDevice.getDevice(), stagingBufferMemory, nullptr);
     }
 
     void Image::createTextureImageView(VkImageViewType viewType) {
@@ -65,7 +65,7 @@ namespace ve {
 
         Device &mDevice;
         VkImage mTextureImage = nullptr;
-        VkDeviceMemory mTextureImageMemory = nullptr;
+        Allocation mTextureImageAllocation{};
         VkImageView mTextureImageView = nullptr;
         VkSampler mTextureSampler = nullptr;
         VkFormat mFormat;
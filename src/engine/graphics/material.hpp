@@ -3,29 +3,17 @@
 //
 
 #pragma once
+#include <cstdint>
 #include <string>
 #include <glm/glm.hpp>
 
 #include "image.hpp"
 
-#include  "../memory/buffer.hpp"
-#include "../renderer.hpp"
-#include "../memory/descriptors.hpp"
+#include "../swapChain.hpp"
 
 namespace ve {
 
 	struct Material {
-        Material(Device& device)
-        {
-            materialUniformBuffer = std::make_unique<Buffer>(
-                device,
-                sizeof(Parameters),
-                1,
-                VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-            materialUniformBuffer->map();
-        }
-
         std::string name;
         std::string id;
 
@@ -37,7 +25,7 @@ namespace ve {
             glm::vec4 baseColorFactor;
             float roughnessFactor;
             float metallicFactor;
-        } parameters{} ;
+        };
 
         struct Samplers
         {
@@ -48,55 +36,26 @@ namespace ve {
             std::shared_ptr<Image> metallicRoughnessTexture;
         } samplers {};
 
+        static constexpr uint32_t NO_TABLE_INDEX = UINT32_MAX;
+        // Slot in the MaterialTable the material was added to, referenced by the draw data of every mesh using it.
+        uint32_t tableIndex = NO_TABLE_INDEX;
 
-        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
-        std::unique_ptr<ve::Buffer> materialUniformBuffer = nullptr;
-
-        void updateBuffers(DescriptorSetLayout& setLayout, const FrameInfo& frameInfo)
+        const Parameters& getParameters() const { return parameters; }
+        void setParameters(const Parameters& parameters)
         {
-            materialUniformBuffer->writeToBuffer(&parameters, sizeof(Parameters));
-            materialUniformBuffer->flush();
-
-            auto bufferInfo = materialUniformBuffer->descriptorInfoForIndex(0);
-
-            VkDescriptorImageInfo emissiveTextureInfo;
-            if (samplers.emissiveTexture != nullptr)
-                emissiveTextureInfo = samplers.emissiveTexture->getImageInfo();
-			else
-                emissiveTextureInfo = Image::getDefaultImage()->getImageInfo();
-
-        	VkDescriptorImageInfo normalTextureInfo;
-        	if (samplers.normalTexture != nullptr)
-				normalTextureInfo = samplers.normalTexture->getImageInfo();
-			else
-				normalTextureInfo = Image::getDefaultImage()->getImageInfo();
-
-        	VkDescriptorImageInfo occlusionTextureInfo;
-        	if (samplers.occlusionTexture != nullptr)
-                occlusionTextureInfo = samplers.occlusionTexture->getImageInfo();
-            else
-                occlusionTextureInfo = Image::getDefaultImage()->getImageInfo();
+            this->parameters = parameters;
+            markDirty();
+        }
 
-            VkDescriptorImageInfo baseColorTextureInfo;
-            if (samplers.baseColorTexture != nullptr)
-                baseColorTextureInfo = samplers.baseColorTexture->getImageInfo();
-            else
-                baseColorTextureInfo = Image::getDefaultImage()->getImageInfo();
+        // One bit per frame in flight, set while that frame's copy of the material record is stale.
+        void markDirty() { dirtyFrames = ALL_FRAMES_DIRTY; }
+        bool isDirty(const int frameIndex) const { return (dirtyFrames & (1u << frameIndex)) != 0; }
+        void clearDirty(const int frameIndex) { dirtyFrames &= ~(1u << frameIndex); }
 
-            VkDescriptorImageInfo metallicRoughnessTextureInfo;
-            if (samplers.metallicRoughnessTexture != nullptr)
-                metallicRoughnessTextureInfo = samplers.metallicRoughnessTexture->getImageInfo();
-			else
-				metallicRoughnessTextureInfo = Image::getDefaultImage()->getImageInfo();
+    private:
+        static constexpr uint32_t ALL_FRAMES_DIRTY = (1u << SwapChain::MAX_FRAMES_IN_FLIGHT) - 1;
 
-            DescriptorWriter(setLayout, frameInfo.frameDescriptorPool)
-                .writeBuffer(0, &bufferInfo)
-        		.writeImage(1, &emissiveTextureInfo)
-        		.writeImage(2, &normalTextureInfo)
-				.writeImage(3, &occlusionTextureInfo)
-        		.writeImage(4, &baseColorTextureInfo)
-                .writeImage(5, &metallicRoughnessTextureInfo)
-                .build(descriptorSet);
-        }
+        Parameters parameters{};
+        uint32_t dirtyFrames = ALL_FRAMES_DIRTY;
     };
 }
@@ -0,0 +1,186 @@
+#include "materialTable.hpp"
+
+#include "../profiling/cpuProfiler.hpp"
+#include "../../log.hpp"
+
+// std
+#include <algorithm>
+
+namespace ve {
+    static constexpr uint32_t MAX_TEXTURES = 4096;
+    static constexpr uint32_t INITIAL_MATERIAL_CAPACITY = 64;
+
+    MaterialTable::MaterialTable(Device &device) : device(device) {
+        const auto &limits = device.properties.limits;
+        maxTextures = std::min({
+            MAX_TEXTURES,
+            limits.maxPerStageDescriptorSamplers,
+            limits.maxPerStageDescriptorSampledImages,
+            limits.maxDescriptorSetSamplers,
+            limits.maxDescriptorSetSampledImages});
+
+        setLayout = DescriptorSetLayout::Builder(device)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, maxTextures,
+                        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT)
+            .build();
+
+        pool = DescriptorPool::Builder(device)
+            .setMaxSets(SwapChain::MAX_FRAMES_IN_FLIGHT)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, SwapChain::MAX_FRAMES_IN_FLIGHT)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxTextures * SwapChain::MAX_FRAMES_IN_FLIGHT)
+            .build();
+
+        for (auto &descriptorSet : descriptorSets) {
+            if (!pool->allocateDescriptor(setLayout->getDescriptorSetLayout(), descriptorSet)) {
+                Log::error("Failed to allocate material table descriptor set");
+                throw std::runtime_error("");
+            }
+        }
+
+        addTexture(Image::getDefaultImage());
+        createMaterialBuffers(INITIAL_MATERIAL_CAPACITY);
+        commit();
+    }
+
+    void MaterialTable::addMaterial(const std::shared_ptr<Material> &material) {
+        if (material->tableIndex != Material::NO_TABLE_INDEX) {
+            return;
+        }
+
+        material->tableIndex = static_cast<uint32_t>(materials.size());
+        material->markDirty();
+        materials.push_back(material);
+
+        for (const auto &texture : {
+                material->samplers.emissiveTexture,
+                material->samplers.normalTexture,
+                material->samplers.occlusionTexture,
+                material->samplers.baseColorTexture,
+                material->samplers.metallicRoughnessTexture}) {
+            if (texture != nullptr) {
+                addTexture(texture);
+            }
+        }
+    }
+
+    uint32_t MaterialTable::addTexture(const std::shared_ptr<Image> &image) {
+        if (const auto it = textureIndices.find(image.get()); it != textureIndices.end()) {
+            return it->second;
+        }
+
+        if (textures.size() >= maxTextures) {
+            Log::error("Material table is full, the device allows " + std::to_string(maxTextures) + " textures");
+            throw std::runtime_error("");
+        }
+
+        const auto index = static_cast<uint32_t>(textures.size());
+        textures.push_back(image);
+        textureIndices.emplace(image.get(), index);
+        return index;
+    }
+
+    uint32_t MaterialTable::getTextureIndex(const std::shared_ptr<Image> &image) const {
+        if (image == nullptr) {
+            return 0;
+        }
+        const auto it = textureIndices.find(image.get());
+        return it != textureIndices.end() ? it->second : 0;
+    }
+
+    void MaterialTable::createMaterialBuffers(const uint32_t capacity) {
+        for (auto &buffer : materialBuffers) {
+            buffer = std::make_unique<Buffer>(
+                device,
+                sizeof(GpuMaterial),
+                capacity,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            buffer->map();
+        }
+        materialCapacity = capacity;
+        buffersChanged = true;
+
+        // The new buffers start out empty in every frame
+        for (const auto &material : materials) {
+            material->markDirty();
+        }
+    }
+
+    void MaterialTable::commit() {
+        VE_PROFILE_SCOPE("MaterialTable::commit");
+        const auto textureCount = static_cast<uint32_t>(textures.size());
+        const auto materialCount = static_cast<uint32_t>(materials.size());
+        if (materialCount == committedMaterialCount && !buffersChanged && committedTextureCount == textureCount) {
+            return;
+        }
+
+        vkDeviceWaitIdle(device.getDevice());
+
+        if (materialCount > materialCapacity) {
+            createMaterialBuffers(std::max(materialCapacity * 2, materialCount));
+        }
+
+        std::vector<VkDescriptorImageInfo> imageInfos;
+        imageInfos.reserve(textureCount - committedTextureCount);
+        for (uint32_t i = committedTextureCount; i < textureCount; i++) {
+            imageInfos.push_back(textures[i]->getImageInfo());
+        }
+
+        for (int i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+            DescriptorWriter writer(*setLayout, *pool);
+
+            auto bufferInfo = materialBuffers[i]->descriptorInfo();
+            if (buffersChanged) {
+                writer.writeBuffer(0, &bufferInfo);
+            }
+            if (!imageInfos.empty()) {
+                writer.writeImages(1, imageInfos.data(), static_cast<uint32_t>(imageInfos.size()), committedTextureCount);
+            }
+            writer.overwrite(descriptorSets[i]);
+        }
+
+        buffersChanged = false;
+        committedMaterialCount = materialCount;
+        committedTextureCount = textureCount;
+    }
+
+    void MaterialTable::update(const int frameIndex) {
+        auto &buffer = *materialBuffers[frameIndex];
+        bool written = false;
+
+        for (const auto &material : materials) {
+            // Added after the last commit, not in the buffer yet
+            if (material->tableIndex >= committedMaterialCount || !material->isDirty(frameIndex)) {
+                continue;
+            }
+
+            auto record = pack(*material);
+            buffer.writeToIndex(&record, static_cast<int>(material->tableIndex));
+            material->clearDirty(frameIndex);
+            written = true;
+        }
+
+        if (written) {
+            buffer.flush();
+        }
+    }
+
+    MaterialTable::GpuMaterial MaterialTable::pack(const Material &material) const {
+        const auto &parameters = material.getParameters();
+
+        GpuMaterial record {};
+        record.baseColorFactor = parameters.baseColorFactor;
+        record.emissiveFactor = parameters.emissiveFactor;
+        record.alphaCutoff = parameters.alphaCutoff;
+        record.roughnessFactor = parameters.roughnessFactor;
+        record.metallicFactor = parameters.metallicFactor;
+        record.doubleSided = parameters.doubleSided ? 1 : 0;
+        record.emissiveTexture = getTextureIndex(material.samplers.emissiveTexture);
+        record.normalTexture = getTextureIndex(material.samplers.normalTexture);
+        record.occlusionTexture = getTextureIndex(material.samplers.occlusionTexture);
+        record.baseColorTexture = getTextureIndex(material.samplers.baseColorTexture);
+        record.metallicRoughnessTexture = getTextureIndex(material.samplers.metallicRoughnessTexture);
+        return record;
+    }
+} // ve
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "material.hpp"
+#include "../memory/buffer.hpp"
+#include "../memory/descriptors.hpp"
+
+// std
+#include <array>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace ve {
+    // Every material of a scene packed into one storage buffer, with all of their textures in a single sampler
+    // array. Draws select their material with an index, so the set is bound once per frame instead of per mesh.
+    class MaterialTable {
+    public:
+        // One record of the material buffer, laid out like the std430 Material struct in PBR.frag.
+        struct GpuMaterial {
+            glm::vec4 baseColorFactor;
+            glm::vec3 emissiveFactor;
+            float alphaCutoff;
+            float roughnessFactor;
+            float metallicFactor;
+            uint32_t doubleSided;
+            uint32_t emissiveTexture;
+            uint32_t normalTexture;
+            uint32_t occlusionTexture;
+            uint32_t baseColorTexture;
+            uint32_t metallicRoughnessTexture;
+        };
+        static_assert(sizeof(GpuMaterial) == 64, "GpuMaterial must match the std430 layout in PBR.frag");
+
+        explicit MaterialTable(Device &device);
+
+        MaterialTable(const MaterialTable &) = delete;
+        MaterialTable &operator=(const MaterialTable &) = delete;
+
+        // Gives the material and its textures a slot in the table, materials already in it are skipped.
+        void addMaterial(const std::shared_ptr<Material> &material);
+        // Grows the material buffers and writes the descriptors of everything added since the last commit. The sets
+        // may be referenced by frames in flight, so this waits for the device and belongs to load time.
+        void commit();
+        // Copies the materials that changed since this frame's buffer was last written.
+        void update(int frameIndex);
+
+        DescriptorSetLayout &getSetLayout() const { return *setLayout; }
+        VkDescriptorSet getDescriptorSet(int frameIndex) const { return descriptorSets[frameIndex]; }
+        uint32_t getMaterialCount() const { return static_cast<uint32_t>(materials.size()); }
+        uint32_t getTextureCount() const { return static_cast<uint32_t>(textures.size()); }
+
+    private:
+        uint32_t addTexture(const std::shared_ptr<Image> &image);
+        uint32_t getTextureIndex(const std::shared_ptr<Image> &image) const;
+        GpuMaterial pack(const Material &material) const;
+        void createMaterialBuffers(uint32_t capacity);
+
+        Device &device;
+        uint32_t maxTextures;
+
+        std::unique_ptr<DescriptorSetLayout> setLayout;
+        std::unique_ptr<DescriptorPool> pool;
+        std::array<VkDescriptorSet, SwapChain::MAX_FRAMES_IN_FLIGHT> descriptorSets{};
+        std::array<std::unique_ptr<Buffer>, SwapChain::MAX_FRAMES_IN_FLIGHT> materialBuffers{};
+        uint32_t materialCapacity = 0;
+        bool buffersChanged = false;
+
+        std::vector<std::shared_ptr<Material>> materials;
+        // Slot 0 always holds the default image, missing textures point there
+        std::vector<std::shared_ptr<Image>> textures;
+        std::unordered_map<const Image *, uint32_t> textureIndices;
+        uint32_t committedMaterialCount = 0;
+        uint32_t committedTextureCount = 0;
+    };
+} // ve
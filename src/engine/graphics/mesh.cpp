@@ -4,131 +4,257 @@
 
 #include "mesh.hpp"
 
+#include "../settings.hpp"
+
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <utility>
 
 #include <glm/ext/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 
 namespace ve {
 
-    Mesh::Mesh(Device &device, const Mesh::Builder& builder) : device(device) {
-        createVertexBuffers(builder.vertices);
-        createIndexBuffers(builder.indices);
-    }
+    // Vertices encoded per copy into the write combined staging memory
+    static constexpr uint32_t ENCODE_CHUNK = 256;
 
-    Mesh::~Mesh() = default;
+    Device* Mesh::arenaDevice = nullptr;
+    std::unordered_map<uint32_t, std::unique_ptr<GeometryArena>> Mesh::geometryArenas {};
+    std::unique_ptr<Buffer> Mesh::vertexDefaults = nullptr;
 
-    void Mesh::bind(VkCommandBuffer commandBuffer) const
-    {
-	    const VkBuffer buffers[] = {vertexBuffer->getBuffer()};
-	    constexpr VkDeviceSize offsets[] = {0};
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
-        if (hasIndexBuffer) {
-            vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT16);
-        }
-    }
+    Mesh::Mesh(Device &device, const Mesh::Builder& builder) {
+        assert(builder.vertices.size() >= 3 && "Vertex count must be at least 3");
+        const auto vertexCount = static_cast<uint32_t>(builder.vertices.size());
+        const auto indexCount = static_cast<uint32_t>(builder.indices.size());
 
-    void Mesh::draw(VkCommandBuffer commandBuffer) const {
-        if (hasIndexBuffer) {
-            vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+        if (builder.bounds.has_value()) {
+            bounds = *builder.bounds;
         } else {
-            vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+            bounds.min = bounds.max = builder.vertices[0].position;
+            for (const auto& vertex : builder.vertices) {
+                bounds.min = glm::min(bounds.min, vertex.position);
+                bounds.max = glm::max(bounds.max, vertex.position);
+            }
         }
-    }
-
-    void Mesh::createVertexBuffers(const std::vector<Vertex> &vertices) {
-        vertexCount = static_cast<uint32_t>(vertices.size());
-        assert(vertexCount >= 3 && "Vertex count must be at least 3");
-        const VkDeviceSize bufferSize = sizeof(Vertex) * vertexCount;
-        uint32_t vertexSize = sizeof(Vertex);
 
-        Buffer stagingBuffer(
-                device,
-                vertexSize,
-                vertexCount,
-                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        format = chooseFormat(builder.attributes, builder.vertices.data(), vertexCount);
+        if (builder.floatPositions) {
+            format = VertexFormat(format.getFlags() & ~VertexFormat::QuantizedPosition);
+        }
+        auto& geometryArena = getGeometryArena(format);
+        const VkIndexType indexType = GeometryArena::getIndexType(vertexCount);
+        range = geometryArena.allocate(vertexCount, indexCount, indexType);
+        writeVertices(format, range, bounds, builder.vertices.data());
 
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void *)vertices.data());
+        if (indexCount == 0) {
+            return;
+        }
+        lods.push_back({range.firstIndex, indexCount, 0.0f});
+        if (indexType == VK_INDEX_TYPE_UINT16) {
+            const std::vector<uint16_t> narrowIndices(builder.indices.begin(), builder.indices.end());
+            std::memcpy(geometryArena.writeIndices(range), narrowIndices.data(), indexCount * sizeof(uint16_t));
+        } else {
+            std::memcpy(geometryArena.writeIndices(range), builder.indices.data(), indexCount * sizeof(uint32_t));
+        }
+    }
 
-        vertexBuffer = std::make_unique<Buffer>(
-                device,
-                vertexSize,
-                vertexCount,
-                VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    Mesh::Mesh(const VertexFormat& format, const GeometryArena::Range& range, const Bounds& bounds,
+               std::vector<Lod> lods, std::vector<Cluster> clusters)
+        : format(format), range(range), bounds(bounds), lods(std::move(lods)), clusters(std::move(clusters)) {
+        assert(range.vertexCount >= 3 && "Vertex count must be at least 3");
+        assert(this->lods.size() <= MAX_LODS && "Too many levels of detail");
+        if (this->lods.empty() && range.isIndexed()) {
+            this->lods.push_back({range.firstIndex, range.indexCount, 0.0f});
+        }
+    }
 
-        device.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
+    Mesh::~Mesh() {
+        if (const auto it = geometryArenas.find(format.getFlags()); it != geometryArenas.end()) {
+            it->second->free(range);
+        }
     }
 
-    void Mesh::createIndexBuffers(const std::vector<uint16_t> &indices) {
-        indexCount = static_cast<uint32_t>(indices.size());
-        hasIndexBuffer = indexCount > 0;
-        if (!hasIndexBuffer) return;
-        VkDeviceSize bufferSize = sizeof(uint16_t) * indexCount;
-        uint32_t indexSize = sizeof(uint16_t);
+    glm::vec3 Mesh::getPositionScale() const {
+        return format.has(VertexFormat::QuantizedPosition) ? bounds.max - bounds.min : glm::vec3(1.0f);
+    }
 
-        Buffer stagingBuffer(
-                device,
-                indexSize,
-                indexCount,
-                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    glm::vec3 Mesh::getPositionOffset() const {
+        return format.has(VertexFormat::QuantizedPosition) ? bounds.min : glm::vec3(0.0f);
+    }
 
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void*)indices.data());
+    VertexFormat Mesh::chooseFormat(const uint32_t attributes, const Vertex* vertices, const size_t vertexCount) {
+        uint32_t flags = attributes & VertexFormat::ATTRIBUTE_FLAGS;
+        if (Settings::getInstance()->QUANTIZED_POSITIONS) {
+            flags |= VertexFormat::QuantizedPosition;
+        }
 
-        indexBuffer = std::make_unique<Buffer>(
-                device,
-                indexSize,
-                indexCount,
-                VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        const bool texCoord0 = (flags & VertexFormat::TexCoord0) != 0;
+        const bool texCoord1 = (flags & VertexFormat::TexCoord1) != 0;
+        const auto outside = [](const glm::vec2& texCoord) {
+            return glm::any(glm::greaterThan(glm::abs(texCoord), glm::vec2(1.0f)));
+        };
+        for (size_t i = 0; i < vertexCount && (texCoord0 || texCoord1); i++) {
+            if ((texCoord0 && outside(vertices[i].tex_coord_0)) || (texCoord1 && outside(vertices[i].tex_coord_1))) {
+                flags |= VertexFormat::FloatTexCoords;
+                break;
+            }
+        }
+        return VertexFormat(flags);
+    }
 
-        device.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
+    glm::vec2 Mesh::encodeOctahedral(glm::vec3 normal) {
+        const float length = glm::abs(normal.x) + glm::abs(normal.y) + glm::abs(normal.z);
+        if (length == 0.0f) {
+            return {0.0f, 0.0f};
+        }
+        normal /= length;
+        glm::vec2 encoded(normal.x, normal.y);
+        if (normal.z < 0.0f) {
+            // Folds the lower hemisphere over the diagonals
+            const glm::vec2 sign(encoded.x >= 0.0f ? 1.0f : -1.0f, encoded.y >= 0.0f ? 1.0f : -1.0f);
+            encoded = (1.0f - glm::abs(glm::vec2(encoded.y, encoded.x))) * sign;
+        }
+        return encoded;
     }
 
-    std::vector<VkVertexInputBindingDescription> Mesh::Vertex::getBindingDescriptions() {
-        std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
-        bindingDescriptions[0].binding = 0;
-        bindingDescriptions[0].stride = sizeof(Vertex);
-        bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-        return bindingDescriptions;
+    glm::vec2 Mesh::encodeTangent(const glm::vec4& tangent) {
+        glm::vec2 encoded = encodeOctahedral(glm::vec3(tangent));
+        // Leaves a step of snorm16 between the two halves
+        constexpr float minimum = 1.0f / 32767.0f;
+        if (tangent.w >= 0.0f) {
+            encoded.y = glm::max(0.5f + 0.5f * encoded.y, minimum);
+        } else {
+            encoded.y = glm::min(-0.5f + 0.5f * encoded.y, -minimum);
+        }
+        return encoded;
     }
 
-    std::vector<VkVertexInputAttributeDescription> Mesh::Vertex::getAttributeDescriptions() {
-        std::vector<VkVertexInputAttributeDescription> attributeDescriptions(6);
-        attributeDescriptions[0].binding = 0;
-        attributeDescriptions[0].location = 0;
-        attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[0].offset = offsetof(Vertex, position);
+    void Mesh::writeVertices(const VertexFormat& format, const GeometryArena::Range& range, const Bounds& bounds,
+                             const Vertex* vertices) {
+        auto& geometryArena = getGeometryArena(format);
+        const glm::vec3 scale = bounds.max - bounds.min;
+        const glm::vec3 inverseScale = glm::vec3(
+                scale.x > 0.0f ? 1.0f / scale.x : 0.0f,
+                scale.y > 0.0f ? 1.0f / scale.y : 0.0f,
+                scale.z > 0.0f ? 1.0f / scale.z : 0.0f);
+
+        // Encoded in cached memory and copied out in order, the staging memory is write combined
+        std::vector<uint8_t> encoded;
+        for (uint32_t stream = 0; stream < geometryArena.getStreamCount(); stream++) {
+            const auto stride = static_cast<size_t>(geometryArena.getVertexStride(stream));
+            auto* output = static_cast<uint8_t*>(geometryArena.writeVertices(range, stream));
+            encoded.resize(ENCODE_CHUNK * stride);
+
+            for (uint32_t first = 0; first < range.vertexCount; first += ENCODE_CHUNK) {
+                const uint32_t count = std::min(ENCODE_CHUNK, range.vertexCount - first);
+                for (uint32_t i = 0; i < count; i++) {
+                    const Vertex& vertex = vertices[first + i];
+                    uint8_t* destination = encoded.data() + i * stride;
+
+                    if (stream == VertexFormat::POSITION_BINDING) {
+                        if (format.has(VertexFormat::QuantizedPosition)) {
+                            const glm::vec3 normalized = (vertex.position - bounds.min) * inverseScale;
+                            const uint64_t packed = glm::packUnorm4x16(glm::vec4(normalized, 0.0f));
+                            std::memcpy(destination, &packed, sizeof(packed));
+                        } else {
+                            std::memcpy(destination, &vertex.position, sizeof(vertex.position));
+                        }
+                        continue;
+                    }
+
+                    for (const auto& attribute : VertexFormat::ATTRIBUTES) {
+                        if (!format.has(attribute.flag)) {
+                            continue;
+                        }
+                        uint32_t packed = 0;
+                        const glm::vec2* texCoord = nullptr;
+                        switch (attribute.flag) {
+                            case VertexFormat::Normal:
+                                packed = glm::packSnorm2x16(encodeOctahedral(vertex.normal));
+                                break;
+                            case VertexFormat::Tangent:
+                                packed = glm::packSnorm2x16(encodeTangent(vertex.tangent));
+                                break;
+                            case VertexFormat::TexCoord0:
+                                texCoord = &vertex.tex_coord_0;
+                                break;
+                            case VertexFormat::TexCoord1:
+                                texCoord = &vertex.tex_coord_1;
+                                break;
+                            case VertexFormat::Color0:
+                                packed = glm::packUnorm4x8(vertex.color_0);
+                                break;
+                            default:
+                                break;
+                        }
+                        if (texCoord != nullptr && format.has(VertexFormat::FloatTexCoords)) {
+                            std::memcpy(destination, texCoord, sizeof(*texCoord));
+                        } else {
+                            if (texCoord != nullptr) {
+                                packed = glm::packHalf2x16(*texCoord);
+                            }
+                            std::memcpy(destination, &packed, sizeof(packed));
+                        }
+                        destination += format.getAttributeSize(attribute);
+                    }
+                }
+                std::memcpy(output + first * stride, encoded.data(), count * stride);
+            }
+        }
+    }
 
-        attributeDescriptions[1].binding = 0;
-        attributeDescriptions[1].location = 1;
-        attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[1].offset = offsetof(Vertex, normal);
+    void Mesh::createGeometryArenas(Device& device) {
+        arenaDevice = &device;
 
-        attributeDescriptions[2].binding = 0;
-        attributeDescriptions[2].location = 2;
-        attributeDescriptions[2].format = VK_FORMAT_R32G32B32A32_SFLOAT;
-        attributeDescriptions[2].offset = offsetof(Vertex, tangent);
+        const uint32_t defaults[VertexFormat::DEFAULTS_SIZE / sizeof(uint32_t)] = {
+                glm::packSnorm2x16(encodeOctahedral({0.0f, 0.0f, 1.0f})),
+                glm::packSnorm2x16(encodeTangent({1.0f, 0.0f, 0.0f, 1.0f})),
+                glm::packHalf2x16({0.0f, 0.0f}),
+                glm::packHalf2x16({0.0f, 0.0f}),
+                glm::packUnorm4x8(glm::vec4(1.0f)),
+        };
+        vertexDefaults = std::make_unique<Buffer>(
+                device,
+                VertexFormat::DEFAULTS_SIZE,
+                1,
+                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        device.getUploadContext().uploadBuffer(vertexDefaults->getBuffer(), 0, defaults, sizeof(defaults));
+    }
 
-        attributeDescriptions[3].binding = 0;
-        attributeDescriptions[3].location = 3;
-        attributeDescriptions[3].format = VK_FORMAT_R32G32_SFLOAT;
-        attributeDescriptions[3].offset = offsetof(Vertex, tex_coord_0);
+    GeometryArena& Mesh::getGeometryArena(const VertexFormat& format) {
+        assert(arenaDevice != nullptr && "Mesh::createGeometryArenas has not been called");
+        // Only looked up while recording on the job system threads, the arenas are created while loading
+        if (const auto it = geometryArenas.find(format.getFlags()); it != geometryArenas.end()) {
+            return *it->second;
+        }
+        auto& geometryArena = geometryArenas[format.getFlags()];
+        geometryArena = std::make_unique<GeometryArena>(*arenaDevice, format.getStreamStrides());
+        return *geometryArena;
+    }
 
-        attributeDescriptions[4].binding = 0;
-        attributeDescriptions[4].location = 4;
-        attributeDescriptions[4].format = VK_FORMAT_R32G32_SFLOAT;
-        attributeDescriptions[4].offset = offsetof(Vertex, tex_coord_1);
+    void Mesh::bindGeometry(VkCommandBuffer commandBuffer, const VertexFormat& format, const VkIndexType indexType) {
+        getGeometryArena(format).bind(commandBuffer, indexType);
+        if (format.needsDefaults()) {
+            const VkBuffer buffer = vertexDefaults->getBuffer();
+            constexpr VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(commandBuffer, VertexFormat::DEFAULT_BINDING, 1, &buffer, &offset);
+        }
+    }
 
-        attributeDescriptions[5].binding = 0;
-        attributeDescriptions[5].location = 5;
-        attributeDescriptions[5].format = VK_FORMAT_R32G32B32A32_SFLOAT;
-        attributeDescriptions[5].offset = offsetof(Vertex, color_0);
+    void Mesh::bind(VkCommandBuffer commandBuffer) const
+    {
+        bindGeometry(commandBuffer, format, range.indexType);
+    }
 
-        return attributeDescriptions;
+    void Mesh::draw(VkCommandBuffer commandBuffer, uint32_t firstInstance) const {
+        if (range.isIndexed()) {
+            const Lod& lod = lods[0];
+            vkCmdDrawIndexed(commandBuffer, lod.indexCount, 1, lod.firstIndex, range.vertexOffset, firstInstance);
+        } else {
+            vkCmdDraw(commandBuffer, range.vertexCount, 1, static_cast<uint32_t>(range.vertexOffset), firstInstance);
+        }
     }
 
     std::shared_ptr<Mesh> Mesh::Builder::build(Device &device) {
@@ -177,7 +303,7 @@ namespace ve {
             }
         }
 
-        const std::vector<uint16_t> indices = {
+        const std::vector<uint32_t> indices = {
                 0, 1, 2, 3,
                 1, 2, 3, 0,
         };
@@ -185,12 +311,14 @@ namespace ve {
         Builder builder {};
         builder.vertices = vertices;
         builder.indices = indices;
+        // The grid passes them straight to its tessellation
+        builder.floatPositions = true;
         return std::make_unique<Mesh>(device, builder);
     }
 
     std::shared_ptr<Mesh> Mesh::sphere(Device& device, int size, int segmentCount) {
         std::vector<Vertex> vertices;
-        std::vector<uint16_t> indices;
+        std::vector<uint32_t> indices;
 
         const float horizontalIncrement = glm::two_pi<float>() / static_cast<float>(segmentCount);
         const float verticalIncrement = glm::pi<float>() / static_cast<float>(segmentCount);
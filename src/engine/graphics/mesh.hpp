@@ -6,6 +6,8 @@
 
 #include "../../engine/device.hpp"
 #include "../../engine/memory/buffer.hpp"
+#include "../../engine/memory/geometryArena.hpp"
+#include "vertexFormat.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -13,12 +15,15 @@
 
 #include <vector>
 #include <memory>
+#include <optional>
+#include <unordered_map>
 
 #include "material.hpp"
 
 namespace ve {
     class Mesh {
     public:
+        // Full precision vertex the meshes are built from, the GPU gets it encoded in the mesh's VertexFormat
         struct Vertex {
             glm::vec3 position{};
             glm::vec3 normal{};
@@ -26,39 +31,116 @@ namespace ve {
             glm::vec2 tex_coord_0{};
             glm::vec2 tex_coord_1{};
             glm::vec4 color_0 {};
+        };
+
+        // Object space box around the vertices, used for culling
+        struct Bounds {
+            glm::vec3 min{};
+            glm::vec3 max{};
+        };
+
+        // One level of detail, a triangle list over the same vertices as the others
+        struct Lod {
+            // In indices of the range's index type, from the start of the index buffer
+            uint32_t firstIndex = 0;
+            uint32_t indexCount = 0;
+            // Object space distance the level strays from the full mesh, 0 for the full mesh itself
+            float error = 0.0f;
+        };
 
-            static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
-            static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+        // The full mesh and up to four simplified levels
+        static constexpr uint32_t MAX_LODS = 5;
+
+        // A meshlet of the full mesh, a run of its indices culled on its own
+        struct Cluster {
+            // Object space sphere around the cluster's vertices
+            glm::vec3 center{};
+            float radius = 0.0f;
+            // Every triangle faces away from a camera for which
+            // dot(center - camera, coneAxis) >= coneCutoff * length(center - camera) + radius. 1 when there is no cone.
+            glm::vec3 coneAxis{};
+            float coneCutoff = 1.0f;
+            // In indices of the range's index type, from the start of the index buffer like Lod::firstIndex
+            uint32_t firstIndex = 0;
+            uint32_t indexCount = 0;
         };
 
         struct Builder {
             std::vector<Vertex> vertices{};
-            std::vector<uint16_t> indices{};
+            // Stored as 16 bit indices when there are few enough vertices
+            std::vector<uint32_t> indices{};
+            // VertexFormat flags of the attributes the vertices have, the others are left out of the GPU copy
+            uint32_t attributes = VertexFormat::Normal | VertexFormat::TexCoord0;
+            // Known up front when the file stores it, computed from the vertices otherwise
+            std::optional<Bounds> bounds{};
+            // For meshes drawn without their draw data, which dequantizes positions
+            bool floatPositions = false;
 
             std::shared_ptr<Mesh> build(Device& device);
         };
 
         Mesh(Device& device, const Builder& builder);
+        // Takes over a range allocated from the format's geometry arena and filled by the caller, see writeVertices.
+        // The levels of detail split the range's indices, finest first, the whole range is the only level without them.
+        // The clusters split the first level, a mesh without them is culled as a whole.
+        Mesh(const VertexFormat& format, const GeometryArena::Range& range, const Bounds& bounds,
+             std::vector<Lod> lods = {}, std::vector<Cluster> clusters = {});
         Mesh(const Mesh&) = delete;
         Mesh& operator=(const Mesh&) = delete;
         ~Mesh();
 
+        // Binds the geometry arena of this mesh's format with its index type, a frame drawing many meshes only needs
+        // to do this once per format and index type
         void bind(VkCommandBuffer commandBuffer) const;
-        void draw(VkCommandBuffer commandBuffer) const;
+        // firstInstance shows up as gl_InstanceIndex, shaders use it to find per-object data. Draws the full mesh.
+        void draw(VkCommandBuffer commandBuffer, uint32_t firstInstance = 0) const;
+
+        const VertexFormat& getFormat() const { return format; }
+        const GeometryArena::Range& getRange() const { return range; }
+        const Bounds& getBounds() const { return bounds; }
+        // Finest first, empty for a mesh drawn without indices
+        const std::vector<Lod>& getLods() const { return lods; }
+        const std::vector<Cluster>& getClusters() const { return clusters; }
+        // Takes the stored positions to object space, position * scale + offset
+        glm::vec3 getPositionScale() const;
+        glm::vec3 getPositionOffset() const;
+
+        // The most compact format for vertices with the given attributes. Texture coordinates stay 32 bit floats when
+        // any is outside [-1, 1], where half floats lose texel precision, positions are quantized with
+        // Settings::QUANTIZED_POSITIONS.
+        static VertexFormat chooseFormat(uint32_t attributes, const Vertex* vertices, size_t vertexCount);
+        // Encodes the range's vertices into the staging memory of each of its streams. Quantized positions are
+        // relative to bounds, which has to be the bounds the mesh is created with.
+        static void writeVertices(const VertexFormat& format, const GeometryArena::Range& range, const Bounds& bounds,
+                                  const Vertex* vertices);
+        // Octahedral normal in [-1, 1]^2, the same mapping for a zero vector as for +Z
+        static glm::vec2 encodeOctahedral(glm::vec3 normal);
+        // Octahedral tangent with the bitangent sign folded into y: y is halved into (0, 1] for a positive sign and
+        // into [-1, 0) for a negative one, keeping clear of 0 so the sign survives snorm16. Decoded as
+        // sign = y >= 0 ? 1 : -1, y = 2 * y - sign.
+        static glm::vec2 encodeTangent(const glm::vec4& tangent);
+
+        // Meshes of a format share one arena, created on first use. The device has to be set before the first mesh.
+        static void createGeometryArenas(Device& device);
+        static GeometryArena& getGeometryArena(const VertexFormat& format);
+        static const std::unordered_map<uint32_t, std::unique_ptr<GeometryArena>>& getGeometryArenas() {
+            return geometryArenas;
+        }
+        // Binds the format's arena, the defaults of the attributes it lacks and the index buffer as indexType
+        static void bindGeometry(VkCommandBuffer commandBuffer, const VertexFormat& format, VkIndexType indexType);
 
     private:
-        void createVertexBuffers(const std::vector<Vertex>& vertices);
-        void createIndexBuffers(const std::vector<uint16_t>& indices);
-
-        Device& device;
-
-        std::unique_ptr<Buffer> vertexBuffer;
-        uint32_t vertexCount;
-
-        bool hasIndexBuffer = false;
-
-        std::unique_ptr<Buffer> indexBuffer;
-        uint32_t indexCount;
+        static Device* arenaDevice;
+        // By format flags
+        static std::unordered_map<uint32_t, std::unique_ptr<GeometryArena>> geometryArenas;
+        // VertexFormat::DEFAULTS_SIZE bytes read at stride 0 in place of missing attributes
+        static std::unique_ptr<Buffer> vertexDefaults;
+
+        VertexFormat format {};
+        GeometryArena::Range range {};
+        Bounds bounds {};
+        std::vector<Lod> lods {};
+        std::vector<Cluster> clusters {};
         std::shared_ptr<Material> material = nullptr;
 
     public:
@@ -1,42 +1,43 @@
 #pragma once
+#include <cstdint>
 #include <memory>
 
 #include "material.hpp"
 #include "mesh.hpp"
-#include "../renderer.hpp"
-#include "../memory/descriptors.hpp"
 
 namespace ve
 {
 	class RenderObject
 	{
 	public:
-		explicit RenderObject(Device& device) {
-			objectUniformBuffer = std::make_unique<Buffer>(
-				device,
-				sizeof(glm::mat4),
-				1,
-				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-			objectUniformBuffer->map();
-		}
-
-		glm::mat4 localModelMatrix = glm::mat4(1);
 		std::vector<std::shared_ptr<ve::Mesh>> meshes {};
 
-		std::unique_ptr<ve::Buffer> objectUniformBuffer;
-		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		static constexpr uint32_t NO_TABLE_INDEX = UINT32_MAX;
+		// Slot in the TransformTable, referenced by the draw data of every mesh of this object.
+		uint32_t tableIndex = NO_TABLE_INDEX;
 
-		void updateBuffers(DescriptorSetLayout& programLayout, const FrameInfo& frameInfo)
+		const glm::mat4& getLocalModelMatrix() const { return localModelMatrix; }
+		void setLocalModelMatrix(const glm::mat4& localModelMatrix)
 		{
-			objectUniformBuffer->writeToBuffer(&localModelMatrix, sizeof(glm::mat4));
-			objectUniformBuffer->flush();
+			this->localModelMatrix = localModelMatrix;
+			markDirty();
+			boundsDirty = true;
+		}
 
-			auto bufferInfo = objectUniformBuffer->descriptorInfoForIndex(0);
+		// One bit per frame in flight, set while that frame's copy of the transform is stale.
+		void markDirty() { dirtyFrames = ALL_FRAMES_DIRTY; }
+		bool isDirty(const int frameIndex) const { return (dirtyFrames & (1u << frameIndex)) != 0; }
+		void clearDirty(const int frameIndex) { dirtyFrames &= ~(1u << frameIndex); }
 
-			DescriptorWriter(programLayout, frameInfo.frameDescriptorPool)
-				.writeBuffer(0, &bufferInfo)
-				.build(descriptorSet);
-		}
+		// Set while the world space bounds of the meshes lag behind the transform.
+		bool areBoundsDirty() const { return boundsDirty; }
+		void clearBoundsDirty() { boundsDirty = false; }
+
+	private:
+		static constexpr uint32_t ALL_FRAMES_DIRTY = (1u << SwapChain::MAX_FRAMES_IN_FLIGHT) - 1;
+
+		glm::mat4 localModelMatrix = glm::mat4(1);
+		uint32_t dirtyFrames = ALL_FRAMES_DIRTY;
+		bool boundsDirty = true;
 	};
 }
@@ -10,12 +10,12 @@
 
 namespace ve {
     Grid::Grid(Device &device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout): device{device} {
-        createPipelineLayout(globalSetLayout);
-        createPipeline(renderPass);
-
         gridModels.emplace_back(Mesh::square(device, 1, {0, -1, 0}));
         gridModels.emplace_back(Mesh::square(device, 1, {0, 0, 1}));
 
+        createPipelineLayout(globalSetLayout);
+        createPipeline(renderPass);
+
         gridBuffer = std::make_unique<Buffer>(
                 device,
                 sizeof(int) * 2,
@@ -30,6 +30,8 @@ namespace ve {
     }
 
     void Grid::renderGrid(const FrameInfo& frameInfo) {
+        GpuProfiler::Scope scope(frameInfo.gpuProfiler, frameInfo.graphicsCommandBuffer, "Grid", true);
+
         pipeline->bind(frameInfo.graphicsCommandBuffer);
 
         gridBuffer->writeToBuffer(&size, sizeof(int));
@@ -106,7 +108,7 @@ namespace ve {
         shaderFiles.fragFile = "shaders/compiled/grid.frag.spv";
 
         GraphicsPipelineConfigInfo pipelineConfig {};
-        GraphicsPipeline::defaultPipelineConfigInfo(pipelineConfig);
+        GraphicsPipeline::defaultPipelineConfigInfo(pipelineConfig, device.getSampleCount());
         pipelineConfig.renderPass = renderPass;
         pipelineConfig.pipelineLayout = pipelineLayout;
         pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_NONE;
@@ -115,6 +117,10 @@ namespace ve {
         pipelineConfig.inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_PATCH_LIST;
         pipelineConfig.tessellationInfo.patchControlPoints = 4;
         pipelineConfig.depthStencilInfo.depthTestEnable = VK_TRUE;
+        // Only the squares' positions, from their position stream
+        const auto &format = gridModels.front()->getFormat();
+        pipelineConfig.bindingDescriptions = format.getPositionBindingDescriptions();
+        pipelineConfig.attributeDescriptions = format.getPositionAttributeDescriptions();
 
         pipeline = std::make_unique<GraphicsPipeline>(device,shaderFiles,pipelineConfig);
     }
@@ -6,11 +6,21 @@
 
 #include "../../renderer.hpp"
 #include "../../../log.hpp"
+#include "../../settings.hpp"
+#include "../../../utils.hpp"
+#include "../../jobs/jobSystem.hpp"
 
-SceneRenderProgram::SceneRenderProgram(ve::Device& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout) : device(device)
+SceneRenderProgram::SceneRenderProgram(ve::Device& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout) : device(device), renderPass(renderPass)
 {
     createPipelineLayout(globalSetLayout);
-    createPipeline(renderPass);
+    bindFormat = [this](VkCommandBuffer commandBuffer, const ve::VertexFormat& format) {
+        pipelines.at(format.getFlags())->bind(commandBuffer);
+    };
+
+    if (device.supportsIndirectDrawCount()) {
+        drawCulling = std::make_unique<DrawCulling>(device);
+        depthPyramid = std::make_unique<DepthPyramid>(device);
+    }
 }
 
 SceneRenderProgram::~SceneRenderProgram()
@@ -20,23 +30,17 @@ SceneRenderProgram::~SceneRenderProgram()
 
 void SceneRenderProgram::createPipelineLayout(const VkDescriptorSetLayout globalSetLayout)
 {
-    objectSetLayout = ve::DescriptorSetLayout::Builder(device)
-        .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
-        .build();
+    transformTable = std::make_unique<ve::TransformTable>(device);
 
-    materialSetLayout = ve::DescriptorSetLayout::Builder(device)
-        .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
-        .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-        .addBinding(2, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT)
-        .addBinding(3, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT)
-        .addBinding(4, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT)
-        .addBinding(5, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT)
-		.build();
+    materialTable = std::make_unique<ve::MaterialTable>(device);
+
+    drawList = std::make_unique<ve::DrawList>(device);
 
 	const std::vector layouts = {
     	globalSetLayout,
-        objectSetLayout->getDescriptorSetLayout(),
-        materialSetLayout->getDescriptorSetLayout(),
+        transformTable->getSetLayout().getDescriptorSetLayout(),
+        materialTable->getSetLayout().getDescriptorSetLayout(),
+        drawList->getSetLayout().getDescriptorSetLayout(),
     };
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
@@ -50,7 +54,7 @@ void SceneRenderProgram::createPipelineLayout(const VkDescriptorSetLayout global
     }
 }
 
-void SceneRenderProgram::createPipeline(VkRenderPass renderPass)
+void SceneRenderProgram::createPipeline(const ve::VertexFormat& format)
 {
     if (pipelineLayout == nullptr) {
         Log::error("Cannot create pipeline before pipeline layout");
@@ -62,20 +66,174 @@ void SceneRenderProgram::createPipeline(VkRenderPass renderPass)
     shaderFiles.fragFile = "shaders/compiled/PBR.frag.spv";
 
     ve::GraphicsPipelineConfigInfo pipelineConfig {};
-    ve::GraphicsPipeline::defaultPipelineConfigInfo(pipelineConfig);
+    ve::GraphicsPipeline::defaultPipelineConfigInfo(pipelineConfig, device.getSampleCount());
     pipelineConfig.renderPass = renderPass;
     pipelineConfig.pipelineLayout = pipelineLayout;
-    // pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_BACK_BIT;
+    pipelineConfig.bindingDescriptions = format.getBindingDescriptions();
+    pipelineConfig.attributeDescriptions = format.getAttributeDescriptions();
+    pipelineConfig.rasterizationInfo.cullMode = CULL_MODE;
+
+    pipelines[format.getFlags()] = std::make_unique<ve::GraphicsPipeline>(device, shaderFiles, pipelineConfig);
+}
 
-    pipeline = std::make_unique<ve::GraphicsPipeline>(device, shaderFiles, pipelineConfig);
+void SceneRenderProgram::updateTables(const int frameIndex) const
+{
+    transformTable->update(frameIndex);
+    materialTable->update(frameIndex);
+    drawList->update(frameIndex);
+}
+
+bool SceneRenderProgram::isCulling() const
+{
+    const auto settings = ve::Settings::getInstance();
+    // The culled draws go out in a single call per group, which can draw as many commands as the group has cull
+    // items, one per cluster of its meshes
+    return drawCulling != nullptr && settings->INDIRECT_DRAW && settings->GPU_CULLING &&
+           drawList->getMaxIndexedGroupItemCount() <= device.properties.limits.maxDrawIndirectCount &&
+           drawList->getIndexedGroupCount() <= DrawCulling::MAX_DRAW_GROUPS;
+}
+
+bool SceneRenderProgram::isCpuCulling() const
+{
+    return !isCulling() && ve::Settings::getInstance()->CPU_CULLING;
+}
+
+void SceneRenderProgram::cullScene(const ve::FrameInfo& frameInfo, const glm::mat4& viewProjection,
+                                   const glm::vec3& cameraPosition, const float pixelsPerUnit)
+{
+    VE_PROFILE_SCOPE("SceneRenderProgram::cullScene");
+    updateBounds();
+
+    const auto settings = ve::Settings::getInstance();
+    std::optional<ve::DrawList::LodView> lodView;
+    if (settings->LOD_SELECTION) {
+        lodView = ve::DrawList::LodView{
+            cameraPosition, pixelsPerUnit, settings->LOD_PIXEL_ERROR, settings->LOD_MIN_PIXEL_SIZE};
+    }
+
+    culledFrames[frameInfo.frameIndex] = isCulling();
+    if (!culledFrames[frameInfo.frameIndex]) {
+        if (!settings->CPU_CULLING) {
+            drawList->setAllVisible(frameInfo.frameIndex);
+            return;
+        }
+
+        const bool hierarchy = settings->BVH_CULLING;
+        ve::Timer timer;
+        visibleDraws.clear();
+        if (hierarchy) {
+            bvh.queryFrustum(ve::FrustumCuller::getFrustumPlanes(viewProjection), visibleDraws);
+        } else {
+            frustumCuller.cull(viewProjection, visibleDraws);
+        }
+        visibleLods.clear();
+        cpuCullingStats.sizeCulled = 0;
+        if (lodView.has_value()) {
+            selectLods(*lodView);
+        }
+        cpuCullingStats.milliseconds = timer.ElapsedMillis();
+        cpuCullingStats.path = ve::FrustumCuller::getBestPath();
+        cpuCullingStats.hierarchy = hierarchy;
+        cpuCullingStats.drawCount = frustumCuller.size();
+        cpuCullingStats.visible = static_cast<uint32_t>(visibleDraws.size());
+
+        drawList->setVisible(frameInfo.frameIndex, visibleDraws, visibleLods);
+        cpuCullingStats.triangles = drawList->getIndexedTriangleCount(frameInfo.frameIndex);
+        return;
+    }
+
+    drawList->setAllVisible(frameInfo.frameIndex);
+    updateTables(frameInfo.frameIndex);
+    drawCulling->cull(frameInfo, *drawList, *transformTable, *depthPyramid, viewProjection, cameraPosition,
+                      settings->OCCLUSION_CULLING, settings->CLUSTER_CULLING,
+                      (CULL_MODE & VK_CULL_MODE_BACK_BIT) != 0, lodView);
+}
+
+void SceneRenderProgram::selectLods(const ve::DrawList::LodView& lodView)
+{
+    size_t kept = 0;
+    for (const uint32_t draw : visibleDraws)
+    {
+        // The sphere around the world space box, errors scale with the largest axis of the transform
+        const auto& box = drawBoxes[draw];
+        const glm::mat3 linear(renderTargets[drawSources[draw].object]->getLocalModelMatrix());
+        const float scale = glm::sqrt(glm::max(glm::max(
+            glm::dot(linear[0], linear[0]), glm::dot(linear[1], linear[1])), glm::dot(linear[2], linear[2])));
+        const uint32_t lod = drawList->selectLod(
+            draw, (box.min + box.max) * 0.5f, glm::length(box.max - box.min) * 0.5f, scale, lodView);
+        if (lod == ve::DrawList::CULLED_LOD)
+        {
+            continue;
+        }
+        visibleDraws[kept++] = draw;
+        visibleLods.push_back(lod);
+    }
+    cpuCullingStats.sizeCulled = static_cast<uint32_t>(visibleDraws.size() - kept);
+    visibleDraws.resize(kept);
+}
+
+void SceneRenderProgram::buildDepthPyramid(const ve::FrameInfo& frameInfo, VkImageView depthImageView,
+                                           const VkExtent2D extent, const glm::mat4& viewProjection)
+{
+    if (!culledFrames[frameInfo.frameIndex] || !ve::Settings::getInstance()->OCCLUSION_CULLING) {
+        return;
+    }
+    depthPyramid->build(frameInfo, depthImageView, extent, viewProjection);
 }
 
 void SceneRenderProgram::renderScene(const ve::FrameInfo& frameInfo) const
 {
-    pipeline->bind(frameInfo.graphicsCommandBuffer);
+    VE_PROFILE_SCOPE("SceneRenderProgram::renderScene");
+    updateTables(frameInfo.frameIndex);
+
+    if (frameInfo.secondaryRecorder == nullptr) {
+        ve::GpuProfiler::Scope scope(frameInfo.gpuProfiler, frameInfo.graphicsCommandBuffer, "Scene", true);
+        bindScene(frameInfo.graphicsCommandBuffer, frameInfo);
+        if (isDirectDraw(frameInfo.frameIndex)) {
+            drawList->drawDirect(frameInfo.graphicsCommandBuffer, frameInfo.frameIndex, bindFormat);
+        } else {
+            drawIndirect(frameInfo.graphicsCommandBuffer, frameInfo.frameIndex);
+        }
+        return;
+    }
 
+    auto& recorder = *frameInfo.secondaryRecorder;
+    if (!isDirectDraw(frameInfo.frameIndex)) {
+        // A handful of indirect calls, nothing worth splitting
+        const VkCommandBuffer commandBuffer = recorder.begin();
+        bindScene(commandBuffer, frameInfo);
+        drawIndirect(commandBuffer, frameInfo.frameIndex);
+        ve::SecondaryCommandRecorder::end(commandBuffer);
+        recorder.queue(commandBuffer);
+        return;
+    }
+
+    // One chunk per thread, unless that leaves the chunks too small to pay for their buffer and state binds
+    const uint32_t drawCount = drawList->getDirectDrawCount(frameInfo.frameIndex);
+    const uint32_t threadCount = recorder.getThreadCount();
+    const uint32_t chunkSize = std::max(MIN_DRAWS_PER_CHUNK, (drawCount + threadCount - 1) / threadCount);
+    std::vector<VkCommandBuffer> chunks((drawCount + chunkSize - 1) / chunkSize);
+
+    ve::JobSystem::getInstance().parallelFor(drawCount, chunkSize, [&](const uint32_t begin, const uint32_t end) {
+        VE_PROFILE_SCOPE("SceneRenderProgram::recordChunk");
+        const VkCommandBuffer commandBuffer = recorder.begin();
+        bindScene(commandBuffer, frameInfo);
+        drawList->drawDirect(commandBuffer, frameInfo.frameIndex, bindFormat, begin, end - begin);
+        ve::SecondaryCommandRecorder::end(commandBuffer);
+        chunks[begin / chunkSize] = commandBuffer;
+    });
+    recorder.queue(chunks);
+}
+
+bool SceneRenderProgram::isDirectDraw(const int frameIndex) const
+{
+    return !culledFrames[frameIndex] && !(ve::Settings::getInstance()->INDIRECT_DRAW && device.supportsIndirectDraw());
+}
+
+void SceneRenderProgram::bindScene(VkCommandBuffer commandBuffer, const ve::FrameInfo& frameInfo) const
+{
     vkCmdBindDescriptorSets(
-        frameInfo.graphicsCommandBuffer,
+        commandBuffer,
         VK_PIPELINE_BIND_POINT_GRAPHICS,
         pipelineLayout,
         0,
@@ -84,44 +242,135 @@ void SceneRenderProgram::renderScene(const ve::FrameInfo& frameInfo) const
         0,
         nullptr);
 
-	for (const auto& renderTarget : renderTargets)
+    const std::array tableSets = {
+        transformTable->getDescriptorSet(frameInfo.frameIndex),
+        materialTable->getDescriptorSet(frameInfo.frameIndex),
+        drawList->getDescriptorSet(frameInfo.frameIndex),
+    };
+    vkCmdBindDescriptorSets(
+        commandBuffer,
+        VK_PIPELINE_BIND_POINT_GRAPHICS,
+        pipelineLayout,
+        1,
+        static_cast<uint32_t>(tableSets.size()),
+        tableSets.data(),
+        0,
+        nullptr);
+}
+
+void SceneRenderProgram::drawIndirect(VkCommandBuffer commandBuffer, const int frameIndex) const
+{
+    if (culledFrames[frameIndex]) {
+        drawList->drawIndirectCount(
+            commandBuffer,
+            frameIndex,
+            bindFormat,
+            drawCulling->getVisibleCommands(frameIndex),
+            drawCulling->getCounts(frameIndex),
+            DrawCulling::getCountOffset(),
+            DrawCulling::getCountStride());
+    } else {
+        drawList->drawIndirect(commandBuffer, frameIndex, bindFormat);
+    }
+}
+
+void SceneRenderProgram::rebuildDrawList()
+{
+    VE_PROFILE_SCOPE("SceneRenderProgram::rebuildDrawList");
+    drawList->clear();
+    drawBoxes.clear();
+    drawSources.clear();
+    frustumCuller.clear();
+	for (uint32_t object = 0; object < renderTargets.size(); object++)
 	{
-        renderTarget->updateBuffers(*objectSetLayout, frameInfo);
-        vkCmdBindDescriptorSets(
-            frameInfo.graphicsCommandBuffer,
-            VK_PIPELINE_BIND_POINT_GRAPHICS,
-            pipelineLayout,
-            1,
-            1,
-            &renderTarget->descriptorSet,
-            0,
-            nullptr);
-
-        for (const auto& mesh : renderTarget->meshes) 
+        const auto& renderTarget = renderTargets[object];
+        for (uint32_t mesh = 0; mesh < renderTarget->meshes.size(); mesh++)
         {
-            const auto& material = mesh->getMaterial();
-            material->updateBuffers(*materialSetLayout, frameInfo);
-            vkCmdBindDescriptorSets(
-                frameInfo.graphicsCommandBuffer,
-                VK_PIPELINE_BIND_POINT_GRAPHICS,
-                pipelineLayout,
-                2,
-                1,
-                &mesh->getMaterial()->descriptorSet,
-                0,
-                nullptr);
-            
-            mesh->bind(frameInfo.graphicsCommandBuffer);
-            mesh->draw(frameInfo.graphicsCommandBuffer);
+            const auto& meshData = renderTarget->meshes[mesh];
+            drawList->add(*meshData, renderTarget->tableIndex, meshData->getMaterial()->tableIndex);
+            if (meshData->getRange().isIndexed())
+            {
+                ve::Bvh::Box box{meshData->getBounds().min, meshData->getBounds().max};
+                ve::FrustumCuller::transformBox(renderTarget->getLocalModelMatrix(), box.min, box.max);
+                drawBoxes.push_back(box);
+                drawSources.push_back({object, mesh});
+                frustumCuller.add(box.min, box.max);
+            }
         }
+        renderTarget->clearBoundsDirty();
 	}
-    return;
+
+    // Pipelines are only looked up while recording
+    for (const auto& format : drawList->getFormats())
+    {
+        if (pipelines.find(format.getFlags()) == pipelines.end())
+        {
+            createPipeline(format);
+        }
+    }
+
+    bvh.build(drawBoxes);
+}
+
+void SceneRenderProgram::updateBounds()
+{
+    bool moved = false;
+    for (uint32_t draw = 0; draw < drawSources.size(); draw++)
+    {
+        const auto& renderTarget = renderTargets[drawSources[draw].object];
+        if (!renderTarget->areBoundsDirty())
+        {
+            continue;
+        }
+
+        const auto& mesh = renderTarget->meshes[drawSources[draw].mesh];
+        auto& box = drawBoxes[draw];
+        box = {mesh->getBounds().min, mesh->getBounds().max};
+        ve::FrustumCuller::transformBox(renderTarget->getLocalModelMatrix(), box.min, box.max);
+        frustumCuller.set(draw, box.min, box.max);
+        moved = true;
+
+        // The object's last draw, it is up to date now
+        if (draw + 1 == drawSources.size() || drawSources[draw + 1].object != drawSources[draw].object)
+        {
+            renderTarget->clearBoundsDirty();
+        }
+    }
+
+    if (moved)
+    {
+        bvh.refit(drawBoxes);
+    }
+}
+
+std::optional<SceneRenderProgram::Pick> SceneRenderProgram::pick(const glm::vec3& origin, const glm::vec3& direction) const
+{
+    const auto hit = bvh.raycast({origin, direction});
+    if (!hit.has_value())
+    {
+        return std::nullopt;
+    }
+    const auto& source = drawSources[hit->item];
+    return Pick{source.object, source.mesh, hit->distance};
 }
 
 void SceneRenderProgram::addRenderTargets(std::vector<std::unique_ptr<ve::RenderObject>> models)
 {
+    for (const auto& model : models)
+    {
+        transformTable->addObject(*model);
+        for (const auto& mesh : model->meshes)
+        {
+            materialTable->addMaterial(mesh->getMaterial());
+        }
+    }
+    transformTable->commit();
+    materialTable->commit();
+
 	std::for_each(models.begin(), models.end(), [this](std::unique_ptr<ve::RenderObject>& model)
 	{
 		renderTargets.emplace_back(std::move(model));
 	});
-}
+
+    rebuildDrawList();
+}
\ No newline at end of file
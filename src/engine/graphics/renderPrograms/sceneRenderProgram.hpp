@@ -5,7 +5,9 @@
 #pragma once
 
 
+#include <array>
 #include <memory>
+#include <unordered_map>
 
 #include "../renderObject.hpp"
 #include "../../../engine/device.hpp"
@@ -14,29 +16,119 @@
 #include "../../../engine/graphics/Mesh.hpp"
 #include "../../../engine/renderer.hpp"
 #include "../../../engine/graphics/material.hpp"
+#include "../../../engine/graphics/materialTable.hpp"
+#include "../../../engine/graphics/transformTable.hpp"
+#include "../../../engine/graphics/drawList.hpp"
+#include "../../../engine/graphics/frustumCuller.hpp"
+#include "../../../engine/graphics/bvh.hpp"
+#include "../../../engine/compute/computePrograms/drawCulling.hpp"
+#include "../../../engine/compute/computePrograms/depthPyramid.hpp"
 
 class SceneRenderProgram {
 public:
+    struct CpuCullingStats {
+        ve::FrustumCuller::Path path = ve::FrustumCuller::Path::Scalar;
+        uint32_t drawCount = 0;
+        uint32_t visible = 0;
+        // Smaller than LOD_MIN_PIXEL_SIZE, not counted as visible
+        uint32_t sizeCulled = 0;
+        // Of the visible draws, at their levels of detail
+        uint64_t triangles = 0;
+        float milliseconds = 0.0f;
+        // Culled by walking the BVH, path is unused then
+        bool hierarchy = false;
+    };
+
+    struct Pick {
+        // Index into the render targets and into that target's meshes
+        uint32_t object;
+        uint32_t mesh;
+        float distance;
+    };
+
 	explicit SceneRenderProgram(ve::Device& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
     ~SceneRenderProgram();
 
     SceneRenderProgram(const SceneRenderProgram &) = delete;
     SceneRenderProgram &operator=(const SceneRenderProgram &) = delete;
 
+    // Culls the draws on the GPU when the device and settings allow it, recorded before the render pass. Otherwise
+    // the indexed draws are frustum culled on the CPU if CPU_CULLING is set. Either way the surviving draws get their
+    // level of detail with LOD_SELECTION, pixelsPerUnit being |projection[1][1]| * viewport height / 2. Only the GPU
+    // culling goes down to the clusters of a mesh.
+    void cullScene(const ve::FrameInfo& frameInfo, const glm::mat4& viewProjection, const glm::vec3& cameraPosition,
+                   float pixelsPerUnit);
+    // Inline into the graphics command buffer, or into secondary command buffers when the frame has a recorder. The
+    // draws issued one by one are then split into chunks recorded on the job system threads.
     void renderScene(const ve::FrameInfo& frameInfo) const;
+    // Recorded after the render pass, gives the culling of the next frame its occlusion data
+    void buildDepthPyramid(const ve::FrameInfo& frameInfo, VkImageView depthImageView, VkExtent2D extent,
+                           const glm::mat4& viewProjection);
+
+    bool isCulling() const;
+    bool isCpuCulling() const;
+    const DrawCulling::Stats& getCullingStats() const { return drawCulling->getStats(); }
+    const CpuCullingStats& getCpuCullingStats() const { return cpuCullingStats; }
+
+    // Closest indexed mesh whose world space box the ray hits
+    std::optional<Pick> pick(const glm::vec3& origin, const glm::vec3& direction) const;
+    // World space box of every indexed draw, the BVH items
+    const std::vector<ve::Bvh::Box>& getDrawBoxes() const { return drawBoxes; }
+    const ve::Bvh& getBvh() const { return bvh; }
 
     void addRenderTargets(std::vector<std::unique_ptr<ve::RenderObject>>);
 
 private:
     void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-    void createPipeline(VkRenderPass renderPass);
+    // One per vertex format the draws use, the formats differ only in their vertex input
+    void createPipeline(const ve::VertexFormat& format);
+    // Draws every mesh of every render target, called whenever the set of render targets changes
+    void rebuildDrawList();
+    // Recomputes the boxes of the objects that moved and refits the BVH around them
+    void updateBounds();
+    // Picks the level of detail of each of the visibleDraws into visibleLods, dropping the ones too small to draw
+    void selectLods(const ve::DrawList::LodView& lodView);
+    void updateTables(int frameIndex) const;
+    bool isDirectDraw(int frameIndex) const;
+    // Descriptor sets, every command buffer of the scene starts with them. The draw list binds pipelines and
+    // geometry through bindFormat.
+    void bindScene(VkCommandBuffer commandBuffer, const ve::FrameInfo& frameInfo) const;
+    void drawIndirect(VkCommandBuffer commandBuffer, int frameIndex) const;
+
+    static constexpr uint32_t MIN_DRAWS_PER_CHUNK = 128;
+    // Double sided materials share the pipelines, so back faces are drawn. The GPU culling only drops the clusters
+    // facing away when they are culled.
+    static constexpr VkCullModeFlags CULL_MODE = VK_CULL_MODE_NONE;
 
     ve::Device &device;
-    std::unique_ptr<ve::GraphicsPipeline> pipeline;
+    VkRenderPass renderPass;
+    // By vertex format flags
+    std::unordered_map<uint32_t, std::unique_ptr<ve::GraphicsPipeline>> pipelines;
+    ve::DrawList::BindFormat bindFormat;
     VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
 
-    std::unique_ptr<ve::DescriptorSetLayout> objectSetLayout;
-    std::unique_ptr<ve::DescriptorSetLayout> materialSetLayout;
+    std::unique_ptr<ve::TransformTable> transformTable;
+    std::unique_ptr<ve::MaterialTable> materialTable;
+    std::unique_ptr<ve::DrawList> drawList;
+
+    std::unique_ptr<DrawCulling> drawCulling;
+    std::unique_ptr<DepthPyramid> depthPyramid;
+    // Frames whose draws come from the culling output
+    std::array<bool, ve::SwapChain::MAX_FRAMES_IN_FLIGHT> culledFrames{};
+
+    struct DrawSource {
+        uint32_t object;
+        uint32_t mesh;
+    };
+
+    // World space box of every indexed draw, in draw list order. The draws of an object are adjacent.
+    std::vector<ve::Bvh::Box> drawBoxes;
+    std::vector<DrawSource> drawSources;
+    ve::FrustumCuller frustumCuller;
+    ve::Bvh bvh;
+    std::vector<uint32_t> visibleDraws;
+    std::vector<uint32_t> visibleLods;
+    CpuCullingStats cpuCullingStats{};
 
     std::vector<std::unique_ptr<ve::RenderObject>> renderTargets;
 };
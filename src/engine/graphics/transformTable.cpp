@@ -0,0 +1,107 @@
+#include "transformTable.hpp"
+
+#include "../profiling/cpuProfiler.hpp"
+#include "../../log.hpp"
+
+// std
+#include <algorithm>
+
+namespace ve {
+    static constexpr uint32_t INITIAL_CAPACITY = 256;
+
+    TransformTable::TransformTable(Device &device) : device(device) {
+        setLayout = DescriptorSetLayout::Builder(device)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+            .build();
+
+        pool = DescriptorPool::Builder(device)
+            .setMaxSets(SwapChain::MAX_FRAMES_IN_FLIGHT)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, SwapChain::MAX_FRAMES_IN_FLIGHT)
+            .build();
+
+        for (auto &descriptorSet : descriptorSets) {
+            if (!pool->allocateDescriptor(setLayout->getDescriptorSetLayout(), descriptorSet)) {
+                Log::error("Failed to allocate transform table descriptor set");
+                throw std::runtime_error("");
+            }
+        }
+
+        createTransformBuffers(INITIAL_CAPACITY);
+        commit();
+    }
+
+    void TransformTable::addObject(RenderObject &object) {
+        if (object.tableIndex != RenderObject::NO_TABLE_INDEX) {
+            return;
+        }
+
+        object.tableIndex = static_cast<uint32_t>(objects.size());
+        object.markDirty();
+        objects.push_back(&object);
+    }
+
+    void TransformTable::createTransformBuffers(const uint32_t capacity) {
+        for (auto &buffer : transformBuffers) {
+            buffer = std::make_unique<Buffer>(
+                device,
+                sizeof(glm::mat4),
+                capacity,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            buffer->map();
+        }
+        this->capacity = capacity;
+        buffersChanged = true;
+
+        for (const auto object : objects) {
+            object->markDirty();
+        }
+    }
+
+    void TransformTable::commit() {
+        VE_PROFILE_SCOPE("TransformTable::commit");
+        const auto objectCount = static_cast<uint32_t>(objects.size());
+
+        if (objectCount > capacity) {
+            vkDeviceWaitIdle(device.getDevice());
+            createTransformBuffers(std::max(capacity * 2, objectCount));
+        }
+
+        if (buffersChanged) {
+            for (int i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+                auto bufferInfo = transformBuffers[i]->descriptorInfo();
+                DescriptorWriter(*setLayout, *pool)
+                    .writeBuffer(0, &bufferInfo)
+                    .overwrite(descriptorSets[i]);
+            }
+            buffersChanged = false;
+        }
+
+        committedObjectCount = objectCount;
+    }
+
+    void TransformTable::update(const int frameIndex) {
+        auto &buffer = *transformBuffers[frameIndex];
+        uint32_t dirtyBegin = committedObjectCount;
+        uint32_t dirtyEnd = 0;
+
+        for (uint32_t i = 0; i < committedObjectCount; i++) {
+            auto &object = *objects[i];
+            if (!object.isDirty(frameIndex)) {
+                continue;
+            }
+
+            auto matrix = object.getLocalModelMatrix();
+            buffer.writeToIndex(&matrix, static_cast<int>(i));
+            object.clearDirty(frameIndex);
+            dirtyBegin = std::min(dirtyBegin, i);
+            dirtyEnd = i + 1;
+        }
+
+        if (dirtyBegin < dirtyEnd) {
+            buffer.flush(
+                (dirtyEnd - dirtyBegin) * buffer.getAlignmentSize(),
+                dirtyBegin * buffer.getAlignmentSize());
+        }
+    }
+} // ve
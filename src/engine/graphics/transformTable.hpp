@@ -0,0 +1,51 @@
+#pragma once
+
+#include "renderObject.hpp"
+#include "../memory/buffer.hpp"
+#include "../memory/descriptors.hpp"
+
+// std
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace ve {
+    // Model matrices of every render object in one storage buffer per frame in flight. The vertex shader finds its
+    // object's slot in the draw data, so the set is bound once per frame instead of once per object.
+    class TransformTable {
+    public:
+        explicit TransformTable(Device &device);
+
+        TransformTable(const TransformTable &) = delete;
+        TransformTable &operator=(const TransformTable &) = delete;
+
+        // Gives the object a slot, objects already in the table are skipped.
+        void addObject(RenderObject &object);
+        // Grows the buffers if needed and points the sets at them. Waits for the device when the buffers are
+        // replaced, so it belongs to load time.
+        void commit();
+        // Writes the transforms that changed since this frame's buffer was last written and flushes the range they span.
+        void update(int frameIndex);
+
+        DescriptorSetLayout &getSetLayout() const { return *setLayout; }
+        VkDescriptorSet getDescriptorSet(int frameIndex) const { return descriptorSets[frameIndex]; }
+        Buffer &getBuffer(int frameIndex) const { return *transformBuffers[frameIndex]; }
+        uint32_t getObjectCount() const { return static_cast<uint32_t>(objects.size()); }
+
+    private:
+        void createTransformBuffers(uint32_t capacity);
+
+        Device &device;
+
+        std::unique_ptr<DescriptorSetLayout> setLayout;
+        std::unique_ptr<DescriptorPool> pool;
+        std::array<VkDescriptorSet, SwapChain::MAX_FRAMES_IN_FLIGHT> descriptorSets{};
+        std::array<std::unique_ptr<Buffer>, SwapChain::MAX_FRAMES_IN_FLIGHT> transformBuffers{};
+        uint32_t capacity = 0;
+        bool buffersChanged = false;
+
+        // Owned by the render program, which outlives the table's use of them
+        std::vector<RenderObject *> objects;
+        uint32_t committedObjectCount = 0;
+    };
+} // ve
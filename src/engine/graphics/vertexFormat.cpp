@@ -0,0 +1,47 @@
+#include "vertexFormat.hpp"
+
+namespace ve {
+    std::vector<VkDeviceSize> VertexFormat::getStreamStrides() const {
+        std::vector<VkDeviceSize> strides{getPositionStride()};
+        if (getAttributeStride() > 0) {
+            strides.push_back(getAttributeStride());
+        }
+        return strides;
+    }
+
+    std::vector<VkVertexInputBindingDescription> VertexFormat::getBindingDescriptions() const {
+        auto bindingDescriptions = getPositionBindingDescriptions();
+        if (getAttributeStride() > 0) {
+            bindingDescriptions.push_back({ATTRIBUTE_BINDING, getAttributeStride(), VK_VERTEX_INPUT_RATE_VERTEX});
+        }
+        if (needsDefaults()) {
+            // Stride 0, every vertex reads the same defaults
+            bindingDescriptions.push_back({DEFAULT_BINDING, 0, VK_VERTEX_INPUT_RATE_VERTEX});
+        }
+        return bindingDescriptions;
+    }
+
+    std::vector<VkVertexInputAttributeDescription> VertexFormat::getAttributeDescriptions() const {
+        auto attributeDescriptions = getPositionAttributeDescriptions();
+        for (const auto &attribute : ATTRIBUTES) {
+            if (has(attribute.flag)) {
+                attributeDescriptions.push_back({
+                    attribute.location, ATTRIBUTE_BINDING, getAttributeFormat(attribute),
+                    getAttributeOffset(attribute.flag)});
+            } else {
+                attributeDescriptions.push_back({
+                    attribute.location, DEFAULT_BINDING, attribute.format, attribute.defaultOffset});
+            }
+        }
+        return attributeDescriptions;
+    }
+
+    std::vector<VkVertexInputBindingDescription> VertexFormat::getPositionBindingDescriptions() const {
+        return {{POSITION_BINDING, getPositionStride(), VK_VERTEX_INPUT_RATE_VERTEX}};
+    }
+
+    std::vector<VkVertexInputAttributeDescription> VertexFormat::getPositionAttributeDescriptions() const {
+        const VkFormat format = has(QuantizedPosition) ? VK_FORMAT_R16G16B16A16_UNORM : VK_FORMAT_R32G32B32_SFLOAT;
+        return {{0, POSITION_BINDING, format, 0}};
+    }
+} // ve
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "../../engine/device.hpp"
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace ve {
+    // How a mesh's vertices are stored on the GPU, chosen per mesh from the attributes it has. Positions are in their
+    // own stream so depth only passes read nothing else, the other attributes are quantized and interleaved in a
+    // second stream. Attributes a mesh lacks are read from a stride 0 binding of defaults, so one vertex shader
+    // serves every format. The layouts follow from the ATTRIBUTES table.
+    //
+    // Encodings, in shader locations:
+    //   0 position    RGB32 float, or RGBA16 unorm in the mesh's bounds, dequantized with the draw's position scale
+    //   1 normal      octahedral, RG16 snorm
+    //   2 tangent     octahedral, RG16 snorm, the bitangent sign folded into y, see Mesh::encodeTangent
+    //   3 texCoord0   RG16 float, or RG32 float for coordinates outside [-1, 1]
+    //   4 texCoord1   as texCoord0
+    //   5 color0      RGBA8 unorm
+    class VertexFormat {
+    public:
+        enum Flag : uint32_t {
+            Normal = 1 << 0,
+            Tangent = 1 << 1,
+            TexCoord0 = 1 << 2,
+            TexCoord1 = 1 << 3,
+            Color0 = 1 << 4,
+            QuantizedPosition = 1 << 5,
+            FloatTexCoords = 1 << 6,
+        };
+
+        static constexpr uint32_t ATTRIBUTE_FLAGS = Normal | Tangent | TexCoord0 | TexCoord1 | Color0;
+
+        static constexpr uint32_t POSITION_BINDING = 0;
+        static constexpr uint32_t ATTRIBUTE_BINDING = 1;
+        static constexpr uint32_t DEFAULT_BINDING = 2;
+
+        // Attributes other than the position, in the order they are interleaved
+        struct Attribute {
+            Flag flag;
+            uint32_t location;
+            VkFormat format;
+            uint32_t size;
+            // Encoding with FloatTexCoords, the same as format otherwise
+            VkFormat floatFormat;
+            uint32_t floatSize;
+            // Where the default is in the buffer bound to DEFAULT_BINDING
+            uint32_t defaultOffset;
+        };
+
+        static constexpr Attribute ATTRIBUTES[] = {
+            {Normal, 1, VK_FORMAT_R16G16_SNORM, 4, VK_FORMAT_R16G16_SNORM, 4, 0},
+            {Tangent, 2, VK_FORMAT_R16G16_SNORM, 4, VK_FORMAT_R16G16_SNORM, 4, 4},
+            {TexCoord0, 3, VK_FORMAT_R16G16_SFLOAT, 4, VK_FORMAT_R32G32_SFLOAT, 8, 8},
+            {TexCoord1, 4, VK_FORMAT_R16G16_SFLOAT, 4, VK_FORMAT_R32G32_SFLOAT, 8, 12},
+            {Color0, 5, VK_FORMAT_R8G8B8A8_UNORM, 4, VK_FORMAT_R8G8B8A8_UNORM, 4, 16},
+        };
+        static constexpr uint32_t DEFAULTS_SIZE = 20;
+
+        constexpr VertexFormat() = default;
+        constexpr explicit VertexFormat(const uint32_t flags) : flags(flags) {}
+
+        constexpr bool has(const Flag flag) const { return (flags & flag) != 0; }
+        constexpr uint32_t getFlags() const { return flags; }
+
+        constexpr uint32_t getPositionStride() const { return has(QuantizedPosition) ? 8 : 12; }
+        constexpr uint32_t getAttributeSize(const Attribute &attribute) const {
+            return has(FloatTexCoords) ? attribute.floatSize : attribute.size;
+        }
+        constexpr VkFormat getAttributeFormat(const Attribute &attribute) const {
+            return has(FloatTexCoords) ? attribute.floatFormat : attribute.format;
+        }
+        // 0 for a mesh with positions only
+        constexpr uint32_t getAttributeStride() const {
+            uint32_t stride = 0;
+            for (const auto &attribute : ATTRIBUTES) {
+                stride += has(attribute.flag) ? getAttributeSize(attribute) : 0;
+            }
+            return stride;
+        }
+        // Of an attribute the format has, inside the attribute stream
+        constexpr uint32_t getAttributeOffset(const Flag flag) const {
+            uint32_t offset = 0;
+            for (const auto &attribute : ATTRIBUTES) {
+                if (attribute.flag == flag) {
+                    break;
+                }
+                offset += has(attribute.flag) ? getAttributeSize(attribute) : 0;
+            }
+            return offset;
+        }
+        constexpr bool needsDefaults() const { return (flags & ATTRIBUTE_FLAGS) != ATTRIBUTE_FLAGS; }
+
+        // Strides of the streams a geometry arena of this format holds, positions first
+        std::vector<VkDeviceSize> getStreamStrides() const;
+
+        // Every location of the vertex shader
+        std::vector<VkVertexInputBindingDescription> getBindingDescriptions() const;
+        std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions() const;
+        // Location 0 only, for depth only pipelines
+        std::vector<VkVertexInputBindingDescription> getPositionBindingDescriptions() const;
+        std::vector<VkVertexInputAttributeDescription> getPositionAttributeDescriptions() const;
+
+        bool operator==(const VertexFormat &other) const { return flags == other.flags; }
+        bool operator!=(const VertexFormat &other) const { return flags != other.flags; }
+
+    private:
+        uint32_t flags = 0;
+    };
+} // ve
@@ -0,0 +1,216 @@
+#include "jobSystem.hpp"
+
+#include "../profiling/cpuProfiler.hpp"
+
+// std
+#include <algorithm>
+#include <string>
+
+namespace ve {
+    uint32_t JobSystem::requestedThreadCount = 0;
+
+    // Which system and queue the calling thread belongs to, threads of no system push into queue 0
+    static thread_local const JobSystem *currentSystem = nullptr;
+    static thread_local uint32_t currentQueueIndex = 0;
+
+    JobSystem::JobSystem(const uint32_t workerCount) {
+        queues.resize(workerCount + 1);
+        for (auto &queue : queues) {
+            queue = std::make_unique<Queue>();
+        }
+
+        previousSystem = currentSystem;
+        previousQueueIndex = currentQueueIndex;
+        currentSystem = this;
+        currentQueueIndex = 0;
+
+        workers.reserve(workerCount);
+        for (uint32_t i = 1; i <= workerCount; i++) {
+            workers.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    JobSystem::~JobSystem() {
+        {
+            std::lock_guard lock(sleepMutex);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for (auto &worker : workers) {
+            worker.join();
+        }
+        if (currentSystem == this) {
+            currentSystem = previousSystem;
+            currentQueueIndex = previousQueueIndex;
+        }
+    }
+
+    void JobSystem::setThreadCount(const uint32_t threadCount) {
+        requestedThreadCount = threadCount;
+    }
+
+    JobSystem &JobSystem::getInstance() {
+        static JobSystem instance([] {
+            const uint32_t threads = requestedThreadCount != 0
+                ? requestedThreadCount
+                : std::max(1u, std::thread::hardware_concurrency());
+            return threads - 1;
+        }());
+        return instance;
+    }
+
+    bool JobSystem::isMainThread() const {
+        return currentSystem == this && currentQueueIndex == 0;
+    }
+
+    uint32_t JobSystem::currentQueue() const {
+        return currentSystem == this ? currentQueueIndex : 0;
+    }
+
+    void JobSystem::run(Job job, Counter *signal, Counter *dependency) {
+        if (signal != nullptr) {
+            signal->pending.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (dependency != nullptr) {
+            // Checked under the lock the finishing job takes before it collects the continuations
+            std::lock_guard lock(dependency->mutex);
+            if (dependency->pending.load(std::memory_order_acquire) != 0) {
+                dependency->continuations.emplace_back(std::move(job), signal);
+                return;
+            }
+        }
+
+        schedule({std::move(job), signal});
+    }
+
+    void JobSystem::runOnMainThread(Job job, Counter *signal) {
+        if (signal != nullptr) {
+            signal->pending.fetch_add(1, std::memory_order_relaxed);
+        }
+        std::lock_guard lock(mainThreadMutex);
+        mainThreadJobs.push_back({std::move(job), signal});
+    }
+
+    void JobSystem::schedule(Entry entry) {
+        // Counted first, so a thread that takes the job right away never sees the count underflow
+        queuedJobs.fetch_add(1, std::memory_order_release);
+        auto &queue = *queues[currentQueue()];
+        {
+            std::lock_guard lock(queue.mutex);
+            queue.entries.push_back(std::move(entry));
+        }
+        if (!workers.empty()) {
+            // Taking the lock orders this with a worker that just found nothing and is about to sleep
+            { std::lock_guard lock(sleepMutex); }
+            wakeUp.notify_one();
+        }
+    }
+
+    bool JobSystem::pop(const uint32_t queueIndex, Entry &entry) {
+        auto &queue = *queues[queueIndex];
+        std::lock_guard lock(queue.mutex);
+        if (queue.entries.empty()) {
+            return false;
+        }
+        // Newest first, its data is most likely still in cache
+        entry = std::move(queue.entries.back());
+        queue.entries.pop_back();
+        return true;
+    }
+
+    bool JobSystem::steal(const uint32_t queueIndex, Entry &entry) {
+        const auto queueCount = static_cast<uint32_t>(queues.size());
+        for (uint32_t offset = 1; offset < queueCount; offset++) {
+            auto &queue = *queues[(queueIndex + offset) % queueCount];
+            std::unique_lock lock(queue.mutex, std::try_to_lock);
+            if (!lock.owns_lock() || queue.entries.empty()) {
+                continue;
+            }
+            // Oldest first, it tends to be the biggest piece of work left
+            entry = std::move(queue.entries.front());
+            queue.entries.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    void JobSystem::execute(Entry &entry) {
+        entry.job();
+        entry.job = nullptr;
+
+        Counter *signal = entry.signal;
+        if (signal == nullptr) {
+            return;
+        }
+
+        // Decremented under the lock, a waiter takes it once before it lets the counter go out of scope
+        std::vector<std::pair<Job, Counter *>> continuations;
+        {
+            std::lock_guard lock(signal->mutex);
+            if (signal->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                continuations.swap(signal->continuations);
+            }
+        }
+        for (auto &[job, continuationSignal] : continuations) {
+            schedule({std::move(job), continuationSignal});
+        }
+    }
+
+    bool JobSystem::runOne(const uint32_t queueIndex) {
+        Entry entry;
+        if (!pop(queueIndex, entry) && !steal(queueIndex, entry)) {
+            return false;
+        }
+        queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+        execute(entry);
+        return true;
+    }
+
+    void JobSystem::processMainThreadJobs() {
+        VE_PROFILE_SCOPE("JobSystem::processMainThreadJobs");
+        std::deque<Entry> jobs;
+        {
+            std::lock_guard lock(mainThreadMutex);
+            jobs.swap(mainThreadJobs);
+        }
+        for (auto &entry : jobs) {
+            execute(entry);
+        }
+    }
+
+    void JobSystem::wait(Counter &counter) {
+        const uint32_t queueIndex = currentQueue();
+        const bool mainThread = isMainThread();
+        while (!counter.isDone()) {
+            if (mainThread) {
+                processMainThreadJobs();
+            }
+            if (!runOne(queueIndex)) {
+                std::this_thread::yield();
+            }
+        }
+        // The job that finished the counter may still hold its lock
+        std::lock_guard lock(counter.mutex);
+    }
+
+    void JobSystem::workerLoop(const uint32_t queueIndex) {
+        currentSystem = this;
+        currentQueueIndex = queueIndex;
+        CpuProfiler::setThreadName("Worker " + std::to_string(queueIndex));
+
+        while (true) {
+            if (runOne(queueIndex)) {
+                continue;
+            }
+
+            std::unique_lock lock(sleepMutex);
+            wakeUp.wait(lock, [this] {
+                return stopping.load() || queuedJobs.load(std::memory_order_acquire) > 0;
+            });
+            if (stopping) {
+                return;
+            }
+        }
+    }
+} // ve
@@ -0,0 +1,127 @@
+#pragma once
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ve {
+    // Work-stealing scheduler. Every thread, the one that created the system included, owns a deque: it pushes and
+    // pops its own jobs at the back, idle threads steal from the front of the others. Waiting on a counter runs
+    // jobs instead of blocking, so jobs may wait on the jobs they spawned.
+    class JobSystem {
+    public:
+        using Job = std::function<void()>;
+
+        // Number of jobs still to finish. Jobs scheduled with a dependency start once its counter reaches zero.
+        class Counter {
+        public:
+            Counter() = default;
+            Counter(const Counter &) = delete;
+            Counter &operator=(const Counter &) = delete;
+
+            bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+        private:
+            friend class JobSystem;
+
+            std::atomic<uint32_t> pending{0};
+            std::mutex mutex;
+            std::vector<std::pair<Job, Counter *>> continuations;
+        };
+
+        // workerCount threads on top of the creating thread, which becomes the main thread until the system is
+        // destroyed. Systems created on one thread have to be destroyed in reverse order.
+        explicit JobSystem(uint32_t workerCount);
+        ~JobSystem();
+
+        JobSystem(const JobSystem &) = delete;
+        JobSystem &operator=(const JobSystem &) = delete;
+
+        // 0 uses one thread per hardware thread. Only has an effect before the first getInstance, which has to come
+        // from the main thread.
+        static void setThreadCount(uint32_t threadCount);
+        static JobSystem &getInstance();
+
+        // signal, when given, is done once the job has run. dependency, when given, has to be done before it starts.
+        void run(Job job, Counter *signal = nullptr, Counter *dependency = nullptr);
+        // Runs on the main thread the next time it waits or processes its jobs. Vulkan queue submission and
+        // anything else bound to the main thread goes through here.
+        void runOnMainThread(Job job, Counter *signal = nullptr);
+        void wait(Counter &counter);
+        // Runs the jobs queued for the main thread, called once per frame
+        void processMainThreadJobs();
+
+        // Calls body(begin, end) over ranges of at most grainSize indices and waits for all of them. A grainSize of 0
+        // picks one that gives every thread a few ranges.
+        template<typename Body>
+        void parallelFor(uint32_t count, uint32_t grainSize, const Body &body) {
+            if (count == 0) {
+                return;
+            }
+            if (grainSize == 0) {
+                grainSize = std::max(1u, count / (getThreadCount() * 4));
+            }
+            if (grainSize >= count) {
+                body(0u, count);
+                return;
+            }
+
+            Counter counter;
+            for (uint32_t begin = grainSize; begin < count; begin += grainSize) {
+                const uint32_t end = std::min(count, begin + grainSize);
+                run([&body, begin, end] { body(begin, end); }, &counter);
+            }
+            // The first range runs here instead of idling
+            body(0u, grainSize);
+            wait(counter);
+        }
+
+        uint32_t getThreadCount() const { return static_cast<uint32_t>(queues.size()); }
+        // Below getThreadCount, 0 on the main thread and on threads that belong to no system
+        uint32_t getThreadIndex() const { return currentQueue(); }
+        bool isMainThread() const;
+
+    private:
+        struct Entry {
+            Job job;
+            Counter *signal;
+        };
+
+        struct Queue {
+            std::mutex mutex;
+            std::deque<Entry> entries;
+        };
+
+        void schedule(Entry entry);
+        bool runOne(uint32_t queueIndex);
+        bool pop(uint32_t queueIndex, Entry &entry);
+        bool steal(uint32_t queueIndex, Entry &entry);
+        void execute(Entry &entry);
+        void workerLoop(uint32_t queueIndex);
+        uint32_t currentQueue() const;
+
+        std::vector<std::unique_ptr<Queue>> queues;
+        std::vector<std::thread> workers;
+
+        std::mutex mainThreadMutex;
+        std::deque<Entry> mainThreadJobs;
+
+        std::mutex sleepMutex;
+        std::condition_variable wakeUp;
+        std::atomic<uint32_t> queuedJobs{0};
+        std::atomic<bool> stopping{false};
+
+        const JobSystem *previousSystem = nullptr;
+        uint32_t previousQueueIndex = 0;
+
+        static uint32_t requestedThreadCount;
+    };
+} // ve
@@ -0,0 +1,145 @@
+#include "launchOptions.hpp"
+
+#include <stdexcept>
+#include <string>
+
+#include "../log.hpp"
+
+namespace ve {
+    static uint32_t parseUnsigned(const std::string &option, const std::string &value) {
+        try {
+            size_t parsed = 0;
+            const unsigned long result = std::stoul(value, &parsed);
+            if (parsed != value.size()) {
+                throw std::invalid_argument(value);
+            }
+            return static_cast<uint32_t>(result);
+        } catch (const std::exception &) {
+            Log::error("Invalid value '" + value + "' for " + option);
+            throw std::runtime_error("");
+        }
+    }
+
+    static float parseNonNegative(const std::string &option, const std::string &value) {
+        try {
+            size_t parsed = 0;
+            const float result = std::stof(value, &parsed);
+            if (parsed != value.size() || !(result >= 0.0f)) {
+                throw std::invalid_argument(value);
+            }
+            return result;
+        } catch (const std::exception &) {
+            Log::error("Invalid value '" + value + "' for " + option);
+            throw std::runtime_error("");
+        }
+    }
+
+    LaunchOptions LaunchOptions::parse(int argc, char **argv) {
+        LaunchOptions options {};
+        bool warmupSet = false;
+
+        for (int i = 1; i < argc; i++) {
+            const std::string argument = argv[i];
+
+            auto nextValue = [&]() -> std::string {
+                if (i + 1 >= argc) {
+                    Log::error("Missing value for " + argument);
+                    throw std::runtime_error("");
+                }
+                return argv[++i];
+            };
+
+            if (argument == "--headless") {
+                options.headless = true;
+            } else if (argument == "--frames") {
+                options.frameCount = parseUnsigned(argument, nextValue());
+            } else if (argument == "--benchmark") {
+                options.benchmark = true;
+            } else if (argument == "--warmup") {
+                options.warmupFrames = parseUnsigned(argument, nextValue());
+                warmupSet = true;
+            } else if (argument == "--output") {
+                options.outputPath = nextValue();
+            } else if (argument == "--trace") {
+                options.tracePath = nextValue();
+            } else if (argument == "--bench-culling") {
+                options.benchCulling = true;
+            } else if (argument == "--threads") {
+                options.threadCount = parseUnsigned(argument, nextValue());
+            } else if (argument == "--quantize-positions") {
+                options.quantizePositions = true;
+            } else if (argument == "--no-mesh-optimization") {
+                options.optimizeMeshes = false;
+            } else if (argument == "--optimize-overdraw") {
+                options.optimizeOverdraw = true;
+            } else if (argument == "--mesh-stats") {
+                options.meshStatsPath = nextValue();
+            } else if (argument == "--no-lods") {
+                options.generateLods = false;
+            } else if (argument == "--no-meshlets") {
+                options.generateMeshlets = false;
+            } else if (argument == "--lod-error") {
+                options.lodPixelError = parseNonNegative(argument, nextValue());
+            } else if (argument == "--lod-min-size") {
+                options.lodMinPixelSize = parseNonNegative(argument, nextValue());
+            } else if (argument == "--bench-jobs") {
+                options.benchJobs = true;
+            } else if (argument == "--bench-bvh") {
+                options.benchBvh = true;
+            } else if (argument == "--bench-gltf-parse") {
+                options.benchGltfParse = true;
+            } else if (argument == "--bench-accessors") {
+                options.benchAccessors = true;
+            } else if (argument == "--resolution") {
+                const std::string value = nextValue();
+                const size_t separator = value.find('x');
+                if (separator == std::string::npos) {
+                    Log::error("Expected --resolution <width>x<height>, got '" + value + "'");
+                    throw std::runtime_error("");
+                }
+                options.extent.width = parseUnsigned(argument, value.substr(0, separator));
+                options.extent.height = parseUnsigned(argument, value.substr(separator + 1));
+            } else {
+                Log::error("Unknown option " + argument);
+                throw std::runtime_error("");
+            }
+        }
+
+        if (options.extent.width == 0 || options.extent.height == 0) {
+            Log::error("Resolution must be non-zero");
+            throw std::runtime_error("");
+        }
+
+        if (options.benchmark) {
+            if (!warmupSet) {
+                options.warmupFrames = 60;
+            }
+            if (options.frameCount == 0) {
+                options.frameCount = 1000;
+            }
+        } else if (options.warmupFrames > 0) {
+            Log::warning("--warmup only applies to --benchmark runs, ignoring it");
+            options.warmupFrames = 0;
+        }
+
+#ifndef VE_ENABLE_PROFILING
+        if (!options.tracePath.empty()) {
+            Log::warning("Built without VE_ENABLE_PROFILING, the trace will be empty");
+        }
+#endif
+
+        if (options.benchBvh) {
+            options.headless = true;
+            if (options.frameCount == 0) {
+                options.frameCount = 1;
+            }
+        }
+
+        if (options.headless && options.frameCount == 0) {
+            Log::warning("Headless mode without --frames, rendering a single frame");
+            options.frameCount = 1;
+        }
+
+        return options;
+    }
+} // ve
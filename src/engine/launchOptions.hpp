@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+
+namespace ve {
+    struct LaunchOptions {
+        // Render into offscreen images instead of a window and a swap chain.
+        bool headless = false;
+        // Number of frames to render before exiting (after any warm-up), 0 runs until the window is closed.
+        uint32_t frameCount = 0;
+        VkExtent2D extent {1920, 1080};
+
+        // Play the scene's scripted camera path with fixed delta times and write frame statistics.
+        bool benchmark = false;
+        // Frames rendered before measuring starts, not counted in frameCount.
+        uint32_t warmupFrames = 0;
+        std::string outputPath = "benchmark.json";
+
+        // Chrome trace of the CPU profiler scopes, written on exit. Empty disables recording.
+        std::string tracePath;
+
+        // Threads of the job system, the main thread included. 0 uses one per hardware thread.
+        uint32_t threadCount = 0;
+        // Store mesh positions as 16 bit unorm in their bounds, sets Settings::QUANTIZED_POSITIONS before loading.
+        bool quantizePositions = false;
+        // Sets Settings::OPTIMIZE_MESHES and OPTIMIZE_OVERDRAW before loading.
+        bool optimizeMeshes = true;
+        bool optimizeOverdraw = false;
+        // CSV of the vertex cache efficiency of every optimized primitive, written after loading. Empty disables it.
+        std::string meshStatsPath;
+        // Sets Settings::GENERATE_LODS before loading.
+        bool generateLods = true;
+        // Sets Settings::GENERATE_MESHLETS before loading.
+        bool generateMeshlets = true;
+        // Set Settings::LOD_PIXEL_ERROR and LOD_MIN_PIXEL_SIZE, in pixels.
+        float lodPixelError = 1.0f;
+        float lodMinPixelSize = 1.0f;
+
+        // Run the CPU frustum culling micro-benchmark and exit, without creating a window or a device.
+        bool benchCulling = false;
+        // Time building and querying the BVH of the loaded scene, renders a single headless frame afterwards.
+        bool benchBvh = false;
+        // Run the job system scaling benchmark and exit.
+        bool benchJobs = false;
+        // Time parsing the scene's glTF document with the glTF SDK and with simdjson, then exit.
+        bool benchGltfParse = false;
+        // Time decoding synthetic glTF accessors into vertices on the scalar and SSE paths, then exit.
+        bool benchAccessors = false;
+
+        static LaunchOptions parse(int argc, char **argv);
+    };
+} // ve
@@ -40,17 +40,19 @@ namespace ve {
               memoryPropertyFlags{memoryPropertyFlags} {
         alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
         bufferSize = alignmentSize * instanceCount;
-        device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, memory);
+        device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, allocation);
     }
 
     Buffer::~Buffer() {
         unmap();
         vkDestroyBuffer(device.getDevice(), buffer, nullptr);
-        vkFreeMemory(device.getDevice(), memory, nullptr);
+        device.getAllocator().free(allocation);
     }
 
 /**
  * Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
+ * Host visible memory blocks are persistently mapped by the allocator, so this only hands out a
+ * pointer into them.
  *
  * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
  * buffer range.
@@ -59,8 +61,12 @@ namespace ve {
  * @return VkResult of the buffer mapping call
  */
     VkResult Buffer::map(VkDeviceSize size, VkDeviceSize offset) {
-        assert(buffer && memory && "Called map on buffer before create");
-        return vkMapMemory(device.getDevice(), memory, offset, size, 0, &mapped);
+        assert(buffer && allocation.memory && "Called map on buffer before create");
+        if (allocation.mapped == nullptr) {
+            return VK_ERROR_MEMORY_MAP_FAILED;
+        }
+        mapped = static_cast<char *>(allocation.mapped) + offset;
+        return VK_SUCCESS;
     }
 
 /**
@@ -69,10 +75,7 @@ namespace ve {
  * @note Does not return a result as vkUnmapMemory can't fail
  */
     void Buffer::unmap() {
-        if (mapped) {
-            vkUnmapMemory(device.getDevice(), memory);
-            mapped = nullptr;
-        }
+        mapped = nullptr;
     }
 
 /**
@@ -108,12 +111,7 @@ namespace ve {
  * @return VkResult of the flush call
  */
     VkResult Buffer::flush(VkDeviceSize size, VkDeviceSize offset) {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
-        return vkFlushMappedMemoryRanges(device.getDevice(), 1, &mappedRange);
+        return device.getAllocator().flush(allocation, offset, size);
     }
 
 /**
@@ -128,12 +126,7 @@ namespace ve {
  * @return VkResult of the invalidate call
  */
     VkResult Buffer::invalidate(VkDeviceSize size, VkDeviceSize offset) {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
-        return vkInvalidateMappedMemoryRanges(device.getDevice(), 1, &mappedRange);
+        return device.getAllocator().invalidate(allocation, offset, size);
     }
 
 /**
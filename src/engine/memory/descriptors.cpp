@@ -3,6 +3,7 @@
 //
 
 #include "descriptors.hpp"
+#include "../profiling/cpuProfiler.hpp"
 
 // std
 #include <cassert>
@@ -16,7 +17,8 @@ namespace ve {
             uint32_t binding,
             VkDescriptorType descriptorType,
             VkShaderStageFlags stageFlags,
-            uint32_t count) {
+            uint32_t count,
+            VkDescriptorBindingFlags flags) {
         assert(bindings.count(binding) == 0 && "Binding already in use");
         VkDescriptorSetLayoutBinding layoutBinding{};
         layoutBinding.binding = binding;
@@ -24,21 +26,29 @@ namespace ve {
         layoutBinding.descriptorCount = count;
         layoutBinding.stageFlags = stageFlags;
         bindings[binding] = layoutBinding;
+        if (flags != 0) {
+            bindingFlags[binding] = flags;
+        }
         return *this;
     }
 
     std::unique_ptr<DescriptorSetLayout> DescriptorSetLayout::Builder::build() const {
-        return std::make_unique<DescriptorSetLayout>(device, bindings);
+        return std::make_unique<DescriptorSetLayout>(device, bindings, bindingFlags);
     }
 
 // *************** Descriptor Set Layout *********************
 
     DescriptorSetLayout::DescriptorSetLayout(
-            Device &device, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings)
+            Device &device,
+            std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+            const std::unordered_map<uint32_t, VkDescriptorBindingFlags> &bindingFlags)
             : device{device}, bindings{bindings} {
         std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
+        std::vector<VkDescriptorBindingFlags> setLayoutBindingFlags{};
         for (auto kv: bindings) {
             setLayoutBindings.push_back(kv.second);
+            const auto flags = bindingFlags.find(kv.first);
+            setLayoutBindingFlags.push_back(flags != bindingFlags.end() ? flags->second : 0);
         }
 
         VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
@@ -46,6 +56,14 @@ namespace ve {
         descriptorSetLayoutInfo.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
         descriptorSetLayoutInfo.pBindings = setLayoutBindings.data();
 
+        VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+        if (!bindingFlags.empty()) {
+            bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+            bindingFlagsInfo.bindingCount = static_cast<uint32_t>(setLayoutBindingFlags.size());
+            bindingFlagsInfo.pBindingFlags = setLayoutBindingFlags.data();
+            descriptorSetLayoutInfo.pNext = &bindingFlagsInfo;
+        }
+
         if (vkCreateDescriptorSetLayout(
                 device.getDevice(),
                 &descriptorSetLayoutInfo,
@@ -182,6 +200,28 @@ namespace ve {
         return *this;
     }
 
+    DescriptorWriter &DescriptorWriter::writeImages(
+            uint32_t binding, VkDescriptorImageInfo *imageInfos, uint32_t count, uint32_t firstElement) {
+        assert(setLayout.bindings.count(binding) == 1 && "Layout does not contain specified binding");
+
+        auto &bindingDescription = setLayout.bindings[binding];
+
+        assert(
+                firstElement + count <= bindingDescription.descriptorCount &&
+                "Writing past the end of the binding's array");
+
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.descriptorType = bindingDescription.descriptorType;
+        write.dstBinding = binding;
+        write.dstArrayElement = firstElement;
+        write.pImageInfo = imageInfos;
+        write.descriptorCount = count;
+
+        writes.push_back(write);
+        return *this;
+    }
+
     bool DescriptorWriter::build(VkDescriptorSet &set) {
         bool success = pool.allocateDescriptor(setLayout.getDescriptorSetLayout(), set);
         if (!success) {
@@ -192,6 +232,7 @@ namespace ve {
     }
 
     void DescriptorWriter::overwrite(VkDescriptorSet &set) {
+        VE_PROFILE_SCOPE("DescriptorWriter::overwrite");
         for (auto &write: writes) {
             write.dstSet = set;
         }
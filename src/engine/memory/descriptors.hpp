@@ -23,16 +23,20 @@ namespace ve {
                     uint32_t binding,
                     VkDescriptorType descriptorType,
                     VkShaderStageFlags stageFlags,
-                    uint32_t count = 1);
+                    uint32_t count = 1,
+                    VkDescriptorBindingFlags bindingFlags = 0);
             std::unique_ptr<DescriptorSetLayout> build() const;
 
         private:
             Device &device;
             std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings{};
+            std::unordered_map<uint32_t, VkDescriptorBindingFlags> bindingFlags{};
         };
 
         DescriptorSetLayout(
-                Device &device, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings);
+                Device &device,
+                std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+                const std::unordered_map<uint32_t, VkDescriptorBindingFlags> &bindingFlags = {});
         ~DescriptorSetLayout();
         DescriptorSetLayout(const DescriptorSetLayout &) = delete;
         DescriptorSetLayout &operator=(const DescriptorSetLayout &) = delete;
@@ -94,6 +98,9 @@ namespace ve {
 
         DescriptorWriter &writeBuffer(uint32_t binding, VkDescriptorBufferInfo *bufferInfo);
         DescriptorWriter &writeImage(uint32_t binding, VkDescriptorImageInfo *imageInfo);
+        // Writes count consecutive elements of an array binding, starting at firstElement.
+        DescriptorWriter &writeImages(
+                uint32_t binding, VkDescriptorImageInfo *imageInfos, uint32_t count, uint32_t firstElement = 0);
 
         bool build(VkDescriptorSet &set);
         void overwrite(VkDescriptorSet &set);
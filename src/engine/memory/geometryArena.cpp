@@ -0,0 +1,206 @@
+#include "geometryArena.hpp"
+
+#include "../swapChain.hpp"
+#include "../profiling/cpuProfiler.hpp"
+#include "../../log.hpp"
+
+// std
+#include <algorithm>
+#include <utility>
+
+namespace ve {
+    static constexpr VkBufferUsageFlags VERTEX_USAGE =
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    static constexpr VkBufferUsageFlags INDEX_USAGE =
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    // Granularity of the index allocator
+    static constexpr VkDeviceSize INDEX_UNIT_SIZE = sizeof(uint16_t);
+
+    GeometryArena::GeometryArena(
+            Device &device,
+            std::vector<VkDeviceSize> vertexStrides,
+            const uint32_t vertexCapacity,
+            const uint32_t indexCapacity)
+            : device(device),
+              vertexStrides(std::move(vertexStrides)),
+              vertexAllocator(vertexCapacity),
+              indexAllocator(indexCapacity) {
+        if (this->vertexStrides.empty() || this->vertexStrides.size() > MAX_STREAMS) {
+            Log::error("Geometry arenas hold 1 to " + std::to_string(MAX_STREAMS) + " vertex streams");
+            throw std::runtime_error("");
+        }
+        for (const VkDeviceSize stride : this->vertexStrides) {
+            vertexBuffers.push_back(createBuffer(stride, vertexCapacity, VERTEX_USAGE));
+        }
+        indexBuffer = createBuffer(INDEX_UNIT_SIZE, indexCapacity, INDEX_USAGE);
+    }
+
+    VkIndexType GeometryArena::getIndexType(const uint32_t vertexCount) {
+        return vertexCount <= UINT16_MAX + 1u ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    }
+
+    VkDeviceSize GeometryArena::getIndexSize(const VkIndexType indexType) {
+        switch (indexType) {
+            case VK_INDEX_TYPE_UINT16:
+                return sizeof(uint16_t);
+            case VK_INDEX_TYPE_UINT32:
+                return sizeof(uint32_t);
+            default:
+                Log::error("Geometry arenas only hold 16 or 32 bit indices");
+                throw std::runtime_error("");
+        }
+    }
+
+    std::unique_ptr<Buffer> GeometryArena::createBuffer(
+            const VkDeviceSize elementSize, const uint32_t count, const VkBufferUsageFlags usage) const {
+        return std::make_unique<Buffer>(
+                device,
+                elementSize,
+                count,
+                usage,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+
+    GeometryArena::Range GeometryArena::allocate(
+            const uint32_t vertexCount, const uint32_t indexCount, const VkIndexType indexType) {
+        VE_PROFILE_SCOPE("GeometryArena::allocate");
+        if (vertexCount == 0) {
+            Log::error("Cannot allocate geometry without vertices");
+            throw std::runtime_error("");
+        }
+        const uint64_t unitsPerIndex = getIndexSize(indexType) / INDEX_UNIT_SIZE;
+
+        Range range {};
+        range.vertices = vertexAllocator.allocate(vertexCount);
+        if (!range.vertices.isValid()) {
+            const uint64_t oldCount = vertexAllocator.getSize();
+            const uint64_t newCount = getGrownCount(vertexAllocator, vertexCount);
+            for (size_t stream = 0; stream < vertexBuffers.size(); stream++) {
+                grow(vertexBuffers[stream], oldCount, newCount, vertexStrides[stream], VERTEX_USAGE);
+            }
+            vertexAllocator.grow(newCount);
+            range.vertices = vertexAllocator.allocate(vertexCount);
+        }
+
+        if (indexCount > 0) {
+            // Growing by the size plus the alignment always leaves room for an aligned block
+            const uint64_t units = indexCount * unitsPerIndex;
+            range.indices = indexAllocator.allocate(units, unitsPerIndex);
+            if (!range.indices.isValid()) {
+                const uint64_t newCount = getGrownCount(indexAllocator, units + unitsPerIndex);
+                grow(indexBuffer, indexAllocator.getSize(), newCount, INDEX_UNIT_SIZE, INDEX_USAGE);
+                indexAllocator.grow(newCount);
+                range.indices = indexAllocator.allocate(units, unitsPerIndex);
+            }
+        }
+
+        range.vertexOffset = static_cast<int32_t>(range.vertices.offset);
+        range.vertexCount = vertexCount;
+        range.firstIndex = static_cast<uint32_t>(range.indices.offset / unitsPerIndex);
+        range.indexCount = indexCount;
+        range.indexType = indexType;
+
+        rangeCount++;
+        return range;
+    }
+
+    void *GeometryArena::writeVertices(const Range &range, const uint32_t stream) {
+        const VkDeviceSize stride = vertexStrides[stream];
+        return device.getUploadContext().writeBuffer(
+                vertexBuffers[stream]->getBuffer(), range.vertices.offset * stride, range.vertexCount * stride);
+    }
+
+    void *GeometryArena::writeIndices(const Range &range) {
+        return device.getUploadContext().writeBuffer(
+                indexBuffer->getBuffer(), range.indices.offset * INDEX_UNIT_SIZE,
+                range.indexCount * getIndexSize(range.indexType));
+    }
+
+    void GeometryArena::free(Range &range) {
+        if (!range.isValid()) {
+            return;
+        }
+        pendingFrees.push_back({range, SwapChain::MAX_FRAMES_IN_FLIGHT});
+        range = {};
+        rangeCount--;
+    }
+
+    void GeometryArena::nextFrame() {
+        for (auto &pending : pendingFrees) {
+            if (--pending.framesLeft == 0) {
+                vertexAllocator.free(pending.range.vertices);
+                if (pending.range.isIndexed()) {
+                    indexAllocator.free(pending.range.indices);
+                }
+            }
+        }
+
+        pendingFrees.erase(
+                std::remove_if(pendingFrees.begin(), pendingFrees.end(),
+                               [](const PendingFree &pending) { return pending.framesLeft == 0; }),
+                pendingFrees.end());
+    }
+
+    void GeometryArena::bind(VkCommandBuffer commandBuffer, const VkIndexType indexType) const {
+        VkBuffer buffers[MAX_STREAMS];
+        constexpr VkDeviceSize offsets[MAX_STREAMS] = {};
+        for (size_t stream = 0; stream < vertexBuffers.size(); stream++) {
+            buffers[stream] = vertexBuffers[stream]->getBuffer();
+        }
+        vkCmdBindVertexBuffers(commandBuffer, 0, getStreamCount(), buffers, offsets);
+        bindIndices(commandBuffer, indexType);
+    }
+
+    void GeometryArena::bindIndices(VkCommandBuffer commandBuffer, const VkIndexType indexType) const {
+        vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, indexType);
+    }
+
+    uint64_t GeometryArena::getGrownCount(const Tlsf &allocator, const uint64_t minimumCount) {
+        const uint64_t oldCount = allocator.getSize();
+        const uint64_t newCount = std::max(oldCount * 2, oldCount + minimumCount);
+        if (newCount > UINT32_MAX) {
+            Log::error("Geometry arena cannot grow past 2^32 elements");
+            throw std::runtime_error("");
+        }
+        return newCount;
+    }
+
+    void GeometryArena::grow(
+            std::unique_ptr<Buffer> &buffer,
+            const uint64_t oldCount,
+            const uint64_t newCount,
+            const VkDeviceSize elementSize,
+            const VkBufferUsageFlags usage) {
+        VE_PROFILE_SCOPE("GeometryArena::grow");
+        // Draws recorded for frames in flight still reference the old buffer
+        vkDeviceWaitIdle(device.getDevice());
+
+        auto grown = createBuffer(elementSize, static_cast<uint32_t>(newCount), usage);
+        auto &uploads = device.getUploadContext();
+        uploads.copyBuffer(buffer->getBuffer(), grown->getBuffer(), oldCount * elementSize);
+        // The old buffer is destroyed right away, the copy out of it has to be done
+        uploads.wait(uploads.flush());
+        buffer = std::move(grown);
+
+        Log::info("Geometry arena grown to " + std::to_string(newCount) + " elements of " +
+                  std::to_string(elementSize) + " bytes");
+    }
+
+    VkDeviceSize GeometryArena::getVertexSize() const {
+        VkDeviceSize size = 0;
+        for (const VkDeviceSize stride : vertexStrides) {
+            size += stride;
+        }
+        return size;
+    }
+
+    VkDeviceSize GeometryArena::getUsedBytes() const {
+        return (vertexAllocator.getSize() - vertexAllocator.getFreeSize()) * getVertexSize() +
+               (indexAllocator.getSize() - indexAllocator.getFreeSize()) * INDEX_UNIT_SIZE;
+    }
+
+    VkDeviceSize GeometryArena::getCapacityBytes() const {
+        return vertexAllocator.getSize() * getVertexSize() + indexAllocator.getSize() * INDEX_UNIT_SIZE;
+    }
+} // ve
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "buffer.hpp"
+#include "tlsf.hpp"
+
+// std
+#include <memory>
+#include <vector>
+
+namespace ve {
+    // Vertex buffers and one index buffer shared by every mesh of a vertex format. Meshes own ranges of
+    // them, so a frame binds the buffers once and each draw only carries firstIndex and vertexOffset. A format
+    // can split its vertices into several streams, one buffer each, all indexed by the same vertex offset.
+    // Vertices and indices are managed by TLSF free lists counted in elements and grow when they run out of space.
+    // The index buffer is counted in 16 bit units and holds ranges of either index type: 32 bit ranges are
+    // aligned so that binding the same buffer as UINT32 addresses them with their own firstIndex.
+    class GeometryArena {
+    public:
+        struct Range {
+            Tlsf::Allocation vertices;
+            Tlsf::Allocation indices;
+
+            int32_t vertexOffset = 0;
+            uint32_t vertexCount = 0;
+            // In indices of indexType
+            uint32_t firstIndex = 0;
+            uint32_t indexCount = 0;
+            VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+
+            bool isValid() const { return vertices.isValid(); }
+            bool isIndexed() const { return indices.isValid(); }
+        };
+
+        GeometryArena(
+                Device &device,
+                std::vector<VkDeviceSize> vertexStrides,
+                uint32_t vertexCapacity = 1 << 20,
+                uint32_t indexCapacity = 1 << 22);
+
+        GeometryArena(const GeometryArena &) = delete;
+        GeometryArena &operator=(const GeometryArena &) = delete;
+
+        // Reserves the range without filling it. Its contents go into the staging memory returned by writeVertices
+        // and writeIndices, see UploadContext::writeBuffer. Each has to be filled before the next call into the arena.
+        Range allocate(uint32_t vertexCount, uint32_t indexCount, VkIndexType indexType = VK_INDEX_TYPE_UINT16);
+        void *writeVertices(const Range &range, uint32_t stream = 0);
+        // Only for indexed ranges
+        void *writeIndices(const Range &range);
+        // Frames in flight may still read the range, its space is reused MAX_FRAMES_IN_FLIGHT frames later.
+        void free(Range &range);
+        // Called once per frame after its fence was waited on, recycles the ranges that are no longer in use.
+        void nextFrame();
+
+        // Binds stream i to binding i and the index buffer as indexType
+        void bind(VkCommandBuffer commandBuffer, VkIndexType indexType = VK_INDEX_TYPE_UINT16) const;
+        // Switches between the draws of 16 and 32 bit ranges, the vertex buffers stay bound
+        void bindIndices(VkCommandBuffer commandBuffer, VkIndexType indexType) const;
+
+        uint32_t getStreamCount() const { return static_cast<uint32_t>(vertexBuffers.size()); }
+        VkBuffer getVertexBuffer(const uint32_t stream = 0) const { return vertexBuffers[stream]->getBuffer(); }
+        VkBuffer getIndexBuffer() const { return indexBuffer->getBuffer(); }
+        VkDeviceSize getVertexStride(const uint32_t stream = 0) const { return vertexStrides[stream]; }
+
+        // The narrowest type that can index vertexCount vertices. Primitive restart is off, so 16 bit indices
+        // reach all 65536 of theirs.
+        static VkIndexType getIndexType(uint32_t vertexCount);
+        static VkDeviceSize getIndexSize(VkIndexType indexType);
+
+        uint32_t getRangeCount() const { return rangeCount; }
+        VkDeviceSize getUsedBytes() const;
+        VkDeviceSize getCapacityBytes() const;
+
+    private:
+        // Positions and everything else
+        static constexpr size_t MAX_STREAMS = 2;
+
+        struct PendingFree {
+            Range range;
+            uint32_t framesLeft;
+        };
+
+        std::unique_ptr<Buffer> createBuffer(VkDeviceSize elementSize, uint32_t count, VkBufferUsageFlags usage) const;
+        // Replaces the buffer with one that holds at least minimumCount elements, keeping its contents
+        void grow(std::unique_ptr<Buffer> &buffer, uint64_t oldCount, uint64_t newCount, VkDeviceSize elementSize,
+                  VkBufferUsageFlags usage);
+        static uint64_t getGrownCount(const Tlsf &allocator, uint64_t minimumCount);
+        // Bytes of one vertex over all streams
+        VkDeviceSize getVertexSize() const;
+
+        Device &device;
+        std::vector<VkDeviceSize> vertexStrides;
+
+        std::vector<std::unique_ptr<Buffer>> vertexBuffers;
+        std::unique_ptr<Buffer> indexBuffer;
+        Tlsf vertexAllocator;
+        Tlsf indexAllocator;
+
+        std::vector<PendingFree> pendingFrees;
+        uint32_t rangeCount = 0;
+    };
+} // ve
@@ -0,0 +1,319 @@
+#include "memoryAllocator.hpp"
+
+#include "../../log.hpp"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace ve {
+    static VkDeviceSize alignUp(const VkDeviceSize value, const VkDeviceSize alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    MemoryAllocator::MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice) : device(device) {
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        nonCoherentAtomSize = properties.limits.nonCoherentAtomSize;
+
+        constexpr VkDeviceSize largeHeapSize = 1024ull * 1024 * 1024;
+        constexpr VkDeviceSize defaultBlockSize = 64ull * 1024 * 1024;
+
+        pools.resize(memoryProperties.memoryTypeCount * 2);
+        for (uint32_t type = 0; type < memoryProperties.memoryTypeCount; type++) {
+            // Small heaps, like the host visible window into VRAM, get proportionally smaller blocks
+            const VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[type].heapIndex].size;
+            const VkDeviceSize blockSize = heapSize > largeHeapSize ? defaultBlockSize : alignUp(heapSize / 8, 1024);
+
+            pools[type * 2].memoryType = type;
+            pools[type * 2].blockSize = blockSize;
+            pools[type * 2 + 1].memoryType = type;
+            pools[type * 2 + 1].blockSize = blockSize;
+        }
+    }
+
+    MemoryAllocator::~MemoryAllocator() {
+        if (stats.allocationCount > 0) {
+            Log::warning(std::to_string(stats.allocationCount) + " device memory allocations were not freed");
+        }
+
+        for (auto &pool : pools) {
+            for (auto &block : pool.blocks) {
+                if (block == nullptr) {
+                    continue;
+                }
+                if (block->mapped != nullptr) {
+                    vkUnmapMemory(device, block->memory);
+                }
+                vkFreeMemory(device, block->memory, nullptr);
+            }
+        }
+    }
+
+    uint32_t MemoryAllocator::findMemoryType(const uint32_t typeFilter, const VkMemoryPropertyFlags properties) const {
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+            if ((typeFilter & (1 << i)) &&
+                (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+                return i;
+            }
+        }
+
+        Log::error("Failed to find suitable memory type!");
+        throw std::runtime_error("");
+    }
+
+    VkDeviceMemory MemoryAllocator::allocateDeviceMemory(const VkDeviceSize size, const uint32_t memoryType, const void *next, void **mapped) {
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.pNext = next;
+        allocInfo.allocationSize = size;
+        allocInfo.memoryTypeIndex = memoryType;
+
+        VkDeviceMemory memory;
+        if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+            return VK_NULL_HANDLE;
+        }
+
+        *mapped = nullptr;
+        if (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+            if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+                vkFreeMemory(device, memory, nullptr);
+                Log::error("Failed to map device memory!");
+                throw std::runtime_error("");
+            }
+        }
+
+        stats.deviceMemoryCount++;
+        stats.reservedBytes += size;
+        return memory;
+    }
+
+    Allocation MemoryAllocator::allocateForBuffer(VkBuffer buffer, const VkMemoryPropertyFlags properties) {
+        VkBufferMemoryRequirementsInfo2 requirementsInfo{};
+        requirementsInfo.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+        requirementsInfo.buffer = buffer;
+
+        VkMemoryDedicatedRequirements dedicatedRequirements{};
+        dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+        VkMemoryRequirements2 requirements{};
+        requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+        requirements.pNext = &dedicatedRequirements;
+
+        vkGetBufferMemoryRequirements2(device, &requirementsInfo, &requirements);
+
+        const bool dedicated = dedicatedRequirements.requiresDedicatedAllocation || dedicatedRequirements.prefersDedicatedAllocation;
+        Allocation allocation = allocate(requirements.memoryRequirements, dedicated, true, properties, buffer, VK_NULL_HANDLE);
+
+        if (vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS) {
+            Log::error("Failed to bind buffer memory!");
+            throw std::runtime_error("");
+        }
+        return allocation;
+    }
+
+    Allocation MemoryAllocator::allocateForImage(VkImage image, const VkImageTiling tiling, const VkMemoryPropertyFlags properties) {
+        VkImageMemoryRequirementsInfo2 requirementsInfo{};
+        requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+        requirementsInfo.image = image;
+
+        VkMemoryDedicatedRequirements dedicatedRequirements{};
+        dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+        VkMemoryRequirements2 requirements{};
+        requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+        requirements.pNext = &dedicatedRequirements;
+
+        vkGetImageMemoryRequirements2(device, &requirementsInfo, &requirements);
+
+        const bool dedicated = dedicatedRequirements.requiresDedicatedAllocation || dedicatedRequirements.prefersDedicatedAllocation;
+        Allocation allocation = allocate(requirements.memoryRequirements, dedicated, tiling == VK_IMAGE_TILING_LINEAR,
+                                         properties, VK_NULL_HANDLE, image);
+
+        if (vkBindImageMemory(device, image, allocation.memory, allocation.offset) != VK_SUCCESS) {
+            Log::error("Failed to bind image memory!");
+            throw std::runtime_error("");
+        }
+        return allocation;
+    }
+
+    Allocation MemoryAllocator::allocate(const VkMemoryRequirements &requirements, const bool dedicated, const bool linear,
+                                         const VkMemoryPropertyFlags properties, VkBuffer buffer, VkImage image) {
+        const uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+        const VkMemoryPropertyFlags propertyFlags = memoryProperties.memoryTypes[memoryType].propertyFlags;
+
+        // Keep non-coherent allocations on whole atoms, so flushing one never touches its neighbours
+        VkDeviceSize alignment = requirements.alignment;
+        VkDeviceSize size = requirements.size;
+        if ((propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+            alignment = std::max(alignment, nonCoherentAtomSize);
+            size = alignUp(size, nonCoherentAtomSize);
+        }
+
+        std::lock_guard lock(mutex);
+
+        const uint32_t poolIndex = memoryType * 2 + (linear ? 0 : 1);
+        Pool &pool = pools[poolIndex];
+
+        if (dedicated || size > pool.blockSize / 2) {
+            Allocation allocation = allocateDedicated(size, memoryType, buffer, image);
+            allocation.pool = poolIndex;
+            return allocation;
+        }
+
+        Allocation allocation{};
+        allocation.size = size;
+        allocation.propertyFlags = propertyFlags;
+        allocation.pool = poolIndex;
+
+        for (uint32_t i = 0; i < pool.blocks.size(); i++) {
+            Block *block = pool.blocks[i].get();
+            if (block == nullptr || block->allocator.getFreeSize() < size) {
+                continue;
+            }
+
+            allocation.range = block->allocator.allocate(size, alignment);
+            if (allocation.range.isValid()) {
+                allocation.block = i;
+                break;
+            }
+        }
+
+        if (!allocation.range.isValid()) {
+            // Fall back to smaller blocks when the heap is running out
+            VkDeviceSize blockSize = pool.blockSize;
+            void *mapped = nullptr;
+            VkDeviceMemory memory = allocateDeviceMemory(blockSize, memoryType, nullptr, &mapped);
+            while (memory == VK_NULL_HANDLE && blockSize / 2 >= size) {
+                blockSize /= 2;
+                memory = allocateDeviceMemory(blockSize, memoryType, nullptr, &mapped);
+            }
+            if (memory == VK_NULL_HANDLE) {
+                Log::error("Failed to allocate device memory block!");
+                throw std::runtime_error("");
+            }
+
+            auto block = std::unique_ptr<Block>(new Block{ memory, mapped, Tlsf(blockSize) });
+            allocation.range = block->allocator.allocate(size, alignment);
+            stats.blockCount++;
+
+            auto slot = std::find(pool.blocks.begin(), pool.blocks.end(), nullptr);
+            if (slot == pool.blocks.end()) {
+                slot = pool.blocks.insert(pool.blocks.end(), nullptr);
+            }
+            *slot = std::move(block);
+            allocation.block = static_cast<uint32_t>(slot - pool.blocks.begin());
+        }
+
+        const Block &block = *pool.blocks[allocation.block];
+        allocation.memory = block.memory;
+        allocation.offset = allocation.range.offset;
+        allocation.mapped = block.mapped != nullptr ? static_cast<char *>(block.mapped) + allocation.offset : nullptr;
+
+        stats.allocationCount++;
+        stats.usedBytes += size;
+        return allocation;
+    }
+
+    Allocation MemoryAllocator::allocateDedicated(const VkDeviceSize size, const uint32_t memoryType, VkBuffer buffer, VkImage image) {
+        VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+        dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+        dedicatedInfo.buffer = buffer;
+        dedicatedInfo.image = image;
+
+        Allocation allocation{};
+        allocation.size = size;
+        allocation.propertyFlags = memoryProperties.memoryTypes[memoryType].propertyFlags;
+        allocation.dedicated = true;
+        allocation.memory = allocateDeviceMemory(size, memoryType, &dedicatedInfo, &allocation.mapped);
+        if (allocation.memory == VK_NULL_HANDLE) {
+            Log::error("Failed to allocate dedicated device memory!");
+            throw std::runtime_error("");
+        }
+
+        stats.dedicatedCount++;
+        stats.allocationCount++;
+        stats.usedBytes += size;
+        return allocation;
+    }
+
+    void MemoryAllocator::free(Allocation &allocation) {
+        if (allocation.memory == VK_NULL_HANDLE) {
+            return;
+        }
+
+        std::lock_guard lock(mutex);
+
+        stats.allocationCount--;
+        stats.usedBytes -= allocation.size;
+
+        if (allocation.dedicated) {
+            if (allocation.mapped != nullptr) {
+                vkUnmapMemory(device, allocation.memory);
+            }
+            vkFreeMemory(device, allocation.memory, nullptr);
+
+            stats.dedicatedCount--;
+            stats.deviceMemoryCount--;
+            stats.reservedBytes -= allocation.size;
+            allocation = {};
+            return;
+        }
+
+        Pool &pool = pools[allocation.pool];
+        std::unique_ptr<Block> &block = pool.blocks[allocation.block];
+        block->allocator.free(allocation.range);
+
+        // Keep one empty block around per pool so loading and unloading doesn't thrash vkAllocateMemory
+        const auto liveBlocks = std::count_if(pool.blocks.begin(), pool.blocks.end(), [](const auto &b) { return b != nullptr; });
+        if (block->allocator.isEmpty() && liveBlocks > 1) {
+            if (block->mapped != nullptr) {
+                vkUnmapMemory(device, block->memory);
+            }
+            vkFreeMemory(device, block->memory, nullptr);
+
+            stats.blockCount--;
+            stats.deviceMemoryCount--;
+            stats.reservedBytes -= block->allocator.getSize();
+            block.reset();
+        }
+
+        allocation = {};
+    }
+
+    VkMappedMemoryRange MemoryAllocator::getMappedRange(const Allocation &allocation, const VkDeviceSize offset, const VkDeviceSize size) const {
+        const VkDeviceSize start = allocation.offset + offset;
+        const VkDeviceSize end = size == VK_WHOLE_SIZE ? allocation.offset + allocation.size : start + size;
+
+        VkMappedMemoryRange range{};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = allocation.memory;
+        range.offset = start & ~(nonCoherentAtomSize - 1);
+        range.size = alignUp(end, nonCoherentAtomSize) - range.offset;
+        return range;
+    }
+
+    VkResult MemoryAllocator::flush(const Allocation &allocation, const VkDeviceSize offset, const VkDeviceSize size) const {
+        if (allocation.propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) {
+            return VK_SUCCESS;
+        }
+        const VkMappedMemoryRange range = getMappedRange(allocation, offset, size);
+        return vkFlushMappedMemoryRanges(device, 1, &range);
+    }
+
+    VkResult MemoryAllocator::invalidate(const Allocation &allocation, const VkDeviceSize offset, const VkDeviceSize size) const {
+        if (allocation.propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) {
+            return VK_SUCCESS;
+        }
+        const VkMappedMemoryRange range = getMappedRange(allocation, offset, size);
+        return vkInvalidateMappedMemoryRanges(device, 1, &range);
+    }
+
+    MemoryAllocator::Stats MemoryAllocator::getStats() const {
+        std::lock_guard lock(mutex);
+        return stats;
+    }
+} // ve
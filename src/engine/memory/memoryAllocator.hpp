@@ -0,0 +1,93 @@
+#pragma once
+
+#include "tlsf.hpp"
+
+// vendor
+#include <vulkan/vulkan.h>
+
+// std
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ve {
+    // A range of device memory handed out by MemoryAllocator
+    struct Allocation {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        // Points at offset for host visible memory, blocks stay mapped for as long as they live
+        void *mapped = nullptr;
+        VkMemoryPropertyFlags propertyFlags = 0;
+
+        uint32_t pool = 0;
+        uint32_t block = 0;
+        Tlsf::Allocation range{};
+        bool dedicated = false;
+    };
+
+    // Sub-allocates buffers and images from large device memory blocks instead of calling
+    // vkAllocateMemory per resource. Each memory type gets one pool for linear resources (buffers)
+    // and one for optimally tiled images, so neighbours in a block never violate bufferImageGranularity.
+    // Large resources, and the ones the driver asks for, get dedicated allocations.
+    class MemoryAllocator {
+    public:
+        struct Stats {
+            // Live vkAllocateMemory objects, blocks plus dedicated allocations
+            uint32_t deviceMemoryCount = 0;
+            uint32_t blockCount = 0;
+            uint32_t dedicatedCount = 0;
+            uint32_t allocationCount = 0;
+            VkDeviceSize reservedBytes = 0;
+            VkDeviceSize usedBytes = 0;
+        };
+
+        MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice);
+        ~MemoryAllocator();
+
+        MemoryAllocator(const MemoryAllocator &) = delete;
+        MemoryAllocator &operator=(const MemoryAllocator &) = delete;
+
+        // Allocate and bind memory for the resource
+        Allocation allocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties);
+        Allocation allocateForImage(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags properties);
+        void free(Allocation &allocation);
+
+        // Offsets are relative to the allocation, no-ops for coherent memory
+        VkResult flush(const Allocation &allocation, VkDeviceSize offset, VkDeviceSize size) const;
+        VkResult invalidate(const Allocation &allocation, VkDeviceSize offset, VkDeviceSize size) const;
+
+        Stats getStats() const;
+
+    private:
+        struct Block {
+            VkDeviceMemory memory;
+            void *mapped;
+            Tlsf allocator;
+        };
+
+        struct Pool {
+            uint32_t memoryType;
+            VkDeviceSize blockSize;
+            // Freed blocks leave a null entry so the indices of live allocations stay valid
+            std::vector<std::unique_ptr<Block>> blocks{};
+        };
+
+        Allocation allocate(const VkMemoryRequirements &requirements, bool dedicated, bool linear,
+                            VkMemoryPropertyFlags properties, VkBuffer buffer, VkImage image);
+        Allocation allocateDedicated(VkDeviceSize size, uint32_t memoryType, VkBuffer buffer, VkImage image);
+        VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, const void *next, void **mapped);
+        uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+        VkMappedMemoryRange getMappedRange(const Allocation &allocation, VkDeviceSize offset, VkDeviceSize size) const;
+
+        VkDevice device;
+        VkPhysicalDeviceMemoryProperties memoryProperties{};
+        VkDeviceSize nonCoherentAtomSize;
+
+        // Indexed by memory type * 2, +1 for optimally tiled images
+        std::vector<Pool> pools{};
+
+        mutable std::mutex mutex;
+        Stats stats{};
+    };
+} // ve
@@ -0,0 +1,289 @@
+#include "tlsf.hpp"
+
+#include "../../log.hpp"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+
+namespace ve {
+    static uint32_t mostSignificantBit(const uint64_t value) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return static_cast<uint32_t>(index);
+#else
+        return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+    }
+
+    static uint32_t leastSignificantBit(const uint64_t value) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward64(&index, value);
+        return static_cast<uint32_t>(index);
+#else
+        return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+    }
+
+    Tlsf::Tlsf(const uint64_t size) : size(size), freeSize(size) {
+        if (size == 0) {
+            Log::error("Cannot create an empty TLSF allocator");
+            throw std::runtime_error("");
+        }
+
+        for (auto &lists : freeLists) {
+            std::fill(std::begin(lists), std::end(lists), NO_NODE);
+        }
+
+        lastPhysical = createNode(0, size);
+        insertFree(lastPhysical);
+    }
+
+    void Tlsf::mapping(const uint64_t size, uint32_t &firstLevel, uint32_t &secondLevel) {
+        if (size < SECOND_LEVEL_COUNT) {
+            firstLevel = 0;
+            secondLevel = static_cast<uint32_t>(size);
+            return;
+        }
+
+        const uint32_t msb = mostSignificantBit(size);
+        firstLevel = msb - SECOND_LEVEL_BITS + 1;
+        secondLevel = static_cast<uint32_t>(size >> (msb - SECOND_LEVEL_BITS)) - SECOND_LEVEL_COUNT;
+    }
+
+    uint32_t Tlsf::createNode(const uint64_t offset, const uint64_t size) {
+        uint32_t node;
+        if (!unusedNodes.empty()) {
+            node = unusedNodes.back();
+            unusedNodes.pop_back();
+            nodes[node] = Node{};
+        } else {
+            node = static_cast<uint32_t>(nodes.size());
+            nodes.emplace_back();
+        }
+
+        nodes[node].offset = offset;
+        nodes[node].size = size;
+        return node;
+    }
+
+    void Tlsf::destroyNode(const uint32_t node) {
+        unusedNodes.push_back(node);
+    }
+
+    void Tlsf::insertFree(const uint32_t node) {
+        uint32_t firstLevel, secondLevel;
+        mapping(nodes[node].size, firstLevel, secondLevel);
+
+        const uint32_t head = freeLists[firstLevel][secondLevel];
+        nodes[node].previousFree = NO_NODE;
+        nodes[node].nextFree = head;
+        if (head != NO_NODE) {
+            nodes[head].previousFree = node;
+        }
+        freeLists[firstLevel][secondLevel] = node;
+
+        firstLevelBitmap |= 1ull << firstLevel;
+        secondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+    }
+
+    void Tlsf::removeFree(const uint32_t node) {
+        const Node &n = nodes[node];
+        if (n.previousFree != NO_NODE) {
+            nodes[n.previousFree].nextFree = n.nextFree;
+        }
+        if (n.nextFree != NO_NODE) {
+            nodes[n.nextFree].previousFree = n.previousFree;
+        }
+
+        uint32_t firstLevel, secondLevel;
+        mapping(n.size, firstLevel, secondLevel);
+        if (freeLists[firstLevel][secondLevel] == node) {
+            freeLists[firstLevel][secondLevel] = n.nextFree;
+            if (n.nextFree == NO_NODE) {
+                secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+                if (secondLevelBitmaps[firstLevel] == 0) {
+                    firstLevelBitmap &= ~(1ull << firstLevel);
+                }
+            }
+        }
+    }
+
+    uint32_t Tlsf::findFree(uint64_t size) const {
+        // Round up to the next size class, so any block in the bin found is large enough
+        if (size >= SECOND_LEVEL_COUNT) {
+            const uint64_t round = (1ull << (mostSignificantBit(size) - SECOND_LEVEL_BITS)) - 1;
+            if (size > ~0ull - round) {
+                return NO_NODE;
+            }
+            size += round;
+        }
+
+        uint32_t firstLevel, secondLevel;
+        mapping(size, firstLevel, secondLevel);
+
+        uint32_t secondLevelMap = secondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+        if (secondLevelMap == 0) {
+            const uint64_t firstLevelMap = firstLevel + 1 < 64 ? firstLevelBitmap & (~0ull << (firstLevel + 1)) : 0;
+            if (firstLevelMap == 0) {
+                return NO_NODE;
+            }
+            firstLevel = leastSignificantBit(firstLevelMap);
+            secondLevelMap = secondLevelBitmaps[firstLevel];
+        }
+
+        return freeLists[firstLevel][leastSignificantBit(secondLevelMap)];
+    }
+
+    uint32_t Tlsf::searchBin(const uint64_t size) const {
+        uint32_t firstLevel, secondLevel;
+        mapping(size, firstLevel, secondLevel);
+
+        for (uint32_t node = freeLists[firstLevel][secondLevel]; node != NO_NODE; node = nodes[node].nextFree) {
+            if (nodes[node].size >= size) {
+                return node;
+            }
+        }
+        return NO_NODE;
+    }
+
+    void Tlsf::splitTail(const uint32_t node, const uint64_t size) {
+        const uint64_t remainder = nodes[node].size - size;
+        if (remainder == 0) {
+            return;
+        }
+
+        const uint32_t tail = createNode(nodes[node].offset + size, remainder);
+        nodes[tail].previousPhysical = node;
+        nodes[tail].nextPhysical = nodes[node].nextPhysical;
+        if (nodes[tail].nextPhysical != NO_NODE) {
+            nodes[nodes[tail].nextPhysical].previousPhysical = tail;
+        } else {
+            lastPhysical = tail;
+        }
+        nodes[node].nextPhysical = tail;
+        nodes[node].size = size;
+
+        insertFree(tail);
+    }
+
+    Tlsf::Allocation Tlsf::allocate(const uint64_t size, const uint64_t alignment) {
+        if (size == 0 || size > freeSize) {
+            return {};
+        }
+
+        const uint64_t padded = size + alignment - 1;
+        uint32_t node = findFree(padded);
+        if (node == NO_NODE) {
+            node = searchBin(padded);
+        }
+        if (node == NO_NODE) {
+            return {};
+        }
+        removeFree(node);
+
+        // Alignment padding in front becomes its own free block, the previous block is used or absent
+        const uint64_t offset = nodes[node].offset;
+        const uint64_t alignedOffset = (offset + alignment - 1) & ~(alignment - 1);
+        if (alignedOffset != offset) {
+            const uint32_t front = createNode(offset, alignedOffset - offset);
+            nodes[front].previousPhysical = nodes[node].previousPhysical;
+            nodes[front].nextPhysical = node;
+            if (nodes[front].previousPhysical != NO_NODE) {
+                nodes[nodes[front].previousPhysical].nextPhysical = front;
+            }
+            nodes[node].previousPhysical = front;
+            nodes[node].offset = alignedOffset;
+            nodes[node].size -= alignedOffset - offset;
+            insertFree(front);
+        }
+
+        splitTail(node, size);
+
+        nodes[node].used = true;
+        freeSize -= size;
+        allocationCount++;
+
+        return { alignedOffset, size, node };
+    }
+
+    void Tlsf::free(const Allocation &allocation) {
+        if (!allocation.isValid() || !nodes[allocation.node].used) {
+            Log::error("Freeing an invalid TLSF allocation");
+            throw std::runtime_error("");
+        }
+
+        uint32_t node = allocation.node;
+        nodes[node].used = false;
+        freeSize += nodes[node].size;
+        allocationCount--;
+
+        const uint32_t next = nodes[node].nextPhysical;
+        if (next != NO_NODE && !nodes[next].used) {
+            removeFree(next);
+            nodes[node].size += nodes[next].size;
+            nodes[node].nextPhysical = nodes[next].nextPhysical;
+            if (nodes[node].nextPhysical != NO_NODE) {
+                nodes[nodes[node].nextPhysical].previousPhysical = node;
+            } else {
+                lastPhysical = node;
+            }
+            destroyNode(next);
+        }
+
+        const uint32_t previous = nodes[node].previousPhysical;
+        if (previous != NO_NODE && !nodes[previous].used) {
+            removeFree(previous);
+            nodes[previous].size += nodes[node].size;
+            nodes[previous].nextPhysical = nodes[node].nextPhysical;
+            if (nodes[previous].nextPhysical != NO_NODE) {
+                nodes[nodes[previous].nextPhysical].previousPhysical = previous;
+            } else {
+                lastPhysical = previous;
+            }
+            destroyNode(node);
+            node = previous;
+        }
+
+        insertFree(node);
+    }
+
+    void Tlsf::grow(const uint64_t newSize) {
+        if (newSize <= size) {
+            return;
+        }
+
+        const uint64_t extra = newSize - size;
+        if (!nodes[lastPhysical].used) {
+            removeFree(lastPhysical);
+            nodes[lastPhysical].size += extra;
+            insertFree(lastPhysical);
+        } else {
+            const uint32_t tail = createNode(size, extra);
+            nodes[tail].previousPhysical = lastPhysical;
+            nodes[lastPhysical].nextPhysical = tail;
+            lastPhysical = tail;
+            insertFree(tail);
+        }
+
+        size = newSize;
+        freeSize += extra;
+    }
+
+    uint64_t Tlsf::getLargestFreeBlock() const {
+        if (firstLevelBitmap == 0) {
+            return 0;
+        }
+
+        const uint32_t firstLevel = mostSignificantBit(firstLevelBitmap);
+        const uint32_t secondLevel = mostSignificantBit(secondLevelBitmaps[firstLevel]);
+
+        uint64_t largest = 0;
+        for (uint32_t node = freeLists[firstLevel][secondLevel]; node != NO_NODE; node = nodes[node].nextFree) {
+            largest = std::max(largest, nodes[node].size);
+        }
+        return largest;
+    }
+} // ve
@@ -0,0 +1,80 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace ve {
+    // Two-level segregated fit allocator over an abstract range of offsets [0, size). It never touches
+    // the memory it manages, so it can sub-allocate device memory blocks as well as buffer ranges.
+    // Allocation and free are O(1): free blocks are binned by size class, found with two bitmap
+    // scans and coalesced with their physical neighbours on free.
+    class Tlsf {
+    public:
+        static constexpr uint32_t NO_NODE = ~0u;
+
+        struct Allocation {
+            uint64_t offset = 0;
+            uint64_t size = 0;
+            uint32_t node = NO_NODE;
+
+            bool isValid() const { return node != NO_NODE; }
+        };
+
+        explicit Tlsf(uint64_t size);
+
+        // Returns an invalid allocation when no free block fits. Alignment has to be a power of two.
+        Allocation allocate(uint64_t size, uint64_t alignment = 1);
+        void free(const Allocation &allocation);
+        // Extends the managed range to [0, newSize), existing allocations keep their offsets.
+        void grow(uint64_t newSize);
+
+        uint64_t getSize() const { return size; }
+        uint64_t getFreeSize() const { return freeSize; }
+        uint64_t getLargestFreeBlock() const;
+        uint32_t getAllocationCount() const { return allocationCount; }
+        bool isEmpty() const { return allocationCount == 0; }
+
+    private:
+        static constexpr uint32_t SECOND_LEVEL_BITS = 4;
+        static constexpr uint32_t SECOND_LEVEL_COUNT = 1u << SECOND_LEVEL_BITS;
+        static constexpr uint32_t FIRST_LEVEL_COUNT = 64 - SECOND_LEVEL_BITS + 1;
+
+        struct Node {
+            uint64_t offset;
+            uint64_t size;
+            // Neighbours by address
+            uint32_t previousPhysical = NO_NODE;
+            uint32_t nextPhysical = NO_NODE;
+            // Neighbours in the free list of the node's bin
+            uint32_t previousFree = NO_NODE;
+            uint32_t nextFree = NO_NODE;
+            bool used = false;
+        };
+
+        static void mapping(uint64_t size, uint32_t &firstLevel, uint32_t &secondLevel);
+
+        uint32_t createNode(uint64_t offset, uint64_t size);
+        void destroyNode(uint32_t node);
+        void insertFree(uint32_t node);
+        void removeFree(uint32_t node);
+        uint32_t findFree(uint64_t size) const;
+        // Slow path for requests close to the largest free block, which rounding up would skip
+        uint32_t searchBin(uint64_t size) const;
+        // Splits the tail of a node off into a new free node
+        void splitTail(uint32_t node, uint64_t size);
+
+        uint64_t size;
+        uint64_t freeSize;
+        uint32_t allocationCount = 0;
+        // Block ending at size, the one grow() extends
+        uint32_t lastPhysical = NO_NODE;
+
+        std::vector<Node> nodes{};
+        std::vector<uint32_t> unusedNodes{};
+
+        uint64_t firstLevelBitmap = 0;
+        uint32_t secondLevelBitmaps[FIRST_LEVEL_COUNT]{};
+        uint32_t freeLists[FIRST_LEVEL_COUNT][SECOND_LEVEL_COUNT];
+    };
+} // ve
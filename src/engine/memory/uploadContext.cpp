@@ -0,0 +1,480 @@
+#include "uploadContext.hpp"
+
+#include "../device.hpp"
+#include "../profiling/cpuProfiler.hpp"
+#include "../../log.hpp"
+
+// std
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace ve {
+    UploadContext::UploadContext(Device &device, const VkDeviceSize stagingSize)
+        : device(device), stagingSize(stagingSize) {
+        stagingAlignment = std::max<VkDeviceSize>(16, device.properties.limits.optimalBufferCopyOffsetAlignment);
+
+        device.createBuffer(
+                stagingSize,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                stagingBuffer,
+                stagingAllocation);
+
+        const QueueFamilyIndices indices = device.getQueueFamilyIndices();
+        graphicsFamily = indices.graphicsFamily;
+        createCommandPool(graphicsCommands, graphicsFamily);
+        semaphore = createTimeline();
+
+        if (device.hasTransferQueue()) {
+            transferFamily = indices.transferFamily;
+            createCommandPool(transferCommands, transferFamily);
+            transferSemaphore = createTimeline();
+            Log::info("Uploading through the transfer queue family " + std::to_string(transferFamily));
+        } else {
+            transferFamily = graphicsFamily;
+        }
+    }
+
+    UploadContext::~UploadContext() {
+        wait(flush());
+
+        vkDestroySemaphore(device.getDevice(), semaphore, nullptr);
+        // Destroying the pools frees their command buffers
+        vkDestroyCommandPool(device.getDevice(), graphicsCommands.commandPool, nullptr);
+        if (usesTransferQueue()) {
+            vkDestroySemaphore(device.getDevice(), transferSemaphore, nullptr);
+            vkDestroyCommandPool(device.getDevice(), transferCommands.commandPool, nullptr);
+        }
+        vkDestroyBuffer(device.getDevice(), stagingBuffer, nullptr);
+        device.getAllocator().free(stagingAllocation);
+    }
+
+    void UploadContext::createCommandPool(CommandBuffers &commandBuffers, const uint32_t queueFamily) {
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = queueFamily;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+        if (vkCreateCommandPool(device.getDevice(), &poolInfo, nullptr, &commandBuffers.commandPool) != VK_SUCCESS) {
+            Log::error("Failed to create upload command pool!");
+            throw std::runtime_error("");
+        }
+    }
+
+    VkSemaphore UploadContext::createTimeline() {
+        VkSemaphoreTypeCreateInfo typeInfo{};
+        typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        typeInfo.initialValue = 0;
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreInfo.pNext = &typeInfo;
+
+        VkSemaphore timeline;
+        if (vkCreateSemaphore(device.getDevice(), &semaphoreInfo, nullptr, &timeline) != VK_SUCCESS) {
+            Log::error("Failed to create upload timeline semaphore!");
+            throw std::runtime_error("");
+        }
+        return timeline;
+    }
+
+    VkCommandBuffer UploadContext::getCommandBuffer(CommandBuffers &commandBuffers) {
+        if (commandBuffers.recording != VK_NULL_HANDLE) {
+            return commandBuffers.recording;
+        }
+
+        reclaim();
+        if (commandBuffers.free.empty()) {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandPool = commandBuffers.commandPool;
+            allocInfo.commandBufferCount = 1;
+
+            VkCommandBuffer commandBuffer;
+            if (vkAllocateCommandBuffers(device.getDevice(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+                Log::error("Failed to allocate upload command buffer!");
+                throw std::runtime_error("");
+            }
+            commandBuffers.free.push_back(commandBuffer);
+        }
+
+        VkCommandBuffer commandBuffer = commandBuffers.free.back();
+        commandBuffers.free.pop_back();
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+            Log::error("Failed to begin recording upload command buffer!");
+            throw std::runtime_error("");
+        }
+        commandBuffers.recording = commandBuffer;
+        return commandBuffer;
+    }
+
+    VkCommandBuffer UploadContext::getTransferCommandBuffer() {
+        return getCommandBuffer(usesTransferQueue() ? transferCommands : graphicsCommands);
+    }
+
+    bool UploadContext::tryAllocate(const VkDeviceSize size, VkDeviceSize &offset) {
+        if (stagingRegions.empty()) {
+            stagingHead = 0;
+        }
+
+        const VkDeviceSize head = (stagingHead + stagingAlignment - 1) / stagingAlignment * stagingAlignment;
+        if (stagingRegions.empty() || stagingHead > stagingRegions.front().begin) {
+            // Free space runs from the head to the end of the ring, then from its start to the oldest region
+            const VkDeviceSize tail = stagingRegions.empty() ? 0 : stagingRegions.front().begin;
+            if (head + size <= stagingSize) {
+                offset = head;
+            } else if (size <= tail) {
+                offset = 0;
+            } else {
+                return false;
+            }
+        } else {
+            // Wrapped around, free space runs from the head to the oldest region
+            if (head + size > stagingRegions.front().begin) {
+                return false;
+            }
+            offset = head;
+        }
+
+        stagingHead = offset + size;
+        stagingRegions.push_back({offset, offset + size, nextValue});
+        return true;
+    }
+
+    UploadContext::Staging UploadContext::stage(const VkDeviceSize size) {
+        if (size > stagingSize) {
+            DedicatedStaging staging{VK_NULL_HANDLE, {}, nextValue};
+            device.createBuffer(
+                    size,
+                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                    staging.buffer,
+                    staging.allocation);
+            dedicatedStaging.push_back(staging);
+            return {staging.buffer, 0, staging.allocation.mapped};
+        }
+
+        VkDeviceSize offset;
+        while (!tryAllocate(size, offset)) {
+            VE_PROFILE_SCOPE("UploadContext::waitForStaging");
+            // The ring is full, the oldest region has to be read before its space comes back
+            if (stagingRegions.front().value == nextValue) {
+                flush();
+            }
+            wait(stagingRegions.front().value);
+        }
+
+        return {stagingBuffer, offset, static_cast<uint8_t *>(stagingAllocation.mapped) + offset};
+    }
+
+    void UploadContext::uploadBuffer(
+            VkBuffer buffer, const VkDeviceSize offset, const void *data, const VkDeviceSize size) {
+        if (size == 0) {
+            return;
+        }
+        std::memcpy(writeBuffer(buffer, offset, size), data, size);
+    }
+
+    void *UploadContext::writeBuffer(VkBuffer buffer, const VkDeviceSize offset, const VkDeviceSize size) {
+        const Staging staging = stage(size);
+
+        VkBufferCopy copyRegion{};
+        copyRegion.srcOffset = staging.offset;
+        copyRegion.dstOffset = offset;
+        copyRegion.size = size;
+        vkCmdCopyBuffer(getTransferCommandBuffer(), staging.buffer, buffer, 1, &copyRegion);
+
+        if (usesTransferQueue()) {
+            VkBufferMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.srcQueueFamilyIndex = transferFamily;
+            barrier.dstQueueFamilyIndex = graphicsFamily;
+            barrier.buffer = buffer;
+            barrier.offset = offset;
+            barrier.size = size;
+            bufferTransfers.push_back(barrier);
+        }
+        return staging.mapped;
+    }
+
+    void UploadContext::copyBuffer(
+            VkBuffer srcBuffer, VkBuffer dstBuffer, const VkDeviceSize size, const VkDeviceSize srcOffset,
+            const VkDeviceSize dstOffset) {
+        if (usesTransferQueue()) {
+            // Uploads recorded so far have to be acquired by the graphics queue before the copy touches them
+            flush();
+        }
+        VkCommandBuffer commandBuffer = getCommandBuffer(graphicsCommands);
+
+        // The source may have been written by an upload earlier in this batch
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(
+                commandBuffer,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0,
+                1,
+                &barrier,
+                0,
+                nullptr,
+                0,
+                nullptr);
+
+        VkBufferCopy copyRegion{};
+        copyRegion.srcOffset = srcOffset;
+        copyRegion.dstOffset = dstOffset;
+        copyRegion.size = size;
+        vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+
+        if (usesTransferQueue()) {
+            // Uploads recorded next would run on the transfer queue ahead of the copy
+            flush();
+        }
+    }
+
+    void UploadContext::uploadImage(
+            VkImage image, const VkExtent3D extent, const uint32_t mipLevels, const uint32_t layerCount,
+            const void *pixels, const VkDeviceSize size) {
+        const Staging staging = stage(size);
+        std::memcpy(staging.mapped, pixels, size);
+        const VkBuffer srcBuffer = staging.buffer;
+        const VkDeviceSize srcOffset = staging.offset;
+        VkCommandBuffer commandBuffer = getTransferCommandBuffer();
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = mipLevels;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = layerCount;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(
+                commandBuffer,
+                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0,
+                0,
+                nullptr,
+                0,
+                nullptr,
+                1,
+                &barrier);
+
+        VkBufferImageCopy region{};
+        region.bufferOffset = srcOffset;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = layerCount;
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = extent;
+        vkCmdCopyBufferToImage(commandBuffer, srcBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        if (usesTransferQueue()) {
+            // The layout changes as part of the ownership transfer
+            barrier.srcQueueFamilyIndex = transferFamily;
+            barrier.dstQueueFamilyIndex = graphicsFamily;
+            imageTransfers.push_back(barrier);
+            return;
+        }
+        vkCmdPipelineBarrier(
+                commandBuffer,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0,
+                0,
+                nullptr,
+                0,
+                nullptr,
+                1,
+                &barrier);
+    }
+
+    uint64_t UploadContext::flush() {
+        VkCommandBuffer transferCommandBuffer = transferCommands.recording;
+        if (transferCommandBuffer == VK_NULL_HANDLE && graphicsCommands.recording == VK_NULL_HANDLE) {
+            return nextValue - 1;
+        }
+        VE_PROFILE_SCOPE("UploadContext::flush");
+        const uint64_t value = nextValue;
+
+        if (transferCommandBuffer != VK_NULL_HANDLE) {
+            // Release, the destination half of the barriers is recorded by the acquire
+            vkCmdPipelineBarrier(
+                    transferCommandBuffer,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                    0,
+                    0,
+                    nullptr,
+                    static_cast<uint32_t>(bufferTransfers.size()),
+                    bufferTransfers.data(),
+                    static_cast<uint32_t>(imageTransfers.size()),
+                    imageTransfers.data());
+            submit(device.getTransferQueue(), transferCommandBuffer, transferSemaphore, value, VK_NULL_HANDLE);
+            transferCommands.recording = VK_NULL_HANDLE;
+
+            // Acquire, the source access was made available by the release
+            for (auto &barrier : bufferTransfers) {
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+            }
+            for (auto &barrier : imageTransfers) {
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            }
+            vkCmdPipelineBarrier(
+                    getCommandBuffer(graphicsCommands),
+                    VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                    VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                    0,
+                    0,
+                    nullptr,
+                    static_cast<uint32_t>(bufferTransfers.size()),
+                    bufferTransfers.data(),
+                    static_cast<uint32_t>(imageTransfers.size()),
+                    imageTransfers.data());
+            bufferTransfers.clear();
+            imageTransfers.clear();
+        }
+
+        // Makes the copies visible to everything submitted after the batch
+        VkCommandBuffer graphicsCommandBuffer = graphicsCommands.recording;
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        vkCmdPipelineBarrier(
+                graphicsCommandBuffer,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                0,
+                1,
+                &barrier,
+                0,
+                nullptr,
+                0,
+                nullptr);
+
+        submit(device.getGraphicsQueue(), graphicsCommandBuffer, semaphore, value,
+               transferCommandBuffer != VK_NULL_HANDLE ? transferSemaphore : VK_NULL_HANDLE);
+        graphicsCommands.recording = VK_NULL_HANDLE;
+
+        submitted.push_back({transferCommandBuffer, graphicsCommandBuffer, value});
+        nextValue++;
+        return value;
+    }
+
+    void UploadContext::submit(VkQueue queue, VkCommandBuffer commandBuffer, VkSemaphore signal, const uint64_t value,
+                               VkSemaphore wait) {
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            Log::error("Failed to record upload command buffer!");
+            throw std::runtime_error("");
+        }
+
+        // The transfer semaphore reaches the same value as the one the batch signals
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = wait != VK_NULL_HANDLE ? 1 : 0;
+        timelineInfo.pWaitSemaphoreValues = &value;
+        timelineInfo.signalSemaphoreValueCount = 1;
+        timelineInfo.pSignalSemaphoreValues = &value;
+
+        constexpr VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.waitSemaphoreCount = wait != VK_NULL_HANDLE ? 1 : 0;
+        submitInfo.pWaitSemaphores = &wait;
+        submitInfo.pWaitDstStageMask = &waitStage;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &signal;
+
+        if (vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            Log::error("Failed to submit upload command buffer!");
+            throw std::runtime_error("");
+        }
+    }
+
+    void UploadContext::wait(const uint64_t value) {
+        if (value == nextValue) {
+            flush();
+        }
+        if (!isComplete(value)) {
+            VE_PROFILE_SCOPE("UploadContext::wait");
+            VkSemaphoreWaitInfo waitInfo{};
+            waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+            waitInfo.semaphoreCount = 1;
+            waitInfo.pSemaphores = &semaphore;
+            waitInfo.pValues = &value;
+
+            if (vkWaitSemaphores(device.getDevice(), &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+                Log::error("Failed to wait for uploads!");
+                throw std::runtime_error("");
+            }
+        }
+        reclaim();
+    }
+
+    bool UploadContext::isComplete(const uint64_t value) {
+        uint64_t completed = 0;
+        if (vkGetSemaphoreCounterValue(device.getDevice(), semaphore, &completed) != VK_SUCCESS) {
+            Log::error("Failed to read upload timeline semaphore!");
+            throw std::runtime_error("");
+        }
+        return completed >= value;
+    }
+
+    void UploadContext::reclaim() {
+        uint64_t completed = 0;
+        vkGetSemaphoreCounterValue(device.getDevice(), semaphore, &completed);
+
+        while (!submitted.empty() && submitted.front().value <= completed) {
+            const auto &batch = submitted.front();
+            if (batch.transferCommandBuffer != VK_NULL_HANDLE) {
+                transferCommands.free.push_back(batch.transferCommandBuffer);
+            }
+            graphicsCommands.free.push_back(batch.graphicsCommandBuffer);
+            submitted.pop_front();
+        }
+        while (!stagingRegions.empty() && stagingRegions.front().value <= completed) {
+            stagingRegions.pop_front();
+        }
+
+        auto retired = std::partition(dedicatedStaging.begin(), dedicatedStaging.end(),
+                                      [completed](const DedicatedStaging &staging) { return staging.value > completed; });
+        for (auto it = retired; it != dedicatedStaging.end(); ++it) {
+            vkDestroyBuffer(device.getDevice(), it->buffer, nullptr);
+            device.getAllocator().free(it->allocation);
+        }
+        dedicatedStaging.erase(retired, dedicatedStaging.end());
+    }
+} // ve
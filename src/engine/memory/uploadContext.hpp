@@ -0,0 +1,137 @@
+#pragma once
+
+#include "memoryAllocator.hpp"
+
+// vendor
+#include <vulkan/vulkan.h>
+
+// std
+#include <deque>
+#include <vector>
+
+namespace ve {
+    class Device;
+
+    // Batches the copies and layout transitions that fill device local resources into one command buffer, submitted
+    // by flush instead of waiting for the queue after every copy. The source data goes through a persistently mapped
+    // staging ring, whose space is handed back once the batch that read it has completed. Completion is tracked with
+    // a timeline semaphore, every batch signals the next value. Main thread only.
+    //
+    // With a dedicated transfer queue the staging copies run there, next to the frames instead of in between them.
+    // The written ranges are released to the graphics family at the end of the batch and acquired by a small
+    // graphics queue submission that waits for the transfer, that one signals the batch value.
+    class UploadContext {
+    public:
+        static constexpr VkDeviceSize DEFAULT_STAGING_SIZE = 64ull * 1024 * 1024;
+
+        explicit UploadContext(Device &device, VkDeviceSize stagingSize = DEFAULT_STAGING_SIZE);
+        ~UploadContext();
+
+        UploadContext(const UploadContext &) = delete;
+        UploadContext &operator=(const UploadContext &) = delete;
+
+        void uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void *data, VkDeviceSize size);
+        // Like uploadBuffer, but returns the staging memory for the caller to write the data into, which saves a
+        // copy when the data is produced on the fly. It has to be filled before anything else is called on the
+        // context, a later call may submit the batch. The memory is write combined, write it sequentially and
+        // never read from it.
+        void *writeBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size);
+        // Runs on the graphics queue, which owns both buffers, in a batch of its own
+        void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset = 0,
+                        VkDeviceSize dstOffset = 0);
+        // Fills every layer of mip 0 from tightly packed pixels and leaves the image shader readable. The image must
+        // not have been used yet.
+        void uploadImage(VkImage image, VkExtent3D extent, uint32_t mipLevels, uint32_t layerCount,
+                         const void *pixels, VkDeviceSize size);
+
+        // Submits what was recorded since the last flush. Returns the value the batch signals, or the value of the
+        // last batch when there was nothing to submit. Commands submitted later to the graphics queue see the
+        // uploaded data without waiting on it.
+        uint64_t flush();
+        void wait(uint64_t value);
+        bool isComplete(uint64_t value);
+        // Value the batch being recorded will signal, reached once everything recorded so far is uploaded
+        uint64_t getPendingValue() const { return nextValue; }
+
+        bool usesTransferQueue() const { return transferCommands.commandPool != VK_NULL_HANDLE; }
+        VkSemaphore getSemaphore() const { return semaphore; }
+        VkDeviceSize getStagingSize() const { return stagingSize; }
+        uint64_t getSubmittedBatchCount() const { return nextValue - 1; }
+
+    private:
+        struct Batch {
+            // Null when the batch had nothing for that queue
+            VkCommandBuffer transferCommandBuffer;
+            VkCommandBuffer graphicsCommandBuffer;
+            uint64_t value;
+        };
+
+        struct CommandBuffers {
+            VkCommandPool commandPool = VK_NULL_HANDLE;
+            std::vector<VkCommandBuffer> free;
+            VkCommandBuffer recording = VK_NULL_HANDLE;
+        };
+
+        // Space of the ring read by the batch that signals value
+        struct StagingRegion {
+            VkDeviceSize begin;
+            VkDeviceSize end;
+            uint64_t value;
+        };
+
+        struct Staging {
+            VkBuffer buffer;
+            VkDeviceSize offset;
+            void *mapped;
+        };
+
+        // Uploads bigger than the ring get a buffer of their own, freed with its batch
+        struct DedicatedStaging {
+            VkBuffer buffer;
+            Allocation allocation;
+            uint64_t value;
+        };
+
+        void createCommandPool(CommandBuffers &commandBuffers, uint32_t queueFamily);
+        VkSemaphore createTimeline();
+        // Begins a command buffer of the batch being recorded, reusing a completed one when there is one
+        VkCommandBuffer getCommandBuffer(CommandBuffers &commandBuffers);
+        // Where the staging copies go, the graphics command buffer without a transfer queue
+        VkCommandBuffer getTransferCommandBuffer();
+        void submit(VkQueue queue, VkCommandBuffer commandBuffer, VkSemaphore signal, uint64_t value,
+                    VkSemaphore wait);
+        // Space for size bytes of source data, read by the batch being recorded
+        Staging stage(VkDeviceSize size);
+        bool tryAllocate(VkDeviceSize size, VkDeviceSize &offset);
+        // Hands back the command buffers and staging space of the completed batches
+        void reclaim();
+
+        Device &device;
+        VkDeviceSize stagingSize;
+        VkDeviceSize stagingAlignment;
+        VkBuffer stagingBuffer = VK_NULL_HANDLE;
+        Allocation stagingAllocation{};
+
+        std::deque<StagingRegion> stagingRegions;
+        VkDeviceSize stagingHead = 0;
+        std::vector<DedicatedStaging> dedicatedStaging;
+
+        uint32_t graphicsFamily;
+        uint32_t transferFamily;
+        CommandBuffers graphicsCommands;
+        // Without a pool when there is no transfer queue
+        CommandBuffers transferCommands;
+        std::deque<Batch> submitted;
+
+        // Queue family ownership transfers of the batch being recorded, released on the transfer queue and acquired
+        // on the graphics queue
+        std::vector<VkBufferMemoryBarrier> bufferTransfers;
+        std::vector<VkImageMemoryBarrier> imageTransfers;
+
+        // Signalled on the graphics queue once a batch can be used there
+        VkSemaphore semaphore = VK_NULL_HANDLE;
+        // Signalled on the transfer queue, waited on by the acquires
+        VkSemaphore transferSemaphore = VK_NULL_HANDLE;
+        uint64_t nextValue = 1;
+    };
+} // ve
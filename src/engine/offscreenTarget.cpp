@@ -0,0 +1,329 @@
+#include "offscreenTarget.hpp"
+#include "../log.hpp"
+#include "profiling/cpuProfiler.hpp"
+
+#include <stdexcept>
+#include <array>
+#include <limits>
+
+namespace ve {
+    OffscreenTarget::OffscreenTarget(Device &device, VkExtent2D extent) : device(device), extent(extent) {
+        depthFormat = device.findSupportedFormat(
+                {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
+                VK_IMAGE_TILING_OPTIMAL,
+                VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+
+        createRenderPass();
+        createImages();
+        createFrameBuffers();
+        createSyncObjects();
+    }
+
+    OffscreenTarget::~OffscreenTarget() {
+        for (auto framebuffer : frameBuffers) {
+            vkDestroyFramebuffer(device.getDevice(), framebuffer, nullptr);
+        }
+
+        for (size_t i = 0; i < resolveImages.size(); i++) {
+            vkDestroyImageView(device.getDevice(), colorImageViews[i], nullptr);
+            vkDestroyImage(device.getDevice(), colorImages[i], nullptr);
+            device.getAllocator().free(colorImageAllocations[i]);
+
+            vkDestroyImageView(device.getDevice(), depthImageViews[i], nullptr);
+            vkDestroyImage(device.getDevice(), depthImages[i], nullptr);
+            device.getAllocator().free(depthImageAllocations[i]);
+
+            vkDestroyImageView(device.getDevice(), resolveImageViews[i], nullptr);
+            vkDestroyImage(device.getDevice(), resolveImages[i], nullptr);
+            device.getAllocator().free(resolveImageAllocations[i]);
+        }
+
+        vkDestroyRenderPass(device.getDevice(), renderPass, nullptr);
+
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            vkDestroySemaphore(device.getDevice(), computeFinishedSemaphores[i], nullptr);
+            vkDestroyFence(device.getDevice(), inFlightFences[i], nullptr);
+        }
+    }
+
+    void OffscreenTarget::createRenderPass() {
+        VkAttachmentDescription colorAttachment {};
+        colorAttachment.format = imageFormat;
+        colorAttachment.samples = device.getSampleCount();
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference colorAttachmentRef {};
+        colorAttachmentRef.attachment = 0;
+        colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentDescription depthAttachment {};
+        depthAttachment.format = depthFormat;
+        depthAttachment.samples = device.getSampleCount();
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+        VkAttachmentReference depthAttachmentRef {};
+        depthAttachmentRef.attachment = 1;
+        depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentDescription resolveAttachment {};
+        resolveAttachment.format = imageFormat;
+        resolveAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        resolveAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        resolveAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        resolveAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        resolveAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        resolveAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        resolveAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+        VkAttachmentReference resolveAttachmentRef {};
+        resolveAttachmentRef.attachment = 2;
+        resolveAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        std::array<VkAttachmentDescription, 3> attachments = {
+            colorAttachment,
+            depthAttachment,
+            resolveAttachment,
+        };
+
+        VkSubpassDescription subpass {};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorAttachmentRef;
+        subpass.pDepthStencilAttachment = &depthAttachmentRef;
+        subpass.pResolveAttachments = &resolveAttachmentRef;
+
+        std::array<VkSubpassDependency, 3> dependencies {};
+        dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[0].dstSubpass = 0;
+        // Includes compute, the previous frame using this depth image may still be reading it into the depth pyramid
+        dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        dependencies[0].srcAccessMask = 0;
+        dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+        // Make the resolved image visible to transfers recorded after the render pass (captures)
+        dependencies[1].srcSubpass = 0;
+        dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        // Make the depth visible to the depth pyramid build recorded after the render pass
+        dependencies[2].srcSubpass = 0;
+        dependencies[2].dstSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[2].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependencies[2].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependencies[2].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        dependencies[2].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        VkRenderPassCreateInfo renderPassInfo {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+        renderPassInfo.pAttachments = attachments.data();
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+        renderPassInfo.pDependencies = dependencies.data();
+
+        if (vkCreateRenderPass(device.getDevice(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+            Log::error("Failed to create offscreen render pass!");
+            throw std::runtime_error("");
+        }
+    }
+
+    void OffscreenTarget::createAttachment(
+            VkFormat format,
+            VkImageUsageFlags usage,
+            VkSampleCountFlagBits samples,
+            VkImageAspectFlags aspectMask,
+            VkImage &image,
+            Allocation &imageAllocation,
+            VkImageView &imageView) {
+        VkImageCreateInfo imageInfo {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = extent.width;
+        imageInfo.extent.height = extent.height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = format;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = usage;
+        imageInfo.samples = samples;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.flags = 0;
+
+        device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageAllocation);
+
+        VkImageViewCreateInfo viewInfo {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange.aspectMask = aspectMask;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(device.getDevice(), &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+            Log::error("Failed to create offscreen image view!");
+            throw std::runtime_error("");
+        }
+    }
+
+    void OffscreenTarget::createImages() {
+        colorImages.resize(MAX_FRAMES_IN_FLIGHT);
+        colorImageAllocations.resize(MAX_FRAMES_IN_FLIGHT);
+        colorImageViews.resize(MAX_FRAMES_IN_FLIGHT);
+
+        depthImages.resize(MAX_FRAMES_IN_FLIGHT);
+        depthImageAllocations.resize(MAX_FRAMES_IN_FLIGHT);
+        depthImageViews.resize(MAX_FRAMES_IN_FLIGHT);
+
+        resolveImages.resize(MAX_FRAMES_IN_FLIGHT);
+        resolveImageAllocations.resize(MAX_FRAMES_IN_FLIGHT);
+        resolveImageViews.resize(MAX_FRAMES_IN_FLIGHT);
+
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            createAttachment(
+                    imageFormat,
+                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                    device.getSampleCount(),
+                    VK_IMAGE_ASPECT_COLOR_BIT,
+                    colorImages[i],
+                    colorImageAllocations[i],
+                    colorImageViews[i]);
+
+            createAttachment(
+                    depthFormat,
+                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                    device.getSampleCount(),
+                    VK_IMAGE_ASPECT_DEPTH_BIT,
+                    depthImages[i],
+                    depthImageAllocations[i],
+                    depthImageViews[i]);
+
+            createAttachment(
+                    imageFormat,
+                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                    VK_SAMPLE_COUNT_1_BIT,
+                    VK_IMAGE_ASPECT_COLOR_BIT,
+                    resolveImages[i],
+                    resolveImageAllocations[i],
+                    resolveImageViews[i]);
+        }
+    }
+
+    void OffscreenTarget::createFrameBuffers() {
+        frameBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            std::array<VkImageView, 3> attachments {
+                colorImageViews[i],
+                depthImageViews[i],
+                resolveImageViews[i]
+            };
+
+            VkFramebufferCreateInfo framebufferInfo = {};
+            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass = renderPass;
+            framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+            framebufferInfo.pAttachments = attachments.data();
+            framebufferInfo.width = extent.width;
+            framebufferInfo.height = extent.height;
+            framebufferInfo.layers = 1;
+
+            if (vkCreateFramebuffer(device.getDevice(), &framebufferInfo, nullptr, &frameBuffers[i]) != VK_SUCCESS) {
+                Log::error("Failed to create offscreen framebuffer!");
+                throw std::runtime_error("");
+            }
+        }
+    }
+
+    void OffscreenTarget::createSyncObjects() {
+        inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+        computeFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+
+        VkSemaphoreCreateInfo semaphoreInfo = {};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            if (vkCreateSemaphore(device.getDevice(), &semaphoreInfo, nullptr, &computeFinishedSemaphores[i]) != VK_SUCCESS ||
+                vkCreateFence(device.getDevice(), &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+                Log::error("Failed to create synchronization objects for an offscreen frame!");
+                throw std::runtime_error("");
+            }
+        }
+    }
+
+    VkResult OffscreenTarget::acquireNextImage(uint32_t *imageIndex) {
+        VE_PROFILE_SCOPE("OffscreenTarget::acquireNextImage");
+        vkWaitForFences(
+            device.getDevice(),
+            1,
+            &inFlightFences[currentFrame],
+            VK_TRUE,
+            std::numeric_limits<uint64_t>::max());
+
+        // Every frame in flight owns its images, so there is nothing to acquire
+        *imageIndex = static_cast<uint32_t>(currentFrame);
+        return VK_SUCCESS;
+    }
+
+    VkResult OffscreenTarget::submitCommandBuffers(const VkCommandBuffer *graphicsBuffers, const VkCommandBuffer *computeBuffers, uint32_t *imageIndex) {
+        VE_PROFILE_SCOPE("OffscreenTarget::submitCommandBuffers");
+        {
+            VkSubmitInfo computeSubmitInfo = {};
+            computeSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            computeSubmitInfo.commandBufferCount = 1;
+            computeSubmitInfo.pCommandBuffers = computeBuffers;
+            computeSubmitInfo.signalSemaphoreCount = 1;
+            computeSubmitInfo.pSignalSemaphores = &computeFinishedSemaphores[currentFrame];
+
+            if (vkQueueSubmit(device.getComputeQueue(), 1, &computeSubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+                Log::error("Failed to submit compute command buffer!");
+                throw std::runtime_error("");
+            }
+        }
+
+        {
+            VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+
+            VkSubmitInfo graphicsSubmitInfo = {};
+            graphicsSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            graphicsSubmitInfo.waitSemaphoreCount = 1;
+            graphicsSubmitInfo.pWaitSemaphores = &computeFinishedSemaphores[currentFrame];
+            graphicsSubmitInfo.pWaitDstStageMask = &waitStage;
+            graphicsSubmitInfo.commandBufferCount = 1;
+            graphicsSubmitInfo.pCommandBuffers = graphicsBuffers;
+
+            vkResetFences(device.getDevice(), 1, &inFlightFences[currentFrame]);
+            if (vkQueueSubmit(device.getGraphicsQueue(), 1, &graphicsSubmitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
+                Log::error("Failed to submit draw command buffer!");
+                throw std::runtime_error("");
+            }
+        }
+
+        currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+
+        return VK_SUCCESS;
+    }
+} // ve
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "frameTarget.hpp"
+
+// std
+#include <vector>
+
+namespace ve {
+    // Renders each frame into offscreen color/depth images and never presents. Used when running
+    // without a window, the resolved color image of a frame is left in TRANSFER_SRC_OPTIMAL so it
+    // can be copied out for captures.
+    class OffscreenTarget : public FrameTarget {
+    public:
+        OffscreenTarget(Device &device, VkExtent2D extent);
+        ~OffscreenTarget() override;
+
+        VkFramebuffer getFrameBuffer(int index) override { return frameBuffers[index]; }
+        VkRenderPass getRenderPass() override { return renderPass; }
+        size_t getImageCount() override { return resolveImages.size(); }
+        VkImageView getDepthImageView(int index) override { return depthImageViews[index]; }
+        VkExtent2D getSwapChainExtent() override { return extent; }
+        VkImage getResolveImage(int index) const { return resolveImages[index]; }
+        VkFormat getImageFormat() const { return imageFormat; }
+
+        float getExtentAspectRatio() const override {
+            return static_cast<float>(extent.width) / static_cast<float>(extent.height);
+        }
+
+        VkResult acquireNextImage(uint32_t *imageIndex) override;
+        VkResult submitCommandBuffers(
+                const VkCommandBuffer *graphicsBuffers,
+                const VkCommandBuffer *computeBuffers,
+                uint32_t *imageIndex) override;
+
+    private:
+        void createRenderPass();
+        void createImages();
+        void createFrameBuffers();
+        void createSyncObjects();
+
+        void createAttachment(
+                VkFormat format,
+                VkImageUsageFlags usage,
+                VkSampleCountFlagBits samples,
+                VkImageAspectFlags aspectMask,
+                VkImage &image,
+                Allocation &imageAllocation,
+                VkImageView &imageView);
+
+        Device &device;
+        VkExtent2D extent;
+
+        VkFormat imageFormat = VK_FORMAT_B8G8R8A8_SRGB;
+        VkFormat depthFormat;
+
+        VkRenderPass renderPass;
+        std::vector<VkFramebuffer> frameBuffers;
+
+        std::vector<VkImage> colorImages;
+        std::vector<Allocation> colorImageAllocations;
+        std::vector<VkImageView> colorImageViews;
+
+        std::vector<VkImage> depthImages;
+        std::vector<Allocation> depthImageAllocations;
+        std::vector<VkImageView> depthImageViews;
+
+        std::vector<VkImage> resolveImages;
+        std::vector<Allocation> resolveImageAllocations;
+        std::vector<VkImageView> resolveImageViews;
+
+        std::vector<VkFence> inFlightFences;
+        std::vector<VkSemaphore> computeFinishedSemaphores;
+
+        size_t currentFrame = 0;
+    };
+} // ve
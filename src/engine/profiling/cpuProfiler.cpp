@@ -0,0 +1,155 @@
+#include "cpuProfiler.hpp"
+#include "json.hpp"
+
+#include "../../log.hpp"
+
+// std
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+namespace ve {
+    std::atomic<bool> CpuProfiler::enabled = false;
+
+    namespace {
+        struct Event {
+            const char *name;
+            int64_t start;
+            int64_t end;
+        };
+
+        // Written by the owning thread only. The count is published with release semantics so the
+        // exporter can read a consistent prefix while the thread keeps recording.
+        struct Chunk {
+            static constexpr size_t CAPACITY = 4096;
+
+            Event events[CAPACITY];
+            std::atomic<size_t> count = 0;
+            std::atomic<Chunk *> next = nullptr;
+        };
+
+        struct ThreadBuffer {
+            uint32_t threadId;
+            std::string name;
+            Chunk *head;
+            Chunk *tail;
+
+            explicit ThreadBuffer(const uint32_t threadId) : threadId(threadId), name("Thread " + std::to_string(threadId)) {
+                head = tail = new Chunk();
+            }
+
+            ~ThreadBuffer() {
+                while (head != nullptr) {
+                    Chunk *next = head->next.load(std::memory_order_relaxed);
+                    delete head;
+                    head = next;
+                }
+            }
+        };
+
+        // Buffers are owned here rather than by the threads, so events of finished threads still get exported
+        struct Registry {
+            std::mutex mutex;
+            std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+            std::set<std::string> names;
+        };
+
+        Registry &getRegistry() {
+            static Registry registry;
+            return registry;
+        }
+
+        ThreadBuffer &getThreadBuffer() {
+            thread_local ThreadBuffer *buffer = nullptr;
+            if (buffer == nullptr) {
+                Registry &registry = getRegistry();
+                std::lock_guard lock(registry.mutex);
+                registry.buffers.push_back(std::make_unique<ThreadBuffer>(static_cast<uint32_t>(registry.buffers.size())));
+                buffer = registry.buffers.back().get();
+            }
+            return *buffer;
+        }
+
+        const auto epoch = std::chrono::steady_clock::now();
+    }
+
+    void CpuProfiler::setEnabled(const bool enabled) {
+        CpuProfiler::enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    void CpuProfiler::setThreadName(const std::string &name) {
+        ThreadBuffer &buffer = getThreadBuffer();
+        std::lock_guard lock(getRegistry().mutex);
+        buffer.name = name;
+    }
+
+    const char *CpuProfiler::intern(const std::string &name) {
+        Registry &registry = getRegistry();
+        std::lock_guard lock(registry.mutex);
+        return registry.names.insert(name).first->c_str();
+    }
+
+    int64_t CpuProfiler::now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    void CpuProfiler::record(const char *name, const int64_t start, const int64_t end) {
+        ThreadBuffer &buffer = getThreadBuffer();
+
+        size_t count = buffer.tail->count.load(std::memory_order_relaxed);
+        if (count == Chunk::CAPACITY) {
+            auto *chunk = new Chunk();
+            buffer.tail->next.store(chunk, std::memory_order_release);
+            buffer.tail = chunk;
+            count = 0;
+        }
+
+        buffer.tail->events[count] = { name, start, end };
+        buffer.tail->count.store(count + 1, std::memory_order_release);
+    }
+
+    void CpuProfiler::exportChromeTrace(const std::string &path) {
+        std::ofstream file(path);
+        if (!file.is_open()) {
+            Log::error("Failed to open trace output " + path);
+            throw std::runtime_error("");
+        }
+
+        Registry &registry = getRegistry();
+        std::lock_guard lock(registry.mutex);
+
+        size_t eventCount = 0;
+        bool first = true;
+        auto separator = [&]() -> std::ofstream & {
+            file << (first ? "\n" : ",\n");
+            first = false;
+            return file;
+        };
+
+        file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+        for (const auto &buffer : registry.buffers) {
+            separator() << R"({"name": "thread_name", "ph": "M", "pid": 1, "tid": )" << buffer->threadId
+                        << R"(, "args": {"name": ")" << escapeJson(buffer->name) << "\"}}";
+
+            for (const Chunk *chunk = buffer->head; chunk != nullptr; chunk = chunk->next.load(std::memory_order_acquire)) {
+                const size_t count = chunk->count.load(std::memory_order_acquire);
+                for (size_t i = 0; i < count; i++) {
+                    const Event &event = chunk->events[i];
+                    // Trace timestamps are in microseconds
+                    separator() << R"({"name": ")" << escapeJson(event.name)
+                                << R"(", "ph": "X", "pid": 1, "tid": )" << buffer->threadId
+                                << ", \"ts\": " << static_cast<double>(event.start) / 1000.0
+                                << ", \"dur\": " << static_cast<double>(event.end - event.start) / 1000.0 << "}";
+                }
+                eventCount += count;
+            }
+        }
+        file << "\n]}\n";
+
+        Log::info("Wrote " + std::to_string(eventCount) + " trace events to " + path);
+    }
+} // ve
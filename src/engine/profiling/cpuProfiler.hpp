@@ -0,0 +1,59 @@
+#pragma once
+
+// std
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace ve {
+    // Records named CPU scopes into per-thread buffers. Recording only touches the calling thread's
+    // buffer, the registry lock is taken once per thread and when exporting.
+    class CpuProfiler {
+    public:
+        class Scope {
+        public:
+            // The name has to outlive the profiler, use string literals or intern()
+            explicit Scope(const char *name) : name(name), start(isEnabled() ? now() : -1) {}
+            ~Scope() {
+                if (start >= 0) {
+                    record(name, start, now());
+                }
+            }
+
+            Scope(const Scope &) = delete;
+            Scope &operator=(const Scope &) = delete;
+
+        private:
+            const char *name;
+            int64_t start;
+        };
+
+        // Nothing is recorded until enabled
+        static void setEnabled(bool enabled);
+        static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+        static void setThreadName(const std::string &name);
+        // Returns a pointer that stays valid for the lifetime of the program
+        static const char *intern(const std::string &name);
+
+        // Nanoseconds since the profiler started
+        static int64_t now();
+        static void record(const char *name, int64_t start, int64_t end);
+
+        // Chrome trace event JSON, opens in chrome://tracing and ui.perfetto.dev
+        static void exportChromeTrace(const std::string &path);
+
+    private:
+        static std::atomic<bool> enabled;
+    };
+} // ve
+
+#ifdef VE_ENABLE_PROFILING
+#define VE_PROFILE_CONCAT_INNER(a, b) a##b
+#define VE_PROFILE_CONCAT(a, b) VE_PROFILE_CONCAT_INNER(a, b)
+#define VE_PROFILE_SCOPE(name) ::ve::CpuProfiler::Scope VE_PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define VE_PROFILE_FUNCTION() VE_PROFILE_SCOPE(__func__)
+#else
+#define VE_PROFILE_SCOPE(name) ((void)0)
+#define VE_PROFILE_FUNCTION() ((void)0)
+#endif
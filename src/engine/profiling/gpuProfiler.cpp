@@ -0,0 +1,295 @@
+#include "gpuProfiler.hpp"
+
+#include "../../log.hpp"
+
+namespace ve {
+    static constexpr VkQueryPipelineStatisticFlags statisticFlags =
+            VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+    // Statistics are written in the order of their flag bits
+    static constexpr uint32_t statisticCount = 4;
+
+    GpuProfiler::Scope::Scope(GpuProfiler &profiler, VkCommandBuffer commandBuffer, const std::string &name, const bool statistics)
+        : profiler(profiler), commandBuffer(commandBuffer) {
+        scope = profiler.beginScope(commandBuffer, name, statistics);
+    }
+
+    GpuProfiler::Scope::~Scope() {
+        profiler.endScope(commandBuffer, scope);
+    }
+
+    GpuProfiler::GpuProfiler(Device &device, const uint32_t framesInFlight) : device(device) {
+        validBits[static_cast<int>(Queue::Graphics)] = device.getGraphicsTimestampValidBits();
+        validBits[static_cast<int>(Queue::Compute)] = device.getComputeTimestampValidBits();
+        if (device.properties.limits.timestampPeriod == 0.0f) {
+            validBits[0] = validBits[1] = 0;
+        }
+
+        frames.resize(framesInFlight);
+        for (auto &frame : frames) {
+            for (int queue = 0; queue < 2; queue++) {
+                if (validBits[queue] == 0) {
+                    continue;
+                }
+
+                VkQueryPoolCreateInfo timestampPoolInfo{};
+                timestampPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+                timestampPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+                timestampPoolInfo.queryCount = MAX_SCOPES * 2;
+
+                if (vkCreateQueryPool(device.getDevice(), &timestampPoolInfo, nullptr, &frame.streams[queue].timestampPool) != VK_SUCCESS) {
+                    Log::error("Failed to create profiler timestamp query pool!");
+                    throw std::runtime_error("");
+                }
+            }
+
+            if (device.supportsPipelineStatistics()) {
+                VkQueryPoolCreateInfo statisticsPoolInfo{};
+                statisticsPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+                statisticsPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+                statisticsPoolInfo.queryCount = MAX_SCOPES;
+                statisticsPoolInfo.pipelineStatistics = statisticFlags;
+
+                if (vkCreateQueryPool(device.getDevice(), &statisticsPoolInfo, nullptr, &frame.statisticsPool) != VK_SUCCESS) {
+                    Log::error("Failed to create profiler pipeline statistics query pool!");
+                    throw std::runtime_error("");
+                }
+            }
+        }
+
+        if (validBits[static_cast<int>(Queue::Graphics)] == 0) {
+            Log::warning("Graphics queue does not support timestamps, GPU scopes will not be timed");
+        }
+        if (!device.supportsPipelineStatistics()) {
+            Log::warning("Pipeline statistics queries are not supported");
+        }
+    }
+
+    GpuProfiler::~GpuProfiler() {
+        for (auto &frame : frames) {
+            for (auto &stream : frame.streams) {
+                if (stream.timestampPool != VK_NULL_HANDLE) {
+                    vkDestroyQueryPool(device.getDevice(), stream.timestampPool, nullptr);
+                }
+            }
+            if (frame.statisticsPool != VK_NULL_HANDLE) {
+                vkDestroyQueryPool(device.getDevice(), frame.statisticsPool, nullptr);
+            }
+        }
+    }
+
+    void GpuProfiler::beginFrame(const int frameIndex, const uint64_t frameNumber, VkCommandBuffer graphicsCommandBuffer, VkCommandBuffer computeCommandBuffer) {
+        currentFrame = frameIndex;
+        FrameQueries &frame = frames[frameIndex];
+
+        // The fence of this slot has been waited on, so this does not stall
+        if (frame.pending) {
+            resolveFrame(frame, VK_QUERY_RESULT_WAIT_BIT);
+        }
+
+        frame.streams[static_cast<int>(Queue::Graphics)].commandBuffer = graphicsCommandBuffer;
+        frame.streams[static_cast<int>(Queue::Compute)].commandBuffer = computeCommandBuffer;
+        for (auto &stream : frame.streams) {
+            if (stream.timestampPool != VK_NULL_HANDLE) {
+                vkCmdResetQueryPool(stream.commandBuffer, stream.timestampPool, 0, MAX_SCOPES * 2);
+            }
+            stream.timestampCount = 0;
+            stream.openScopes.clear();
+        }
+
+        if (frame.statisticsPool != VK_NULL_HANDLE) {
+            vkCmdResetQueryPool(graphicsCommandBuffer, frame.statisticsPool, 0, MAX_SCOPES);
+        }
+        frame.statisticsCount = 0;
+        frame.statisticsActive = false;
+
+        frame.scopes.clear();
+        frame.frameNumber = frameNumber;
+        frame.pending = false;
+    }
+
+    void GpuProfiler::endFrame() {
+        FrameQueries &frame = frames[currentFrame];
+        for (const auto &stream : frame.streams) {
+            if (!stream.openScopes.empty()) {
+                Log::error("GPU profiler scope " + frame.scopes[stream.openScopes.back()].path + " was not ended");
+                throw std::runtime_error("");
+            }
+        }
+        frame.pending = true;
+    }
+
+    GpuProfiler::Stream &GpuProfiler::getStream(VkCommandBuffer commandBuffer, Queue &queue) {
+        FrameQueries &frame = frames[currentFrame];
+        for (int i = 0; i < 2; i++) {
+            if (frame.streams[i].commandBuffer == commandBuffer) {
+                queue = static_cast<Queue>(i);
+                return frame.streams[i];
+            }
+        }
+
+        Log::error("Command buffer is not being profiled this frame");
+        throw std::runtime_error("");
+    }
+
+    uint32_t GpuProfiler::beginScope(VkCommandBuffer commandBuffer, const std::string &name, const bool statistics) {
+        FrameQueries &frame = frames[currentFrame];
+
+        Queue queue;
+        Stream &stream = getStream(commandBuffer, queue);
+
+        ScopeRecord record{};
+        record.name = name;
+        record.depth = static_cast<uint32_t>(stream.openScopes.size());
+        record.path = stream.openScopes.empty() ? name : frame.scopes[stream.openScopes.back()].path + "/" + name;
+        record.queue = queue;
+        record.timestampQuery = NO_QUERY;
+        record.statisticsQuery = NO_QUERY;
+
+        if (stream.timestampPool != VK_NULL_HANDLE && stream.timestampCount < MAX_SCOPES * 2) {
+            record.timestampQuery = stream.timestampCount;
+            stream.timestampCount += 2;
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, stream.timestampPool, record.timestampQuery);
+        }
+
+        if (statistics && queue == Queue::Graphics && frame.statisticsPool != VK_NULL_HANDLE &&
+            !frame.statisticsActive && frame.statisticsCount < MAX_SCOPES) {
+            record.statisticsQuery = frame.statisticsCount++;
+            frame.statisticsActive = true;
+            vkCmdBeginQuery(commandBuffer, frame.statisticsPool, record.statisticsQuery, 0);
+        }
+
+        const auto scope = static_cast<uint32_t>(frame.scopes.size());
+        frame.scopes.push_back(std::move(record));
+        stream.openScopes.push_back(scope);
+        return scope;
+    }
+
+    void GpuProfiler::endScope(VkCommandBuffer commandBuffer, const uint32_t scope) {
+        FrameQueries &frame = frames[currentFrame];
+
+        Queue queue;
+        Stream &stream = getStream(commandBuffer, queue);
+
+        if (stream.openScopes.empty() || stream.openScopes.back() != scope) {
+            Log::error("GPU profiler scopes must end in the reverse order they began");
+            throw std::runtime_error("");
+        }
+        stream.openScopes.pop_back();
+
+        const ScopeRecord &record = frame.scopes[scope];
+        if (record.statisticsQuery != NO_QUERY) {
+            vkCmdEndQuery(commandBuffer, frame.statisticsPool, record.statisticsQuery);
+            frame.statisticsActive = false;
+        }
+        if (record.timestampQuery != NO_QUERY) {
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, stream.timestampPool, record.timestampQuery + 1);
+        }
+    }
+
+    std::vector<GpuProfiler::FrameResults> GpuProfiler::collectResults() {
+        for (auto &frame : frames) {
+            if (frame.pending) {
+                resolveFrame(frame, 0);
+            }
+        }
+
+        std::vector<FrameResults> results;
+        results.swap(resolvedResults);
+        return results;
+    }
+
+    float GpuProfiler::ticksToMillis(const uint64_t begin, const uint64_t end, const uint32_t bits) const {
+        const uint64_t mask = bits >= 64 ? ~0ull : (1ull << bits) - 1;
+        const uint64_t ticks = (end - begin) & mask;
+        return static_cast<float>(static_cast<double>(ticks) * device.properties.limits.timestampPeriod * 1e-6);
+    }
+
+    bool GpuProfiler::resolveFrame(FrameQueries &frame, const VkQueryResultFlags flags) {
+        std::vector<uint64_t> timestamps[2];
+        for (int queue = 0; queue < 2; queue++) {
+            const Stream &stream = frame.streams[queue];
+            if (stream.timestampCount == 0) {
+                continue;
+            }
+
+            timestamps[queue].resize(stream.timestampCount);
+            const VkResult result = vkGetQueryPoolResults(
+                    device.getDevice(),
+                    stream.timestampPool,
+                    0,
+                    stream.timestampCount,
+                    timestamps[queue].size() * sizeof(uint64_t),
+                    timestamps[queue].data(),
+                    sizeof(uint64_t),
+                    VK_QUERY_RESULT_64_BIT | flags);
+
+            if (result == VK_NOT_READY) {
+                return false;
+            }
+            if (result != VK_SUCCESS) {
+                Log::error("Failed to read profiler timestamps!");
+                throw std::runtime_error("");
+            }
+        }
+
+        std::vector<uint64_t> statistics(frame.statisticsCount * statisticCount);
+        if (frame.statisticsCount > 0) {
+            const VkResult result = vkGetQueryPoolResults(
+                    device.getDevice(),
+                    frame.statisticsPool,
+                    0,
+                    frame.statisticsCount,
+                    statistics.size() * sizeof(uint64_t),
+                    statistics.data(),
+                    statisticCount * sizeof(uint64_t),
+                    VK_QUERY_RESULT_64_BIT | flags);
+
+            if (result == VK_NOT_READY) {
+                return false;
+            }
+            if (result != VK_SUCCESS) {
+                Log::error("Failed to read profiler pipeline statistics!");
+                throw std::runtime_error("");
+            }
+        }
+
+        FrameResults frameResults{};
+        frameResults.frameNumber = frame.frameNumber;
+        frameResults.scopes.reserve(frame.scopes.size());
+        for (const auto &record : frame.scopes) {
+            ScopeResult result{};
+            result.name = record.name;
+            result.path = record.path;
+            result.depth = record.depth;
+            result.queue = record.queue;
+            result.time = -1.0f;
+
+            const int queue = static_cast<int>(record.queue);
+            if (record.timestampQuery != NO_QUERY) {
+                result.time = ticksToMillis(
+                        timestamps[queue][record.timestampQuery],
+                        timestamps[queue][record.timestampQuery + 1],
+                        validBits[queue]);
+            }
+
+            if (record.statisticsQuery != NO_QUERY) {
+                const uint64_t *values = &statistics[record.statisticsQuery * statisticCount];
+                result.hasStatistics = true;
+                result.vertexInvocations = values[0];
+                result.clippingInvocations = values[1];
+                result.clippingPrimitives = values[2];
+                result.fragmentInvocations = values[3];
+            }
+
+            frameResults.scopes.push_back(std::move(result));
+        }
+
+        frame.pending = false;
+        latestResults = frameResults;
+        resolvedResults.push_back(std::move(frameResults));
+        return true;
+    }
+} // ve
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "../device.hpp"
+
+// std
+#include <string>
+#include <vector>
+
+namespace ve {
+    // Brackets named scopes in the graphics and compute command buffers with timestamp queries and,
+    // for graphics scopes that ask for it, pipeline statistics. Every frame in flight owns its query
+    // pools, so a frame's results are read back once its slot comes around again and recording never
+    // waits on the GPU.
+    class GpuProfiler {
+    public:
+        static constexpr uint32_t MAX_SCOPES = 64;
+
+        enum class Queue { Graphics, Compute };
+
+        struct ScopeResult {
+            std::string name;
+            // Names of the enclosing scopes and this one joined with '/', unique within a frame
+            std::string path;
+            uint32_t depth;
+            Queue queue;
+            // Milliseconds, negative when the queue cannot write timestamps
+            float time;
+
+            bool hasStatistics;
+            uint64_t vertexInvocations;
+            uint64_t clippingInvocations;
+            uint64_t clippingPrimitives;
+            uint64_t fragmentInvocations;
+        };
+
+        struct FrameResults {
+            uint64_t frameNumber;
+            // In the order the scopes were opened
+            std::vector<ScopeResult> scopes;
+        };
+
+        class Scope {
+        public:
+            // Pipeline statistics queries cannot nest, statistics are skipped while an enclosing scope collects them.
+            Scope(GpuProfiler &profiler, VkCommandBuffer commandBuffer, const std::string &name, bool statistics = false);
+            ~Scope();
+
+            Scope(const Scope &) = delete;
+            Scope &operator=(const Scope &) = delete;
+
+        private:
+            GpuProfiler &profiler;
+            VkCommandBuffer commandBuffer;
+            uint32_t scope;
+        };
+
+        GpuProfiler(Device &device, uint32_t framesInFlight);
+        ~GpuProfiler();
+
+        GpuProfiler(const GpuProfiler &) = delete;
+        GpuProfiler &operator=(const GpuProfiler &) = delete;
+
+        // Reads back the frame that last used this slot, then resets its queries. Has to be called right
+        // after the command buffers begin, outside of any render pass.
+        void beginFrame(int frameIndex, uint64_t frameNumber, VkCommandBuffer graphicsCommandBuffer, VkCommandBuffer computeCommandBuffer);
+        // Called before the command buffers end, the frame's queries are read back after it is submitted.
+        void endFrame();
+
+        uint32_t beginScope(VkCommandBuffer commandBuffer, const std::string &name, bool statistics);
+        void endScope(VkCommandBuffer commandBuffer, uint32_t scope);
+
+        // Frames resolved since the last call, polling the ones still in flight without waiting.
+        std::vector<FrameResults> collectResults();
+        // The most recently resolved frame
+        const FrameResults &getLatestResults() const { return latestResults; }
+
+    private:
+        static constexpr uint32_t NO_QUERY = ~0u;
+
+        struct ScopeRecord {
+            std::string name;
+            std::string path;
+            uint32_t depth;
+            Queue queue;
+            uint32_t timestampQuery;
+            uint32_t statisticsQuery;
+        };
+
+        struct Stream {
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+            VkQueryPool timestampPool = VK_NULL_HANDLE;
+            uint32_t timestampCount = 0;
+            std::vector<uint32_t> openScopes{};
+        };
+
+        struct FrameQueries {
+            Stream streams[2];
+            VkQueryPool statisticsPool = VK_NULL_HANDLE;
+            uint32_t statisticsCount = 0;
+            bool statisticsActive = false;
+
+            std::vector<ScopeRecord> scopes{};
+            uint64_t frameNumber = 0;
+            bool pending = false;
+        };
+
+        Stream &getStream(VkCommandBuffer commandBuffer, Queue &queue);
+        bool resolveFrame(FrameQueries &frame, VkQueryResultFlags flags);
+        float ticksToMillis(uint64_t begin, uint64_t end, uint32_t validBits) const;
+
+        Device &device;
+        uint32_t validBits[2];
+        std::vector<FrameQueries> frames;
+        int currentFrame = 0;
+
+        std::vector<FrameResults> resolvedResults{};
+        FrameResults latestResults{};
+    };
+} // ve
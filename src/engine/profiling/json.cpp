@@ -0,0 +1,24 @@
+#include "json.hpp"
+
+// std
+#include <cstdio>
+
+namespace ve {
+    std::string escapeJson(const std::string &text) {
+        std::string escaped;
+        escaped.reserve(text.size());
+        for (const char c : text) {
+            if (c == '"' || c == '\\') {
+                escaped.push_back('\\');
+                escaped.push_back(c);
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char code[7];
+                std::snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned char>(c));
+                escaped += code;
+            } else {
+                escaped.push_back(c);
+            }
+        }
+        return escaped;
+    }
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// std
+#include <string>
+
+namespace ve {
+    // Escapes text written into a JSON string, quotes and backslashes with a backslash and control characters as
+    // \u escapes. Shared by the profiler trace and the benchmark results.
+    std::string escapeJson(const std::string &text);
+}
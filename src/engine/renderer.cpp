@@ -7,26 +7,35 @@
 
 #include "../engine/memory/descriptors.hpp"
 #include "settings.hpp"
+#include "jobs/jobSystem.hpp"
 
 namespace ve {
-    Renderer::Renderer(Window &window, Device &device)
-    : window(window), device(device) {
+    Renderer::Renderer(Window *window, Device &device, VkExtent2D extent)
+    : window(window), device(device), extent(extent), gpuProfiler(device, SwapChain::MAX_FRAMES_IN_FLIGHT),
+      secondaryRecorder(device, JobSystem::getInstance().getThreadCount()) {
         createSwapChain();
         createCommandBuffers();
         createGlobalDescriptorPool();
+        createTimestampQueries();
     }
 
     Renderer::~Renderer() {
+        if (timestampQueryPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(device.getDevice(), timestampQueryPool, nullptr);
+        }
         freeCommandBuffers();
     }
 
     std::pair<VkCommandBuffer, VkCommandBuffer> Renderer::beginFrame() {
+        VE_PROFILE_SCOPE("Renderer::beginFrame");
         if(isFrameStarted) {
             Log::error("Can't call beginFrame while already in progress");
             throw std::runtime_error("");
         }
 
+        Timer acquireTimer;
         auto result = swapChain->acquireNextImage(reinterpret_cast<uint32_t *>(&currentImageIndex));
+        const float presentWaitTime = acquireTimer.ElapsedMillis();
 
         if (result == VK_ERROR_OUT_OF_DATE_KHR) {
             createSwapChain();
@@ -40,6 +49,9 @@ namespace ve {
 
         isFrameStarted = true;
 
+        // The frame that last used these queries has retired, read them before they are reset
+        resolveGpuTime(currentFrameIndex, VK_QUERY_RESULT_WAIT_BIT);
+
         auto graphicsCommandBuffer = getCurrentGraphicsCommandBuffer();
         auto computeCommandBuffer = getCurrentComputeCommandBuffer();
 
@@ -56,18 +68,43 @@ namespace ve {
             throw std::runtime_error("");
         }
 
+        if (timestampQueryPool != VK_NULL_HANDLE) {
+            const uint32_t firstQuery = currentFrameIndex * 2;
+            vkCmdResetQueryPool(graphicsCommandBuffer, timestampQueryPool, firstQuery, 2);
+            vkCmdWriteTimestamp(graphicsCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, firstQuery);
+        }
+
+        gpuProfiler.beginFrame(currentFrameIndex, frameNumber, graphicsCommandBuffer, computeCommandBuffer);
+        secondaryRecorder.beginFrame(currentFrameIndex);
+
+        currentFrameTimings = {};
+        currentFrameTimings.frameNumber = frameNumber;
+        currentFrameTimings.presentWaitTime = presentWaitTime;
+        recordTimer.Reset();
+
         return { graphicsCommandBuffer, computeCommandBuffer };
     }
 
     void Renderer::endFrame() {
+        VE_PROFILE_SCOPE("Renderer::endFrame");
         if (!isFrameStarted) {
             Log::error("Can't call endFrame while frame is not in progress");
             throw std::runtime_error("");
         }
 
+        currentFrameTimings.recordTime = recordTimer.ElapsedMillis();
+
         auto graphicsCommandBuffer = getCurrentGraphicsCommandBuffer();
         auto computeCommandBuffer = getCurrentComputeCommandBuffer();
 
+        gpuProfiler.endFrame();
+
+        if (timestampQueryPool != VK_NULL_HANDLE) {
+            vkCmdWriteTimestamp(graphicsCommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, currentFrameIndex * 2 + 1);
+            timestampFrameNumbers[currentFrameIndex] = frameNumber;
+            timestampsPending[currentFrameIndex] = true;
+        }
+
         if (vkEndCommandBuffer(graphicsCommandBuffer) != VK_SUCCESS) {
             Log::error("Failed to record graphics command buffer!");
             throw std::runtime_error("");
@@ -78,9 +115,13 @@ namespace ve {
             throw std::runtime_error("");
         }
 
+        Timer submitTimer;
+        // Resources uploaded while recording have to reach the queue ahead of the frame that uses them
+        device.getUploadContext().flush();
         auto result = swapChain->submitCommandBuffers(&graphicsCommandBuffer, &computeCommandBuffer, reinterpret_cast<uint32_t *>(&currentImageIndex));
+        currentFrameTimings.submitTime = submitTimer.ElapsedMillis();
 
-        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || Settings::changed()) {
+        if (window != nullptr && (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || Settings::changed())) {
             Settings::update();
             createSwapChain();
         } else if (result != VK_SUCCESS) {
@@ -90,9 +131,55 @@ namespace ve {
 
         isFrameStarted = false;
         currentFrameIndex = (currentFrameIndex + 1) % SwapChain::MAX_FRAMES_IN_FLIGHT;
+
+        lastFrameTimings = currentFrameTimings;
+        frameNumber++;
+    }
+
+    std::vector<GpuFrameTime> Renderer::collectGpuTimes() {
+        for (int i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+            resolveGpuTime(i, 0);
+        }
+
+        std::vector<GpuFrameTime> gpuTimes;
+        gpuTimes.swap(resolvedGpuTimes);
+        return gpuTimes;
+    }
+
+    void Renderer::resolveGpuTime(const int frameIndex, const VkQueryResultFlags flags) {
+        if (timestampQueryPool == VK_NULL_HANDLE || !timestampsPending[frameIndex]) {
+            return;
+        }
+
+        uint64_t timestamps[2];
+        const VkResult result = vkGetQueryPoolResults(
+                device.getDevice(),
+                timestampQueryPool,
+                frameIndex * 2,
+                2,
+                sizeof(timestamps),
+                timestamps,
+                sizeof(uint64_t),
+                VK_QUERY_RESULT_64_BIT | flags);
+
+        if (result == VK_NOT_READY) {
+            return;
+        }
+        if (result != VK_SUCCESS) {
+            Log::error("Failed to read frame timestamps!");
+            throw std::runtime_error("");
+        }
+
+        const uint32_t validBits = device.getGraphicsTimestampValidBits();
+        const uint64_t mask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+        const uint64_t ticks = (timestamps[1] - timestamps[0]) & mask;
+
+        lastGpuTime = static_cast<float>(static_cast<double>(ticks) * device.properties.limits.timestampPeriod * 1e-6);
+        resolvedGpuTimes.push_back({ timestampFrameNumbers[frameIndex], lastGpuTime });
+        timestampsPending[frameIndex] = false;
     }
 
-    void Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
+    void Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer, const VkSubpassContents contents) {
         if (!isFrameStarted) {
             Log::error("Can't call beginSwapChainRenderPass if frame is not in progress");
             throw std::runtime_error("");
@@ -117,7 +204,14 @@ namespace ve {
         renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
         renderPassInfo.pClearValues = clearValues.data();
 
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+
+        if (contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS) {
+            // The secondary buffers set their own viewport and scissor
+            secondaryRecorder.beginRenderPass(renderPassInfo.renderPass, renderPassInfo.framebuffer,
+                                              renderPassInfo.renderArea.extent);
+            return;
+        }
 
         VkViewport viewport{};
         viewport.x = 0.0f;
@@ -135,7 +229,7 @@ namespace ve {
         vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
     }
 
-    void Renderer::endSwapChainRenderPass(VkCommandBuffer commandBuffer) const {
+    void Renderer::endSwapChainRenderPass(VkCommandBuffer commandBuffer) {
         if (!isFrameStarted) {
             Log::error("Can't call endSwapChainRenderPass if frame is not in progress");
             throw std::runtime_error("");
@@ -146,6 +240,9 @@ namespace ve {
             throw std::runtime_error("");
         }
 
+        if (secondaryRecorder.isRecording()) {
+            secondaryRecorder.execute(commandBuffer);
+        }
         vkCmdEndRenderPass(commandBuffer);
     }
 
@@ -190,23 +287,54 @@ namespace ve {
     }
 
     void Renderer::createSwapChain() {
-        auto extent = window.getExtent();
-
         vkDeviceWaitIdle(device.getDevice());
 
+        if (window == nullptr) {
+            // Offscreen images never go out of date
+            if (swapChain == nullptr) {
+                swapChain = std::make_unique<OffscreenTarget>(device, extent);
+            }
+            return;
+        }
+
+        auto extent = window->getExtent();
+
         if (swapChain == nullptr) {
             swapChain = std::make_unique<SwapChain>(device, extent);
         } else {
-            std::shared_ptr<SwapChain> oldSwapChain = std::move(swapChain);
-            swapChain = std::make_unique<SwapChain>(device, extent, oldSwapChain);
+            std::shared_ptr<SwapChain> oldSwapChain(static_cast<SwapChain *>(swapChain.release()));
+            auto newSwapChain = std::make_unique<SwapChain>(device, extent, oldSwapChain);
+
+            const bool formatsMatch = oldSwapChain->compareSwapFormats(*newSwapChain);
+            swapChain = std::move(newSwapChain);
 
-            if (!oldSwapChain->compareSwapFormats(*swapChain)) {
+            if (!formatsMatch) {
                 Log::error("Swap chain image(or depth) format has changed!");
                 throw std::runtime_error("");
             }
         }
     }
 
+    void Renderer::createTimestampQueries() {
+        if (device.getGraphicsTimestampValidBits() == 0 || device.properties.limits.timestampPeriod == 0.0f) {
+            Log::warning("Graphics queue does not support timestamps, GPU frame times are unavailable");
+            return;
+        }
+
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = SwapChain::MAX_FRAMES_IN_FLIGHT * 2;
+
+        if (vkCreateQueryPool(device.getDevice(), &queryPoolInfo, nullptr, &timestampQueryPool) != VK_SUCCESS) {
+            Log::error("Failed to create timestamp query pool!");
+            throw std::runtime_error("");
+        }
+
+        timestampFrameNumbers.resize(SwapChain::MAX_FRAMES_IN_FLIGHT, 0);
+        timestampsPending.resize(SwapChain::MAX_FRAMES_IN_FLIGHT, false);
+    }
+
     void Renderer::createGlobalDescriptorPool() {
         DescriptorPool::Builder poolBuilder(device);
         globalDescriptorPool = poolBuilder
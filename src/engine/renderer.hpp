@@ -5,8 +5,12 @@
 #pragma once
 
 #include "swapChain.hpp"
+#include "offscreenTarget.hpp"
+#include "secondaryCommandRecorder.hpp"
 #include "../log.hpp"
+#include "../utils.hpp"
 #include "../engine/memory/descriptors.hpp"
+#include "profiling/gpuProfiler.hpp"
 
 namespace ve {
     struct FrameInfo {
@@ -15,11 +19,32 @@ namespace ve {
         VkCommandBuffer computeCommandBuffer;
         VkDescriptorSet globalDescriptorSet;
         DescriptorPool &frameDescriptorPool;
+        GpuProfiler &gpuProfiler;
+        // Set while the main pass takes secondary command buffers, its contents can't be recorded inline then
+        SecondaryCommandRecorder *secondaryRecorder = nullptr;
+    };
+
+    // CPU side timings of a frame, in milliseconds.
+    struct FrameTimings {
+        uint64_t frameNumber = 0;
+        // Blocked in acquire, waiting for the frame in flight to retire and for the presentation engine
+        float presentWaitTime = 0.0f;
+        // Between beginFrame and endFrame
+        float recordTime = 0.0f;
+        // Queue submits and present
+        float submitTime = 0.0f;
+    };
+
+    // Time the graphics queue spent on a frame, resolved a few frames after it was submitted.
+    struct GpuFrameTime {
+        uint64_t frameNumber;
+        float gpuTime;
     };
 
     class Renderer {
     public:
-        Renderer(Window &window, Device &device);
+        // A null window renders headless into offscreen images of the given extent.
+        Renderer(Window *window, Device &device, VkExtent2D extent);
         ~Renderer();
 
         bool shouldRecreateSwapChain = false;
@@ -47,6 +72,14 @@ namespace ve {
             return computeCommandBuffers[currentFrameIndex];
         }
 
+        VkImageView getCurrentDepthImageView() const {
+            if (!isFrameStarted) {
+                Log::error("Cannot get depth image when frame not in progress");
+                throw std::runtime_error("");
+            }
+            return swapChain->getDepthImageView(currentImageIndex);
+        }
+
         int getFrameIndex() const {
             if (!isFrameStarted) {
                 Log::error("Cannot get frame index when frame not in progress");
@@ -58,20 +91,35 @@ namespace ve {
         std::pair<VkCommandBuffer, VkCommandBuffer> beginFrame();
         void endFrame();
 
-        void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
-        void endSwapChainRenderPass(VkCommandBuffer commandBuffer) const;
+        // With VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS the pass is recorded through getSecondaryRecorder, the
+        // queued buffers are executed when it ends
+        void beginSwapChainRenderPass(VkCommandBuffer commandBuffer,
+                                      VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+        void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
         float getAspectRatio() const { return swapChain->getExtentAspectRatio(); }
 
+        const FrameTimings &getLastFrameTimings() const { return lastFrameTimings; }
+        float getLastGpuTime() const { return lastGpuTime; }
+        // Returns the GPU times resolved since the last call, without waiting on frames still in flight.
+        std::vector<GpuFrameTime> collectGpuTimes();
+
         std::unique_ptr<DescriptorPool> &getGlobalDescriptorPool() { return globalDescriptorPool; }
+        GpuProfiler &getGpuProfiler() { return gpuProfiler; }
+        const GpuProfiler &getGpuProfiler() const { return gpuProfiler; }
+        SecondaryCommandRecorder &getSecondaryRecorder() { return secondaryRecorder; }
+        const SecondaryCommandRecorder &getSecondaryRecorder() const { return secondaryRecorder; }
     private:
         void createCommandBuffers();
         void freeCommandBuffers();
         void createSwapChain();
+        void createTimestampQueries();
+        void resolveGpuTime(int frameIndex, VkQueryResultFlags flags);
 
-        Window &window;
+        Window *window;
         Device &device;
-        std::unique_ptr<SwapChain> swapChain;
+        VkExtent2D extent;
+        std::unique_ptr<FrameTarget> swapChain;
 
         std::vector<VkCommandBuffer> graphicsCommandBuffers{};
         std::vector<VkCommandBuffer> computeCommandBuffers{};
@@ -80,6 +128,21 @@ namespace ve {
         int currentFrameIndex = 0;
         bool isFrameStarted = false;
 
+        uint64_t frameNumber = 0;
+        FrameTimings currentFrameTimings{};
+        FrameTimings lastFrameTimings{};
+        Timer recordTimer;
+
+        // Two timestamps per frame in flight, bracketing the graphics command buffer
+        VkQueryPool timestampQueryPool = VK_NULL_HANDLE;
+        std::vector<uint64_t> timestampFrameNumbers{};
+        std::vector<bool> timestampsPending{};
+        std::vector<GpuFrameTime> resolvedGpuTimes{};
+        float lastGpuTime = 0.0f;
+
+        GpuProfiler gpuProfiler;
+        SecondaryCommandRecorder secondaryRecorder;
+
         std::unique_ptr<DescriptorPool> globalDescriptorPool;
 
         void createGlobalDescriptorPool();
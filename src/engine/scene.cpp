@@ -10,34 +10,47 @@
 
 #include "../engine/graphics/renderPrograms/grid.hpp"
 #include "../utils.hpp"
+#include "../benchmark/benchmark.hpp"
 #include "settings.hpp"
+#include "jobs/jobSystem.hpp"
 #include "../engine/compute/computePrograms/matrixSum.hpp"
 
 namespace ve {
     Scene *Scene::instance = nullptr;
 
-    Scene::Scene(Window &window) : window(window), device(window), renderer(window, device),
-                                   camera(75.0f, 0.001f, 1000.0f) {
-        window.addInputController(&camera);
-        window.addInputController(this);
+    Scene::Scene(Window *window, const LaunchOptions &options) : window(window), options(options), device(window),
+                                   renderer(window, device, options.extent), camera(75.0f, 0.001f, 1000.0f) {
+        if (window != nullptr) {
+            window->addInputController(&camera);
+            window->addInputController(this);
+        }
 
         framePools.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
         const auto framePoolBuilder = DescriptorPool::Builder(device)
             .setMaxSets(1000)
             .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1000)
             .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1000)
-            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1000);
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1000)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1000);
 
         for (auto& framePool : framePools) {
             framePool = framePoolBuilder.build();
         }
 
         Image::loadDefaultImage(device);
+        Settings::getInstance()->QUANTIZED_POSITIONS = options.quantizePositions;
+        Settings::getInstance()->OPTIMIZE_MESHES = options.optimizeMeshes;
+        Settings::getInstance()->OPTIMIZE_OVERDRAW = options.optimizeOverdraw;
+        Settings::getInstance()->GENERATE_LODS = options.generateLods;
+        Settings::getInstance()->GENERATE_MESHLETS = options.generateMeshlets;
+        Settings::getInstance()->LOD_PIXEL_ERROR = options.lodPixelError;
+        Settings::getInstance()->LOD_MIN_PIXEL_SIZE = options.lodMinPixelSize;
+        Mesh::createGeometryArenas(device);
     }
 
     void Scene::initImGui() {
         ImGui::CreateContext();
-        ImGui_ImplGlfw_InitForVulkan(window.getWindowHandle(), true);
+        ImGui_ImplGlfw_InitForVulkan(window->getWindowHandle(), true);
 
 //        DescriptorPool::Builder poolBuilder(device);
 //        static auto imGuiPool = poolBuilder
@@ -65,12 +78,13 @@ namespace ve {
         initInfo.Allocator = nullptr;
         initInfo.MinImageCount = 2;
         initInfo.ImageCount = 2;
-        initInfo.MSAASamples = VK_SAMPLE_COUNT_8_BIT;
+        initInfo.MSAASamples = device.getSampleCount();
         initInfo.CheckVkResultFn = nullptr;
         ImGui_ImplVulkan_Init(&initInfo, renderer.getSwapChainRenderPass());
     }
 
     void Scene::renderImGui(const VkCommandBuffer& commandBuffer) const {
+        VE_PROFILE_SCOPE("Scene::renderImGui");
         ImGui_ImplVulkan_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
@@ -79,18 +93,101 @@ namespace ve {
         auto [size, usage] = device.getMemorySize();
 
         ImGui::Text("Memory usage: %llu / %llu MB", usage / 1024 / 1024, size / 1024 / 1024);
+        const auto allocatorStats = device.getAllocator().getStats();
+        ImGui::Text("Allocations: %u in %u device memory objects (%u blocks, %u dedicated)",
+                    allocatorStats.allocationCount, allocatorStats.deviceMemoryCount,
+                    allocatorStats.blockCount, allocatorStats.dedicatedCount);
+        ImGui::Text("Allocator: %llu / %llu MB used",
+                    static_cast<unsigned long long>(allocatorStats.usedBytes / 1024 / 1024),
+                    static_cast<unsigned long long>(allocatorStats.reservedBytes / 1024 / 1024));
+        uint32_t meshCount = 0;
+        VkDeviceSize geometryUsed = 0;
+        VkDeviceSize geometryCapacity = 0;
+        for (const auto &[_, geometryArena] : Mesh::getGeometryArenas()) {
+            meshCount += geometryArena->getRangeCount();
+            geometryUsed += geometryArena->getUsedBytes();
+            geometryCapacity += geometryArena->getCapacityBytes();
+        }
+        ImGui::Text("Geometry: %u meshes in %zu vertex formats, %llu / %llu MB", meshCount,
+                    Mesh::getGeometryArenas().size(),
+                    static_cast<unsigned long long>(geometryUsed / 1024 / 1024),
+                    static_cast<unsigned long long>(geometryCapacity / 1024 / 1024));
+        renderStats();
         ImGui::Text("Frame Time: %f", frameTime);
         ImGui::Text("FPS: %f", 1.0f / frameTime * 1000.0f);
+
+        const auto &timings = renderer.getLastFrameTimings();
+        ImGui::Text("Record: %.3f ms", timings.recordTime);
+        if (Settings::getInstance()->PARALLEL_RECORDING) {
+            ImGui::Text("Secondary buffers: %u on %u threads", renderer.getSecondaryRecorder().getBufferCount(),
+                        renderer.getSecondaryRecorder().getThreadCount());
+        }
+        ImGui::Text("Submit: %.3f ms", timings.submitTime);
+        ImGui::Text("Present wait: %.3f ms", timings.presentWaitTime);
+        ImGui::Text("GPU: %.3f ms", renderer.getLastGpuTime());
+        ImGui::End();
+
+        ImGui::Begin("GPU Profiler");
+        if (ImGui::BeginTable("Scopes", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("Scope");
+            ImGui::TableSetupColumn("Time (ms)");
+            ImGui::TableSetupColumn("Vertices");
+            ImGui::TableSetupColumn("Fragments");
+            ImGui::TableSetupColumn("Clipping out / in");
+            ImGui::TableHeadersRow();
+
+            for (const auto &scope : renderer.getGpuProfiler().getLatestResults().scopes) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::Text("%*s%s%s", static_cast<int>(scope.depth) * 2, "", scope.name.c_str(),
+                            scope.queue == GpuProfiler::Queue::Compute ? " (compute)" : "");
+                ImGui::TableNextColumn();
+                if (scope.time >= 0.0f) {
+                    ImGui::Text("%.3f", scope.time);
+                }
+                if (scope.hasStatistics) {
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%llu", static_cast<unsigned long long>(scope.vertexInvocations));
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%llu", static_cast<unsigned long long>(scope.fragmentInvocations));
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%llu / %llu", static_cast<unsigned long long>(scope.clippingPrimitives),
+                                static_cast<unsigned long long>(scope.clippingInvocations));
+                }
+            }
+            ImGui::EndTable();
+        }
         ImGui::End();
 
         ImGui::Begin("Settings");
         ImGui::Checkbox("V-sync", &(Settings::getInstance()->VSYNC));
+        if (device.supportsIndirectDraw()) {
+            ImGui::Checkbox("Indirect draws", &(Settings::getInstance()->INDIRECT_DRAW));
+        }
+        if (device.supportsIndirectDrawCount()) {
+            ImGui::Checkbox("GPU culling", &(Settings::getInstance()->GPU_CULLING));
+            ImGui::Checkbox("Occlusion culling", &(Settings::getInstance()->OCCLUSION_CULLING));
+            ImGui::Checkbox("Cluster culling", &(Settings::getInstance()->CLUSTER_CULLING));
+        }
+        ImGui::Checkbox("CPU culling", &(Settings::getInstance()->CPU_CULLING));
+        ImGui::Checkbox("BVH culling", &(Settings::getInstance()->BVH_CULLING));
+        ImGui::Checkbox("Parallel recording", &(Settings::getInstance()->PARALLEL_RECORDING));
+        ImGui::Checkbox("LOD selection", &(Settings::getInstance()->LOD_SELECTION));
+        ImGui::SliderFloat("LOD pixel error", &(Settings::getInstance()->LOD_PIXEL_ERROR), 0.0f, 16.0f);
+        ImGui::SliderFloat("LOD minimum size", &(Settings::getInstance()->LOD_MIN_PIXEL_SIZE), 0.0f, 16.0f);
         ImGui::End();
 
         ImGui::Render();
         ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
     }
 
+    bool Scene::isRunning(const uint32_t renderedFrames) const {
+        if (options.frameCount > 0 && renderedFrames >= options.warmupFrames + options.frameCount) {
+            return false;
+        }
+        return window == nullptr || !window->shouldClose();
+    }
+
     void Scene::run() {
         std::vector<std::unique_ptr<Buffer>> uniformBuffers(SwapChain::MAX_FRAMES_IN_FLIGHT);
         for (auto& buffer : uniformBuffers) {
@@ -116,58 +213,159 @@ namespace ve {
                     .build(globalDescriptorSets[i]);
         }
 
-        init();
+        {
+            VE_PROFILE_SCOPE("Scene::init");
+            init();
+            // Gets the scene's uploads going while the rest is set up
+            device.getUploadContext().flush();
+        }
 
-        initImGui();
+        if (window != nullptr) {
+            initImGui();
+        }
 
         Grid grid(device, renderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout());
         MatrixSum sum(device, globalSetLayout->getDescriptorSetLayout());
 
-        while (!window.shouldClose()) {
-            window.pollEvents();
-            window.computeDeltaTime();
-            window.updateInputs();
+        // Headless runs have no window clock and benchmarks must be repeatable, step them at a fixed rate instead
+        constexpr float fixedDeltaTime = 1.0f / 60.0f;
+
+        std::unique_ptr<CameraPath> benchmarkPath;
+        std::unique_ptr<Benchmark> benchmark;
+        if (options.benchmark) {
+            benchmarkPath = createBenchmarkPath();
+            if (benchmarkPath == nullptr) {
+                Log::error(getName() + " has no benchmark camera path");
+                throw std::runtime_error("");
+            }
+            benchmark = std::make_unique<Benchmark>(options, fixedDeltaTime);
+        }
+
+        uint32_t renderedFrames = 0;
+        while (isRunning(renderedFrames)) {
+            VE_PROFILE_SCOPE("Frame");
+            float deltaTime = fixedDeltaTime;
+            if (window != nullptr) {
+                window->pollEvents();
+                window->computeDeltaTime();
+                window->updateInputs();
+                if (benchmark == nullptr) {
+                    deltaTime = window->getDeltaTime();
+                }
+            }
+
+            if (benchmarkPath != nullptr) {
+                const auto [position, target] = benchmarkPath->sample(static_cast<float>(renderedFrames) * fixedDeltaTime);
+                camera.setPose(position, target - position);
+            }
+
+            JobSystem::getInstance().processMainThreadJobs();
 
             const auto [width, height] = renderer.getSwapChainExtent();
             camera.resize(width, height);
-            camera.update(window.getDeltaTime());
+            camera.update(deltaTime);
 
             Timer timer;
+            bool frameRendered = false;
             if (auto [graphicsCommandBuffer, computeCommandBuffer] = renderer.beginFrame(); 
                 graphicsCommandBuffer != VK_NULL_HANDLE && computeCommandBuffer != VK_NULL_HANDLE) {
 	            const int frameIndex = renderer.getFrameIndex();
                 framePools[frameIndex]->resetPool();
+                for (const auto &[_, geometryArena] : Mesh::getGeometryArenas()) {
+                    geometryArena->nextFrame();
+                }
 
-                update(window.getDeltaTime());
+                {
+                    VE_PROFILE_SCOPE("Scene::update");
+                    update(deltaTime);
+                }
 
                 FrameInfo frameInfo{
                         frameIndex,
                         graphicsCommandBuffer,
                         computeCommandBuffer,
                         globalDescriptorSets[frameIndex],
-                        *framePools[frameIndex]
+                        *framePools[frameIndex],
+                        renderer.getGpuProfiler()
                 };
 
                 sum.computeMatrixSum(frameInfo);
 
-                renderer.beginSwapChainRenderPass(graphicsCommandBuffer);
-
-                auto cameraBufferData = camera.getCameraBufferData();
-                uniformBuffers[frameIndex]->writeToIndex(&cameraBufferData, 0);
-                uniformBuffers[frameIndex]->flush();
-
-                render(frameInfo);
-
-                // grid.renderGrid(frameInfo);
-                renderImGui(graphicsCommandBuffer);
-                renderer.endSwapChainRenderPass(graphicsCommandBuffer);
+                {
+                    VE_PROFILE_SCOPE("Scene::preRender");
+                    preRender(frameInfo);
+                }
+
+                {
+                    GpuProfiler::Scope mainPass(frameInfo.gpuProfiler, graphicsCommandBuffer, "Main pass");
+                    // Only vkCmdExecuteCommands may go into the primary buffer during a pass taking secondary
+                    // buffers, so the GPU scopes nested in the pass are only recorded inline
+                    const bool secondary = Settings::getInstance()->PARALLEL_RECORDING;
+                    if (secondary) {
+                        renderer.beginSwapChainRenderPass(graphicsCommandBuffer,
+                                                          VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+                        frameInfo.secondaryRecorder = &renderer.getSecondaryRecorder();
+                    } else {
+                        renderer.beginSwapChainRenderPass(graphicsCommandBuffer);
+                    }
+
+                    auto cameraBufferData = camera.getCameraBufferData();
+                    uniformBuffers[frameIndex]->writeToIndex(&cameraBufferData, 0);
+                    uniformBuffers[frameIndex]->flush();
+
+                    render(frameInfo);
+
+                    // grid.renderGrid(frameInfo);
+                    if (window != nullptr && secondary) {
+                        auto &recorder = renderer.getSecondaryRecorder();
+                        const VkCommandBuffer imGuiCommandBuffer = recorder.begin();
+                        renderImGui(imGuiCommandBuffer);
+                        SecondaryCommandRecorder::end(imGuiCommandBuffer);
+                        recorder.queue(imGuiCommandBuffer);
+                    } else if (window != nullptr) {
+                        GpuProfiler::Scope imGui(frameInfo.gpuProfiler, graphicsCommandBuffer, "ImGui", true);
+                        renderImGui(graphicsCommandBuffer);
+                    }
+                    renderer.endSwapChainRenderPass(graphicsCommandBuffer);
+                    frameInfo.secondaryRecorder = nullptr;
+                }
+
+                {
+                    VE_PROFILE_SCOPE("Scene::postRender");
+                    postRender(frameInfo);
+                }
                 renderer.endFrame();
 
                 result = sum.getResult();
+                renderedFrames++;
+                frameRendered = true;
             }
 
             frameTime = timer.ElapsedMillis();
+
+            const auto gpuTimes = renderer.collectGpuTimes();
+            const auto gpuScopes = renderer.getGpuProfiler().collectResults();
+            if (benchmark != nullptr) {
+                if (frameRendered) {
+                    benchmark->addFrame(renderer.getLastFrameTimings(), frameTime);
+                }
+                benchmark->addGpuTimes(gpuTimes);
+                benchmark->addGpuScopes(gpuScopes);
+            }
         }
         vkDeviceWaitIdle(device.getDevice());
+
+        if (benchmark != nullptr) {
+            benchmark->addGpuTimes(renderer.collectGpuTimes());
+            benchmark->addGpuScopes(renderer.getGpuProfiler().collectResults());
+            benchmark->write(getName(), device.properties.deviceName, renderer.getSwapChainExtent(),
+                             device.getSampleCount(), window != nullptr && Settings::getInstance()->VSYNC);
+        }
+
+        if (window == nullptr) {
+            const auto [width, height] = renderer.getSwapChainExtent();
+            Log::info("Rendered " + std::to_string(renderedFrames) + " headless frames at " +
+                      std::to_string(width) + "x" + std::to_string(height));
+        }
     }
 } // ve
\ No newline at end of file
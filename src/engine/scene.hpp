@@ -5,22 +5,27 @@
 #pragma once
 
 #include "renderer.hpp"
+#include "launchOptions.hpp"
 #include "../camera/camera.hpp"
+#include "../benchmark/cameraPath.hpp"
 
 namespace ve {
     class Scene : public InputController {
     private:
-        Window& window;
+        Window* window;
+        LaunchOptions options;
     protected:
         Device device;
         Renderer renderer;
-        explicit Scene(Window & window);
+        // A null window runs the scene headless for options.frameCount frames.
+        Scene(Window* window, const LaunchOptions& options);
         ~Scene() = default;
         static Scene* instance;
     private:
 
         void initImGui();
         void renderImGui(const VkCommandBuffer& commandBuffer) const;
+        bool isRunning(uint32_t renderedFrames) const;
 
     public:
         Scene(const Scene&) = delete;
@@ -31,7 +36,17 @@ namespace ve {
     protected:
         virtual void init() {}
         virtual void update(float deltaTime) {}
+        // Records work that has to stay outside of the main render pass, before and after it
+        virtual void preRender(FrameInfo& frameInfo) {}
         virtual void render(FrameInfo& frameInfo) {}
+        virtual void postRender(FrameInfo& frameInfo) {}
+        // Extra lines for the frame statistics window
+        virtual void renderStats() const {}
+        virtual std::string getName() const { return "Scene"; }
+        // Camera path played by --benchmark runs, scenes without one cannot be benchmarked.
+        virtual std::unique_ptr<CameraPath> createBenchmarkPath() const { return nullptr; }
+
+        const LaunchOptions& getOptions() const { return options; }
 
         Camera camera;
         std::unique_ptr<DescriptorSetLayout> globalSetLayout;
@@ -0,0 +1,147 @@
+#include "secondaryCommandRecorder.hpp"
+
+#include "jobs/jobSystem.hpp"
+#include "profiling/cpuProfiler.hpp"
+#include "../log.hpp"
+
+// std
+#include <stdexcept>
+
+namespace ve {
+    SecondaryCommandRecorder::SecondaryCommandRecorder(Device &device, const uint32_t threadCount)
+        : device(device), threadCount(threadCount) {
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = device.getQueueFamilyIndices().graphicsFamily;
+        // No RESET_COMMAND_BUFFER_BIT, the buffers are only ever reset with their pool
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+        for (auto &pools : frames) {
+            pools.resize(threadCount);
+            for (auto &pool : pools) {
+                if (vkCreateCommandPool(device.getDevice(), &poolInfo, nullptr, &pool.commandPool) != VK_SUCCESS) {
+                    Log::error("Failed to create secondary command pool!");
+                    throw std::runtime_error("");
+                }
+            }
+        }
+    }
+
+    SecondaryCommandRecorder::~SecondaryCommandRecorder() {
+        for (auto &pools : frames) {
+            for (auto &pool : pools) {
+                // Destroying the pool frees its buffers
+                vkDestroyCommandPool(device.getDevice(), pool.commandPool, nullptr);
+            }
+        }
+    }
+
+    void SecondaryCommandRecorder::beginFrame(const int frameIndex) {
+        VE_PROFILE_SCOPE("SecondaryCommandRecorder::beginFrame");
+        currentFrameIndex = frameIndex;
+        for (auto &pool : frames[frameIndex]) {
+            if (pool.used == 0) {
+                continue;
+            }
+            if (vkResetCommandPool(device.getDevice(), pool.commandPool, 0) != VK_SUCCESS) {
+                Log::error("Failed to reset secondary command pool!");
+                throw std::runtime_error("");
+            }
+            pool.used = 0;
+        }
+        inheritance = {};
+        queued.clear();
+    }
+
+    void SecondaryCommandRecorder::beginRenderPass(VkRenderPass renderPass, VkFramebuffer framebuffer,
+                                                   const VkExtent2D extent) {
+        inheritance = {};
+        inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritance.renderPass = renderPass;
+        inheritance.subpass = 0;
+        inheritance.framebuffer = framebuffer;
+        this->extent = extent;
+    }
+
+    VkCommandBuffer SecondaryCommandRecorder::begin() {
+        if (!isRecording()) {
+            Log::error("Can't begin a secondary command buffer outside of a render pass");
+            throw std::runtime_error("");
+        }
+
+        auto &pool = frames[currentFrameIndex][JobSystem::getInstance().getThreadIndex()];
+        if (pool.used == pool.commandBuffers.size()) {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocInfo.commandPool = pool.commandPool;
+            allocInfo.commandBufferCount = 1;
+
+            VkCommandBuffer commandBuffer;
+            if (vkAllocateCommandBuffers(device.getDevice(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+                Log::error("Failed to allocate secondary command buffer!");
+                throw std::runtime_error("");
+            }
+            pool.commandBuffers.push_back(commandBuffer);
+        }
+        VkCommandBuffer commandBuffer = pool.commandBuffers[pool.used++];
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        beginInfo.pInheritanceInfo = &inheritance;
+
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+            Log::error("Failed to begin recording secondary command buffer!");
+            throw std::runtime_error("");
+        }
+
+        VkViewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = (float) extent.width;
+        viewport.height = (float) extent.height;
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+
+        VkRect2D scissor{};
+        scissor.offset = {0, 0};
+        scissor.extent = extent;
+
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+        return commandBuffer;
+    }
+
+    void SecondaryCommandRecorder::end(VkCommandBuffer commandBuffer) {
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            Log::error("Failed to record secondary command buffer!");
+            throw std::runtime_error("");
+        }
+    }
+
+    void SecondaryCommandRecorder::queue(VkCommandBuffer commandBuffer) {
+        queued.push_back(commandBuffer);
+    }
+
+    void SecondaryCommandRecorder::queue(const std::vector<VkCommandBuffer> &commandBuffers) {
+        queued.insert(queued.end(), commandBuffers.begin(), commandBuffers.end());
+    }
+
+    void SecondaryCommandRecorder::execute(VkCommandBuffer primaryCommandBuffer) {
+        if (!queued.empty()) {
+            vkCmdExecuteCommands(primaryCommandBuffer, static_cast<uint32_t>(queued.size()), queued.data());
+        }
+        queued.clear();
+        inheritance = {};
+    }
+
+    uint32_t SecondaryCommandRecorder::getBufferCount() const {
+        uint32_t count = 0;
+        for (const auto &pool : frames[currentFrameIndex]) {
+            count += pool.used;
+        }
+        return count;
+    }
+} // ve
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "device.hpp"
+#include "swapChain.hpp"
+
+// std
+#include <array>
+#include <vector>
+
+namespace ve {
+    // Secondary command buffers for the render pass instance of the current frame, recorded from any thread of the
+    // job system. Every thread has its own command pool per frame in flight, so recording needs no locking, and the
+    // pools are reset wholesale when their frame slot comes around again.
+    class SecondaryCommandRecorder {
+    public:
+        SecondaryCommandRecorder(Device &device, uint32_t threadCount);
+        ~SecondaryCommandRecorder();
+
+        SecondaryCommandRecorder(const SecondaryCommandRecorder &) = delete;
+        SecondaryCommandRecorder &operator=(const SecondaryCommandRecorder &) = delete;
+
+        // The submission that last used the frame slot has to have completed
+        void beginFrame(int frameIndex);
+        // The render pass instance the buffers continue, begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+        void beginRenderPass(VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent);
+
+        // Begins a buffer from the calling thread's pool, with the viewport and scissor of the pass set since dynamic
+        // state is not inherited. Recording it and ending it with end stays on the calling thread.
+        VkCommandBuffer begin();
+        static void end(VkCommandBuffer commandBuffer);
+        // Ended buffers go out in the order they were queued, queued from the main thread only
+        void queue(VkCommandBuffer commandBuffer);
+        void queue(const std::vector<VkCommandBuffer> &commandBuffers);
+        // Executes the queued buffers into the primary buffer that holds the render pass instance
+        void execute(VkCommandBuffer primaryCommandBuffer);
+
+        bool isRecording() const { return inheritance.renderPass != VK_NULL_HANDLE; }
+        uint32_t getThreadCount() const { return threadCount; }
+        // Buffers begun this frame, over all threads
+        uint32_t getBufferCount() const;
+
+    private:
+        struct ThreadPool {
+            VkCommandPool commandPool = VK_NULL_HANDLE;
+            // Allocated once and reused after every reset, the first used of them were begun this frame
+            std::vector<VkCommandBuffer> commandBuffers;
+            uint32_t used = 0;
+        };
+
+        Device &device;
+        uint32_t threadCount;
+        std::array<std::vector<ThreadPool>, SwapChain::MAX_FRAMES_IN_FLIGHT> frames{};
+        int currentFrameIndex = 0;
+
+        VkCommandBufferInheritanceInfo inheritance{};
+        VkExtent2D extent{};
+        std::vector<VkCommandBuffer> queued;
+    };
+} // ve
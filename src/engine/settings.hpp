@@ -9,6 +9,40 @@ namespace ve {
     class Settings {
     public:
         bool VSYNC = true;
+        // Submit the scene with multi-draw indirect calls instead of one draw call per mesh
+        bool INDIRECT_DRAW = true;
+        // Cull the indirect draws on the GPU, against the frustum and, with OCCLUSION_CULLING, the previous frame's depth
+        bool GPU_CULLING = true;
+        bool OCCLUSION_CULLING = true;
+        // Frustum cull the draws on the CPU when they are not culled on the GPU
+        bool CPU_CULLING = true;
+        // Walk the scene BVH for the CPU culling instead of testing every draw
+        bool BVH_CULLING = false;
+        // Record the main pass into secondary command buffers, the scene draws in chunks on the job system threads.
+        // Off by default: the primary buffer only takes vkCmdExecuteCommands inside such a pass, so the GPU profiler
+        // then loses the Scene and ImGui scopes and their pipeline statistics, keeping only the Main pass time.
+        bool PARALLEL_RECORDING = false;
+        // Store positions as 16 bit unorm in each mesh's bounds. Meshes sharing an edge quantize it on different
+        // grids, which can open cracks between them, so it is off unless memory matters more. Read at load time.
+        bool QUANTIZED_POSITIONS = false;
+        // Reorder imported triangles for the post-transform vertex cache and their vertices for fetch locality, and
+        // with OPTIMIZE_OVERDRAW also in outward facing clusters. Read at load time.
+        bool OPTIMIZE_MESHES = true;
+        bool OPTIMIZE_OVERDRAW = false;
+        // Simplify imported meshes into coarser levels of detail sharing their vertices. Read at load time.
+        bool GENERATE_LODS = true;
+        // Split the full detail of larger imported meshes into meshlets with bounding spheres and normal cones.
+        // Read at load time.
+        bool GENERATE_MESHLETS = true;
+        // Cull the meshlets of the draws at full detail one by one with the GPU culling, including the ones facing
+        // away from the camera when the scene pipelines cull back faces
+        bool CLUSTER_CULLING = true;
+        // Draw each culled draw at the coarsest level of detail whose error projects to at most LOD_PIXEL_ERROR
+        // pixels, and cull the ones projected smaller than LOD_MIN_PIXEL_SIZE pixels across. Without culling every
+        // draw is at its full mesh.
+        bool LOD_SELECTION = true;
+        float LOD_PIXEL_ERROR = 1.0f;
+        float LOD_MIN_PIXEL_SIZE = 1.0f;
 
         static Settings* getInstance() {
             if (instance == nullptr) {
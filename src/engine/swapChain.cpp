@@ -5,6 +5,7 @@
 #include "swapChain.hpp"
 #include "../log.hpp"
 #include "settings.hpp"
+#include "profiling/cpuProfiler.hpp"
 
 #include <stdexcept>
 #include <array>
@@ -35,13 +36,13 @@ namespace ve {
         for (int i = 0; i < depthImages.size(); i++) {
             vkDestroyImageView(device.getDevice(), depthImageViews[i], nullptr);
             vkDestroyImage(device.getDevice(), depthImages[i], nullptr);
-            vkFreeMemory(device.getDevice(), depthImageMemorys[i], nullptr);
+            device.getAllocator().free(depthImageAllocations[i]);
         }
 
         for (int i = 0; i < colorImages.size(); i++) {
             vkDestroyImageView(device.getDevice(), colorImageViews[i], nullptr);
             vkDestroyImage(device.getDevice(), colorImages[i], nullptr);
-            vkFreeMemory(device.getDevice(), colorImageMemorys[i], nullptr);
+            device.getAllocator().free(colorImageAllocations[i]);
         }
 
         for (int i = 0; i < swapChainImages.size(); i++) {
@@ -183,13 +184,14 @@ namespace ve {
     void SwapChain::createRenderPass() {
         VkAttachmentDescription depthAttachment {};
         depthAttachment.format = findDepthFormat();
-        depthAttachment.samples = VK_SAMPLE_COUNT_8_BIT;
+        depthAttachment.samples = device.getSampleCount();
         depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
         depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        // The depth pyramid is built from it after the pass
+        depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
 
         VkAttachmentReference depthAttachmentRef {};
         depthAttachmentRef.attachment = 1;
@@ -197,7 +199,7 @@ namespace ve {
 
         VkAttachmentDescription colorAttachment {};
         colorAttachment.format = getSwapChainImageFormat();
-        colorAttachment.samples = VK_SAMPLE_COUNT_8_BIT;
+        colorAttachment.samples = device.getSampleCount();
         colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
         colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
         colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
@@ -236,13 +238,23 @@ namespace ve {
         subpass.pDepthStencilAttachment = &depthAttachmentRef;
         subpass.pResolveAttachments = &colorAttachmentResolveRef;
 
-        VkSubpassDependency dependency = {};
-        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-        dependency.srcAccessMask = 0;
-        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-        dependency.dstSubpass = 0;
-        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        std::array<VkSubpassDependency, 2> dependencies {};
+        dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[0].srcAccessMask = 0;
+        // Includes compute, the previous frame using this depth image may still be reading it into the depth pyramid
+        dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        dependencies[0].dstSubpass = 0;
+        dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+        // Make the depth visible to the depth pyramid build recorded after the render pass
+        dependencies[1].srcSubpass = 0;
+        dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
         VkRenderPassCreateInfo renderPassInfo {};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -250,8 +262,8 @@ namespace ve {
         renderPassInfo.pAttachments = attachments.data();
         renderPassInfo.subpassCount = 1;
         renderPassInfo.pSubpasses = &subpass;
-        renderPassInfo.dependencyCount = 1;
-        renderPassInfo.pDependencies = &dependency;
+        renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+        renderPassInfo.pDependencies = dependencies.data();
 
         if (vkCreateRenderPass(device.getDevice(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
             Log::error("Failed to create render pass!");
@@ -264,7 +276,7 @@ namespace ve {
         swapChainColorFormat = colorFormat;
 
         colorImages.resize(getImageCount());
-        colorImageMemorys.resize(getImageCount());
+        colorImageAllocations.resize(getImageCount());
         colorImageViews.resize(getImageCount());
 
         for (int i = 0; i < colorImages.size(); i++) {
@@ -280,7 +292,7 @@ namespace ve {
             imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
             imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
             imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-            imageInfo.samples = VK_SAMPLE_COUNT_8_BIT;
+            imageInfo.samples = device.getSampleCount();
             imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
             imageInfo.flags = 0;
 
@@ -288,7 +300,7 @@ namespace ve {
                     imageInfo,
                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                     colorImages[i],
-                    colorImageMemorys[i]);
+                    colorImageAllocations[i]);
 
             VkImageViewCreateInfo viewInfo {};
             viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -313,7 +325,7 @@ namespace ve {
         swapChainDepthFormat = depthFormat;
 
         depthImages.resize(getImageCount());
-        depthImageMemorys.resize(getImageCount());
+        depthImageAllocations.resize(getImageCount());
         depthImageViews.resize(getImageCount());
 
         for (int i = 0; i < depthImages.size(); i++) {
@@ -328,8 +340,8 @@ namespace ve {
             imageInfo.format = depthFormat;
             imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
             imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-            imageInfo.samples = VK_SAMPLE_COUNT_8_BIT;
+            imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+            imageInfo.samples = device.getSampleCount();
             imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
             imageInfo.flags = 0;
 
@@ -337,7 +349,7 @@ namespace ve {
                     imageInfo,
                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                     depthImages[i],
-                    depthImageMemorys[i]);
+                    depthImageAllocations[i]);
 
             VkImageViewCreateInfo viewInfo {};
             viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -416,6 +428,7 @@ namespace ve {
     }
 
     VkResult SwapChain::acquireNextImage(uint32_t *imageIndex) {
+        VE_PROFILE_SCOPE("SwapChain::acquireNextImage");
         vkWaitForFences(
             device.getDevice(),
             1,
@@ -435,6 +448,7 @@ namespace ve {
     }
 
     VkResult SwapChain::submitCommandBuffers(const VkCommandBuffer *graphicsBuffers, const VkCommandBuffer *computeBuffers, uint32_t *imageIndex) {
+        VE_PROFILE_SCOPE("SwapChain::submitCommandBuffers");
         if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
             vkWaitForFences(device.getDevice(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
         }
@@ -497,6 +511,7 @@ namespace ve {
             presentInfo.pSwapchains = swapChains;
             presentInfo.pImageIndices = imageIndex;
 
+            VE_PROFILE_SCOPE("vkQueuePresentKHR");
             result = vkQueuePresentKHR(device.getPresentQueue(), &presentInfo);
         }
 
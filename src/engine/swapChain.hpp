@@ -4,32 +4,31 @@
 
 #pragma once
 
-#include "device.hpp"
+#include "frameTarget.hpp"
 
 // std
 #include <memory>
 
 namespace ve {
-    class SwapChain {
+    class SwapChain : public FrameTarget {
     public:
-        static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
-
         SwapChain(Device &device, VkExtent2D windowExtent, const std::shared_ptr<SwapChain>& previous = nullptr);
-        ~SwapChain();
+        ~SwapChain() override;
 
         SwapChain(const SwapChain &) = delete;
         void operator=(const SwapChain &) = delete;
 
-        VkFramebuffer getFrameBuffer(int index) { return swapChainFrameBuffers[index]; }
-        VkRenderPass getRenderPass() { return renderPass; }
+        VkFramebuffer getFrameBuffer(int index) override { return swapChainFrameBuffers[index]; }
+        VkRenderPass getRenderPass() override { return renderPass; }
         VkImageView getImageView(int index) { return swapChainImageViews[index]; }
-        size_t getImageCount() { return swapChainImages.size(); }
+        VkImageView getDepthImageView(int index) override { return depthImageViews[index]; }
+        size_t getImageCount() override { return swapChainImages.size(); }
         VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
-        VkExtent2D getSwapChainExtent() { return swapChainExtent; }
+        VkExtent2D getSwapChainExtent() override { return swapChainExtent; }
         uint32_t width() const { return swapChainExtent.width; }
         uint32_t height() const { return swapChainExtent.height; }
 
-        float getExtentAspectRatio() const {
+        float getExtentAspectRatio() const override {
             return static_cast<float>(swapChainExtent.width) / static_cast<float>(swapChainExtent.height);
         }
 
@@ -37,14 +36,14 @@ namespace ve {
             return device.findSupportedFormat(
                     {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
                     VK_IMAGE_TILING_OPTIMAL,
-                    VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+                    VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
         }
 
-        VkResult acquireNextImage(uint32_t *imageIndex);
+        VkResult acquireNextImage(uint32_t *imageIndex) override;
         VkResult submitCommandBuffers(
                 const VkCommandBuffer *graphicsBuffers,
                 const VkCommandBuffer *computeBuffers,
-                uint32_t *imageIndex);
+                uint32_t *imageIndex) override;
 
         bool compareSwapFormats(const SwapChain &swapChain) const {
             return swapChain.swapChainDepthFormat == swapChainDepthFormat &&
@@ -74,11 +73,11 @@ namespace ve {
         VkRenderPass renderPass;
 
         std::vector<VkImage> depthImages;
-        std::vector<VkDeviceMemory> depthImageMemorys;
+        std::vector<Allocation> depthImageAllocations;
         std::vector<VkImageView> depthImageViews;
 
         std::vector<VkImage> colorImages;
-        std::vector<VkDeviceMemory> colorImageMemorys;
+        std::vector<Allocation> colorImageAllocations;
         std::vector<VkImageView> colorImageViews;
 
         std::vector<VkImage> swapChainImages;
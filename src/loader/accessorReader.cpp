@@ -0,0 +1,637 @@
+#include "accessorReader.hpp"
+
+#include "../log.hpp"
+
+// std
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define VE_ACCESSOR_SSE
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    using ComponentType = GLTFDocument::ComponentType;
+
+    // What the decoded values are multiplied with, after which signed normalized values are clamped to -1. The
+    // reciprocal rather than a division keeps the scalar and SSE paths bit for bit equal.
+    float getNormalization(const ComponentType componentType, const bool normalized)
+    {
+        if (!normalized)
+        {
+            return 1.0f;
+        }
+        switch (componentType)
+        {
+        case ComponentType::Byte:
+            return 1.0f / 127.0f;
+        case ComponentType::UnsignedByte:
+            return 1.0f / 255.0f;
+        case ComponentType::Short:
+            return 1.0f / 32767.0f;
+        case ComponentType::UnsignedShort:
+            return 1.0f / 65535.0f;
+        case ComponentType::UnsignedInt:
+            return 1.0f / 4294967295.0f;
+        case ComponentType::Float:
+            return 1.0f;
+        }
+        return 1.0f;
+    }
+
+    bool isSigned(const ComponentType componentType)
+    {
+        return componentType == ComponentType::Byte || componentType == ComponentType::Short;
+    }
+
+    // Per element arguments shared by the kernels, computed once per read
+    struct Conversion
+    {
+        uint32_t componentCount;
+        uint32_t destinationCount;
+        // Normalization times scale for the components the accessor has, only scale for signed normalized
+        // values, which are clamped in between
+        float factor[4];
+        float scale[4];
+        // Zero for the components the accessor has, fill for the rest
+        float tail[4];
+        bool clamp;
+    };
+
+    template <ComponentType T>
+    float loadComponent(const uint8_t *source)
+    {
+        if constexpr (T == ComponentType::Byte)
+        {
+            int8_t value;
+            std::memcpy(&value, source, sizeof(value));
+            return static_cast<float>(value);
+        }
+        else if constexpr (T == ComponentType::UnsignedByte)
+        {
+            return static_cast<float>(*source);
+        }
+        else if constexpr (T == ComponentType::Short)
+        {
+            int16_t value;
+            std::memcpy(&value, source, sizeof(value));
+            return static_cast<float>(value);
+        }
+        else if constexpr (T == ComponentType::UnsignedShort)
+        {
+            uint16_t value;
+            std::memcpy(&value, source, sizeof(value));
+            return static_cast<float>(value);
+        }
+        else if constexpr (T == ComponentType::UnsignedInt)
+        {
+            uint32_t value;
+            std::memcpy(&value, source, sizeof(value));
+            return static_cast<float>(value);
+        }
+        else
+        {
+            float value;
+            std::memcpy(&value, source, sizeof(value));
+            return value;
+        }
+    }
+
+    template <ComponentType T>
+    void decodeScalar(const uint8_t *source, const size_t sourceStride, const size_t count, float *destination,
+                      const size_t destinationStride, const Conversion &conversion)
+    {
+        constexpr size_t componentSize = T == ComponentType::Byte || T == ComponentType::UnsignedByte ? 1
+                                       : T == ComponentType::Short || T == ComponentType::UnsignedShort ? 2 : 4;
+        for (size_t i = 0; i < count; i++)
+        {
+            const uint8_t *element = source + i * sourceStride;
+            auto *output = reinterpret_cast<float *>(reinterpret_cast<uint8_t *>(destination) + i * destinationStride);
+            for (uint32_t c = 0; c < conversion.destinationCount; c++)
+            {
+                float value = 0.0f;
+                if (c < conversion.componentCount)
+                {
+                    value = loadComponent<T>(element + c * componentSize) * conversion.factor[c];
+                    if (conversion.clamp)
+                    {
+                        value = std::max(value, -1.0f) * conversion.scale[c];
+                    }
+                }
+                output[c] = value + conversion.tail[c];
+            }
+        }
+    }
+
+#ifdef VE_ACCESSOR_SSE
+    // Exactly B bytes into the low bytes of a register, the rest zero. Reading more could run past the end of the
+    // mapping on the last element, and going through a partially written stack slot stalls store forwarding.
+    template <size_t B>
+    __m128i loadBytes(const uint8_t *source)
+    {
+        if constexpr (B == 16)
+        {
+            return _mm_loadu_si128(reinterpret_cast<const __m128i *>(source));
+        }
+        else if constexpr (B == 12)
+        {
+            int32_t last;
+            std::memcpy(&last, source + 8, sizeof(last));
+            return _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(source)),
+                                      _mm_cvtsi32_si128(last));
+        }
+        else if constexpr (B == 8)
+        {
+            return _mm_loadl_epi64(reinterpret_cast<const __m128i *>(source));
+        }
+        else if constexpr (B == 6)
+        {
+            int32_t low;
+            uint16_t high;
+            std::memcpy(&low, source, sizeof(low));
+            std::memcpy(&high, source + 4, sizeof(high));
+            return _mm_insert_epi16(_mm_cvtsi32_si128(low), high, 2);
+        }
+        else if constexpr (B == 4)
+        {
+            int32_t value;
+            std::memcpy(&value, source, sizeof(value));
+            return _mm_cvtsi32_si128(value);
+        }
+        else if constexpr (B == 3)
+        {
+            uint16_t low;
+            std::memcpy(&low, source, sizeof(low));
+            return _mm_cvtsi32_si128(low | source[2] << 16);
+        }
+        else if constexpr (B == 2)
+        {
+            uint16_t value;
+            std::memcpy(&value, source, sizeof(value));
+            return _mm_cvtsi32_si128(value);
+        }
+        else
+        {
+            return _mm_cvtsi32_si128(source[0]);
+        }
+    }
+
+    // The components of one element in the low lanes as floats, the other lanes zero
+    template <ComponentType T, uint32_t N>
+    __m128 loadSse(const uint8_t *source)
+    {
+        constexpr size_t componentSize = T == ComponentType::Byte || T == ComponentType::UnsignedByte ? 1
+                                       : T == ComponentType::Short || T == ComponentType::UnsignedShort ? 2 : 4;
+        __m128i raw = loadBytes<N * componentSize>(source);
+
+        if constexpr (T == ComponentType::Float)
+        {
+            return _mm_castsi128_ps(raw);
+        }
+        else if constexpr (T == ComponentType::UnsignedByte)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            raw = _mm_unpacklo_epi16(_mm_unpacklo_epi8(raw, zero), zero);
+        }
+        else if constexpr (T == ComponentType::Byte)
+        {
+            // Every byte ends up at the top of its lane and is shifted down keeping its sign
+            raw = _mm_unpacklo_epi8(raw, raw);
+            raw = _mm_srai_epi32(_mm_unpacklo_epi16(raw, raw), 24);
+        }
+        else if constexpr (T == ComponentType::UnsignedShort)
+        {
+            raw = _mm_unpacklo_epi16(raw, _mm_setzero_si128());
+        }
+        else if constexpr (T == ComponentType::Short)
+        {
+            raw = _mm_srai_epi32(_mm_unpacklo_epi16(raw, raw), 16);
+        }
+        return _mm_cvtepi32_ps(raw);
+    }
+
+    template <uint32_t N>
+    void storeSse(float *destination, const __m128 value)
+    {
+        if constexpr (N == 1)
+        {
+            _mm_store_ss(destination, value);
+        }
+        else if constexpr (N == 2)
+        {
+            _mm_storel_pi(reinterpret_cast<__m64 *>(destination), value);
+        }
+        else if constexpr (N == 3)
+        {
+            _mm_storel_pi(reinterpret_cast<__m64 *>(destination), value);
+            _mm_store_ss(destination + 2, _mm_movehl_ps(value, value));
+        }
+        else
+        {
+            _mm_storeu_ps(destination, value);
+        }
+    }
+
+    // N components read, D written
+    template <ComponentType T, uint32_t N, uint32_t D>
+    void decodeSse(const uint8_t *source, const size_t sourceStride, const size_t count, float *destination,
+                   const size_t destinationStride, const Conversion &conversion)
+    {
+        const __m128 factor = _mm_loadu_ps(conversion.factor);
+        const __m128 scale = _mm_loadu_ps(conversion.scale);
+        const __m128 tail = _mm_loadu_ps(conversion.tail);
+        const __m128 minusOne = _mm_set1_ps(-1.0f);
+        for (size_t i = 0; i < count; i++)
+        {
+            __m128 value = _mm_mul_ps(loadSse<T, N>(source + i * sourceStride), factor);
+            if (conversion.clamp)
+            {
+                value = _mm_mul_ps(_mm_max_ps(value, minusOne), scale);
+            }
+            value = _mm_add_ps(value, tail);
+            storeSse<D>(reinterpret_cast<float *>(reinterpret_cast<uint8_t *>(destination) + i * destinationStride),
+                        value);
+        }
+    }
+
+    template <ComponentType T, uint32_t D>
+    void decodeSse(const uint8_t *source, const size_t sourceStride, const size_t count, float *destination,
+                   const size_t destinationStride, const Conversion &conversion)
+    {
+        switch (conversion.componentCount)
+        {
+        case 1:
+            decodeSse<T, 1, D>(source, sourceStride, count, destination, destinationStride, conversion);
+            break;
+        case 2:
+            decodeSse<T, 2, D>(source, sourceStride, count, destination, destinationStride, conversion);
+            break;
+        case 3:
+            decodeSse<T, 3, D>(source, sourceStride, count, destination, destinationStride, conversion);
+            break;
+        default:
+            decodeSse<T, 4, D>(source, sourceStride, count, destination, destinationStride, conversion);
+            break;
+        }
+    }
+
+    template <ComponentType T>
+    void decodeSse(const uint8_t *source, const size_t sourceStride, const size_t count, float *destination,
+                   const size_t destinationStride, const Conversion &conversion)
+    {
+        switch (conversion.destinationCount)
+        {
+        case 1:
+            decodeSse<T, 1>(source, sourceStride, count, destination, destinationStride, conversion);
+            break;
+        case 2:
+            decodeSse<T, 2>(source, sourceStride, count, destination, destinationStride, conversion);
+            break;
+        case 3:
+            decodeSse<T, 3>(source, sourceStride, count, destination, destinationStride, conversion);
+            break;
+        default:
+            decodeSse<T, 4>(source, sourceStride, count, destination, destinationStride, conversion);
+            break;
+        }
+    }
+#endif
+
+    template <ComponentType T>
+    void decode(const AccessorReader::Path path, const uint8_t *source, const size_t sourceStride, const size_t count,
+                float *destination, const size_t destinationStride, const Conversion &conversion)
+    {
+#ifdef VE_ACCESSOR_SSE
+        // Unsigned ints past 2^31 don't survive the signed conversion, they are rare enough to stay scalar
+        if (path == AccessorReader::Path::Sse && T != ComponentType::UnsignedInt)
+        {
+            decodeSse<T>(source, sourceStride, count, destination, destinationStride, conversion);
+            return;
+        }
+#endif
+        decodeScalar<T>(source, sourceStride, count, destination, destinationStride, conversion);
+    }
+
+    void decode(const AccessorReader::Path path, const ComponentType componentType, const uint8_t *source,
+                const size_t sourceStride, const size_t count, float *destination, const size_t destinationStride,
+                const Conversion &conversion)
+    {
+        switch (componentType)
+        {
+        case ComponentType::Byte:
+            decode<ComponentType::Byte>(path, source, sourceStride, count, destination, destinationStride, conversion);
+            break;
+        case ComponentType::UnsignedByte:
+            decode<ComponentType::UnsignedByte>(path, source, sourceStride, count, destination, destinationStride, conversion);
+            break;
+        case ComponentType::Short:
+            decode<ComponentType::Short>(path, source, sourceStride, count, destination, destinationStride, conversion);
+            break;
+        case ComponentType::UnsignedShort:
+            decode<ComponentType::UnsignedShort>(path, source, sourceStride, count, destination, destinationStride, conversion);
+            break;
+        case ComponentType::UnsignedInt:
+            decode<ComponentType::UnsignedInt>(path, source, sourceStride, count, destination, destinationStride, conversion);
+            break;
+        case ComponentType::Float:
+            decode<ComponentType::Float>(path, source, sourceStride, count, destination, destinationStride, conversion);
+            break;
+        }
+    }
+
+    size_t loadIndex(const uint8_t *source, const ComponentType componentType)
+    {
+        switch (componentType)
+        {
+        case ComponentType::UnsignedByte:
+            return *source;
+        case ComponentType::UnsignedShort:
+        {
+            uint16_t value;
+            std::memcpy(&value, source, sizeof(value));
+            return value;
+        }
+        default:
+        {
+            uint32_t value;
+            std::memcpy(&value, source, sizeof(value));
+            return value;
+        }
+        }
+    }
+
+    bool isIndexType(const ComponentType componentType)
+    {
+        return componentType == ComponentType::UnsignedByte || componentType == ComponentType::UnsignedShort ||
+               componentType == ComponentType::UnsignedInt;
+    }
+
+    template <typename I>
+    void copyIndices(const uint8_t *source, const size_t sourceStride, const size_t count, uint32_t *destination)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            I value;
+            std::memcpy(&value, source + i * sourceStride, sizeof(value));
+            destination[i] = value;
+        }
+    }
+
+    [[noreturn]] void fail(const uint32_t accessorIndex, const std::string &message)
+    {
+        Log::error("Accessor " + std::to_string(accessorIndex) + " " + message);
+        throw std::runtime_error("");
+    }
+
+    // Source of the elements of a sparse accessor without a buffer view
+    constexpr uint8_t ZEROS[16]{};
+}
+
+AccessorReader::AccessorReader(const GLTFDocument &document, const std::vector<BufferData> &buffers, const Path path)
+    : document(document), buffers(buffers), path(isSupported(path) ? path : Path::Scalar)
+{
+}
+
+const uint8_t *AccessorReader::getData(const uint32_t bufferViewIndex, const size_t byteOffset, const size_t size) const
+{
+    const auto &bufferView = document.bufferViews[bufferViewIndex];
+    const auto &buffer = buffers[bufferView.buffer];
+    // The mapping ends where the file does, reading past it would fault instead of reading garbage
+    if (byteOffset + size > bufferView.byteLength || bufferView.byteOffset + bufferView.byteLength > buffer.size)
+    {
+        return nullptr;
+    }
+    return buffer.data + bufferView.byteOffset + byteOffset;
+}
+
+AccessorReader::Accessor AccessorReader::get(const uint32_t accessorIndex) const
+{
+    const auto &accessor = document.accessors[accessorIndex];
+
+    Accessor result{};
+    result.count = accessor.count;
+    result.componentType = accessor.componentType;
+    result.componentCount = GLTFDocument::getComponentCount(accessor.type);
+    result.normalized = accessor.normalized;
+    if (result.componentCount > 4)
+    {
+        fail(accessorIndex, "is a matrix, only scalars and vectors can be read");
+    }
+
+    const size_t elementSize = GLTFDocument::getComponentSize(accessor.componentType) * result.componentCount;
+    if (accessor.bufferView.has_value())
+    {
+        const auto byteStride = document.bufferViews[*accessor.bufferView].byteStride;
+        result.stride = byteStride != 0 ? byteStride : elementSize;
+        const size_t size = result.count == 0 ? 0 : (result.count - 1) * result.stride + elementSize;
+        result.data = getData(*accessor.bufferView, accessor.byteOffset, size);
+        if (result.data == nullptr)
+        {
+            fail(accessorIndex, "reads past the end of its buffer");
+        }
+    }
+    else if (!accessor.sparse.has_value())
+    {
+        fail(accessorIndex, "has neither a buffer view nor sparse values");
+    }
+
+    if (accessor.sparse.has_value())
+    {
+        const auto &sparse = *accessor.sparse;
+        if (!isIndexType(sparse.indicesComponentType))
+        {
+            fail(accessorIndex, "has sparse indices of an invalid type");
+        }
+
+        result.sparseCount = sparse.count;
+        result.sparseIndexType = sparse.indicesComponentType;
+        const size_t indexSize = GLTFDocument::getComponentSize(sparse.indicesComponentType);
+        result.sparseIndices = getData(sparse.indicesBufferView, sparse.indicesByteOffset, sparse.count * indexSize);
+        result.sparseValues = getData(sparse.valuesBufferView, sparse.valuesByteOffset, sparse.count * elementSize);
+        if (result.sparseIndices == nullptr || result.sparseValues == nullptr)
+        {
+            fail(accessorIndex, "has sparse data past the end of its buffer");
+        }
+
+        // read relies on this to find the first sparse element of a range with a binary search
+        size_t previous = 0;
+        for (size_t i = 0; i < sparse.count; i++)
+        {
+            const size_t index = loadIndex(result.sparseIndices + i * indexSize, sparse.indicesComponentType);
+            if (index >= result.count || (i > 0 && index <= previous))
+            {
+                fail(accessorIndex, "has sparse indices that are out of range or not increasing");
+            }
+            previous = index;
+        }
+    }
+    return result;
+}
+
+void AccessorReader::read(
+    const Accessor &accessor, const size_t first, const size_t count, const uint32_t componentCount,
+    float *destination, const size_t destinationStride, const float *scale, const float *fill) const
+{
+    if (count == 0)
+    {
+        return;
+    }
+    checkRange(accessor, first, count);
+
+    Conversion conversion{};
+    conversion.componentCount = std::min(accessor.componentCount, componentCount);
+    conversion.destinationCount = componentCount;
+    conversion.clamp = accessor.normalized && isSigned(accessor.componentType);
+    const float normalization = getNormalization(accessor.componentType, accessor.normalized);
+    for (uint32_t c = 0; c < 4; c++)
+    {
+        const bool present = c < conversion.componentCount;
+        const float componentScale = c < componentCount ? scale[c] : 1.0f;
+        conversion.scale[c] = present ? componentScale : 0.0f;
+        conversion.factor[c] = present ? (conversion.clamp ? normalization : normalization * componentScale) : 0.0f;
+        conversion.tail[c] = present || c >= componentCount ? 0.0f : fill[c];
+    }
+
+    if (accessor.data != nullptr)
+    {
+        decode(path, accessor.componentType, accessor.data + first * accessor.stride, accessor.stride, count,
+               destination, destinationStride, conversion);
+    }
+    else
+    {
+        // Stride 0 keeps reading the same zeros
+        decode(path, accessor.componentType, ZEROS, 0, count, destination, destinationStride, conversion);
+    }
+
+    if (accessor.sparseCount == 0)
+    {
+        return;
+    }
+
+    const size_t indexSize = GLTFDocument::getComponentSize(accessor.sparseIndexType);
+    const size_t valueSize = GLTFDocument::getComponentSize(accessor.componentType) * accessor.componentCount;
+    for (size_t i = findSparse(accessor, first); i < accessor.sparseCount; i++)
+    {
+        const size_t index = loadIndex(accessor.sparseIndices + i * indexSize, accessor.sparseIndexType);
+        if (index >= first + count)
+        {
+            break;
+        }
+        auto *output = reinterpret_cast<float *>(reinterpret_cast<uint8_t *>(destination) + (index - first) * destinationStride);
+        decode(path, accessor.componentType, accessor.sparseValues + i * valueSize, valueSize, 1, output,
+               destinationStride, conversion);
+    }
+}
+
+void AccessorReader::readIndices(const Accessor &accessor, const size_t first, const size_t count,
+                                 uint32_t *destination) const
+{
+    if (count == 0)
+    {
+        return;
+    }
+    checkRange(accessor, first, count);
+    if (accessor.componentCount != 1 || accessor.normalized || !isIndexType(accessor.componentType))
+    {
+        Log::error("Indices have to be unsigned byte, short or int scalars");
+        throw std::runtime_error("");
+    }
+
+    const size_t indexSize = GLTFDocument::getComponentSize(accessor.componentType);
+    if (accessor.data != nullptr)
+    {
+        switch (accessor.componentType)
+        {
+        case ComponentType::UnsignedByte:
+            copyIndices<uint8_t>(accessor.data + first * accessor.stride, accessor.stride, count, destination);
+            break;
+        case ComponentType::UnsignedShort:
+            copyIndices<uint16_t>(accessor.data + first * accessor.stride, accessor.stride, count, destination);
+            break;
+        default:
+            copyIndices<uint32_t>(accessor.data + first * accessor.stride, accessor.stride, count, destination);
+            break;
+        }
+    }
+    else
+    {
+        std::fill(destination, destination + count, 0u);
+    }
+
+    const size_t sparseIndexSize = GLTFDocument::getComponentSize(accessor.sparseIndexType);
+    for (size_t i = findSparse(accessor, first); i < accessor.sparseCount; i++)
+    {
+        const size_t index = loadIndex(accessor.sparseIndices + i * sparseIndexSize, accessor.sparseIndexType);
+        if (index >= first + count)
+        {
+            break;
+        }
+        destination[index - first] =
+            static_cast<uint32_t>(loadIndex(accessor.sparseValues + i * indexSize, accessor.componentType));
+    }
+}
+
+void AccessorReader::checkRange(const Accessor &accessor, const size_t first, const size_t count)
+{
+    if (first + count > accessor.count)
+    {
+        Log::error("Read of elements " + std::to_string(first) + " to " + std::to_string(first + count) +
+                   " from an accessor of " + std::to_string(accessor.count));
+        throw std::runtime_error("");
+    }
+}
+
+size_t AccessorReader::findSparse(const Accessor &accessor, const size_t first)
+{
+    const size_t indexSize = GLTFDocument::getComponentSize(accessor.sparseIndexType);
+    size_t low = 0, high = accessor.sparseCount;
+    while (low < high)
+    {
+        const size_t middle = (low + high) / 2;
+        if (loadIndex(accessor.sparseIndices + middle * indexSize, accessor.sparseIndexType) < first)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+bool AccessorReader::isSupported(const Path path)
+{
+    switch (path)
+    {
+    case Path::Scalar:
+        return true;
+#ifdef VE_ACCESSOR_SSE
+    case Path::Sse:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+AccessorReader::Path AccessorReader::getBestPath()
+{
+    return isSupported(Path::Sse) ? Path::Sse : Path::Scalar;
+}
+
+const char *AccessorReader::getPathName(const Path path)
+{
+    switch (path)
+    {
+    case Path::Scalar:
+        return "scalar";
+    case Path::Sse:
+        return "SSE";
+    }
+    return "unknown";
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "gltfDocument.hpp"
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bytes of a glTF buffer, inside one of the mapped files
+struct BufferData
+{
+	const uint8_t *data = nullptr;
+	size_t size = 0;
+};
+
+// Decodes glTF accessors of any component type, normalized or not (KHR_mesh_quantization), strided or sparse, into
+// float vectors at a given stride, so attributes go straight into an interleaved vertex layout. Conversion is done
+// a whole element per SSE instruction when the CPU has it.
+class AccessorReader
+{
+public:
+	enum class Path { Scalar, Sse };
+
+	// An accessor checked against its buffers, with everything needed to decode it resolved
+	struct Accessor
+	{
+		// Null for a sparse accessor without a buffer view, whose elements start out as zeros
+		const uint8_t *data = nullptr;
+		size_t stride = 0;
+		size_t count = 0;
+		GLTFDocument::ComponentType componentType = GLTFDocument::ComponentType::Float;
+		uint32_t componentCount = 0;
+		bool normalized = false;
+
+		size_t sparseCount = 0;
+		const uint8_t *sparseIndices = nullptr;
+		GLTFDocument::ComponentType sparseIndexType = GLTFDocument::ComponentType::UnsignedInt;
+		const uint8_t *sparseValues = nullptr;
+	};
+
+	AccessorReader(const GLTFDocument &document, const std::vector<BufferData> &buffers, Path path = getBestPath());
+
+	Accessor get(uint32_t accessorIndex) const;
+
+	// Reads elements first to first + count - 1 into destination, destinationStride bytes apart. T is a float vector,
+	// components the accessor doesn't have are taken from fill, the others are multiplied by scale after
+	// normalization (to flip axes).
+	template <typename T>
+	void read(const Accessor &accessor, size_t first, size_t count, T *destination, size_t destinationStride,
+	          const T &scale = T(1.0f), const T &fill = T(0.0f)) const
+	{
+		static_assert(sizeof(T) % sizeof(float) == 0 && sizeof(T) <= 4 * sizeof(float), "T has to be a float vector");
+		read(accessor, first, count, sizeof(T) / sizeof(float), reinterpret_cast<float *>(destination),
+		     destinationStride, reinterpret_cast<const float *>(&scale), reinterpret_cast<const float *>(&fill));
+	}
+
+	// Reads unsigned integer scalars, a primitive's indices, as they are rather than through floats
+	void readIndices(const Accessor &accessor, size_t first, size_t count, uint32_t *destination) const;
+
+	Path getPath() const { return path; }
+
+	static bool isSupported(Path path);
+	static Path getBestPath();
+	static const char *getPathName(Path path);
+
+private:
+	void read(const Accessor &accessor, size_t first, size_t count, uint32_t componentCount, float *destination,
+	          size_t destinationStride, const float *scale, const float *fill) const;
+	static void checkRange(const Accessor &accessor, size_t first, size_t count);
+	// First sparse element whose index is at or after first
+	static size_t findSparse(const Accessor &accessor, size_t first);
+	// Where a buffer view plus an offset starts, checking that size bytes from there stay inside the view
+	const uint8_t *getData(uint32_t bufferViewIndex, size_t byteOffset, size_t size) const;
+
+	const GLTFDocument &document;
+	const std::vector<BufferData> &buffers;
+	Path path;
+};
@@ -0,0 +1,502 @@
+#include "gltfDocument.hpp"
+
+#include "../engine/profiling/cpuProfiler.hpp"
+#include "../log.hpp"
+
+// vendor
+#define SIMDJSON_USING_LIBRARY
+#include <simdjson.h>
+
+// std
+#include <stdexcept>
+
+namespace
+{
+    using simdjson::dom::array;
+    using simdjson::dom::element;
+    using simdjson::dom::object;
+
+    [[noreturn]] void fail(const std::string &message)
+    {
+        Log::error("Invalid glTF document: " + message);
+        throw std::runtime_error("");
+    }
+
+    object asObject(const element &value, const std::string_view what)
+    {
+        object result;
+        if (value.get(result))
+        {
+            fail(std::string(what) + " is not an object");
+        }
+        return result;
+    }
+
+    // Optional members come back as the fallback when they are missing, but a member of the wrong type is an error
+    template <typename T>
+    bool get(const object &parent, const std::string_view key, T &value)
+    {
+        const auto error = parent[key].get(value);
+        if (error == simdjson::NO_SUCH_FIELD)
+        {
+            return false;
+        }
+        if (error)
+        {
+            fail(std::string(key) + ": " + simdjson::error_message(error));
+        }
+        return true;
+    }
+
+    float getFloat(const object &parent, const std::string_view key, const float fallback)
+    {
+        double value;
+        return get(parent, key, value) ? static_cast<float>(value) : fallback;
+    }
+
+    size_t getSize(const object &parent, const std::string_view key, const size_t fallback = 0)
+    {
+        uint64_t value;
+        return get(parent, key, value) ? static_cast<size_t>(value) : fallback;
+    }
+
+    size_t getRequiredSize(const object &parent, const std::string_view key)
+    {
+        uint64_t value;
+        if (!get(parent, key, value))
+        {
+            fail("missing " + std::string(key));
+        }
+        return static_cast<size_t>(value);
+    }
+
+    std::optional<uint32_t> getIndex(const object &parent, const std::string_view key)
+    {
+        uint64_t value;
+        if (!get(parent, key, value))
+        {
+            return std::nullopt;
+        }
+        if (value > UINT32_MAX)
+        {
+            fail(std::string(key) + " is out of range");
+        }
+        return static_cast<uint32_t>(value);
+    }
+
+    std::string getString(const object &parent, const std::string_view key)
+    {
+        std::string_view value;
+        return get(parent, key, value) ? std::string(value) : std::string();
+    }
+
+    bool getBool(const object &parent, const std::string_view key, const bool fallback)
+    {
+        bool value;
+        return get(parent, key, value) ? value : fallback;
+    }
+
+    // Fills count floats from a number array, leaving them untouched when the member is missing
+    void getFloats(const object &parent, const std::string_view key, float *values, const size_t count)
+    {
+        array numbers;
+        if (!get(parent, key, numbers))
+        {
+            return;
+        }
+        if (numbers.size() != count)
+        {
+            fail(std::string(key) + " should have " + std::to_string(count) + " elements");
+        }
+        size_t i = 0;
+        for (const element number : numbers)
+        {
+            double value;
+            if (number.get(value))
+            {
+                fail(std::string(key) + " should only hold numbers");
+            }
+            values[i++] = static_cast<float>(value);
+        }
+    }
+
+    std::vector<float> getFloatArray(const object &parent, const std::string_view key)
+    {
+        array numbers;
+        if (!get(parent, key, numbers))
+        {
+            return {};
+        }
+        std::vector<float> values(numbers.size());
+        getFloats(parent, key, values.data(), values.size());
+        return values;
+    }
+
+    std::vector<uint32_t> getIndexArray(const object &parent, const std::string_view key)
+    {
+        array indices;
+        if (!get(parent, key, indices))
+        {
+            return {};
+        }
+        std::vector<uint32_t> values;
+        values.reserve(indices.size());
+        for (const element index : indices)
+        {
+            uint64_t value;
+            if (index.get(value) || value > UINT32_MAX)
+            {
+                fail(std::string(key) + " should only hold indices");
+            }
+            values.push_back(static_cast<uint32_t>(value));
+        }
+        return values;
+    }
+
+    // Calls parse for every object of an array member
+    template <typename F>
+    void forEach(const object &parent, const std::string_view key, F &&parse)
+    {
+        array elements;
+        if (!get(parent, key, elements))
+        {
+            return;
+        }
+        for (const element value : elements)
+        {
+            parse(asObject(value, key));
+        }
+    }
+
+    // Index of the texture a textureInfo member refers to
+    std::optional<uint32_t> getTexture(const object &parent, const std::string_view key)
+    {
+        object textureInfo;
+        if (!get(parent, key, textureInfo))
+        {
+            return std::nullopt;
+        }
+        return getIndex(textureInfo, "index");
+    }
+
+    GLTFDocument::ComponentType parseComponentType(const size_t value)
+    {
+        switch (value)
+        {
+        case 5120:
+        case 5121:
+        case 5122:
+        case 5123:
+        case 5125:
+        case 5126:
+            return static_cast<GLTFDocument::ComponentType>(value);
+        default:
+            fail("unknown componentType " + std::to_string(value));
+        }
+    }
+
+    GLTFDocument::AccessorType parseAccessorType(const std::string &value)
+    {
+        using AccessorType = GLTFDocument::AccessorType;
+        if (value == "SCALAR") return AccessorType::Scalar;
+        if (value == "VEC2") return AccessorType::Vec2;
+        if (value == "VEC3") return AccessorType::Vec3;
+        if (value == "VEC4") return AccessorType::Vec4;
+        if (value == "MAT2") return AccessorType::Mat2;
+        if (value == "MAT3") return AccessorType::Mat3;
+        if (value == "MAT4") return AccessorType::Mat4;
+        fail("unknown accessor type " + value);
+    }
+
+    void checkIndex(const std::optional<uint32_t> &index, const size_t count, const std::string &what)
+    {
+        if (index.has_value() && *index >= count)
+        {
+            fail(what + " " + std::to_string(*index) + " does not exist");
+        }
+    }
+
+    // The loader indexes the arrays with these without checking
+    void validate(const GLTFDocument &document)
+    {
+        for (const auto &bufferView : document.bufferViews)
+        {
+            checkIndex(bufferView.buffer, document.buffers.size(), "buffer");
+        }
+        for (const auto &accessor : document.accessors)
+        {
+            checkIndex(accessor.bufferView, document.bufferViews.size(), "buffer view");
+            if (accessor.sparse.has_value())
+            {
+                checkIndex(accessor.sparse->indicesBufferView, document.bufferViews.size(), "buffer view");
+                checkIndex(accessor.sparse->valuesBufferView, document.bufferViews.size(), "buffer view");
+            }
+        }
+        for (const auto &mesh : document.meshes)
+        {
+            for (const auto &primitive : mesh.primitives)
+            {
+                for (const auto &[name, accessor] : primitive.attributes)
+                {
+                    checkIndex(accessor, document.accessors.size(), "accessor");
+                }
+                checkIndex(primitive.indices, document.accessors.size(), "accessor");
+                checkIndex(primitive.material, document.materials.size(), "material");
+            }
+        }
+        for (const auto &image : document.images)
+        {
+            checkIndex(image.bufferView, document.bufferViews.size(), "buffer view");
+        }
+        for (const auto &texture : document.textures)
+        {
+            checkIndex(texture.source, document.images.size(), "image");
+        }
+        for (const auto &material : document.materials)
+        {
+            for (const auto &texture : {material.baseColorTexture, material.metallicRoughnessTexture,
+                                        material.normalTexture, material.occlusionTexture, material.emissiveTexture})
+            {
+                checkIndex(texture, document.textures.size(), "texture");
+            }
+        }
+        for (const auto &node : document.nodes)
+        {
+            checkIndex(node.mesh, document.meshes.size(), "mesh");
+            for (const auto child : node.children)
+            {
+                checkIndex(child, document.nodes.size(), "node");
+            }
+        }
+        for (const auto &scene : document.scenes)
+        {
+            for (const auto node : scene.nodes)
+            {
+                checkIndex(node, document.nodes.size(), "node");
+            }
+        }
+        checkIndex(document.scene, document.scenes.size(), "scene");
+    }
+}
+
+std::optional<uint32_t> GLTFDocument::Primitive::getAttribute(const std::string_view name) const
+{
+    for (const auto &[attribute, accessor] : attributes)
+    {
+        if (attribute == name)
+        {
+            return accessor;
+        }
+    }
+    return std::nullopt;
+}
+
+GLTFDocument GLTFDocument::parse(const char *json, const size_t size)
+{
+    VE_PROFILE_SCOPE("GLTFDocument::parse");
+    simdjson::dom::parser parser;
+    element rootElement;
+    // simdjson reads a little past the end, the input is copied when that would cross into an unmapped page
+    if (const auto error = parser.parse(json, size).get(rootElement))
+    {
+        fail(simdjson::error_message(error));
+    }
+    const object root = asObject(rootElement, "the root");
+
+    object asset;
+    if (!get(root, "asset", asset) || getString(asset, "version").rfind("2.", 0) != 0)
+    {
+        fail("only glTF 2.0 is supported");
+    }
+
+    GLTFDocument document;
+
+    forEach(root, "buffers", [&](const object &value) {
+        Buffer &buffer = document.buffers.emplace_back();
+        buffer.uri = getString(value, "uri");
+        buffer.byteLength = getRequiredSize(value, "byteLength");
+    });
+
+    forEach(root, "bufferViews", [&](const object &value) {
+        BufferView &bufferView = document.bufferViews.emplace_back();
+        bufferView.buffer = static_cast<uint32_t>(getRequiredSize(value, "buffer"));
+        bufferView.byteOffset = getSize(value, "byteOffset");
+        bufferView.byteLength = getRequiredSize(value, "byteLength");
+        bufferView.byteStride = getSize(value, "byteStride");
+    });
+
+    forEach(root, "accessors", [&](const object &value) {
+        Accessor &accessor = document.accessors.emplace_back();
+        accessor.bufferView = getIndex(value, "bufferView");
+        accessor.byteOffset = getSize(value, "byteOffset");
+        accessor.componentType = parseComponentType(getRequiredSize(value, "componentType"));
+        accessor.type = parseAccessorType(getString(value, "type"));
+        accessor.normalized = getBool(value, "normalized", false);
+        accessor.count = getRequiredSize(value, "count");
+        accessor.min = getFloatArray(value, "min");
+        accessor.max = getFloatArray(value, "max");
+
+        object sparse, indices, values;
+        if (get(value, "sparse", sparse))
+        {
+            if (!get(sparse, "indices", indices) || !get(sparse, "values", values))
+            {
+                fail("sparse accessor without indices or values");
+            }
+            Sparse &result = accessor.sparse.emplace();
+            result.count = getRequiredSize(sparse, "count");
+            result.indicesBufferView = static_cast<uint32_t>(getRequiredSize(indices, "bufferView"));
+            result.indicesByteOffset = getSize(indices, "byteOffset");
+            result.indicesComponentType = parseComponentType(getRequiredSize(indices, "componentType"));
+            result.valuesBufferView = static_cast<uint32_t>(getRequiredSize(values, "bufferView"));
+            result.valuesByteOffset = getSize(values, "byteOffset");
+        }
+    });
+
+    forEach(root, "meshes", [&](const object &value) {
+        Mesh &mesh = document.meshes.emplace_back();
+        mesh.name = getString(value, "name");
+        forEach(value, "primitives", [&](const object &primitiveValue) {
+            Primitive &primitive = mesh.primitives.emplace_back();
+            object attributes;
+            if (!get(primitiveValue, "attributes", attributes))
+            {
+                fail("primitive without attributes");
+            }
+            for (const auto [name, accessor] : attributes)
+            {
+                uint64_t index;
+                if (accessor.get(index) || index > UINT32_MAX)
+                {
+                    fail("attribute " + std::string(name) + " is not an accessor index");
+                }
+                primitive.attributes.emplace_back(std::string(name), static_cast<uint32_t>(index));
+            }
+            primitive.indices = getIndex(primitiveValue, "indices");
+            primitive.material = getIndex(primitiveValue, "material");
+        });
+    });
+
+    forEach(root, "images", [&](const object &value) {
+        Image &image = document.images.emplace_back();
+        image.uri = getString(value, "uri");
+        image.bufferView = getIndex(value, "bufferView");
+        image.mimeType = getString(value, "mimeType");
+    });
+
+    forEach(root, "textures", [&](const object &value) {
+        Texture &texture = document.textures.emplace_back();
+        texture.name = getString(value, "name");
+        texture.sampler = getIndex(value, "sampler");
+        texture.source = getIndex(value, "source");
+    });
+
+    forEach(root, "materials", [&](const object &value) {
+        Material &material = document.materials.emplace_back();
+        material.name = getString(value, "name");
+        object pbr;
+        if (get(value, "pbrMetallicRoughness", pbr))
+        {
+            getFloats(pbr, "baseColorFactor", &material.baseColorFactor.x, 4);
+            material.metallicFactor = getFloat(pbr, "metallicFactor", material.metallicFactor);
+            material.roughnessFactor = getFloat(pbr, "roughnessFactor", material.roughnessFactor);
+            material.baseColorTexture = getTexture(pbr, "baseColorTexture");
+            material.metallicRoughnessTexture = getTexture(pbr, "metallicRoughnessTexture");
+        }
+        material.normalTexture = getTexture(value, "normalTexture");
+        material.occlusionTexture = getTexture(value, "occlusionTexture");
+        material.emissiveTexture = getTexture(value, "emissiveTexture");
+        getFloats(value, "emissiveFactor", &material.emissiveFactor.x, 3);
+        material.alphaCutoff = getFloat(value, "alphaCutoff", material.alphaCutoff);
+        material.doubleSided = getBool(value, "doubleSided", material.doubleSided);
+    });
+
+    forEach(root, "nodes", [&](const object &value) {
+        Node &node = document.nodes.emplace_back();
+        node.mesh = getIndex(value, "mesh");
+        node.children = getIndexArray(value, "children");
+
+        // Column major like glm
+        getFloats(value, "matrix", &node.matrix[0][0], 16);
+        getFloats(value, "translation", &node.translation.x, 3);
+        getFloats(value, "rotation", &node.rotation.x, 4);
+        getFloats(value, "scale", &node.scale.x, 3);
+
+        // Default values count as missing, like the glTF SDK did
+        if (node.matrix != glm::mat4(1.0f))
+        {
+            node.transform = Node::Transform::Matrix;
+        }
+        else if (node.translation != glm::vec3(0.0f) || node.rotation != glm::vec4(0.0f, 0.0f, 0.0f, 1.0f) ||
+                 node.scale != glm::vec3(1.0f))
+        {
+            node.transform = Node::Transform::Trs;
+        }
+    });
+
+    forEach(root, "scenes", [&](const object &value) {
+        document.scenes.push_back({getIndexArray(value, "nodes")});
+    });
+    document.scene = getIndex(root, "scene");
+
+    object extensions, lightsPunctual;
+    if (get(root, "extensions", extensions) && get(extensions, "KHR_lights_punctual", lightsPunctual))
+    {
+        forEach(lightsPunctual, "lights", [&](const object &value) {
+            Light &light = document.lights.emplace_back();
+            light.type = getString(value, "type");
+            getFloats(value, "color", &light.color.x, 3);
+            light.intensity = getFloat(value, "intensity", light.intensity);
+        });
+    }
+
+    validate(document);
+    return document;
+}
+
+size_t GLTFDocument::getComponentSize(const ComponentType componentType)
+{
+    switch (componentType)
+    {
+    case ComponentType::Byte:
+    case ComponentType::UnsignedByte:
+        return 1;
+    case ComponentType::Short:
+    case ComponentType::UnsignedShort:
+        return 2;
+    case ComponentType::UnsignedInt:
+    case ComponentType::Float:
+        return 4;
+    }
+    return 0;
+}
+
+uint32_t GLTFDocument::getComponentCount(const AccessorType type)
+{
+    switch (type)
+    {
+    case AccessorType::Scalar:
+        return 1;
+    case AccessorType::Vec2:
+        return 2;
+    case AccessorType::Vec3:
+        return 3;
+    case AccessorType::Vec4:
+    case AccessorType::Mat2:
+        return 4;
+    case AccessorType::Mat3:
+        return 9;
+    case AccessorType::Mat4:
+        return 16;
+    }
+    return 0;
+}
+
+const GLTFDocument::Scene &GLTFDocument::getDefaultScene() const
+{
+    if (scenes.empty())
+    {
+        fail("the document has no scenes");
+    }
+    return scenes[scene.value_or(0)];
+}
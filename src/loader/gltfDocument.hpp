@@ -0,0 +1,184 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// The parts of a glTF 2.0 document the loader uses, parsed with simdjson in one pass over the JSON. Everything
+// else in the file is skipped. Objects reference each other by their index in the document's arrays.
+struct GLTFDocument
+{
+	enum class ComponentType : uint32_t
+	{
+		Byte = 5120,
+		UnsignedByte = 5121,
+		Short = 5122,
+		UnsignedShort = 5123,
+		UnsignedInt = 5125,
+		Float = 5126
+	};
+
+	enum class AccessorType
+	{
+		Scalar,
+		Vec2,
+		Vec3,
+		Vec4,
+		Mat2,
+		Mat3,
+		Mat4
+	};
+
+	struct Buffer
+	{
+		// Empty for the binary chunk of a GLB file
+		std::string uri;
+		size_t byteLength = 0;
+	};
+
+	struct BufferView
+	{
+		uint32_t buffer = 0;
+		size_t byteOffset = 0;
+		size_t byteLength = 0;
+		// 0 when the elements are tightly packed
+		size_t byteStride = 0;
+	};
+
+	// Elements replaced on top of the buffer view, or on top of zeros without one
+	struct Sparse
+	{
+		size_t count = 0;
+		// Strictly increasing element indices
+		uint32_t indicesBufferView = 0;
+		size_t indicesByteOffset = 0;
+		ComponentType indicesComponentType = ComponentType::UnsignedInt;
+		// Tightly packed, of the accessor's type
+		uint32_t valuesBufferView = 0;
+		size_t valuesByteOffset = 0;
+	};
+
+	struct Accessor
+	{
+		std::optional<uint32_t> bufferView;
+		size_t byteOffset = 0;
+		ComponentType componentType = ComponentType::Float;
+		AccessorType type = AccessorType::Scalar;
+		bool normalized = false;
+		size_t count = 0;
+		// Empty when the file leaves them out
+		std::vector<float> min;
+		std::vector<float> max;
+		std::optional<Sparse> sparse;
+	};
+
+	struct Primitive
+	{
+		std::vector<std::pair<std::string, uint32_t>> attributes;
+		std::optional<uint32_t> indices;
+		std::optional<uint32_t> material;
+
+		std::optional<uint32_t> getAttribute(std::string_view name) const;
+	};
+
+	struct Mesh
+	{
+		std::string name;
+		std::vector<Primitive> primitives;
+	};
+
+	struct Image
+	{
+		std::string uri;
+		// Images stored in a buffer have a buffer view instead of a uri
+		std::optional<uint32_t> bufferView;
+		std::string mimeType;
+	};
+
+	struct Texture
+	{
+		std::string name;
+		std::optional<uint32_t> sampler;
+		std::optional<uint32_t> source;
+	};
+
+	struct Material
+	{
+		std::string name;
+		glm::vec4 baseColorFactor{1.0f};
+		float metallicFactor = 1.0f;
+		float roughnessFactor = 1.0f;
+		glm::vec3 emissiveFactor{0.0f};
+		float alphaCutoff = 0.5f;
+		bool doubleSided = false;
+
+		// Texture indices
+		std::optional<uint32_t> baseColorTexture;
+		std::optional<uint32_t> metallicRoughnessTexture;
+		std::optional<uint32_t> normalTexture;
+		std::optional<uint32_t> occlusionTexture;
+		std::optional<uint32_t> emissiveTexture;
+	};
+
+	struct Node
+	{
+		enum class Transform
+		{
+			Identity,
+			Matrix,
+			Trs
+		};
+
+		std::optional<uint32_t> mesh;
+		std::vector<uint32_t> children;
+
+		Transform transform = Transform::Identity;
+		glm::mat4 matrix{1.0f};
+		glm::vec3 translation{0.0f};
+		// x, y, z, w as stored in the file
+		glm::vec4 rotation{0.0f, 0.0f, 0.0f, 1.0f};
+		glm::vec3 scale{1.0f};
+	};
+
+	struct Scene
+	{
+		std::vector<uint32_t> nodes;
+	};
+
+	// KHR_lights_punctual
+	struct Light
+	{
+		std::string type;
+		glm::vec3 color{1.0f};
+		float intensity = 1.0f;
+	};
+
+	static size_t getComponentSize(ComponentType componentType);
+	static uint32_t getComponentCount(AccessorType type);
+
+	// The JSON does not have to be padded or null terminated
+	static GLTFDocument parse(const char *json, size_t size);
+
+	const Scene &getDefaultScene() const;
+
+	std::vector<Buffer> buffers;
+	std::vector<BufferView> bufferViews;
+	std::vector<Accessor> accessors;
+	std::vector<Mesh> meshes;
+	std::vector<Image> images;
+	std::vector<Texture> textures;
+	std::vector<Material> materials;
+	std::vector<Node> nodes;
+	std::vector<Scene> scenes;
+	std::optional<uint32_t> scene;
+	std::vector<Light> lights;
+};
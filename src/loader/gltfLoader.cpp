@@ -1,248 +1,587 @@
 #include "gltfLoader.hpp"
 
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <exception>
 #include <fstream>
+#include <optional>
+#include <queue>
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/glm.hpp>
 #include <glm/gtx/quaternion.hpp>
 
 #include <unordered_map>
-#include <execution>
 #include <stb_image.h>
 
+#include "../engine/profiling/cpuProfiler.hpp"
+#include "../engine/jobs/jobSystem.hpp"
+#include "../engine/settings.hpp"
+#include "../log.hpp"
+#include "../utils.hpp"
+#include "meshSimplifier.hpp"
+#include "meshletBuilder.hpp"
+
+
+namespace
+{
+    // GLB container, a 12 byte header followed by a JSON chunk and an optional binary chunk
+    constexpr uint32_t GLB_MAGIC = 0x46546C67;
+    constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+    constexpr uint32_t GLB_CHUNK_BIN = 0x004E4942;
+    constexpr size_t GLB_HEADER_SIZE = 12;
+    constexpr size_t GLB_CHUNK_HEADER_SIZE = 8;
+
+    constexpr size_t INDEX_DECODE_CHUNK = 4096;
+    // Primitives decoded before their upload, at most this many full precision copies are around at once
+    constexpr size_t PRIMITIVE_BATCH = 64;
+
+    // Smaller primitives are cheap enough at full detail, their draw costs more than their triangles
+    constexpr size_t MIN_LOD_TRIANGLES = 256;
+    // Each level has about half the triangles of the one before
+    constexpr float LOD_RATIO = 0.5f;
+    // Relative to the primitive's size, coarser levels would only ever be drawn a few pixels across
+    constexpr float LOD_MAX_ERROR = 0.05f;
+    // Primitives of a few meshlets are culled about as well whole
+    constexpr size_t MIN_MESHLET_TRIANGLES = 4 * MeshletBuilder::MAX_TRIANGLES;
+
+    uint32_t readUint32(const uint8_t *data)
+    {
+        uint32_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+}
 
 GLTFLoader::GLTFLoader(ve::Device &device, const std::string &filepath)
 {
+    VE_PROFILE_SCOPE("GLTFLoader::GLTFLoader");
     loadDocument(filepath);
     loadBuffers();
     loadImages(device);
     loadTextures();
     loadMaterials(device);
-    loadMeshes(device);
+    loadMeshes();
+
+    // Everything was decoded out of the mappings, dropping them gives their pages back
+    buffers.clear();
+    files.clear();
 }
 
 void GLTFLoader::loadDocument(const std::string &filepath)
 {
-    std::ifstream file(filepath);
-    std::string fileContent, line;
-    while (!file.eof())
+    VE_PROFILE_SCOPE("GLTFLoader::loadDocument");
+    // Buffer and image uris are relative to the file
+    directory = filepath.substr(0, filepath.find_last_of("/\\") + 1);
+
+    MappedFile file(filepath);
+    if (file.size() < GLB_HEADER_SIZE || readUint32(file.data()) != GLB_MAGIC)
     {
-        file >> line;
-        fileContent.append(line);
+        document = GLTFDocument::parse(reinterpret_cast<const char *>(file.data()), file.size());
+        return;
     }
-    file.close();
 
-    document = Microsoft::glTF::Deserialize(fileContent);
-}
+    const size_t length = readUint32(file.data() + 8);
+    if (readUint32(file.data() + 4) != 2 || length > file.size())
+    {
+        Log::error("Unsupported or truncated GLB file " + filepath);
+        throw std::runtime_error("");
+    }
 
-void GLTFLoader::loadBuffers()
-{
-    for (const auto &buffer : document.buffers.Elements())
+    const uint8_t *json = nullptr;
+    size_t jsonLength = 0;
+    size_t offset = GLB_HEADER_SIZE;
+    while (offset + GLB_CHUNK_HEADER_SIZE <= length)
     {
-        std::string name = buffer.uri;
-        std::ifstream file("Sponza/" + name, std::ios::binary);
+        const size_t chunkLength = readUint32(file.data() + offset);
+        const uint32_t chunkType = readUint32(file.data() + offset + 4);
+        const uint8_t *chunkData = file.data() + offset + GLB_CHUNK_HEADER_SIZE;
+        if (offset + GLB_CHUNK_HEADER_SIZE + chunkLength > length)
+        {
+            Log::error("Truncated GLB chunk in " + filepath);
+            throw std::runtime_error("");
+        }
 
-        std::vector<uint8_t> data(buffer.byteLength);
-        file.read(reinterpret_cast<char *>(data.data()), data.size());
+        if (chunkType == GLB_CHUNK_JSON && json == nullptr)
+        {
+            json = chunkData;
+            jsonLength = chunkLength;
+        }
+        else if (chunkType == GLB_CHUNK_BIN && glbBinary.data == nullptr)
+        {
+            glbBinary = {chunkData, chunkLength};
+        }
+        // Chunks are padded to 4 bytes, unknown chunk types are skipped
+        offset += GLB_CHUNK_HEADER_SIZE + ((chunkLength + 3) & ~size_t(3));
+    }
 
-        buffers[name] = data;
+    if (json == nullptr)
+    {
+        Log::error("GLB file " + filepath + " has no JSON chunk");
+        throw std::runtime_error("");
     }
+    document = GLTFDocument::parse(reinterpret_cast<const char *>(json), jsonLength);
+
+    // The binary chunk points into the mapping
+    files.push_back(std::move(file));
 }
 
-void GLTFLoader::loadMeshes(ve::Device &device)
+void GLTFLoader::loadBuffers()
 {
-    for (const auto &mesh : document.meshes.Elements())
+    VE_PROFILE_SCOPE("GLTFLoader::loadBuffers");
+    for (size_t i = 0; i < document.buffers.size(); ++i)
     {
-        std::vector<std::shared_ptr<ve::Mesh>> meshes{};
-
-        for (const auto &primitive : mesh.primitives)
+        const auto &buffer = document.buffers[i];
+        BufferData data{};
+        if (buffer.uri.empty())
         {
-            std::vector<ve::Mesh::Vertex> vertices{};
-            std::vector<uint16_t> indices{};
-
-            const auto &indicesAccessorId = primitive.indicesAccessorId;
-            const auto &indicesAccessor = document.accessors.Get(indicesAccessorId);
-
-            const auto &indexBufferViewId = indicesAccessor.bufferViewId;
-            const auto &indexBufferView = document.bufferViews.Get(indexBufferViewId);
-
-            const auto &indexBufferId = indexBufferView.bufferId;
-            const auto &indexBuffer = buffers.at(document.buffers.Get(indexBufferId).uri);
-            const auto indexOffset = indexBufferView.byteOffset + indicesAccessor.byteOffset;
-
-            const auto &indexCount = indicesAccessor.count;
-            indices.resize(indexCount);
-
-            std::memcpy(indices.data(), indexBuffer.data() + indexOffset, indexCount * sizeof(uint16_t));
-
-            vertices.resize(document.accessors.Get(primitive.GetAttributeAccessorId("POSITION")).count);
-
-            if (primitive.HasAttribute("POSITION"))
+            // Only the first buffer of a GLB file may leave out its uri, it is the binary chunk
+            if (glbBinary.data == nullptr)
             {
-                const auto &positionAccessorId = primitive.GetAttributeAccessorId("POSITION");
-                const auto &positionAccessor = document.accessors.Get(positionAccessorId);
-
-                const auto &positionBufferViewId = positionAccessor.bufferViewId;
-                const auto &positionBufferView = document.bufferViews.Get(positionBufferViewId);
+                Log::error("Buffer " + std::to_string(i) + " has no uri and there is no GLB binary chunk");
+                throw std::runtime_error("");
+            }
+            data = glbBinary;
+        }
+        else if (buffer.uri.rfind("data:", 0) == 0)
+        {
+            Log::error("Buffer " + std::to_string(i) + " is embedded as a data uri, which is not supported");
+            throw std::runtime_error("");
+        }
+        else
+        {
+            const auto &file = files.emplace_back(directory + buffer.uri);
+            data = {file.data(), file.size()};
+        }
 
-                const auto &positionBufferId = positionBufferView.bufferId;
-                const auto &positionBuffer = buffers.at(document.buffers.Get(positionBufferId).uri);
-                const auto positionOffset = positionBufferView.byteOffset + positionAccessor.byteOffset;
+        if (data.size < buffer.byteLength)
+        {
+            Log::error("Buffer " + std::to_string(i) + " is shorter than its byteLength");
+            throw std::runtime_error("");
+        }
+        buffers.push_back(data);
+    }
+}
 
-                const auto &positionCount = positionAccessor.count;
+namespace
+{
+    // A primitive decoded at full precision, between the parallel decoding and optimization and the upload
+    struct DecodedPrimitive
+    {
+        std::vector<ve::Mesh::Vertex> vertices;
+        // Widened to 32 bits, narrowed again on upload when the vertices allow it
+        std::vector<uint32_t> indices;
+        uint32_t attributes = 0;
+        ve::Mesh::Bounds bounds{};
+        uint32_t material = 0;
+        // Relative to the start of the indices, the full primitive first. Empty when it was not simplified.
+        std::vector<ve::Mesh::Lod> lods;
+        // Of the full primitive, relative to the start of the indices like the levels. Empty when it was not split.
+        std::vector<ve::Mesh::Cluster> clusters;
+        std::optional<GLTFLoader::PrimitiveStats> stats;
+        // Jobs cannot throw, the error is rethrown on the loading thread
+        std::exception_ptr error;
+    };
+
+    void decodePrimitive(const GLTFDocument &document, const AccessorReader &reader, const uint32_t meshIndex,
+                         const uint32_t primitiveIndex, DecodedPrimitive &decoded)
+    {
+        using Vertex = ve::Mesh::Vertex;
+        const auto &mesh = document.meshes[meshIndex];
+        const auto &primitive = mesh.primitives[primitiveIndex];
 
-                for (size_t i = 0; i < positionCount; ++i)
-                {
-                    const auto position = reinterpret_cast<const glm::vec3 *>(positionBuffer.data() + positionOffset);
-                    vertices[i].position = position[i];
-                    vertices[i].position.x = -vertices[i].position.x;
-                }
+        const auto positionAccessorIndex = primitive.getAttribute("POSITION");
+        if (!positionAccessorIndex.has_value())
+        {
+            Log::error("Mesh " + mesh.name + " has a primitive without positions");
+            throw std::runtime_error("");
+        }
+        if (!primitive.material.has_value())
+        {
+            Log::error("Mesh " + mesh.name + " has a primitive without a material");
+            throw std::runtime_error("");
+        }
+        decoded.material = *primitive.material;
+        // The batch slots are reused
+        decoded.indices.clear();
+        decoded.lods.clear();
+        decoded.clusters.clear();
+        const auto &positionAccessor = document.accessors[*positionAccessorIndex];
+        const auto positions = reader.get(*positionAccessorIndex);
+
+        // Missing attributes are never written and keep the Vertex defaults
+        auto &vertices = decoded.vertices;
+        vertices.assign(positions.count, Vertex{});
+        const auto getAttribute = [&](const char *name) -> std::optional<AccessorReader::Accessor> {
+            const auto accessorIndex = primitive.getAttribute(name);
+            if (!accessorIndex.has_value())
+            {
+                return std::nullopt;
             }
+            auto accessor = reader.get(*accessorIndex);
+            if (accessor.count < positions.count)
+            {
+                Log::error("Accessor " + std::to_string(*accessorIndex) + " has fewer elements than POSITION");
+                throw std::runtime_error("");
+            }
+            return accessor;
+        };
+        const auto normals = getAttribute("NORMAL");
+        const auto tangents = getAttribute("TANGENT");
+        const auto texCoords0 = getAttribute("TEXCOORD_0");
+        const auto texCoords1 = getAttribute("TEXCOORD_1");
+        const auto colors0 = getAttribute("COLOR_0");
+        decoded.attributes =
+            (normals.has_value() ? ve::VertexFormat::Normal : 0) |
+            (tangents.has_value() ? ve::VertexFormat::Tangent : 0) |
+            (texCoords0.has_value() ? ve::VertexFormat::TexCoord0 : 0) |
+            (texCoords1.has_value() ? ve::VertexFormat::TexCoord1 : 0) |
+            (colors0.has_value() ? ve::VertexFormat::Color0 : 0);
+
+        const glm::vec3 mirror{-1.0f, 1.0f, 1.0f};
+        reader.read(positions, 0, positions.count, &vertices[0].position, sizeof(Vertex), mirror);
+        if (normals.has_value())
+        {
+            reader.read(*normals, 0, positions.count, &vertices[0].normal, sizeof(Vertex), mirror);
+        }
+        if (tangents.has_value())
+        {
+            reader.read(*tangents, 0, positions.count, &vertices[0].tangent, sizeof(Vertex));
+        }
+        if (texCoords0.has_value())
+        {
+            reader.read(*texCoords0, 0, positions.count, &vertices[0].tex_coord_0, sizeof(Vertex));
+        }
+        if (texCoords1.has_value())
+        {
+            reader.read(*texCoords1, 0, positions.count, &vertices[0].tex_coord_1, sizeof(Vertex));
+        }
+        if (colors0.has_value())
+        {
+            // Colors may leave out alpha
+            reader.read(*colors0, 0, positions.count, &vertices[0].color_0, sizeof(Vertex), glm::vec4(1.0f),
+                        glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+        }
 
-            if (primitive.HasAttribute("NORMAL"))
+        // glTF requires min/max on position accessors, mirrored on x like the positions. Quantized positions
+        // store them quantized, those are computed from the vertices instead.
+        auto &bounds = decoded.bounds;
+        if (positionAccessor.componentType == GLTFDocument::ComponentType::Float &&
+            positionAccessor.min.size() == 3 && positionAccessor.max.size() == 3)
+        {
+            bounds = ve::Mesh::Bounds{
+                {-positionAccessor.max[0], positionAccessor.min[1], positionAccessor.min[2]},
+                {-positionAccessor.min[0], positionAccessor.max[1], positionAccessor.max[2]}};
+        }
+        else
+        {
+            bounds = ve::Mesh::Bounds{glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX)};
+            for (const auto &vertex : vertices)
             {
-                const auto &normalAccessorId = primitive.GetAttributeAccessorId("NORMAL");
-                const auto &normalAccessor = document.accessors.Get(normalAccessorId);
+                bounds.min = glm::min(bounds.min, vertex.position);
+                bounds.max = glm::max(bounds.max, vertex.position);
+            }
+        }
 
-                const auto &normalBufferViewId = normalAccessor.bufferViewId;
-                const auto &normalBufferView = document.bufferViews.Get(normalBufferViewId);
+        if (!primitive.indices.has_value())
+        {
+            return;
+        }
+        // Indices are checked against the vertices, a narrowed one would otherwise wrap around silently
+        const auto indices = reader.get(*primitive.indices);
+        decoded.indices.resize(indices.count);
+        reader.readIndices(indices, 0, indices.count, decoded.indices.data());
+        if (!decoded.indices.empty() &&
+            *std::max_element(decoded.indices.begin(), decoded.indices.end()) >= positions.count)
+        {
+            Log::error("Mesh " + mesh.name + " has indices past its vertices");
+            throw std::runtime_error("");
+        }
 
-                const auto &normalBufferId = normalBufferView.bufferId;
-                const auto &normalBuffer = buffers.at(document.buffers.Get(normalBufferId).uri);
-                const auto normalOffset = normalBufferView.byteOffset + normalAccessor.byteOffset;
+        if (decoded.indices.empty() || decoded.indices.size() % 3 != 0)
+        {
+            return;
+        }
 
-                const auto &normalCount = normalAccessor.count;
+        // Simplified from the indices as stored, the levels reuse the vertices and are reordered like the full one
+        const auto settings = ve::Settings::getInstance();
+        std::vector<MeshSimplifier::Level> levels;
+        if (settings->GENERATE_LODS && decoded.indices.size() / 3 >= MIN_LOD_TRIANGLES)
+        {
+            VE_PROFILE_SCOPE("GLTFLoader::simplifyPrimitive");
+            levels = MeshSimplifier::simplify(decoded.indices, vertices, ve::Mesh::MAX_LODS - 1, LOD_RATIO,
+                                              LOD_MAX_ERROR);
+        }
 
-                for (size_t i = 0; i < normalCount; ++i)
-                {
-                    const auto normal = reinterpret_cast<const glm::vec3 *>(normalBuffer.data() + normalOffset);
-                    vertices[i].normal = normal[i];
-                    vertices[i].normal.x = -vertices[i].normal.x;
-                }
+        ve::Timer timer;
+        if (settings->OPTIMIZE_MESHES)
+        {
+            GLTFLoader::PrimitiveStats stats{};
+            stats.mesh = meshIndex;
+            stats.primitive = primitiveIndex;
+            stats.triangleCount = static_cast<uint32_t>(decoded.indices.size() / 3);
+            stats.before = MeshOptimizer::analyzeVertexCache(decoded.indices, vertices.size());
+            MeshOptimizer::optimizeVertexCache(decoded.indices, vertices.size());
+            if (settings->OPTIMIZE_OVERDRAW)
+            {
+                MeshOptimizer::optimizeOverdraw(decoded.indices, vertices);
             }
-
-            if (primitive.HasAttribute("TANGENT"))
+            for (auto &level : levels)
             {
-                const auto &tangentAccessorId = primitive.GetAttributeAccessorId("TANGENT");
-                const auto &tangentAccessor = document.accessors.Get(tangentAccessorId);
-
-                const auto &tangentBufferViewId = tangentAccessor.bufferViewId;
-                const auto &tangentBufferView = document.bufferViews.Get(tangentBufferViewId);
-
-                const auto &tangentBufferId = tangentBufferView.bufferId;
-                const auto &tangentBuffer = buffers.at(document.buffers.Get(tangentBufferId).uri);
-                const auto tangentOffset = tangentBufferView.byteOffset + tangentAccessor.byteOffset;
+                MeshOptimizer::optimizeVertexCache(level.indices, vertices.size());
+            }
+            decoded.stats = stats;
+        }
 
-                const auto &tangentCount = tangentAccessor.count;
+        // Grown along the optimized order, which mostly survives inside each meshlet. Double sided triangles are
+        // seen from both sides, their meshlets get no cones.
+        if (settings->GENERATE_MESHLETS && decoded.indices.size() / 3 >= MIN_MESHLET_TRIANGLES)
+        {
+            VE_PROFILE_SCOPE("GLTFLoader::buildMeshlets");
+            decoded.clusters = MeshletBuilder::build(decoded.indices, vertices,
+                                                     !document.materials[decoded.material].doubleSided);
+        }
 
-                for (size_t i = 0; i < tangentCount; ++i)
-                {
-                    const auto tangent = reinterpret_cast<const glm::vec4 *>(tangentBuffer.data() + tangentOffset);
-                    vertices[i].tangent = tangent[i];
-                }
-            }
+        if (decoded.stats.has_value())
+        {
+            decoded.stats->after = MeshOptimizer::analyzeVertexCache(decoded.indices, vertices.size());
+        }
 
-            if (primitive.HasAttribute("TEXCOORD_0"))
+        // The levels follow the full primitive in one index range
+        if (!levels.empty())
+        {
+            decoded.lods.push_back({0, static_cast<uint32_t>(decoded.indices.size()), 0.0f});
+            for (const auto &level : levels)
             {
-                const auto &texCoord0AccessorId = primitive.GetAttributeAccessorId("TEXCOORD_0");
-                const auto &texCoord0Accessor = document.accessors.Get(texCoord0AccessorId);
+                decoded.lods.push_back({
+                    static_cast<uint32_t>(decoded.indices.size()), static_cast<uint32_t>(level.indices.size()),
+                    level.error});
+                decoded.indices.insert(decoded.indices.end(), level.indices.begin(), level.indices.end());
+            }
+        }
 
-                const auto &texCoord0BufferViewId = texCoord0Accessor.bufferViewId;
-                const auto &texCoord0BufferView = document.bufferViews.Get(texCoord0BufferViewId);
+        if (settings->OPTIMIZE_MESHES)
+        {
+            // The levels use a subset of the full primitive's vertices, which come first in the remap
+            MeshOptimizer::optimizeVertexFetch(decoded.indices, vertices);
+            decoded.stats->vertexCount = static_cast<uint32_t>(vertices.size());
+            decoded.stats->milliseconds = timer.ElapsedMillis();
+        }
+    }
+}
 
-                const auto &texCoord0BufferId = texCoord0BufferView.bufferId;
-                const auto &texCoord0Buffer = buffers.at(document.buffers.Get(texCoord0BufferId).uri);
-                const auto texCoord0Offset = texCoord0BufferView.byteOffset + texCoord0Accessor.byteOffset;
+void GLTFLoader::loadMeshes()
+{
+    VE_PROFILE_SCOPE("GLTFLoader::loadMeshes");
+    const AccessorReader reader(document, buffers);
 
-                const auto &texCoord0Count = texCoord0Accessor.count;
+    std::vector<std::pair<uint32_t, uint32_t>> primitives;
+    for (uint32_t mesh = 0; mesh < document.meshes.size(); mesh++)
+    {
+        for (uint32_t primitive = 0; primitive < document.meshes[mesh].primitives.size(); primitive++)
+        {
+            primitives.emplace_back(mesh, primitive);
+        }
+    }
 
-                for (size_t i = 0; i < texCoord0Count; ++i)
+    // Primitives are decoded and optimized on the job system a batch at a time, which bounds the full precision
+    // copies held at once, and uploaded in order on this thread: the staging memory is written sequentially.
+    // Each primitive's vertices are encoded into the staging memory by its vertex format, which depends on all of
+    // them, and its indices narrowed in chunks.
+    std::vector<DecodedPrimitive> batch(std::min<size_t>(PRIMITIVE_BATCH, primitives.size()));
+    std::vector<uint16_t> narrowIndexChunk(INDEX_DECODE_CHUNK);
+    size_t lodPrimitives = 0;
+    size_t meshletPrimitives = 0;
+    size_t meshletCount = 0;
+    uint64_t fullTriangles = 0;
+    uint64_t coarsestTriangles = 0;
+    this->meshes.resize(document.meshes.size());
+    for (size_t batchFirst = 0; batchFirst < primitives.size(); batchFirst += batch.size())
+    {
+        const auto batchSize = static_cast<uint32_t>(std::min(batch.size(), primitives.size() - batchFirst));
+        ve::JobSystem::getInstance().parallelFor(batchSize, 1, [&](const uint32_t begin, const uint32_t end) {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                VE_PROFILE_SCOPE("GLTFLoader::decodePrimitive");
+                auto &decoded = batch[i];
+                decoded.stats.reset();
+                decoded.error = nullptr;
+                try
                 {
-                    const auto texCoord0 = reinterpret_cast<const glm::vec2 *>(texCoord0Buffer.data() + texCoord0Offset);
-                    vertices[i].tex_coord_0 = texCoord0[i];
+                    const auto [mesh, primitive] = primitives[batchFirst + i];
+                    decodePrimitive(document, reader, mesh, primitive, decoded);
+                }
+                catch (...)
+                {
+                    decoded.error = std::current_exception();
                 }
             }
+        });
 
-            if (primitive.HasAttribute("TEXCOORD_1"))
+        for (uint32_t i = 0; i < batchSize; i++)
+        {
+            auto &decoded = batch[i];
+            if (decoded.error != nullptr)
             {
-                const auto &texCoord1AccessorId = primitive.GetAttributeAccessorId("TEXCOORD_1");
-                const auto &texCoord1Accessor = document.accessors.Get(texCoord1AccessorId);
-
-                const auto &texCoord1BufferViewId = texCoord1Accessor.bufferViewId;
-                const auto &texCoord1BufferView = document.bufferViews.Get(texCoord1BufferViewId);
+                std::rethrow_exception(decoded.error);
+            }
+            if (decoded.stats.has_value())
+            {
+                optimizationStats.push_back(*decoded.stats);
+            }
 
-                const auto &texCoord1BufferId = texCoord1BufferView.bufferId;
-                const auto &texCoord1Buffer = buffers.at(document.buffers.Get(texCoord1BufferId).uri);
-                const auto texCoord1Offset = texCoord1BufferView.byteOffset + texCoord1Accessor.byteOffset;
+            const auto vertexCount = static_cast<uint32_t>(decoded.vertices.size());
+            const auto indexCount = static_cast<uint32_t>(decoded.indices.size());
+            // Byte indices are widened, few devices have VK_EXT_index_type_uint8
+            const VkIndexType indexType = ve::GeometryArena::getIndexType(vertexCount);
 
-                const auto &texCoord1Count = texCoord1Accessor.count;
+            const auto format = ve::Mesh::chooseFormat(decoded.attributes, decoded.vertices.data(), vertexCount);
+            auto &geometryArena = ve::Mesh::getGeometryArena(format);
+            auto range = geometryArena.allocate(vertexCount, indexCount, indexType);
+            ve::Mesh::writeVertices(format, range, decoded.bounds, decoded.vertices.data());
 
-                for (size_t i = 0; i < texCoord1Count; ++i)
+            if (indexCount > 0 && indexType == VK_INDEX_TYPE_UINT16)
+            {
+                auto *indexOutput = static_cast<uint16_t *>(geometryArena.writeIndices(range));
+                for (size_t first = 0; first < indexCount; first += narrowIndexChunk.size())
                 {
-                    const auto texCoord1 = reinterpret_cast<const glm::vec2 *>(texCoord1Buffer.data() + texCoord1Offset);
-                    vertices[i].tex_coord_1 = texCoord1[i];
+                    const size_t count = std::min(narrowIndexChunk.size(), indexCount - first);
+                    std::copy_n(decoded.indices.begin() + first, count, narrowIndexChunk.begin());
+                    std::memcpy(indexOutput + first, narrowIndexChunk.data(), count * sizeof(uint16_t));
                 }
             }
-
-            if (primitive.HasAttribute("COLOR_0"))
+            else if (indexCount > 0)
             {
-                const auto &color0AccessorId = primitive.GetAttributeAccessorId("COLOR_0");
-                const auto &color0Accessor = document.accessors.Get(color0AccessorId);
-
-                const auto &color0BufferViewId = color0Accessor.bufferViewId;
-                const auto &color0BufferView = document.bufferViews.Get(color0BufferViewId);
-
-                const auto &color0BufferId = color0BufferView.bufferId;
-                const auto &color0Buffer = buffers.at(document.buffers.Get(color0BufferId).uri);
-                const auto color0Offset = color0BufferView.byteOffset + color0Accessor.byteOffset;
-
-                const auto &color0Count = color0Accessor.count;
+                std::memcpy(geometryArena.writeIndices(range), decoded.indices.data(), indexCount * sizeof(uint32_t));
+            }
 
-                for (size_t i = 0; i < color0Count; ++i)
-                {
-                    const auto color0 = reinterpret_cast<const glm::vec4 *>(color0Buffer.data() + color0Offset);
-                    vertices[i].color_0 = color0[i];
-                }
+            if (!decoded.lods.empty())
+            {
+                lodPrimitives++;
+                fullTriangles += decoded.lods.front().indexCount / 3;
+                coarsestTriangles += decoded.lods.back().indexCount / 3;
+            }
+            for (auto &lod : decoded.lods)
+            {
+                lod.firstIndex += range.firstIndex;
+            }
+            if (!decoded.clusters.empty())
+            {
+                meshletPrimitives++;
+                meshletCount += decoded.clusters.size();
             }
+            for (auto &cluster : decoded.clusters)
+            {
+                cluster.firstIndex += range.firstIndex;
+            }
+            auto mMesh = std::make_shared<ve::Mesh>(format, range, decoded.bounds, decoded.lods, decoded.clusters);
+            mMesh->setMaterial(materials[decoded.material]);
+            this->meshes[primitives[batchFirst + i].first].push_back(mMesh);
+        }
+    }
 
-            ve::Mesh::Builder modelBuilder;
-            modelBuilder.vertices = vertices;
-            modelBuilder.indices = indices;
+    if (lodPrimitives > 0)
+    {
+        Log::info("Simplified " + std::to_string(lodPrimitives) + " primitives from " +
+                  std::to_string(fullTriangles) + " to " + std::to_string(coarsestTriangles) +
+                  " triangles at their coarsest levels of detail");
+    }
+    if (meshletPrimitives > 0)
+    {
+        Log::info("Split " + std::to_string(meshletPrimitives) + " primitives into " + std::to_string(meshletCount) +
+                  " meshlets");
+    }
+    if (!optimizationStats.empty())
+    {
+        // Triangle weighted, like the misses they stand for
+        double trianglesTotal = 0.0;
+        double missesBefore = 0.0;
+        double missesAfter = 0.0;
+        double milliseconds = 0.0;
+        for (const auto &stats : optimizationStats)
+        {
+            trianglesTotal += stats.triangleCount;
+            missesBefore += stats.before.acmr * stats.triangleCount;
+            missesAfter += stats.after.acmr * stats.triangleCount;
+            milliseconds += stats.milliseconds;
+        }
+        Log::info("Optimized " + std::to_string(optimizationStats.size()) + " primitives, ACMR " +
+                  std::to_string(missesBefore / trianglesTotal) + " -> " + std::to_string(missesAfter / trianglesTotal) +
+                  " in " + std::to_string(milliseconds) + " ms of job time");
+    }
+}
 
-            auto mMesh = std::make_shared<ve::Mesh>(device, modelBuilder);
-            mMesh->setMaterial(materials.at(primitive.materialId));
+void GLTFLoader::writeOptimizationReport(const std::string &path) const
+{
+    std::ofstream file(path);
+    if (!file.is_open())
+    {
+        Log::error("Failed to open mesh optimization report " + path);
+        throw std::runtime_error("");
+    }
 
-            meshes.push_back(mMesh);
+    file << "mesh,primitive,triangles,vertices,acmrBefore,atvrBefore,acmrAfter,atvrAfter,milliseconds\n";
+    for (const auto &stats : optimizationStats)
+    {
+        // Names are quoted, they may hold commas
+        std::string name = document.meshes[stats.mesh].name;
+        for (size_t quote = name.find('"'); quote != std::string::npos; quote = name.find('"', quote + 2))
+        {
+            name.insert(quote, 1, '"');
         }
-
-        this->meshes.emplace(mesh.id, meshes);
+        file << '"' << name << "\"," << stats.primitive << ',' << stats.triangleCount << ',' << stats.vertexCount
+             << ',' << stats.before.acmr << ',' << stats.before.atvr << ',' << stats.after.acmr << ','
+             << stats.after.atvr << ',' << stats.milliseconds << '\n';
     }
+    Log::info("Mesh optimization report written to " + path);
 }
 
 void GLTFLoader::loadImages(ve::Device &device)
 {
+    VE_PROFILE_SCOPE("GLTFLoader::loadImages");
     std::vector<std::pair<int, int>> sizes;
     std::vector<stbi_uc*> binaries;
 
-    sizes.resize(document.images.Elements().size());
-    binaries.resize(document.images.Elements().size());
+    sizes.resize(document.images.size());
+    binaries.resize(document.images.size());
 
-    std::for_each(std::execution::par, document.images.Elements().begin(), document.images.Elements().end(), [&sizes, &binaries](const Microsoft::glTF::Image &image) {
-        std::pair size{ 0, 0 };
-        stbi_uc* pixels = stbi_load(("Sponza/" + image.uri).c_str(), &size.first, &size.second, nullptr, STBI_rgb_alpha);
+    // One image per job, decoding times vary too much between images for bigger batches
+    const auto imageCount = static_cast<uint32_t>(document.images.size());
+    ve::JobSystem::getInstance().parallelFor(imageCount, 1, [this, &sizes, &binaries](const uint32_t begin, const uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            VE_PROFILE_SCOPE("stbi_load");
+            const auto &image = document.images[i];
+            std::pair size{ 0, 0 };
+            stbi_uc* pixels = nullptr;
 
-        sizes[std::stoi(image.id)] = size;
-        binaries[std::stoi(image.id)] = pixels;
+            // Images embedded in a buffer, as in GLB files, are decoded from the buffer's mapping
+            if (image.bufferView.has_value())
+            {
+                const auto &bufferView = document.bufferViews[*image.bufferView];
+                const auto &buffer = buffers[bufferView.buffer];
+                pixels = stbi_load_from_memory(
+                    buffer.data + bufferView.byteOffset, static_cast<int>(bufferView.byteLength),
+                    &size.first, &size.second, nullptr, STBI_rgb_alpha);
+            }
+            else
+            {
+                pixels = stbi_load((directory + image.uri).c_str(), &size.first, &size.second, nullptr, STBI_rgb_alpha);
+            }
+
+            sizes[i] = size;
+            binaries[i] = pixels;
+        }
 	});
 
-    for (size_t i = 0; i < document.images.Elements().size(); ++i)
+    images.reserve(document.images.size());
+    for (size_t i = 0; i < document.images.size(); ++i)
 	{
-		const auto &image = document.images.Elements()[i];
 		const auto &[width, height] = sizes[i];
     	auto* pixels = binaries[i];
 
 		std::shared_ptr<ve::Image> mImage = ve::Image::createTextureFromMemory(device, pixels, width, height);
-		images.emplace(image.id, mImage);
+		images.push_back(mImage);
 
 		stbi_image_free(pixels);
 	}
@@ -250,96 +589,76 @@ void GLTFLoader::loadImages(ve::Device &device)
 
 void GLTFLoader::loadTextures()
 {
-    for (const auto &texture : document.textures.Elements())
+    VE_PROFILE_SCOPE("GLTFLoader::loadTextures");
+    textures.reserve(document.textures.size());
+    for (size_t i = 0; i < document.textures.size(); ++i)
     {
+        const auto &texture = document.textures[i];
+        if (!texture.source.has_value())
+        {
+            Log::error("Texture " + std::to_string(i) + " has no image");
+            throw std::runtime_error("");
+        }
+
         const auto mTexture = std::make_shared<ve::Texture>();
-        mTexture->id = texture.id;
+        mTexture->id = std::to_string(i);
         mTexture->name = texture.name;
-        mTexture->samplerId = texture.samplerId;
-        mTexture->imageId = texture.imageId;
+        mTexture->samplerId = texture.sampler.has_value() ? std::to_string(*texture.sampler) : "";
+        mTexture->imageId = std::to_string(*texture.source);
 
-        textures.emplace(texture.id, mTexture);
+        textures.push_back(mTexture);
     }
 }
 
+std::shared_ptr<ve::Image> GLTFLoader::getTextureImage(const std::optional<uint32_t> &textureIndex) const
+{
+    if (!textureIndex.has_value())
+    {
+        return nullptr;
+    }
+    return images[*document.textures[*textureIndex].source];
+}
+
 void GLTFLoader::loadMaterials(ve::Device& device)
 {
-    for (const auto &material : document.materials.Elements())
+    VE_PROFILE_SCOPE("GLTFLoader::loadMaterials");
+    materials.reserve(document.materials.size());
+    for (size_t i = 0; i < document.materials.size(); ++i)
     {
-        auto mMaterial = std::make_shared<ve::Material>(device);
+        const auto &material = document.materials[i];
+        auto mMaterial = std::make_shared<ve::Material>();
         mMaterial->name = material.name;
-        mMaterial->id = material.id;
-
-        mMaterial->parameters.alphaCutoff = material.alphaCutoff;
-        mMaterial->parameters.doubleSided = material.doubleSided;
-
-        mMaterial->parameters.emissiveFactor = {material.emissiveFactor.r, material.emissiveFactor.g, material.emissiveFactor.b};
-
-        if (!material.emissiveTexture.textureId.empty()) {
-            const auto& texture = textures.at(material.emissiveTexture.textureId);
-            mMaterial->samplers.emissiveTexture = images.at(texture->imageId);
-        }
-
-        if (!material.normalTexture.textureId.empty()) {
-            const auto& texture = textures.at(material.normalTexture.textureId);
-            mMaterial->samplers.normalTexture = images.at(texture->imageId);
-        }
-
-        if (!material.occlusionTexture.textureId.empty()) {
-            const auto& texture = textures.at(material.occlusionTexture.textureId);
-            mMaterial->samplers.occlusionTexture = images.at(texture->imageId);
-        }
-
-        mMaterial->parameters.baseColorFactor = {
-            material.metallicRoughness.baseColorFactor.r,
-            material.metallicRoughness.baseColorFactor.g,
-            material.metallicRoughness.baseColorFactor.b,
-            material.metallicRoughness.baseColorFactor.a};
-
-        if (!material.metallicRoughness.baseColorTexture.textureId.empty()) {
-            const auto& texture = textures.at(material.metallicRoughness.baseColorTexture.textureId);
-            mMaterial->samplers.baseColorTexture = images.at(texture->imageId);
-        }
-
-        mMaterial->parameters.roughnessFactor = material.metallicRoughness.roughnessFactor;
-        mMaterial->parameters.metallicFactor = material.metallicRoughness.metallicFactor;
-
-        if (!material.metallicRoughness.metallicRoughnessTexture.textureId.empty()) {
-            const auto& texture = textures.at(material.metallicRoughness.metallicRoughnessTexture.textureId);
-            mMaterial->samplers.metallicRoughnessTexture = images.at(texture->imageId);
-        }
-
-        materials.emplace(material.id, mMaterial);
+        mMaterial->id = std::to_string(i);
+
+        ve::Material::Parameters parameters{};
+        parameters.alphaCutoff = material.alphaCutoff;
+        parameters.doubleSided = material.doubleSided;
+        parameters.emissiveFactor = material.emissiveFactor;
+        parameters.baseColorFactor = material.baseColorFactor;
+        parameters.roughnessFactor = material.roughnessFactor;
+        parameters.metallicFactor = material.metallicFactor;
+
+        mMaterial->samplers.emissiveTexture = getTextureImage(material.emissiveTexture);
+        mMaterial->samplers.normalTexture = getTextureImage(material.normalTexture);
+        mMaterial->samplers.occlusionTexture = getTextureImage(material.occlusionTexture);
+        mMaterial->samplers.baseColorTexture = getTextureImage(material.baseColorTexture);
+        mMaterial->samplers.metallicRoughnessTexture = getTextureImage(material.metallicRoughnessTexture);
+
+        mMaterial->setParameters(parameters);
+        materials.push_back(mMaterial);
     }
 }
 
 std::vector<std::unique_ptr<ve::Light>> GLTFLoader::loadLights(ve::Device& device) const
 {
+	VE_PROFILE_SCOPE("GLTFLoader::loadLights");
 	std::vector<std::unique_ptr<ve::Light>> lights{};
 
-    const auto& lightsJson = document.extensions.at("KHR_lights_punctual");
-
-    auto parser = simdjson::dom::parser();
-    const auto& result = parser.parse(lightsJson);
-
-    const auto& lightList = result.at_key("lights").get_array();
-
-    for (const auto light : lightList)
+    for (const auto &light : document.lights)
     {
-        const auto& arrColor = light.at_key("color").get_array();
-        glm::vec<3, double> color;
-        arrColor.at(0).get(color.x);
-        arrColor.at(1).get(color.y);
-        arrColor.at(2).get(color.z);
-
-    	double intensity;
-    	light.at_key("intensity").get(intensity);
-
-        const auto type = light.at_key("type").get_string().value();
-
-        std::cout << "Light type: " << type << std::endl;
-        std::cout << "Light intensity: " << intensity << std::endl;
-        std::cout << "Light color: " << color.x << " " << color.y << " " << color.z << std::endl << std::endl;
+        std::cout << "Light type: " << light.type << std::endl;
+        std::cout << "Light intensity: " << light.intensity << std::endl;
+        std::cout << "Light color: " << light.color.x << " " << light.color.y << " " << light.color.z << std::endl << std::endl;
     }
 
 	// for (const auto &node : document.nodes.Elements())
@@ -355,78 +674,69 @@ std::vector<std::unique_ptr<ve::Light>> GLTFLoader::loadLights(ve::Device& devic
 
 std::vector<std::unique_ptr<ve::RenderObject>> GLTFLoader::loadRenderTargets(ve::Device &device) const
 {
-    const auto &scene = document.GetDefaultScene();
+    VE_PROFILE_SCOPE("GLTFLoader::loadRenderTargets");
+    const auto &scene = document.getDefaultScene();
     const auto &nodes = document.nodes;
 
     std::vector<std::unique_ptr<ve::RenderObject>> renderObjects{};
 
-    std::queue<std::pair<glm::mat4, std::string>> queue{};
+    std::queue<std::pair<glm::mat4, uint32_t>> queue{};
 
-    for (const auto& nodeName : scene.nodes)
+    for (const auto nodeIndex : scene.nodes)
     {
-        queue.emplace(glm::mat4(1), nodeName);
+        queue.emplace(glm::mat4(1), nodeIndex);
     }
 
     while (!queue.empty())
     {
-        auto [transformation, nodeName] = queue.front();
+        auto [transformation, nodeIndex] = queue.front();
         queue.pop();
 
-        // if (nodeName == "48" || nodeName == "98")
-        //     continue;
-
-        const auto &node = nodes.Get(nodeName);
+        const auto &node = nodes[nodeIndex];
 
-        if (node.HasValidTransformType())
+        switch (node.transform)
         {
-            switch (node.GetTransformationType())
-            {
-            case Microsoft::glTF::TRANSFORMATION_IDENTITY:
-                break;
-            case Microsoft::glTF::TRANSFORMATION_MATRIX:
-                transformation *= glm::mat4 {
-                    node.matrix.values[0], node.matrix.values[1], node.matrix.values[2], node.matrix.values[3],
-                    node.matrix.values[4], node.matrix.values[5], node.matrix.values[6], node.matrix.values[7],
-                    node.matrix.values[8], node.matrix.values[9], node.matrix.values[10], node.matrix.values[11],
-                    node.matrix.values[12], node.matrix.values[13], node.matrix.values[14], node.matrix.values[15] };
-                break;
-            case Microsoft::glTF::TRANSFORMATION_TRS:
-                glm::vec3 translation = {
-                    -node.translation.x,
-                    node.translation.y,
-                    node.translation.z };
-                glm::quat rotation = {
-                   -node.rotation.w,
-                   - node.rotation.x,
-                    node.rotation.y,
-                    node.rotation.z};
-                glm::vec3 scale = {
-                    node.scale.x,
-                    node.scale.y,
-                    node.scale.z };
-
-                transformation = glm::translate(transformation, translation);
-                transformation = transformation * glm::mat4(rotation);
-                transformation = glm::scale(transformation, scale);
-
-                break;
-            }
+        case GLTFDocument::Node::Transform::Identity:
+            break;
+        case GLTFDocument::Node::Transform::Matrix:
+            transformation *= node.matrix;
+            break;
+        case GLTFDocument::Node::Transform::Trs:
+            glm::vec3 translation = {
+                -node.translation.x,
+                node.translation.y,
+                node.translation.z };
+            glm::quat rotation = {
+               -node.rotation.w,
+               - node.rotation.x,
+                node.rotation.y,
+                node.rotation.z};
+            glm::vec3 scale = {
+                node.scale.x,
+                node.scale.y,
+                node.scale.z };
+
+            transformation = glm::translate(transformation, translation);
+            transformation = transformation * glm::mat4(rotation);
+            transformation = glm::scale(transformation, scale);
+
+            break;
         }
 
-        if (!node.meshId.empty())
+        if (node.mesh.has_value())
         {
-            const auto &meshes = this->meshes.at(node.meshId);
-            auto renderObject = std::make_unique<ve::RenderObject>(device);
+            const auto &meshes = this->meshes[*node.mesh];
+            auto renderObject = std::make_unique<ve::RenderObject>();
             renderObject->meshes = meshes;
-            renderObject->localModelMatrix = transformation;
+            renderObject->setLocalModelMatrix(transformation);
 
             renderObjects.emplace_back(std::move(renderObject));
         }
 
 
-    	for (const auto &childName : node.children)
+    	for (const auto childIndex : node.children)
     	{
-            queue.emplace(transformation, childName);
+            queue.emplace(transformation, childIndex);
     	}
     }
     return renderObjects;
@@ -1,39 +1,68 @@
 #pragma once
 
-#include <GLTFSDK/Deserialize.h>
-
 #include "../engine/graphics/material.hpp"
 #include "../engine/graphics/mesh.hpp"
 #include "../engine/graphics/image.hpp"
 #include "../engine/graphics/texture.hpp"
 #include "../engine/graphics/renderObject.hpp"
 #include "../engine/graphics/light.hpp"
-
-#define SIMDJSON_USING_LIBRARY
-#include <simdjson.h>
+#include "accessorReader.hpp"
+#include "gltfDocument.hpp"
+#include "mappedFile.hpp"
+#include "meshOptimizer.hpp"
 
 class GLTFLoader
 {
 public:
+	// Vertex cache efficiency of an optimized primitive, with its indices as stored in the file and as uploaded
+	struct PrimitiveStats
+	{
+		uint32_t mesh = 0;
+		uint32_t primitive = 0;
+		uint32_t triangleCount = 0;
+		// After unused vertices were dropped
+		uint32_t vertexCount = 0;
+		MeshOptimizer::CacheStats before;
+		MeshOptimizer::CacheStats after;
+		float milliseconds = 0.0f;
+	};
+
 	explicit GLTFLoader(ve::Device&, const std::string&);
 
 	std::vector<std::unique_ptr<ve::RenderObject>> loadRenderTargets(ve::Device&) const;
 	std::vector<std::unique_ptr<ve::Light>> loadLights(ve::Device&) const;
 
-	std::unordered_map<std::string, std::vector<std::shared_ptr<ve::Mesh>>> meshes;
-	std::unordered_map<std::string, std::shared_ptr<ve::Image>> images;
-	std::unordered_map<std::string, std::vector<uint8_t>> buffers;
-	std::unordered_map<std::string, std::shared_ptr<ve::Material>> materials;
-	std::unordered_map<std::string, std::shared_ptr<ve::Texture>> textures;
+	// Indexed like the arrays of the document
+	std::vector<std::vector<std::shared_ptr<ve::Mesh>>> meshes;
+	std::vector<std::shared_ptr<ve::Image>> images;
+	std::vector<std::shared_ptr<ve::Material>> materials;
+	std::vector<std::shared_ptr<ve::Texture>> textures;
+
+	// Primitives optimized with Settings::OPTIMIZE_MESHES, in load order
+	const std::vector<PrimitiveStats> &getOptimizationStats() const { return optimizationStats; }
+	// One CSV line per optimized primitive
+	void writeOptimizationReport(const std::string &path) const;
 
 private:
 	void loadDocument(const std::string&);
 	void loadBuffers();
-	void loadMeshes(ve::Device&);
+	void loadMeshes();
 	void loadImages(ve::Device&);
 	void loadTextures();
 	void loadMaterials(ve::Device&);
+	// Null without a texture
+	std::shared_ptr<ve::Image> getTextureImage(const std::optional<uint32_t> &textureIndex) const;
+
+	GLTFDocument document;
+
+	// Directory of the glTF file, uris are relative to it
+	std::string directory;
+	// Mapped until the constructor is done with them
+	std::vector<MappedFile> files;
+	std::vector<BufferData> buffers;
+	// Binary chunk of a GLB file, null for .gltf files
+	BufferData glbBinary;
 
-	Microsoft::glTF::Document document;
+	std::vector<PrimitiveStats> optimizationStats;
 
 };
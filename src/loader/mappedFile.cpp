@@ -0,0 +1,152 @@
+#include "mappedFile.hpp"
+
+#include "../log.hpp"
+
+// std
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string &path, const Access access) : path(path)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              access == Access::Sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        Log::error("Failed to open " + path);
+        throw std::runtime_error("");
+    }
+
+    LARGE_INTEGER fileSize{};
+    if (!GetFileSizeEx(file, &fileSize))
+    {
+        CloseHandle(file);
+        Log::error("Failed to get the size of " + path);
+        throw std::runtime_error("");
+    }
+    length = static_cast<size_t>(fileSize.QuadPart);
+    if (length == 0)
+    {
+        CloseHandle(file);
+        return;
+    }
+
+    // The view keeps the mapping alive and the mapping keeps the file open, neither handle is needed past this
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr)
+    {
+        Log::error("Failed to map " + path);
+        throw std::runtime_error("");
+    }
+
+    bytes = static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (bytes == nullptr)
+    {
+        CloseHandle(mapping);
+        Log::error("Failed to map " + path);
+        throw std::runtime_error("");
+    }
+#else
+    const int file = open(path.c_str(), O_RDONLY);
+    if (file == -1)
+    {
+        Log::error("Failed to open " + path);
+        throw std::runtime_error("");
+    }
+
+    struct stat status{};
+    if (fstat(file, &status) == -1)
+    {
+        close(file);
+        Log::error("Failed to get the size of " + path);
+        throw std::runtime_error("");
+    }
+    length = static_cast<size_t>(status.st_size);
+    if (length == 0)
+    {
+        close(file);
+        return;
+    }
+
+    // The mapping holds its own reference to the file
+    void *address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (address == MAP_FAILED)
+    {
+        Log::error("Failed to map " + path);
+        throw std::runtime_error("");
+    }
+    bytes = static_cast<const uint8_t *>(address);
+
+    // Only hints, the mapping works the same when the kernel ignores them
+    if (access == Access::Sequential)
+    {
+        madvise(address, length, MADV_SEQUENTIAL);
+        madvise(address, length, MADV_WILLNEED);
+    }
+    else
+    {
+        madvise(address, length, MADV_RANDOM);
+    }
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+    unmap();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : path(std::move(other.path)),
+      bytes(std::exchange(other.bytes, nullptr)),
+      length(std::exchange(other.length, 0))
+#ifdef _WIN32
+    , mapping(std::exchange(other.mapping, nullptr))
+#endif
+{
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other)
+    {
+        unmap();
+        path = std::move(other.path);
+        bytes = std::exchange(other.bytes, nullptr);
+        length = std::exchange(other.length, 0);
+#ifdef _WIN32
+        mapping = std::exchange(other.mapping, nullptr);
+#endif
+    }
+    return *this;
+}
+
+void MappedFile::unmap()
+{
+    if (bytes == nullptr)
+    {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(bytes);
+    CloseHandle(mapping);
+    mapping = nullptr;
+#else
+    munmap(const_cast<uint8_t *>(bytes), length);
+#endif
+    bytes = nullptr;
+    length = 0;
+}
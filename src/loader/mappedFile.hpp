@@ -0,0 +1,42 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// A whole file mapped read-only into the address space. Pages are read in by the OS as they are touched, so the
+// contents are never copied into a buffer of our own.
+class MappedFile
+{
+public:
+    enum class Access
+    {
+        // Read front to back once, the OS reads ahead aggressively and may drop pages behind the reader
+        Sequential,
+        Random
+    };
+
+    explicit MappedFile(const std::string &path, Access access = Access::Sequential);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    const uint8_t *data() const { return bytes; }
+    size_t size() const { return length; }
+    const std::string &getPath() const { return path; }
+
+private:
+    void unmap();
+
+    std::string path;
+    // Null for an empty file, those can't be mapped
+    const uint8_t *bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void *mapping = nullptr;
+#endif
+};
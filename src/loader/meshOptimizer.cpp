@@ -0,0 +1,359 @@
+#include "meshOptimizer.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace
+{
+    // Forsyth's scoring parameters, from "Linear-Speed Vertex Cache Optimisation"
+    constexpr uint32_t SCORING_CACHE_SIZE = 32;
+    constexpr float CACHE_DECAY_POWER = 1.5f;
+    constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+    constexpr float VALENCE_BOOST_SCALE = 2.0f;
+    constexpr float VALENCE_BOOST_POWER = 0.5f;
+    // Valences above this are scored like it, their boost is close to nothing anyway
+    constexpr uint32_t MAX_SCORED_VALENCE = 32;
+
+    struct ScoreTable
+    {
+        float cache[SCORING_CACHE_SIZE];
+        float valence[MAX_SCORED_VALENCE + 1];
+
+        ScoreTable()
+        {
+            for (uint32_t position = 0; position < SCORING_CACHE_SIZE; position++)
+            {
+                // The last triangle's vertices get a fixed score, so the next one doesn't simply reuse the same
+                // edge in the same direction
+                cache[position] = position < 3
+                    ? LAST_TRIANGLE_SCORE
+                    : std::pow(1.0f - static_cast<float>(position - 3) / (SCORING_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+            }
+            valence[0] = 0.0f;
+            for (uint32_t count = 1; count <= MAX_SCORED_VALENCE; count++)
+            {
+                valence[count] = VALENCE_BOOST_SCALE * std::pow(static_cast<float>(count), -VALENCE_BOOST_POWER);
+            }
+        }
+
+        // A vertex without triangles left is never looked at again
+        float get(const int32_t cachePosition, const uint32_t remaining) const
+        {
+            if (remaining == 0)
+            {
+                return -1.0f;
+            }
+            const float cacheScore = cachePosition >= 0 ? cache[cachePosition] : 0.0f;
+            return cacheScore + valence[std::min(remaining, MAX_SCORED_VALENCE)];
+        }
+    };
+
+    // Triangles using each vertex, as slices of one array
+    struct Adjacency
+    {
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> counts;
+        std::vector<uint32_t> triangles;
+
+        Adjacency(const std::vector<uint32_t> &indices, const size_t vertexCount)
+            : offsets(vertexCount + 1, 0), counts(vertexCount, 0), triangles(indices.size())
+        {
+            for (const uint32_t index : indices)
+            {
+                counts[index]++;
+            }
+            for (size_t vertex = 0; vertex < vertexCount; vertex++)
+            {
+                offsets[vertex + 1] = offsets[vertex] + counts[vertex];
+                counts[vertex] = 0;
+            }
+            for (size_t i = 0; i < indices.size(); i++)
+            {
+                const uint32_t vertex = indices[i];
+                triangles[offsets[vertex] + counts[vertex]++] = static_cast<uint32_t>(i / 3);
+            }
+        }
+
+        void remove(const uint32_t vertex, const uint32_t triangle)
+        {
+            uint32_t *begin = &triangles[offsets[vertex]];
+            uint32_t *end = begin + counts[vertex];
+            std::iter_swap(std::find(begin, end, triangle), end - 1);
+            counts[vertex]--;
+        }
+    };
+
+    // Triangle clusters of at least one triangle, by first triangle, closed by the index count / 3
+    std::vector<uint32_t> findClusters(const std::vector<uint32_t> &indices, const size_t vertexCount,
+                                       const float threshold)
+    {
+        const auto triangleCount = static_cast<uint32_t>(indices.size() / 3);
+        std::vector<uint32_t> cacheTimes(vertexCount, 0);
+        uint32_t time = MeshOptimizer::ANALYSIS_CACHE_SIZE + 1;
+
+        // Misses of the whole order, against which the clusters are measured
+        uint32_t misses = 0;
+        for (const uint32_t index : indices)
+        {
+            if (time - cacheTimes[index] > MeshOptimizer::ANALYSIS_CACHE_SIZE)
+            {
+                cacheTimes[index] = time++;
+                misses++;
+            }
+        }
+        const float acmr = static_cast<float>(misses) / static_cast<float>(triangleCount);
+
+        // Each cluster starts on a cold cache, as if the ones before it could be drawn anywhere else. It ends as
+        // soon as its own ACMR is back within the threshold.
+        std::vector<uint32_t> clusters{0};
+        std::fill(cacheTimes.begin(), cacheTimes.end(), 0);
+        time += MeshOptimizer::ANALYSIS_CACHE_SIZE + 1;
+        uint32_t clusterMisses = 0;
+        for (uint32_t triangle = 0; triangle < triangleCount; triangle++)
+        {
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                const uint32_t index = indices[triangle * 3 + corner];
+                if (time - cacheTimes[index] > MeshOptimizer::ANALYSIS_CACHE_SIZE)
+                {
+                    cacheTimes[index] = time++;
+                    clusterMisses++;
+                }
+            }
+
+            const uint32_t clusterTriangles = triangle + 1 - clusters.back();
+            if (triangle + 1 < triangleCount &&
+                static_cast<float>(clusterMisses) <= threshold * acmr * static_cast<float>(clusterTriangles))
+            {
+                clusters.push_back(triangle + 1);
+                time += MeshOptimizer::ANALYSIS_CACHE_SIZE + 1;
+                clusterMisses = 0;
+            }
+        }
+        return clusters;
+    }
+}
+
+MeshOptimizer::CacheStats MeshOptimizer::analyzeVertexCache(const std::vector<uint32_t> &indices,
+                                                            const size_t vertexCount)
+{
+    if (indices.empty() || vertexCount == 0)
+    {
+        return {};
+    }
+
+    // A vertex is in the cache while fewer than ANALYSIS_CACHE_SIZE misses came after its own
+    std::vector<uint32_t> cacheTimes(vertexCount, 0);
+    uint32_t time = ANALYSIS_CACHE_SIZE + 1;
+    uint32_t misses = 0;
+    for (const uint32_t index : indices)
+    {
+        if (time - cacheTimes[index] > ANALYSIS_CACHE_SIZE)
+        {
+            cacheTimes[index] = time++;
+            misses++;
+        }
+    }
+
+    CacheStats stats{};
+    stats.acmr = static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+    stats.atvr = static_cast<float>(misses) / static_cast<float>(vertexCount);
+    return stats;
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<uint32_t> &indices, const size_t vertexCount)
+{
+    static const ScoreTable scores;
+
+    const auto triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    Adjacency adjacency(indices, vertexCount);
+    std::vector<int32_t> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t vertex = 0; vertex < vertexCount; vertex++)
+    {
+        vertexScores[vertex] = scores.get(-1, adjacency.counts[vertex]);
+    }
+
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for (uint32_t triangle = 0; triangle < triangleCount; triangle++)
+    {
+        triangleScores[triangle] = vertexScores[indices[triangle * 3]] + vertexScores[indices[triangle * 3 + 1]] +
+                                   vertexScores[indices[triangle * 3 + 2]];
+    }
+
+    std::vector<uint32_t> optimized;
+    optimized.reserve(indices.size());
+    // The cache after the last triangle, its 3 vertices in front of the previous entries
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> nextCache;
+    cache.reserve(SCORING_CACHE_SIZE + 3);
+    nextCache.reserve(SCORING_CACHE_SIZE + 3);
+
+    int64_t best = -1;
+    // Where to look for a triangle once none in the cache is left, every triangle before it is emitted
+    uint32_t cursor = 0;
+    for (uint32_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+    {
+        if (best < 0)
+        {
+            while (emitted[cursor])
+            {
+                cursor++;
+            }
+            best = cursor;
+        }
+
+        const auto triangle = static_cast<uint32_t>(best);
+        const uint32_t *corners = &indices[triangle * 3];
+        optimized.insert(optimized.end(), corners, corners + 3);
+        emitted[triangle] = true;
+
+        // Degenerate triangles repeat a vertex, it takes one entry
+        nextCache.clear();
+        for (uint32_t corner = 0; corner < 3; corner++)
+        {
+            if (std::find(nextCache.begin(), nextCache.end(), corners[corner]) == nextCache.end())
+            {
+                nextCache.push_back(corners[corner]);
+            }
+        }
+        for (const uint32_t vertex : cache)
+        {
+            if (vertex != corners[0] && vertex != corners[1] && vertex != corners[2])
+            {
+                nextCache.push_back(vertex);
+            }
+        }
+        cache.swap(nextCache);
+        for (uint32_t corner = 0; corner < 3; corner++)
+        {
+            adjacency.remove(corners[corner], triangle);
+        }
+
+        // Rescores the cached vertices, and the ones that just fell out of it, along with their triangles
+        for (size_t position = 0; position < cache.size(); position++)
+        {
+            const uint32_t vertex = cache[position];
+            cachePositions[vertex] = position < SCORING_CACHE_SIZE ? static_cast<int32_t>(position) : -1;
+            const float score = scores.get(cachePositions[vertex], adjacency.counts[vertex]);
+            const float delta = score - vertexScores[vertex];
+            vertexScores[vertex] = score;
+
+            const uint32_t *adjacent = &adjacency.triangles[adjacency.offsets[vertex]];
+            for (uint32_t i = 0; i < adjacency.counts[vertex]; i++)
+            {
+                triangleScores[adjacent[i]] += delta;
+            }
+        }
+        if (cache.size() > SCORING_CACHE_SIZE)
+        {
+            cache.resize(SCORING_CACHE_SIZE);
+        }
+
+        // The next triangle shares a cached vertex, unless the cached vertices have none left
+        best = -1;
+        float bestScore = -1.0f;
+        for (const uint32_t vertex : cache)
+        {
+            const uint32_t *adjacent = &adjacency.triangles[adjacency.offsets[vertex]];
+            for (uint32_t i = 0; i < adjacency.counts[vertex]; i++)
+            {
+                if (triangleScores[adjacent[i]] > bestScore)
+                {
+                    bestScore = triangleScores[adjacent[i]];
+                    best = adjacent[i];
+                }
+            }
+        }
+    }
+
+    indices.swap(optimized);
+}
+
+void MeshOptimizer::optimizeOverdraw(std::vector<uint32_t> &indices, const std::vector<ve::Mesh::Vertex> &vertices,
+                                     const float threshold)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    std::vector<uint32_t> clusters = findClusters(indices, vertices.size(), threshold);
+    const size_t clusterCount = clusters.size();
+    clusters.push_back(static_cast<uint32_t>(triangleCount));
+
+    // Area weighted, the cross product's length is twice the triangle's area
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0.0f));
+    for (size_t cluster = 0; cluster < clusterCount; cluster++)
+    {
+        float clusterArea = 0.0f;
+        for (uint32_t triangle = clusters[cluster]; triangle < clusters[cluster + 1]; triangle++)
+        {
+            const glm::vec3 &a = vertices[indices[triangle * 3]].position;
+            const glm::vec3 &b = vertices[indices[triangle * 3 + 1]].position;
+            const glm::vec3 &c = vertices[indices[triangle * 3 + 2]].position;
+            const glm::vec3 normal = glm::cross(b - a, c - a);
+            const float area = glm::length(normal);
+
+            clusterCentroids[cluster] += (a + b + c) * (area / 3.0f);
+            clusterNormals[cluster] += normal;
+            clusterArea += area;
+        }
+        meshCentroid += clusterCentroids[cluster];
+        meshArea += clusterArea;
+        clusterCentroids[cluster] /= clusterArea > 0.0f ? clusterArea : 1.0f;
+    }
+    meshCentroid /= meshArea > 0.0f ? meshArea : 1.0f;
+
+    // How far out along its own normal a cluster faces, the ones furthest out are drawn first
+    std::vector<float> sortKeys(clusterCount);
+    for (size_t cluster = 0; cluster < clusterCount; cluster++)
+    {
+        const float length = glm::length(clusterNormals[cluster]);
+        const glm::vec3 normal = length > 0.0f ? clusterNormals[cluster] / length : glm::vec3(0.0f);
+        sortKeys[cluster] = glm::dot(clusterCentroids[cluster] - meshCentroid, normal);
+    }
+
+    std::vector<uint32_t> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(),
+                     [&sortKeys](const uint32_t a, const uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    std::vector<uint32_t> sorted;
+    sorted.reserve(indices.size());
+    for (const uint32_t cluster : order)
+    {
+        sorted.insert(sorted.end(), indices.begin() + clusters[cluster] * 3, indices.begin() + clusters[cluster + 1] * 3);
+    }
+    indices.swap(sorted);
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<uint32_t> &indices, std::vector<ve::Mesh::Vertex> &vertices)
+{
+    constexpr uint32_t UNUSED = UINT32_MAX;
+    std::vector<uint32_t> remap(vertices.size(), UNUSED);
+    std::vector<ve::Mesh::Vertex> remapped;
+    remapped.reserve(vertices.size());
+    for (uint32_t &index : indices)
+    {
+        if (remap[index] == UNUSED)
+        {
+            remap[index] = static_cast<uint32_t>(remapped.size());
+            remapped.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(remapped);
+}
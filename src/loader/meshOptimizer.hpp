@@ -0,0 +1,40 @@
+#pragma once
+
+#include "../engine/graphics/mesh.hpp"
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Import time reordering of indexed triangle lists for the GPU. Triangles are ordered for the post-transform vertex
+// cache, optionally regrouped so that outward facing clusters are drawn first, and vertices are renumbered in the
+// order the triangles use them so vertex fetch walks memory linearly.
+class MeshOptimizer
+{
+public:
+	// How well an index order reuses transformed vertices, simulated on a FIFO cache of ANALYSIS_CACHE_SIZE
+	struct CacheStats
+	{
+		// Transformed vertices per triangle, 3 at worst, around 0.6 for a well ordered regular grid
+		float acmr = 0.0f;
+		// Transformed vertices per vertex, 1 at best
+		float atvr = 0.0f;
+	};
+
+	// Close to the reuse window of current GPUs, which batch vertices rather than keep a true cache
+	static constexpr uint32_t ANALYSIS_CACHE_SIZE = 16;
+
+	static CacheStats analyzeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount);
+
+	// Tom Forsyth's linear speed vertex cache optimization: triangles are added greedily, scored by where their
+	// vertices sit in a simulated LRU cache and by how few triangles those vertices have left.
+	static void optimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount);
+	// Sander et al., fast triangle reordering for reduced overdraw. The cache optimized order is cut into clusters
+	// whose own ACMR stays within threshold times the mesh's, which are then sorted so the ones facing away from
+	// the mesh's centroid go first and occlude the rest from most directions.
+	static void optimizeOverdraw(std::vector<uint32_t> &indices, const std::vector<ve::Mesh::Vertex> &vertices,
+	                             float threshold = 1.05f);
+	// Renumbers the vertices in the order the indices first use them and drops the unused ones
+	static void optimizeVertexFetch(std::vector<uint32_t> &indices, std::vector<ve::Mesh::Vertex> &vertices);
+};
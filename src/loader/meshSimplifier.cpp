@@ -0,0 +1,592 @@
+#include "meshSimplifier.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+
+namespace
+{
+    constexpr uint32_t NO_VERTEX = UINT32_MAX;
+    // A vertex with open edges to more than one other in the same direction
+    constexpr uint32_t MANY_VERTICES = UINT32_MAX - 1;
+
+    // The position, scaled into a unit sized box, then the weighted normal and texture coordinates
+    constexpr uint32_t DIMENSIONS = 8;
+    // A normal turning by about a radian costs like moving the surface by half the mesh's size, texture coordinates
+    // count as much as positions: on a mesh textured once across, sliding a vertex along the surface smears the
+    // texture by as much as it moves
+    constexpr float NORMAL_WEIGHT = 0.5f;
+    constexpr float TEX_COORD_WEIGHT = 1.0f;
+    // Triangles around a collapse may turn by up to about 75 degrees, further and they are taken as flipped
+    constexpr float MIN_TURN_COSINE = 0.25f;
+    // A level that removes less than this of the one before is not worth storing
+    constexpr float MAX_LEVEL_RATIO = 0.85f;
+
+    using Point = std::array<float, DIMENSIONS>;
+
+    enum class Kind : uint8_t
+    {
+        // Inside a chart, free to collapse into any neighbour
+        Manifold,
+        // One of the two copies of a vertex on an attribute seam, collapses along the seam with its twin
+        Seam,
+        // On a border, or on a seam in a way a collapse could not keep intact
+        Locked,
+    };
+
+    // The area weighted sum of squared distances to the planes of triangles, in position and attribute space, from
+    // "Simplifying Surfaces with Color and Texture using Quadric Error Metrics". Evaluates to v^T A v + 2 b^T v + c.
+    struct Quadric
+    {
+        // Upper triangle of the symmetric A, row by row
+        float a[DIMENSIONS * (DIMENSIONS + 1) / 2]{};
+        float b[DIMENSIONS]{};
+        float c = 0.0f;
+        float weight = 0.0f;
+
+        Quadric &operator+=(const Quadric &other)
+        {
+            for (uint32_t i = 0; i < std::size(a); i++)
+            {
+                a[i] += other.a[i];
+            }
+            for (uint32_t i = 0; i < DIMENSIONS; i++)
+            {
+                b[i] += other.b[i];
+            }
+            c += other.c;
+            weight += other.weight;
+            return *this;
+        }
+
+        // Unnormalized, divided by the weight it is a mean squared distance
+        float evaluate(const Point &point) const
+        {
+            float result = c;
+            uint32_t element = 0;
+            for (uint32_t i = 0; i < DIMENSIONS; i++)
+            {
+                result += a[element++] * point[i] * point[i];
+                for (uint32_t j = i + 1; j < DIMENSIONS; j++)
+                {
+                    result += 2.0f * a[element++] * point[i] * point[j];
+                }
+                result += 2.0f * b[i] * point[i];
+            }
+            // Rounding can take it a little below 0 on the plane itself
+            return std::max(result, 0.0f);
+        }
+    };
+
+    float dot(const Point &left, const Point &right)
+    {
+        float result = 0.0f;
+        for (uint32_t i = 0; i < DIMENSIONS; i++)
+        {
+            result += left[i] * right[i];
+        }
+        return result;
+    }
+
+    // Scales the point to unit length, false if it has none
+    bool normalize(Point &point)
+    {
+        const float length = std::sqrt(dot(point, point));
+        if (length < 1e-12f)
+        {
+            return false;
+        }
+        for (float &value : point)
+        {
+            value /= length;
+        }
+        return true;
+    }
+
+    // Of the plane through the three points, empty for a degenerate triangle
+    Quadric triangleQuadric(const Point &p, const Point &q, const Point &r, const float area)
+    {
+        // Orthonormal basis of the plane, by Gram-Schmidt
+        Point e1;
+        Point e2;
+        for (uint32_t i = 0; i < DIMENSIONS; i++)
+        {
+            e1[i] = q[i] - p[i];
+            e2[i] = r[i] - p[i];
+        }
+        if (!normalize(e1))
+        {
+            return {};
+        }
+        const float along = dot(e2, e1);
+        for (uint32_t i = 0; i < DIMENSIONS; i++)
+        {
+            e2[i] -= along * e1[i];
+        }
+        if (!normalize(e2))
+        {
+            return {};
+        }
+
+        const float pe1 = dot(p, e1);
+        const float pe2 = dot(p, e2);
+        Quadric quadric;
+        uint32_t element = 0;
+        for (uint32_t i = 0; i < DIMENSIONS; i++)
+        {
+            for (uint32_t j = i; j < DIMENSIONS; j++)
+            {
+                const float identity = i == j ? 1.0f : 0.0f;
+                quadric.a[element++] = area * (identity - e1[i] * e1[j] - e2[i] * e2[j]);
+            }
+            quadric.b[i] = area * (pe1 * e1[i] + pe2 * e2[i] - p[i]);
+        }
+        quadric.c = area * (dot(p, p) - pe1 * pe1 - pe2 * pe2);
+        quadric.weight = area;
+        return quadric;
+    }
+
+    glm::vec3 triangleNormal(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+    {
+        return glm::cross(b - a, c - a);
+    }
+
+    struct Collapse
+    {
+        uint32_t from;
+        uint32_t to;
+        // The seam twins that collapse along with them, NO_VERTEX otherwise
+        uint32_t twinFrom;
+        uint32_t twinTo;
+        // Mean squared, relative to the mesh's size
+        float error;
+    };
+
+    class Simplifier
+    {
+    public:
+        Simplifier(const std::vector<uint32_t> &indices, const std::vector<ve::Mesh::Vertex> &vertices)
+            : indices(indices), vertices(vertices), vertexCount(vertices.size())
+        {
+            glm::vec3 min(FLT_MAX);
+            glm::vec3 max(-FLT_MAX);
+            for (const auto &vertex : vertices)
+            {
+                min = glm::min(min, vertex.position);
+                max = glm::max(max, vertex.position);
+            }
+            extent = std::max(std::max(max.x - min.x, max.y - min.y), max.z - min.z);
+            const float scale = extent > 0.0f ? 1.0f / extent : 0.0f;
+
+            points.resize(vertexCount);
+            for (size_t i = 0; i < vertexCount; i++)
+            {
+                const auto &vertex = vertices[i];
+                const glm::vec3 position = (vertex.position - min) * scale;
+                points[i] = {
+                    position.x, position.y, position.z,
+                    vertex.normal.x * NORMAL_WEIGHT, vertex.normal.y * NORMAL_WEIGHT, vertex.normal.z * NORMAL_WEIGHT,
+                    vertex.tex_coord_0.x * TEX_COORD_WEIGHT, vertex.tex_coord_0.y * TEX_COORD_WEIGHT};
+            }
+
+            findPositionCopies();
+
+            quadrics.resize(vertexCount);
+            for (size_t triangle = 0; triangle < indices.size() / 3; triangle++)
+            {
+                const uint32_t *corners = &indices[triangle * 3];
+                const float area = 0.5f * glm::length(triangleNormal(
+                    vertices[corners[0]].position * scale,
+                    vertices[corners[1]].position * scale,
+                    vertices[corners[2]].position * scale));
+                const Quadric quadric = triangleQuadric(
+                    points[corners[0]], points[corners[1]], points[corners[2]], area);
+                for (uint32_t corner = 0; corner < 3; corner++)
+                {
+                    quadrics[corners[corner]] += quadric;
+                }
+            }
+
+            collapseTargets.resize(vertexCount);
+            std::iota(collapseTargets.begin(), collapseTargets.end(), 0);
+        }
+
+        // Collapses a batch of independent edges, cheapest first, false when none could be
+        bool pass(const size_t targetIndexCount, const float maxSquaredError)
+        {
+            buildAdjacency();
+            classifyVertices();
+
+            std::vector<Collapse> collapses;
+            for (size_t i = 0; i < indices.size(); i++)
+            {
+                const uint32_t from = indices[i];
+                const uint32_t to = indices[i - i % 3 + (i + 1) % 3];
+                // Interior edges are seen from both of their triangles, once is enough
+                if (positions[from] == positions[to] || (from > to && hasEdge(to, from)))
+                {
+                    continue;
+                }
+                Collapse forward{};
+                Collapse backward{};
+                const bool canForward = findCollapse(from, to, forward);
+                const bool canBackward = findCollapse(to, from, backward);
+                if (canForward || canBackward)
+                {
+                    collapses.push_back(!canBackward || (canForward && forward.error <= backward.error)
+                                            ? forward : backward);
+                }
+            }
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse &left, const Collapse &right) {
+                return left.error < right.error;
+            });
+
+            // Collapses of one pass touch disjoint vertices, so the errors they were sorted by still hold
+            std::vector<bool> touched(vertexCount, false);
+            const size_t trianglesToRemove = (indices.size() - targetIndexCount) / 3;
+            size_t trianglesRemoved = 0;
+            uint32_t collapsed = 0;
+            for (const auto &collapse : collapses)
+            {
+                if (collapse.error > maxSquaredError || trianglesRemoved >= trianglesToRemove)
+                {
+                    break;
+                }
+                if (touched[positions[collapse.from]] || touched[positions[collapse.to]] ||
+                    flips(collapse.from, collapse.to) ||
+                    (collapse.twinFrom != NO_VERTEX && flips(collapse.twinFrom, collapse.twinTo)))
+                {
+                    continue;
+                }
+
+                trianglesRemoved += countShared(collapse.from, collapse.to);
+                collapseTargets[collapse.from] = collapse.to;
+                quadrics[collapse.to] += quadrics[collapse.from];
+                if (collapse.twinFrom != NO_VERTEX)
+                {
+                    trianglesRemoved += countShared(collapse.twinFrom, collapse.twinTo);
+                    collapseTargets[collapse.twinFrom] = collapse.twinTo;
+                    quadrics[collapse.twinTo] += quadrics[collapse.twinFrom];
+                }
+                touched[positions[collapse.from]] = true;
+                touched[positions[collapse.to]] = true;
+                squaredError = std::max(squaredError, collapse.error);
+                collapsed++;
+            }
+            if (collapsed == 0)
+            {
+                return false;
+            }
+
+            // Triangles with two corners in one place are gone
+            size_t write = 0;
+            for (size_t read = 0; read < indices.size(); read += 3)
+            {
+                const uint32_t a = resolve(indices[read]);
+                const uint32_t b = resolve(indices[read + 1]);
+                const uint32_t c = resolve(indices[read + 2]);
+                if (positions[a] != positions[b] && positions[b] != positions[c] && positions[c] != positions[a])
+                {
+                    indices[write++] = a;
+                    indices[write++] = b;
+                    indices[write++] = c;
+                }
+            }
+            indices.resize(write);
+            return true;
+        }
+
+        const std::vector<uint32_t> &getIndices() const { return indices; }
+        // In the units of the positions
+        float getError() const { return std::sqrt(squaredError) * extent; }
+
+    private:
+        // positions[v] is the first vertex at v's position, twins[v] the next one there, in a ring
+        void findPositionCopies()
+        {
+            std::vector<uint32_t> order(vertexCount);
+            std::iota(order.begin(), order.end(), 0);
+            const auto less = [this](const uint32_t left, const uint32_t right) {
+                const auto &a = vertices[left].position;
+                const auto &b = vertices[right].position;
+                return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z < b.z;
+            };
+            std::sort(order.begin(), order.end(), less);
+
+            positions.resize(vertexCount);
+            twins.resize(vertexCount);
+            for (size_t first = 0; first < vertexCount;)
+            {
+                size_t last = first + 1;
+                while (last < vertexCount && vertices[order[last]].position == vertices[order[first]].position)
+                {
+                    last++;
+                }
+                for (size_t i = first; i < last; i++)
+                {
+                    positions[order[i]] = order[first];
+                    twins[order[i]] = order[i + 1 < last ? i + 1 : first];
+                }
+                first = last;
+            }
+        }
+
+        // Triangles using each vertex, as slices of one array
+        void buildAdjacency()
+        {
+            offsets.assign(vertexCount + 1, 0);
+            for (const uint32_t index : indices)
+            {
+                offsets[index + 1]++;
+            }
+            std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+            triangles.resize(indices.size());
+            std::vector<uint32_t> filled(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < indices.size(); i++)
+            {
+                triangles[filled[indices[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+        }
+
+        // Whether a triangle has the directed edge from -> to
+        bool hasEdge(const uint32_t from, const uint32_t to) const
+        {
+            for (uint32_t i = offsets[from]; i < offsets[from + 1]; i++)
+            {
+                const uint32_t *corners = &indices[triangles[i] * 3];
+                for (uint32_t corner = 0; corner < 3; corner++)
+                {
+                    if (corners[corner] == from && corners[(corner + 1) % 3] == to)
+                    {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        // Whether a copy of from has an edge to a copy of to
+        bool hasPositionEdge(const uint32_t from, const uint32_t to) const
+        {
+            uint32_t copy = from;
+            do
+            {
+                for (uint32_t i = offsets[copy]; i < offsets[copy + 1]; i++)
+                {
+                    const uint32_t *corners = &indices[triangles[i] * 3];
+                    for (uint32_t corner = 0; corner < 3; corner++)
+                    {
+                        if (corners[corner] == copy && positions[corners[(corner + 1) % 3]] == positions[to])
+                        {
+                            return true;
+                        }
+                    }
+                }
+                copy = twins[copy];
+            } while (copy != from);
+            return false;
+        }
+
+        // Open edges have no triangle running the other way between the same vertices. They are borders when no
+        // copies of the vertices close them either, and seams otherwise.
+        void classifyVertices()
+        {
+            openOut.assign(vertexCount, NO_VERTEX);
+            openIn.assign(vertexCount, NO_VERTEX);
+            const auto link = [](uint32_t &slot, const uint32_t vertex) {
+                slot = slot == NO_VERTEX || slot == vertex ? vertex : MANY_VERTICES;
+            };
+            for (size_t i = 0; i < indices.size(); i++)
+            {
+                const uint32_t from = indices[i];
+                const uint32_t to = indices[i - i % 3 + (i + 1) % 3];
+                if (!hasEdge(to, from))
+                {
+                    link(openOut[from], to);
+                    link(openIn[to], from);
+                }
+            }
+
+            const auto isSeamEdge = [this](const uint32_t from, const uint32_t to) {
+                return from < MANY_VERTICES && to < MANY_VERTICES && hasPositionEdge(to, from);
+            };
+            kinds.assign(vertexCount, Kind::Locked);
+            for (uint32_t vertex = 0; vertex < vertexCount; vertex++)
+            {
+                const uint32_t twin = twins[vertex];
+                if (twin == vertex)
+                {
+                    kinds[vertex] = openOut[vertex] == NO_VERTEX && openIn[vertex] == NO_VERTEX
+                        ? Kind::Manifold : Kind::Locked;
+                    continue;
+                }
+                // Exactly two copies, each with one open edge in and one out, running along the same positions in
+                // opposite directions
+                if (twins[twin] == vertex &&
+                    isSeamEdge(vertex, openOut[vertex]) && isSeamEdge(openIn[vertex], vertex) &&
+                    isSeamEdge(twin, openOut[twin]) && isSeamEdge(openIn[twin], twin) &&
+                    positions[openOut[vertex]] == positions[openIn[twin]] &&
+                    positions[openIn[vertex]] == positions[openOut[twin]])
+                {
+                    kinds[vertex] = Kind::Seam;
+                }
+            }
+        }
+
+        bool findCollapse(const uint32_t from, const uint32_t to, Collapse &collapse) const
+        {
+            collapse = {from, to, NO_VERTEX, NO_VERTEX, 0.0f};
+            if (kinds[from] == Kind::Locked)
+            {
+                return false;
+            }
+
+            Quadric quadric = quadrics[from];
+            quadric += quadrics[to];
+            float error = quadric.evaluate(points[to]);
+            float weight = quadric.weight;
+
+            if (kinds[from] == Kind::Seam)
+            {
+                if (to != openOut[from] && to != openIn[from])
+                {
+                    return false;
+                }
+                // The twin runs the seam the other way
+                const uint32_t twinFrom = twins[from];
+                const uint32_t twinTo = to == openOut[from] ? openIn[twinFrom] : openOut[twinFrom];
+                if (twinTo >= MANY_VERTICES || positions[twinTo] != positions[to])
+                {
+                    return false;
+                }
+                Quadric twinQuadric = quadrics[twinFrom];
+                twinQuadric += quadrics[twinTo];
+                error += twinQuadric.evaluate(points[twinTo]);
+                weight += twinQuadric.weight;
+                collapse.twinFrom = twinFrom;
+                collapse.twinTo = twinTo;
+            }
+
+            collapse.error = weight > 0.0f ? error / weight : 0.0f;
+            return true;
+        }
+
+        // Whether a triangle around from that survives the collapse would turn too far
+        bool flips(const uint32_t from, const uint32_t to) const
+        {
+            const glm::vec3 &target = vertices[to].position;
+            for (uint32_t i = offsets[from]; i < offsets[from + 1]; i++)
+            {
+                const uint32_t *corners = &indices[triangles[i] * 3];
+                glm::vec3 before[3];
+                glm::vec3 after[3];
+                bool removed = false;
+                for (uint32_t corner = 0; corner < 3; corner++)
+                {
+                    const uint32_t vertex = resolve(corners[corner]);
+                    removed = removed || positions[vertex] == positions[to];
+                    before[corner] = vertices[vertex].position;
+                    after[corner] = corners[corner] == from ? target : before[corner];
+                }
+                if (removed)
+                {
+                    continue;
+                }
+                // Degenerate triangles have no direction to keep, and none are made
+                const glm::vec3 normalBefore = triangleNormal(before[0], before[1], before[2]);
+                const glm::vec3 normalAfter = triangleNormal(after[0], after[1], after[2]);
+                const float lengthBefore = glm::length(normalBefore);
+                if (lengthBefore > 0.0f &&
+                    glm::dot(normalBefore, normalAfter) <= MIN_TURN_COSINE * lengthBefore * glm::length(normalAfter))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Triangles around from the collapse removes
+        uint32_t countShared(const uint32_t from, const uint32_t to) const
+        {
+            uint32_t count = 0;
+            for (uint32_t i = offsets[from]; i < offsets[from + 1]; i++)
+            {
+                const uint32_t *corners = &indices[triangles[i] * 3];
+                for (uint32_t corner = 0; corner < 3; corner++)
+                {
+                    if (positions[resolve(corners[corner])] == positions[to])
+                    {
+                        count++;
+                        break;
+                    }
+                }
+            }
+            return count;
+        }
+
+        // Where a vertex ended up after the collapses so far
+        uint32_t resolve(uint32_t vertex) const
+        {
+            while (collapseTargets[vertex] != vertex)
+            {
+                vertex = collapseTargets[vertex];
+            }
+            return vertex;
+        }
+
+        std::vector<uint32_t> indices;
+        const std::vector<ve::Mesh::Vertex> &vertices;
+        const size_t vertexCount;
+        float extent = 0.0f;
+
+        std::vector<Point> points;
+        std::vector<uint32_t> positions;
+        std::vector<uint32_t> twins;
+        std::vector<Quadric> quadrics;
+        std::vector<uint32_t> collapseTargets;
+        float squaredError = 0.0f;
+
+        // Rebuilt by every pass
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> triangles;
+        std::vector<uint32_t> openOut;
+        std::vector<uint32_t> openIn;
+        std::vector<Kind> kinds;
+    };
+}
+
+std::vector<MeshSimplifier::Level> MeshSimplifier::simplify(const std::vector<uint32_t> &indices,
+                                                            const std::vector<ve::Mesh::Vertex> &vertices,
+                                                            const uint32_t levelCount, const float ratio,
+                                                            const float maxError)
+{
+    std::vector<Level> levels;
+    if (indices.empty() || indices.size() % 3 != 0)
+    {
+        return levels;
+    }
+
+    // The quadrics carry on from level to level, so each level's error is measured against the full mesh
+    Simplifier simplifier(indices, vertices);
+    const float maxSquaredError = maxError * maxError;
+    size_t previousCount = indices.size();
+    while (levels.size() < levelCount)
+    {
+        const size_t targetCount = static_cast<size_t>(static_cast<float>(previousCount / 3) * ratio) * 3;
+        while (simplifier.getIndices().size() > targetCount && simplifier.pass(targetCount, maxSquaredError))
+        {
+        }
+
+        const size_t count = simplifier.getIndices().size();
+        if (count == 0 || static_cast<float>(count) > static_cast<float>(previousCount) * MAX_LEVEL_RATIO)
+        {
+            break;
+        }
+        levels.push_back({simplifier.getIndices(), simplifier.getError()});
+        previousCount = count;
+    }
+    return levels;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "../engine/graphics/mesh.hpp"
+
+// std
+#include <cstdint>
+#include <vector>
+
+// Import time level of detail generation. Edges are collapsed into one of their vertices in order of their quadric
+// error (Garland and Heckbert), measured over positions, normals and texture coordinates so that collapses which
+// smear shading or texturing cost as much as ones that bend the surface. Vertices on a border of the mesh are never
+// moved, which keeps meshes sharing an edge watertight at any mix of levels, and vertices on an attribute seam only
+// move along it, both of their copies at once.
+class MeshSimplifier
+{
+public:
+	struct Level
+	{
+		// Into the vertices the levels were built from, none are added or moved
+		std::vector<uint32_t> indices;
+		// How far the level strays from the full mesh, in the units of the positions
+		float error = 0.0f;
+	};
+
+	// Up to levelCount successively coarser triangle lists, each with about ratio times the indices of the one
+	// before. Stops early once a collapse would cost more than maxError, relative to the largest extent of the mesh,
+	// or once a level would not be worth its memory. The full list is not among the levels.
+	static std::vector<Level> simplify(const std::vector<uint32_t> &indices, const std::vector<ve::Mesh::Vertex> &vertices,
+	                                   uint32_t levelCount, float ratio, float maxError);
+};
@@ -0,0 +1,244 @@
+#include "meshletBuilder.hpp"
+
+// std
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+    constexpr uint32_t NO_TRIANGLE = UINT32_MAX;
+    // Unused triangles a meshlet without neighbours left looks through for the nearest one to continue with
+    constexpr uint32_t SEED_WINDOW = 64;
+    // Normals spread wider than about 84 degrees around the axis, a cone that loose would almost never cull
+    constexpr float MIN_CONE_COSINE = 0.1f;
+
+    // Triangles using each vertex, as slices of one array
+    struct Adjacency
+    {
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> triangles;
+
+        Adjacency(const std::vector<uint32_t> &indices, const size_t vertexCount)
+            : offsets(vertexCount + 1, 0), triangles(indices.size())
+        {
+            for (const uint32_t index : indices)
+            {
+                offsets[index + 1]++;
+            }
+            for (size_t vertex = 0; vertex < vertexCount; vertex++)
+            {
+                offsets[vertex + 1] += offsets[vertex];
+            }
+            std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < indices.size(); i++)
+            {
+                triangles[next[indices[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+        }
+    };
+
+    ve::Mesh::Cluster computeBounds(const uint32_t *indices, const size_t indexCount,
+                                    const std::vector<ve::Mesh::Vertex> &vertices, const bool backfaceCone)
+    {
+        ve::Mesh::Cluster cluster{};
+        glm::vec3 min(vertices[indices[0]].position);
+        glm::vec3 max = min;
+        for (size_t i = 1; i < indexCount; i++)
+        {
+            min = glm::min(min, vertices[indices[i]].position);
+            max = glm::max(max, vertices[indices[i]].position);
+        }
+        cluster.center = (min + max) * 0.5f;
+        float squaredRadius = 0.0f;
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            const glm::vec3 offset = vertices[indices[i]].position - cluster.center;
+            squaredRadius = std::max(squaredRadius, glm::dot(offset, offset));
+        }
+        cluster.radius = std::sqrt(squaredRadius);
+
+        if (!backfaceCone)
+        {
+            return cluster;
+        }
+
+        // The axis is the mean facing of the triangles, the cone has to hold every one of them. Degenerate triangles
+        // face nowhere and are never drawn.
+        std::vector<glm::vec3> normals;
+        normals.reserve(indexCount / 3);
+        glm::vec3 axis(0.0f);
+        for (size_t i = 0; i < indexCount; i += 3)
+        {
+            const glm::vec3 &a = vertices[indices[i]].position;
+            const glm::vec3 normal = glm::cross(vertices[indices[i + 1]].position - a,
+                                                vertices[indices[i + 2]].position - a);
+            const float length = glm::length(normal);
+            if (length > 0.0f)
+            {
+                normals.push_back(normal / length);
+                axis += normals.back();
+            }
+        }
+        const float axisLength = glm::length(axis);
+        if (normals.empty() || axisLength == 0.0f)
+        {
+            return cluster;
+        }
+        axis /= axisLength;
+
+        float minCosine = 1.0f;
+        for (const auto &normal : normals)
+        {
+            minCosine = std::min(minCosine, glm::dot(normal, axis));
+        }
+        if (minCosine <= MIN_CONE_COSINE)
+        {
+            return cluster;
+        }
+        // A view direction within 90 degrees minus the spread of the axis sees every triangle from behind
+        cluster.coneAxis = axis;
+        cluster.coneCutoff = std::sqrt(1.0f - minCosine * minCosine);
+        return cluster;
+    }
+}
+
+std::vector<ve::Mesh::Cluster> MeshletBuilder::build(std::vector<uint32_t> &indices,
+                                                     const std::vector<ve::Mesh::Vertex> &vertices,
+                                                     const bool backfaceCones)
+{
+    std::vector<ve::Mesh::Cluster> clusters;
+    const auto triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    if (triangleCount == 0)
+    {
+        return clusters;
+    }
+
+    const Adjacency adjacency(indices, vertices.size());
+    std::vector<glm::vec3> centroids(triangleCount);
+    for (uint32_t triangle = 0; triangle < triangleCount; triangle++)
+    {
+        centroids[triangle] = (vertices[indices[triangle * 3]].position +
+                               vertices[indices[triangle * 3 + 1]].position +
+                               vertices[indices[triangle * 3 + 2]].position) / 3.0f;
+    }
+
+    // Stamped with the meshlet being built, which tells its vertices and queued candidates from the others
+    std::vector<uint32_t> vertexStamps(vertices.size(), 0);
+    std::vector<uint32_t> candidateStamps(triangleCount, 0);
+    std::vector<bool> used(triangleCount, false);
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> reordered;
+    reordered.reserve(indices.size());
+
+    // Every triangle before the cursor is used
+    uint32_t cursor = 0;
+    uint32_t stamp = 0;
+    while (cursor < triangleCount)
+    {
+        stamp++;
+        const size_t first = reordered.size();
+        uint32_t vertexCount = 0;
+        uint32_t meshletTriangles = 0;
+        glm::vec3 centroidSum(0.0f);
+        candidates.clear();
+
+        uint32_t triangle = cursor;
+        while (triangle != NO_TRIANGLE)
+        {
+            used[triangle] = true;
+            meshletTriangles++;
+            centroidSum += centroids[triangle];
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                const uint32_t vertex = indices[triangle * 3 + corner];
+                reordered.push_back(vertex);
+                if (vertexStamps[vertex] == stamp)
+                {
+                    continue;
+                }
+                vertexStamps[vertex] = stamp;
+                vertexCount++;
+                for (uint32_t i = adjacency.offsets[vertex]; i < adjacency.offsets[vertex + 1]; i++)
+                {
+                    const uint32_t neighbour = adjacency.triangles[i];
+                    if (!used[neighbour] && candidateStamps[neighbour] != stamp)
+                    {
+                        candidateStamps[neighbour] = stamp;
+                        candidates.push_back(neighbour);
+                    }
+                }
+            }
+            if (meshletTriangles == MAX_TRIANGLES)
+            {
+                break;
+            }
+
+            // The neighbour adding the fewest vertices, the earliest one of those
+            triangle = NO_TRIANGLE;
+            uint32_t bestNewVertices = 4;
+            size_t kept = 0;
+            for (const uint32_t candidate : candidates)
+            {
+                if (used[candidate])
+                {
+                    continue;
+                }
+                candidates[kept++] = candidate;
+                uint32_t newVertices = 0;
+                for (uint32_t corner = 0; corner < 3; corner++)
+                {
+                    newVertices += vertexStamps[indices[candidate * 3 + corner]] != stamp ? 1 : 0;
+                }
+                if (vertexCount + newVertices <= MAX_VERTICES &&
+                    (newVertices < bestNewVertices || (newVertices == bestNewVertices && candidate < triangle)))
+                {
+                    triangle = candidate;
+                    bestNewVertices = newVertices;
+                }
+            }
+            candidates.resize(kept);
+
+            // Out of neighbours, the meshlet goes on with the nearest of the next unused triangles, which shares
+            // none of its vertices
+            if (candidates.empty() && vertexCount + 3 <= MAX_VERTICES)
+            {
+                while (cursor < triangleCount && used[cursor])
+                {
+                    cursor++;
+                }
+                const glm::vec3 centroid = centroidSum / static_cast<float>(meshletTriangles);
+                float bestDistance = FLT_MAX;
+                uint32_t looked = 0;
+                for (uint32_t next = cursor; next < triangleCount && looked < SEED_WINDOW; next++)
+                {
+                    if (used[next])
+                    {
+                        continue;
+                    }
+                    looked++;
+                    const glm::vec3 offset = centroids[next] - centroid;
+                    const float distance = glm::dot(offset, offset);
+                    if (distance < bestDistance)
+                    {
+                        triangle = next;
+                        bestDistance = distance;
+                    }
+                }
+            }
+        }
+
+        while (cursor < triangleCount && used[cursor])
+        {
+            cursor++;
+        }
+
+        auto cluster = computeBounds(reordered.data() + first, reordered.size() - first, vertices, backfaceCones);
+        cluster.firstIndex = static_cast<uint32_t>(first);
+        cluster.indexCount = static_cast<uint32_t>(reordered.size() - first);
+        clusters.push_back(cluster);
+    }
+
+    indices.swap(reordered);
+    return clusters;
+}
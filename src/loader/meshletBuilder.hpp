@@ -0,0 +1,26 @@
+#pragma once
+
+#include "../engine/graphics/mesh.hpp"
+
+// std
+#include <cstdint>
+#include <vector>
+
+// Import time partitioning of an indexed triangle list into meshlets, small clusters of neighbouring triangles that
+// the draw culling tests one by one. Each meshlet is a contiguous run of the reordered indices, so it is drawn with
+// an ordinary indexed draw and needs no mesh shaders.
+class MeshletBuilder
+{
+public:
+	// Sized for the vertex batches of current GPUs, and to match the usual mesh shader limits
+	static constexpr uint32_t MAX_VERTICES = 64;
+	static constexpr uint32_t MAX_TRIANGLES = 124;
+
+	// Groups the triangles into meshlets and reorders the indices meshlet by meshlet. Triangles are added to a
+	// meshlet while they share its vertices, preferring the ones adding the fewest and then the ones earliest in the
+	// given order, which keeps a vertex cache optimized order mostly intact. The meshlets' first indices are
+	// relative to the start of the indices. Without backfaceCones none of them get a cone, for double sided
+	// materials.
+	static std::vector<ve::Mesh::Cluster> build(std::vector<uint32_t> &indices,
+	                                            const std::vector<ve::Mesh::Vertex> &vertices, bool backfaceCones);
+};
@@ -1,14 +1,73 @@
 #include "scenes/sponza.hpp"
 #include "log.hpp"
+#include "engine/settings.hpp"
+#include "engine/profiling/cpuProfiler.hpp"
+#include "benchmark/accessorBenchmark.hpp"
+#include "benchmark/cullingBenchmark.hpp"
+#include "benchmark/gltfParseBenchmark.hpp"
+#include "benchmark/jobsBenchmark.hpp"
+#include "engine/jobs/jobSystem.hpp"
 
-int main()
+int main(int argc, char **argv)
 {
-    ve::Window &window = ve::Window::getInstance({1920, 1080});
-    ve::Scene &scene = Sponza::getInstance(window);
-
     try
     {
+        const auto options = ve::LaunchOptions::parse(argc, argv);
+
+        if (options.benchJobs)
+        {
+            ve::JobsBenchmark::run();
+            return EXIT_SUCCESS;
+        }
+
+        // Created here so this thread is the job system's main thread
+        ve::JobSystem::setThreadCount(options.threadCount);
+        ve::JobSystem::getInstance();
+
+        if (options.benchCulling)
+        {
+            ve::CullingBenchmark::run();
+            return EXIT_SUCCESS;
+        }
+
+        if (options.benchGltfParse)
+        {
+            ve::GltfParseBenchmark::run(Sponza::GLTF_PATH);
+            return EXIT_SUCCESS;
+        }
+
+        if (options.benchAccessors)
+        {
+            ve::AccessorBenchmark::run();
+            return EXIT_SUCCESS;
+        }
+
+        if (!options.tracePath.empty())
+        {
+            ve::CpuProfiler::setThreadName("Main");
+            ve::CpuProfiler::setEnabled(true);
+        }
+
+        if (options.benchmark)
+        {
+            // Frame times capped by the display are useless for comparing builds
+            ve::Settings::getInstance()->VSYNC = false;
+            ve::Settings::update();
+        }
+
+        ve::Window *window = nullptr;
+        if (!options.headless)
+        {
+            window = &ve::Window::getInstance({static_cast<int>(options.extent.width), static_cast<int>(options.extent.height)});
+        }
+
+        ve::Scene &scene = Sponza::getInstance(window, options);
         scene.run();
+
+        if (!options.tracePath.empty())
+        {
+            ve::CpuProfiler::exportChromeTrace(options.tracePath);
+        }
     }
     catch (const std::exception &e)
     {
@@ -5,29 +5,137 @@
 #include "sponza.hpp"
 
 #include "../loader/gltfLoader.hpp"
+#include "../benchmark/bvhBenchmark.hpp"
+#include "../window/window.hpp"
 
-ve::Scene &Sponza::getInstance(ve::Window &window) {
+#include "imgui.h"
+
+ve::Scene &Sponza::getInstance(ve::Window *window, const ve::LaunchOptions &options) {
     if (instance == nullptr) {
-        instance = new Sponza(window);
+        instance = new Sponza(window, options);
     }
     return *instance;
 }
 
-Sponza::Sponza(ve::Window& window) : Scene(window) {}
+static glm::mat4 viewProjection(const Camera &camera)
+{
+    const auto cameraData = camera.getCameraBufferData();
+    return cameraData.projection * cameraData.view;
+}
+
+Sponza::Sponza(ve::Window *window, const ve::LaunchOptions &options) : Scene(window, options) {}
 
 void Sponza::init()
 {
-    GLTFLoader sceneLoader(device, "Sponza/NewSponza_Main_glTF_002.gltf");
+    GLTFLoader sceneLoader(device, GLTF_PATH);
+    if (!getOptions().meshStatsPath.empty()) {
+        sceneLoader.writeOptimizationReport(getOptions().meshStatsPath);
+    }
 
     sceneLoader.loadLights(device);
 
     srp = std::make_unique<SceneRenderProgram>(device, renderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout());
 	srp->addRenderTargets(sceneLoader.loadRenderTargets(device));
+
+    if (getOptions().benchBvh) {
+        runBvhBenchmark();
+    }
+}
+
+void Sponza::runBvhBenchmark()
+{
+    // Views and rays along the benchmark camera path, rays through a grid of pixels of every view
+    constexpr uint32_t VIEW_COUNT = 64;
+    constexpr uint32_t RAY_GRID = 8;
+    const auto path = createBenchmarkPath();
+    const auto extent = getOptions().extent;
+    camera.resize(extent.width, extent.height);
+
+    std::vector<glm::mat4> viewProjections;
+    std::vector<ve::Bvh::Ray> rays;
+    for (uint32_t i = 0; i < VIEW_COUNT; i++) {
+        const auto [position, target] = path->sample(path->getDuration() * static_cast<float>(i) / VIEW_COUNT);
+        camera.setPose(position, target - position);
+        camera.update(0.0f);
+        viewProjections.push_back(viewProjection(camera));
+
+        for (uint32_t y = 0; y < RAY_GRID; y++) {
+            for (uint32_t x = 0; x < RAY_GRID; x++) {
+                const glm::vec2 pixel = (glm::vec2(x, y) + 0.5f) / static_cast<float>(RAY_GRID) *
+                                        glm::vec2(extent.width, extent.height);
+                ve::Bvh::Ray ray{};
+                camera.getRay(pixel, ray.origin, ray.direction);
+                rays.push_back(ray);
+            }
+        }
+    }
+
+    ve::BvhBenchmark::run(srp->getDrawBoxes(), viewProjections, rays);
 }
 
 void Sponza::update(const float deltaTime) {}
 
+void Sponza::preRender(ve::FrameInfo& frameInfo)
+{
+    // Vulkan projections flip y, the scale is the same either way
+    const float pixelsPerUnit =
+        glm::abs(camera.getProjection()[1][1]) * static_cast<float>(renderer.getSwapChainExtent().height) * 0.5f;
+    srp->cullScene(frameInfo, viewProjection(camera), camera.getPosition(), pixelsPerUnit);
+}
+
 void Sponza::render(ve::FrameInfo& frameInfo)
 {
     srp->renderScene(frameInfo);
 }
+
+void Sponza::postRender(ve::FrameInfo& frameInfo)
+{
+    srp->buildDepthPyramid(frameInfo, renderer.getCurrentDepthImageView(), renderer.getSwapChainExtent(),
+                           viewProjection(camera));
+}
+
+void Sponza::renderStats() const
+{
+    if (srp->isCulling()) {
+        const auto &stats = srp->getCullingStats();
+        ImGui::Text("Draws: %u frustum culled, %u occlusion culled, %u too small of %u",
+                    stats.frustumCulled, stats.occlusionCulled, stats.sizeCulled, stats.drawCount);
+        ImGui::Text("Clusters: %u culled, %u backfacing", stats.clustersCulled, stats.clustersBackfacing);
+        ImGui::Text("Commands: %u, triangles: %u", stats.visible, stats.triangles);
+    } else if (srp->isCpuCulling()) {
+        const auto &stats = srp->getCpuCullingStats();
+        ImGui::Text("Draws: %u visible, %u too small of %u, culled on the CPU (%s) in %.3f ms",
+                    stats.visible, stats.sizeCulled, stats.drawCount,
+                    stats.hierarchy ? "BVH" : ve::FrustumCuller::getPathName(stats.path), stats.milliseconds);
+        ImGui::Text("Triangles: %llu", static_cast<unsigned long long>(stats.triangles));
+    }
+
+    if (picked.has_value()) {
+        ImGui::Text("Picked: object %u, mesh %u at %.2f", picked->object, picked->mesh, picked->distance);
+    }
+}
+
+void Sponza::onMouseBtnPress(const int mouseX, const int mouseY, const int button, int mods)
+{
+    if ((button & (1 << GLFW_MOUSE_BUTTON_LEFT)) == 0 || ImGui::GetIO().WantCaptureMouse) {
+        return;
+    }
+
+    glm::vec3 origin;
+    glm::vec3 direction;
+    camera.getRay({static_cast<float>(mouseX) + 0.5f, static_cast<float>(mouseY) + 0.5f}, origin, direction);
+    picked = srp->pick(origin, direction);
+}
+
+std::unique_ptr<ve::CameraPath> Sponza::createBenchmarkPath() const
+{
+    // Down the nave at head height, up into the gallery and back through the side aisle
+    return std::make_unique<ve::CameraPath>(std::vector<ve::CameraPath::Keyframe>{
+        {{-9.0f, 1.7f,  0.0f}, { 0.0f, 2.0f,  0.0f}},
+        {{-3.0f, 1.7f,  2.5f}, { 3.0f, 3.0f,  0.0f}},
+        {{ 4.0f, 1.7f,  2.5f}, { 9.0f, 2.0f,  0.0f}},
+        {{ 9.0f, 3.0f,  0.0f}, { 0.0f, 4.0f,  0.0f}},
+        {{ 4.0f, 6.0f, -3.0f}, {-4.0f, 2.0f,  0.0f}},
+        {{-4.0f, 1.7f, -2.5f}, {-9.0f, 2.0f,  0.0f}},
+    }, 30.0f);
+}
@@ -10,18 +10,32 @@
 class Sponza : public ve::Scene
 {
 public:
-    explicit Sponza(ve::Window &window);
+    static constexpr const char *GLTF_PATH = "Sponza/NewSponza_Main_glTF_002.gltf";
+
+    Sponza(ve::Window *window, const ve::LaunchOptions &options);
     ~Sponza() = default;
 
     Sponza(const Sponza &) = delete;
     Sponza &operator=(const Sponza &) = delete;
 
-    static ve::Scene &getInstance(ve::Window &window);
+    static ve::Scene &getInstance(ve::Window *window, const ve::LaunchOptions &options);
 
     void init() override;
     void update(float deltaTime) override;
+    void preRender(ve::FrameInfo &frameInfo) override;
     void render(ve::FrameInfo &frameInfo) override;
+    void postRender(ve::FrameInfo &frameInfo) override;
+    void renderStats() const override;
+    std::string getName() const override { return "Sponza"; }
+    std::unique_ptr<ve::CameraPath> createBenchmarkPath() const override;
+
+protected:
+    // Left clicks pick the mesh under the cursor
+    void onMouseBtnPress(int mouseX, int mouseY, int button, int mods) override;
 
 private:
+    void runBvhBenchmark();
+
     std::unique_ptr<SceneRenderProgram> srp;
+    std::optional<SceneRenderProgram::Pick> picked;
 };
@@ -9,6 +9,7 @@
 #include <vector>
 
 #include "engine/device.hpp"
+#include "engine/profiling/cpuProfiler.hpp"
 
 namespace ve {
     static void createShaderModule(Device& device, const std::vector<char>& code, VkShaderModule* shaderModule) {
@@ -64,16 +65,16 @@ namespace ve {
         std::chrono::time_point<std::chrono::high_resolution_clock> m_Start;
     };
 
+    // Records its lifetime as a CPU profiler scope, VE_PROFILE_SCOPE avoids interning the name
     class ScopedTimer
     {
     public:
-        explicit ScopedTimer(std::string  name): m_Name(std::move(name)) {}
-        ~ScopedTimer()
-        {
-            float time = m_Timer.ElapsedMillis();
-        }
+#ifdef VE_ENABLE_PROFILING
+        explicit ScopedTimer(const std::string& name): m_Scope(CpuProfiler::isEnabled() ? CpuProfiler::intern(name) : "") {}
     private:
-        std::string m_Name;
-        Timer m_Timer;
+        CpuProfiler::Scope m_Scope;
+#else
+        explicit ScopedTimer(const std::string&) {}
+#endif
     };
 }